@@ -21,89 +21,215 @@ The <device_address> and <encryption_key> can found in the device Settings via:
 
 Settings (cog) >  3 dots (top right) > Product-Info > scroll down > encryption key  
 
-The target device must be nominated in VBM.h as follows: 
-#define VICTRON_ADDRESS <device_address>
-#define VICTRON_NAME    <device_name>
-If you are using this code for several monitors, you can enable the loadKey() function to 
-load the required encryption key by adding the <device_name> for each monitor into loadKey().
-
-The <encryption key> unique to the device must be declared as the 16 byte array key_BM[] in VBM.cpp
+The target devices can be listed in devices[] in VBM.cpp, one line per monitor:
+  {<device_address>, <device_name>, {<encryption_key>}},
+or, with no rebuild for a new site, written to a config blob by host/mkconfig and sent over Serial
+("U", then the blob): it is kept in NVS and used in place of devices[] from then on, with its flags
+and dud test settings if any. See VictronCore/VConfig.h
+Any number of monitors (up to VDEV_MAX = 32) can be read at once. Each key schedule is 
+prepared once at startup, and each advertisement is matched to its device by address.
 
 NB: <device_address> and <encryption_key> must be lower case. 
 
 If device is reporting some dud readings, where the values reported are clearly wrong or corrupted, you can 
 turn FILTERING on to suppress dud readings. To temporarily enable filtering, enter F at the Serial Monitor 
-while the sketch is running. For permanent filtering set bool FILTERING = false in ZZ.cpp before compiling.
-The filtering relies on the user nominating appropriate preferences/threshholds in VBM.h for:
+while the sketch is running. For permanent filtering set bool FILTERING = true in ZZ.cpp before compiling,
+or in a config blob with flags (host/mkconfig), which then decides it.
+A value is a dud if it is out of line with the monitor's own recent readings (more than k spreads from the
+median of the last few), or outside hard limits wide enough for 12, 24 & 48 V systems, so no thresholds need
+setting for the site. A genuine step (a load switched on) is followed from its second reading. Duds are always
+flagged and counted; with FILTERING the values of a reading with any are not printed, only the flag, and the
+reading is left out of the summaries and binary records. See VictronCore/VOutlier.h; the settings are
+outlierCfg in VBM.cpp (or the config blob's), K steps k at runtime.
+Still nominate in VBM.h:
   EXPECTED_AUX_MODE (auxilliary input selection)
-  BATTV_MAX / MIN   (battery Volts)
-  BATTA_MAX / MIN   (battery Amps)
-  AVAL_ MAX / MIN   (Volts or Kelvin, depending on aux setting)
-  AH_MAX            (Amp-Hours of yield)
-  PVW_MAX           (Photo-Voltaic Watts - panel power )
-  SOC_MAX / MIN     (State of Charge)
-The current preferences/threshholds are setup for a 24V system.
 
 ---------------------------------------------------------------------------------------------------
 Once the progam is running entering "V" at the Serial Monitor toggles VERBOSE mode between more/less detailed status/info
+Entering "S" prints the counters kept all the time (adverts, frames, repeats, missed updates, duds ...), see printStats()
+Entering "M" steps the scan mode: continuous (default), adaptive windows, start/stop, see setScanMode()
+Entering "L" prints the p50/p99/max time of each stage, decrypt to Serial, as JSON lines, see printLatency()
+Entering "C" starts streaming the raw advertisements out in binary (a capture for host/replay), see setCapture()
+Entering "H" prints a summary of the reading history kept in RAM (HISTORY_BYTES), see printHistory()
+Entering "E" prints the energy & charge in and out integrated per monitor, the rates, and the drift of the net
+Ah from the monitor's consumed Ah, see printEnergy() and VictronCore/VEnergy.h
+Entering "A" steps the output from every reading to 1 sec, 1 min or 1 hour summaries of volts, amps and
+SOC (min/mean/max and last value in each window), and back, see VictronCore/VAggregate.h
+Entering "K" steps the dud test between k = 5, 8, 3 spreads and hard limits only, and prints its settings and
+what it has flagged per monitor, see stepDudTest()
+Entering "U" takes a config blob from host/mkconfig (within 2 secs), keeps it in NVS and restarts, see uploadConfig()
+Entering "B" switches the output to binary, a COBS framed record per reading (~27 bytes, not ~80) for host/wiredump,
+and back, see setBinary()
 */
 
 #include "ZZ.h"
 #include "VBM.h" // Victron Battery Monitor
 
-int scan_gap_ms   = 500;    // delay between scans 
-int scan_max_secs = 2;      // maximum scan timeout
+int scan_gap_ms   = 500;    // delay between scans (start/stop mode)
+int scan_max_secs = 2;      // maximum scan timeout (start/stop mode), 'not found' timeout (all modes)
+
+AdDataCallback adCallback;
+bool     scanContinuous = false;   // scan mode currently running, see setScanMode()   (intake task)
+bool     scanAdaptive   = false;
+bool     scanOn         = false;   // adaptive & start/stop modes: a scan is running
+uint32_t scanMs         = 0;       // start/stop mode: scan started or stopped
+bool     capturing      = false;   // capture running, see setCapture()                (loop)
+bool     binaryOut      = false;   // binary output running, see setBinary()           (loop)
+uint32_t announceMs     = 0;       // binary output: device records last sent
+uint32_t lastReadingMs  = 0;       // time of last reading, or 'not found' report
+uint32_t readings       = 0;       // readings reported since rateStartMs
+uint32_t rateStartMs    = 0;
+bool     rateContinuous = false;   // scan mode the rate is for, see printRate()
+bool     rateAdaptive   = false;
+uint32_t rateOnMs       = 0;       // sched.onMs & totalMs at rateStartMs
+uint32_t rateTotalMs    = 0;
 
 void setup() {
   Serial.begin(115200);
   while (!Serial && millis() < 2000);                         // wait for serial, up to 2 sec
   Serial << F("\n\n======== Battery Monitor ========\n");
   Serial << F("* wolfssl  : V") << LIBWOLFSSL_VERSION_STRING << '\n';  
-  Serial << F("* Target   : ")  << VICTRON_NAME << '\n';
+  loadDevices();
+  initRing(rxRing);
+  initRing(frameRing);
+  initIntake(intake, rxRing, frameRing, targets, &sched);
+  Serial << F("* Targets  : ")  << targets.count << F(" ->");
+  for (int i = 0; i < targets.count; i++) Serial << ' ' << targets.dev[i].name;
+  Serial << '\n';
+  Serial << F("* CONFIG   : ") << configSource << F(", loaded in ") << configUs << F(" us\n");
+  Serial << F("\tEnter U then send a config blob (host/mkconfig) to keep in NVS and restart with it\n");
   Serial << F("* VERBOSE  : "); if (VERBOSE)   Serial << F("ON\n"); else Serial << F("OFF\n");
   Serial << F("* FILTERING: "); if (FILTERING) Serial << F("ON\n"); else Serial << F("OFF\n");
   Serial << F("\tEnter V to toggle VERBOSE mode ON/OFF\n");
+  Serial << F("\tEnter S to print the STATS: adverts, frames, repeats, IV gaps, duds, key fails per target\n");
   Serial << F("\tEnter F to toggle FILTERING of dud readings ON/OFF\n");
+  Serial << F("\tEnter K to step the dud test: k = 5 / 8 / 3 spreads from the median, hard limits only\n");
   Serial << F("* init BLE ...\n");
   BLEDevice::init("");
   Serial << F("* setup scan ...\n");
   pBLEScan = BLEDevice::getScan();                             // new line to prevent crash dumps!
-  pBLEScan->setAdvertisedDeviceCallbacks(new AdDataCallback());
+  pBLEScan->setAdvertisedDeviceCallbacks(&adCallback, true, false);  // every advertisement, not just the first per scan. Not parsed: onResult() reads the raw payload
   pBLEScan->setActiveScan(true);                               // uses more power, but get results faster
-  Serial << F("* scan for devices every ") << scan_gap_ms << F(" ms (and up to ") << scan_max_secs << F(" secs/scan)\n");
+  Serial << F("* SCAN MODE: "); if (CONTINUOUS) Serial << F("continuous\n"); else if (ADAPTIVE) Serial << F("adaptive\n"); else Serial << F("start/stop\n");
+  Serial << F("\tEnter M to step scan MODE continuous / adaptive / start-stop (every ") << scan_gap_ms << F(" ms, up to ") << scan_max_secs << F(" secs/scan)\n");
+  Serial << F("* HISTORY  : ") << HISTORY_BYTES / 1024 << F(" KB\n");
+  Serial << F("\tEnter H to print the reading HISTORY summary\n");
+  Serial << F("\tEnter E to print the ENERGY in & out, rates & drift vs the device's own count, per target\n");
+  Serial << F("* AGGREGATE: ") << aggModes[AGGREGATE] << '\n';
+  Serial << F("\tEnter A to step through 1 sec / 1 min / 1 hour summaries (min/mean/max (last)) instead of every reading\n");
+  Serial << F("\tEnter L to print the LATENCY of each stage (p50/p99/max, JSON)\n");
+  Serial << F("\tEnter C to start / end a binary CAPTURE of the raw advertisements, for host/replay\n");
+  Serial << F("\tEnter B to start / end BINARY output, a framed record per reading, for host/wiredump\n");
+  rateStartMs    = millis();
+  rateContinuous = CONTINUOUS;
+  rateAdaptive   = ADAPTIVE;
+  if (!startTask(intakeTask, nullptr, "intake", VPIPE_INTAKE_CORE, VPIPE_STACK, VPIPE_PRIORITY, &intakeHandle)) {   // runs the scan from here on
+    Serial << F("\n\n *** Program HALTED: intake task not started\n");
+    while(1);
+  }
+  Serial << F("* PIPELINE : scan & intake on core ") << VPIPE_INTAKE_CORE << F(", decrypt/decode/output (loop) on core ") << taskCore() << '\n';
   Serial << CF(dashes) << F("setup done") << CF(dashes) << '\n';
   displayHeadings();
 } 
 
 uint32_t loopCount = 0;
+VFrame   batch[VRING_SIZE];                         // readings taken from frameRing by one loop()
+byte     plain[VRING_SIZE][16];                     // ... decrypted in one pass, see decryptFrames()
+bool     decrypted[VRING_SIZE];
 
 void loop(){
-  loopCount++; 
   processSerialCommands();
-  mfrDataReceived = false; 
-  pBLEScan->start(scan_max_secs, false);
-  delay(scan_gap_ms);
-  if (VERBOSE) Serial << '\n';
-  printLoopCount();
-  if(mfrDataReceived) {
-    if (VERBOSE) {
-      Serial << CF(line);
-      Serial <<  F("data  : "); printBIGarray(); Serial << '\n';
+  if (UPLOAD) {uploadConfig(); UPLOAD = false;}              // U entered: the blob follows, before anything else reads Serial
+  if (CAPTURE != capturing) setCapture();                   // C entered
+  if (BINARY != binaryOut) setBinary();                     // B entered
+  if (binaryOut && millis() - announceMs >= VWIRE_ANNOUNCE_MS) writeDevices();   // names for a reader joining late
+  if (CONTINUOUS != rateContinuous || ADAPTIVE != rateAdaptive) printRate(true);   // M entered: the intake task changes the scan
+  if (STATS) {printStats(); STATS = false;}                 // S entered
+  if (HISTORY) {printHistory(); HISTORY = false;}           // H entered
+  if (ENERGY) {printEnergy(); ENERGY = false;}              // E entered
+  if (LATENCY) {printLatency(); LATENCY = false;}           // L entered
+  if (DUDTEST) {stepDudTest(); DUDTEST = false;}            // K entered
+  if (!capturing) tickAggregates(millis());                 // summaries of windows with no reading since
+  int n = ringPop(frameRing, batch, VRING_SIZE);            // the batches passed on by the intake task since last time
+  if (capturing) {writeCapture(batch, n); if (!n) delay(1); return;}   // raw frames only, nothing else printed
+  if (n == 0) {                                             // nothing new
+    if (mfrRepeat) {                                        // target still there, just no new data
+      lastReadingMs = millis();
+      mfrRepeat     = false;
     }
-    decryptAesCtr(VERBOSE);
+    if (millis() - lastReadingMs < scan_max_secs * 1000UL) {delay(1); return;}
+    if (!CONTINUOUS && ADAPTIVE && !schedSilent(sched)) {delay(1); return;}   // adaptive: not until every target misses its windows
+    reportNotFound();
+  }
+  uint32_t c0 = ESP.getCycleCount();
+  if (n) decryptFrames(targets, batch, n, plain, decrypted);   // the whole batch, any mix of devices, in one pass
+  uint32_t share = n ? (ESP.getCycleCount() - c0) / n : 0;     // decrypt cycles per frame
+  for (int i = 0; i < n; i++) reportFrame(batch[i], plain[i], decrypted[i], share);
+  if (n) precomputeKeystreams(targets, VDEV_MAX);           // while idle, prepare keystreams for the next IVs
+  lastReadingMs = millis();
+  printRate(false);
+}
+
+// decode & report one reading from the ring, decrypted (ok) into plain in decryptCycles
+void reportFrame(const VFrame &f, const byte plain[16], bool ok, uint32_t decryptCycles){
+  bool quiet = (AGGREGATE && !VERBOSE) || binaryOut;        // summaries only, printed as windows close, or binary records
+  loopCount++; 
+  if (VERBOSE) Serial << '\n';
+  if (!quiet) printLoopCount();
+  loadFrame(f, plain);
+  if (VERBOSE) {
+    Serial << CF(line);
+    Serial <<  F("data  : "); printBIGarray(); Serial << '\n';
+    Serial <<  F("rssi  : ") << f.rssi << F(" dBm, queued ") << millis() - f.ms << F(" ms\n");
+  }
+  uint32_t c0 = ESP.getCycleCount();
+  if (decryptAesCtr(VERBOSE, ok)) {
+    uint16_t iv = f.data[VMFR_IV] | (f.data[VMFR_IV + 1] << 8);
+    statsFrame(stats, rxDevice - targets.dev, iv, f.ms);
+    if (!firstReadingMs) firstReadingMs = millis();
+    latRecord(lat[VST_DECRYPT], decryptCycles);                 // its share of the batch, decrypted in loop()
     if (VERBOSE) {
+      uint32_t hits, misses, accepted, suppressed;
+      keystreamStats(targets, hits, misses);
+      dedupStats(targets, accepted, suppressed);
       Serial << F("output: "); printByteArray(output); Serial << '\n';
+      Serial << F("cache : ") << hits << F(" keystream hits, ") << misses << F(" misses\n");
+      Serial << F("frames: ") << accepted << F(" accepted, ") << suppressed << F(" repeats suppressed\n");
+      Serial << F("ring  : ") << rxRing.pushed << F(" queued, ") << rxRing.dropped << F(" dropped (full), max depth ")
+             << rxRing.maxDepth << '/' << VRING_SIZE << F(", to loop() ") << intake.batches << F(" batches (max ")
+             << intake.maxBatch << F(")\n");
+      uint32_t calls, maxCycles;
+      uint64_t cycles;
+      callbackStats(calls, cycles, maxCycles);
+      Serial << F("callbk: ") << calls << F(" adverts, ") << _FLOAT(cycles / (float)ESP.getCpuFreqMHz() / (calls ? calls : 1), 2)
+             << F(" us avg, ") << _FLOAT(maxCycles / (float)ESP.getCpuFreqMHz(), 2) << F(" us max\n");
     //Serial << F("binary:\n");     printBins(output); Serial << '\n';
       Serial << F("values: "); 
     }
-  reportBMvalues();
+    reportBMvalues();
+    if (!VERBOSE && (!quiet || binaryOut)) latRecord(lat[VST_FRAME], ESP.getCycleCount() - c0 + decryptCycles);
+    readings++;
   }
   else {
-    Serial << '\t';
-    if (VERBOSE) Serial << F("** No device matching ") << VICTRON_ADDRESS << F(" found during last scan ** "); //(" << t2-t1 << ")";
-    else         Serial << F("** Target device not found **");
+    stats.dev[rxDevice - targets.dev].keyFails++;
+    if (binaryOut) return;                                  // counted only, see S
+    if (quiet) printLoopCount();
+    Serial << F("\t**FAIL** key does not match ") << rxDevice->name;
+    quiet = false;
   }
-  Serial << '\n';   
+  if (!quiet) Serial << '\n';
+}
+
+void reportNotFound(){
+  stats.notFound++;
+  if (binaryOut) return;                                    // counted only, see S
+  loopCount++; 
+  if (VERBOSE) Serial << '\n';
+  printLoopCount();
+  Serial << '\t';
+  if (VERBOSE) Serial << F("** No target device found during last scan ** ");
+  else         Serial << F("** Target device not found **");
+  Serial << '\n';
 }
 
 void displayHeadings(){
@@ -117,3 +243,135 @@ void printLoopCount(){
   Serial << loopCount; 
   if (VERBOSE) Serial << F(" ");  
 }
+
+// Capture mode: every advertisement from a target, repeats included, is streamed out in binary after a
+// "VCAP" header (see VictronCore/VCapture.h), and nothing else is printed until C is entered again.
+// Save it with a terminal program, not the Serial Monitor, then run it through host/replay
+void setCapture(){
+  uint8_t buf[VCAP_HEADER];
+  if (CAPTURE) {
+    Serial << F("\nCAPTURE - ON, binary from here: enter C to end\n");
+    Serial.write(buf, captureHeader(buf));
+  }
+  else {
+    buf[0] = VCAP_END;
+    Serial.write(buf, 1);
+    Serial << F("\nCAPTURE - off\n\n");
+  }
+  capturing = CAPTURE;
+}
+
+// Binary mode: each reading goes out as one record (see VictronCore/VWire.h), COBS framed and CRC checked,
+// in place of the report line: a third of the bytes, so 3x the readings fit through the UART. Duds are sent
+// flagged, not filtered (unless FILTERING). The device records, index -> address & name, go first and every
+// VWIRE_ANNOUNCE_MS. VERBOSE goes off, and nothing else is printed until B is entered again. Save the output
+// with a terminal program, or read the port with host/wiredump
+void setBinary(){
+  if (BINARY) {
+    Serial << F("\nBINARY - ON, COBS framed records from here: enter B to end\n");
+    VERBOSE = false;
+    Serial.write(static_cast<uint8_t>(0));                  // ends the text as a frame of its own
+    writeDevices();
+  }
+  else Serial << F("\nBINARY - off\n\n");
+  binaryOut = BINARY;
+}
+
+// binary mode: a device record per target
+void writeDevices(){
+  uint8_t rec[VWIRE_FRAME_MAX];
+  for (int i = 0; i < targets.count; i++)
+    Serial.write(rec, wireDevice(rec, i, millis(), targets.dev[i].mac, targets.dev[i].name));
+  announceMs = millis();
+}
+
+// frames from the ring as capture records
+void writeCapture(const VFrame *f, int n){
+  uint8_t rec[VCAP_RECORD_MAX];
+  for (int i = 0; i < n; i++) Serial.write(rec, captureFrame(f[i], rec));
+}
+
+// ---- intake task, pinned to VPIPE_INTAKE_CORE with the BLE stack (see VictronCore/VPipeline.h) -----
+// Runs the scan, and passes the new frames the callback queued on to loop() in batches, learning the
+// adaptive windows from them. It never prints, so the scan keeps time however long loop() waits on Serial
+void intakeTask(void *){
+  setScanMode();
+  for (;;) {
+    if (CONTINUOUS != scanContinuous || ADAPTIVE != scanAdaptive) setScanMode();   // M entered
+    int n = intakeStep(intake);
+    if (!CONTINUOUS) {
+      if (ADAPTIVE) scanWindow();
+      else          scanStartStop(n > 0);
+    }
+    taskSleep(1);
+  }
+}
+
+// Start/stop mode: scans of up to scan_max_secs, each stopped on the first reading, scan_gap_ms apart, see scanStartStop().
+// Continuous mode: one scan runs forever, listening all the time, and loop() reports each reading as it arrives.
+// Adaptive mode: as continuous, but the scan only runs in windows around each target's next update, see scanWindow().
+void setScanMode(){
+  if (scanContinuous || scanOn) pBLEScan->stop();
+  scanOn = false;
+  scanMs = millis() - scan_gap_ms;                            // start/stop: first scan at once
+  scanContinuous = CONTINUOUS;
+  scanAdaptive   = ADAPTIVE;
+  if (CONTINUOUS || ADAPTIVE) {
+    pBLEScan->setInterval(100);
+    pBLEScan->setWindow(100);                                 // window = interval: radio listens 100% of the time
+    if (CONTINUOUS) {
+      pBLEScan->start(0, nullptr, false);                     // 0 = never ends, returns at once
+      stats.scanStarts++;
+    }                                                         // adaptive: started & stopped by scanWindow()
+  }
+  else {
+    pBLEScan->setInterval(50);                                // ESP32 core defaults
+    pBLEScan->setWindow(30);
+  }
+}
+
+// Adaptive mode: start the scan as a window opens, stop it when none is open (see VictronCore/VSchedule.h)
+void scanWindow(){
+  bool on = schedUpdate(sched, millis());
+  if (on == scanOn) return;
+  if (on) {pBLEScan->start(0, nullptr, false); stats.scanStarts++;}
+  else    pBLEScan->stop();
+  scanOn = on;
+}
+
+// Start/stop mode: stop the scan on a new reading (got) or after scan_max_secs, start the next one scan_gap_ms later
+void scanStartStop(bool got){
+  uint32_t now = millis();
+  if (scanOn) {
+    if (!got && now - scanMs < scan_max_secs * 1000UL) return;
+    pBLEScan->stop();
+  }
+  else {
+    if (now - scanMs < static_cast<uint32_t>(scan_gap_ms)) return;
+    pBLEScan->start(scan_max_secs, nullptr, false);           // returns at once, ends by itself
+    stats.scanStarts++;
+  }
+  scanOn = !scanOn;
+  scanMs = now;
+}
+
+// readings/sec every 10 secs (VERBOSE), or since the last call (force, as the scan mode changes)
+void printRate(bool force){
+  uint32_t ms = millis() - rateStartMs;
+  if (!force && (!VERBOSE || ms < 10000)) return;
+  uint32_t onMs = sched.onMs, totalMs = sched.totalMs;      // kept by the intake task, not reset here
+  if (ms >= 1000) {
+    Serial << F("* ") << _FLOAT(readings * 1000.0 / ms, 2) << F(" readings/s over ") << ms / 1000 << F(" secs, ");
+    if      (rateContinuous) Serial << F("continuous scan\n");
+    else if (rateAdaptive)   Serial << F("adaptive scan, radio on ")
+                                    << _FLOAT(totalMs != rateTotalMs ? (onMs - rateOnMs) * 100.0 / (totalMs - rateTotalMs) : 0, 1) << F("%\n");
+    else                     Serial << F("start/stop scan\n");
+  }
+  if (force) lastReadingMs = millis();                      // a new scan mode: 'not found' timed from here
+  rateContinuous = CONTINUOUS;
+  rateAdaptive   = ADAPTIVE;
+  rateOnMs    = onMs;
+  rateTotalMs = totalMs;
+  readings    = 0;
+  rateStartMs = millis();
+}
@@ -9,346 +9,378 @@
 #error "Missing AES, WOLFSSL_AES_COUNTER or WOLFSSL_AES_128"
 #endif
 
-Aes aesEnc;
-Aes aesDec;
-
 byte BIGarray[26]    = {0};   // for all manufacturer data including encypted data
-byte   encKey[16]    = {0};   // for nominated encryption key
 byte     iv[blkSize] = {0};   // initialisation vector 
 byte cipher[blkSize] = {0};   // encrypted data
 byte output[blkSize] = {0};   // decrypted result
 
-bool mfrDataReceived = false;
-
-// replace with actual key values (in lower case)
-byte key_SS[] = {0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff}; // My_Smartshunt_1
-//te key_S2[] = {0x96,0x52,0x4c,0xc1,0x1d,0x95,0x1b,0x63,0x79,0x6d,0x05,0xa9,0xac,0xce,0x73,0x18}; // My_Smartshunt_2
-//te key_P1[] = {0x21,0x4e,0x63,0x51,0x1c,0xa9,0xff,0x90,0xdb,0xf9,0xce,0x3d,0xf0,0x53,0x15,0x28}; // My_BMV712_P1
+VRing rxRing;                 // readings from the BLE callback to the intake task
+VRing frameRing;              // ... and on from the intake task to loop(), in batches
+VIntake intake;               // see intakeTask()
+VTask intakeHandle;           // the intake task, for its stack in printStats()
+volatile bool mfrRepeat       = false;   // a repeat of the last reading was dropped
+unsigned int mfrLen  = 0;     // bytes held in BIGarray
+VDevice *rxDevice    = nullptr;   // device that sent BIGarray
+uint32_t cbCalls     = 0;     // onResult() calls, for every advertiser in range
+uint64_t cbCycles    = 0;     // CPU cycles spent in onResult()
+uint32_t cbMaxCycles = 0;
+portMUX_TYPE cbMux   = portMUX_INITIALIZER_UNLOCKED;   // the callback counters: updated & read as one, from the other core
+
+// replace with actual address, name & key values (in lower case), one line per monitor
+const DeviceInit devices[] = {
+  {"ff:ff:ff:ff:ff:ff", "My_SmartShunt_1", {0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff}},
+//{"ff:ff:ff:ff:ff:fe", "My_SmartShunt_2", {0x96,0x52,0x4c,0xc1,0x1d,0x95,0x1b,0x63,0x79,0x6d,0x05,0xa9,0xac,0xce,0x73,0x18}},
+//{"ff:ff:ff:ff:ff:fd", "My_BMV712_P1",    {0x21,0x4e,0x63,0x51,0x1c,0xa9,0xff,0x90,0xdb,0xf9,0xce,0x3d,0xf0,0x53,0x15,0x28}},
+};
+
+VConfig config;               // the site config, stored or devices[]: the targets' names live here
+VDeviceTable targets;         // config devices by address, with key schedules expanded
+const char *configSource = "devices[]";   // where the targets came from
+uint32_t configUs    = 0;     // loadDevices() time at boot
+uint32_t firstReadingMs = 0;  // millis() at the first reading decrypted
+VStats stats;                 // counters, printed by S
+VScheduler sched;             // adaptive scan windows, see scanWindow()
+VAggregator aggs[VDEV_MAX];   // rolling summaries, one per target
+VLatency lat[VST_COUNT];      // per stage, in CPU cycles
+VHistory history[VDEV_MAX];   // decoded readings, one per target
+VEnergy energy[VDEV_MAX];     // integrated readings, one per target
+VOutlierCfg outlierCfg = bmOutlierDefaults;   // dud test settings, shared by the targets
+VOutlier outliers[VDEV_MAX];  // dud test state, one per target
+uint32_t rxMs        = 0;     // millis() when the reading in BIGarray was received
 
 // --- forward declarations ---
-void loadKey();
-float parseTimeToGo();
-float parseBattVolts();
-float parseAuxVolts();
-float parseMidVolts();
-float parseAuxKelvin();
-//oat parseAuxCelsius();
-float parseBattAmps();
-float parseAmpHours();
-float parseStateOfCharge();
-char * reportAlarms(uint32_t alarmBits);
-uint32_t countBitsSet(uint32_t val);
-bool checkForbadArgs();
+bool checkForbadArgs(Aes *aes);
 void printBIGarray();
 void printByteArray(byte byteArray[16]);
 void printBins();
 
-BLEScan *pBLEScan = nullptr();                                          // don't call getScan() immediately (else crash dumps happen!)
+BLEScan *pBLEScan = nullptr;                                            // don't call getScan() immediately (else crash dumps happen!)
+
+// --------------------------------------------------------------------------------
+// Load the targets, expanding each key schedule once here rather than per reading: from the site config blob
+// kept in NVS (see uploadConfig()) if there is one, else from devices[]. The blob may set the flags & dud test too
+void loadDevices(){
+  uint32_t c0 = ESP.getCycleCount();
+  static byte blob[VCFG_MAX];
+  size_t n = configRead(VCFG_NVS_KEY, blob, sizeof(blob));
+  bool stored = n && configParse(blob, n, config);
+  if (n && !stored) Serial << F("** Config blob in NVS is not valid, ignored\n");
+  if (!stored) initConfig(config);
+  if (config.hasFlags) {
+    FILTERING = config.flags & VCFG_FILTERING;
+    VERBOSE   = config.flags & VCFG_VERBOSE;
+  }
+  if (config.hasBM) outlierCfg = config.bm;
+  configSource = config.count ? "stored blob" : stored ? "stored blob & devices[]" : "devices[]";
+  if (!config.count)
+    for (const DeviceInit &d : devices)
+      if (!configAddDevice(config, macFromString(d.address), d.key, d.name)) {
+        Serial << "\n\n *** Program HALTED: bad or duplicate address " << d.address << " for " << d.name << '\n';
+        while(1);
+      }
+  configDevices(config, targets);
+  configUs = (ESP.getCycleCount() - c0) / ESP.getCpuFreqMHz();
+  if (checkForbadArgs(&targets.dev[0].aes.aes)) Serial << F("**FAIL** bad args detected!\n");
+  initStats(stats);
+  initScheduler(sched, targets.count, millis());
+  for (VLatency &l : lat) initLatency(l);
+  for (int i = 0; i < targets.count; i++) initAggregator(aggs[i], bmAggFields, VAGG_BM_FIELDS);
+  for (int i = 0; i < targets.count; i++) initOutlier(outliers[i], &outlierCfg);
+  for (int i = 0; i < targets.count; i++) initEnergy(energy[i]);
+  // allocated once, here: nothing is allocated per reading
+  size_t per  = HISTORY_BYTES / targets.count;
+  byte  *hbuf = static_cast<byte *>(malloc(HISTORY_BYTES));
+  for (int i = 0; i < targets.count; i++)
+    if (!hbuf || !initHistory(history[i], hbuf + i * per, per, VHIST_BM_FIELDS, VHIST_BM_XOR)) {
+      Serial << F("** No reading history: HISTORY_BYTES too small or not available\n");
+      break;
+    }
+}
 
 // --------------------------------------------------------------------------------
 // Scan for BLE servers for the advertising service we seek. Called for each advertising server
 void AdDataCallback::onResult(BLEAdvertisedDevice advertiser) {
-  if (!mfrDataReceived){
-    if (advertiser.getAddress().toString() == VICTRON_ADDRESS){         // select a specific advertising device
-      unsigned int len = advertiser.getManufacturerData().length();
-      if (len >= 11 && advertiser.getManufacturerData()[0] == 0xE1      // second byte of Victron company identifier 0x02E1 (little endian)
-                    && advertiser.getManufacturerData()[1] == 0x02      // first byte
-                    && advertiser.getManufacturerData()[2] == 0x10) {   // indicates manufacturer data follows next
-        BLEDevice::getScan()->stop();                                         // stop this scan
-        for (int i = 0; i < min(len,sizeof(BIGarray)); i++) BIGarray[i] = advertiser.getManufacturerData()[i];
-        mfrDataReceived = true;
-        }
-      }
+  uint32_t t0 = ESP.getCycleCount();
+  VDevice *dev = findDevice(targets, macFromBytes(*advertiser.getAddress().getNative()));
+  if (dev){                                                           // select a target device
+    size_t len;
+    const byte *mfr = findVictronData(advertiser.getPayload(), advertiser.getPayloadLength(), len);  // view into the raw payload
+    if (mfr) {                                                        // Victron company id 0x02E1 + 0x10 manufacturer data
+      stats.dev[dev - targets.dev].adverts++;
+      if (!CAPTURE && isDuplicate(*dev, mfr, len)) mfrRepeat = true;  // same IV & data as last time: drop it here (kept in a capture)
+      else if (ringPush(rxRing, dev->mac, advertiser.getRSSI(), millis(), mfr, len) && !CAPTURE)   // bounded time, counted as dropped if loop() is behind
+        dedupAccept(*dev, mfr, len);                                    // kept only once queued, so a dropped frame's repeat is let through
     }
   }
+  uint32_t cycles = ESP.getCycleCount() - t0;
+  latRecord(lat[VST_CALLBACK], cycles);
+  portENTER_CRITICAL(&cbMux);                                         // cbCycles is 64 bit: never read half written
+  cbCycles += cycles;
+  if (cycles > cbMaxCycles) cbMaxCycles = cycles;
+  cbCalls++;
+  portEXIT_CRITICAL(&cbMux);
+}
+
+// the callback counters as one consistent copy, for loop()
+void callbackStats(uint32_t &calls, uint64_t &cycles, uint32_t &maxCycles){
+  portENTER_CRITICAL(&cbMux);
+  calls     = cbCalls;
+  cycles    = cbCycles;
+  maxCycles = cbMaxCycles;
+  portEXIT_CRITICAL(&cbMux);
+}
+
+// copy a reading taken from the ring into BIGarray, and its decrypted record (see loop()) into output
+void loadFrame(const VFrame &f, const byte plain[16]){
+  rxDevice = findDevice(targets, f.mac);                  // always found, the callback checked
+  rxMs     = f.ms;
+  mfrLen   = f.len;
+  memcpy(BIGarray, f.data, f.len);
+  memcpy(output, plain, blkSize);
+}
 
 // --------------------------------------------------------------------------------
-// decrypt cipher -> outputs  
-void decryptAesCtr(bool VERBOSE){
-  memcpy(encKey,key_SS,sizeof(key_SS));       // key_SS -> encKey[]
-  //loadKey();                                // replaced by line above. enable loadKey() for multiple BM 
-  iv[0] = BIGarray[7];                        // copy LSB into iv
-  iv[1] = BIGarray[8];                        // copy MSB into iv
-  memcpy(cipher, BIGarray + 10, 16);          // BIGarray[11:26] -> cipher[1:16]
-  memset(&aesDec,0,sizeof(Aes));              // Init stack variables
+// the batch was decrypted in one pass by decryptFrames() in loop() (ok: this frame was): print the details. false if wrong key
+bool decryptAesCtr(bool VERBOSE, bool ok){
   if (VERBOSE) {
-    Serial << F("key   : "); printByteArray(encKey); Serial << '\n';
-    Serial << F("salt  : "); printByteArray(iv);     Serial << '\n';
-    Serial << F("cipher: "); printByteArray(cipher); Serial << '\n';
+    iv[0] = BIGarray[7];                        // copy LSB into iv
+    iv[1] = BIGarray[8];                        // copy MSB into iv
+    memcpy(cipher, BIGarray + 10, 16);          // BIGarray[11:26] -> cipher[1:16]
+    Serial << F("device: ") << rxDevice->name << '\n';
+    Serial << F("key   : "); printByteArray(rxDevice->key); Serial << '\n';
+    Serial << F("salt  : "); printByteArray(iv);            Serial << '\n';
+    Serial << F("cipher: "); printByteArray(cipher);        Serial << '\n';
     } 
-  wc_AesInit      (&aesDec, NULL, INVALID_DEVID);                         // init aesDec 
-  wc_AesSetKey    (&aesDec, encKey, blkSize, iv, AES_ENCRYPTION);         // load dec key 
-  wc_AesCtrEncrypt(&aesDec, output, cipher, sizeof(cipher)/sizeof(byte)); // do decryption
-  if (checkForbadArgs()) Serial << F("**FAIL** bad args detected!");      //
-  wc_AesFree(&aesDec);    // free up resources
+  return ok;
 }
 
-/*
-void loadKey(){
-  if      (VICTRON_NAME == "My_SmartShunt_1") memcpy(encKey,key_SS,sizeof(key_SS));   // key_SS -> encKey[]
-  else if (VICTRON_NAME == "My_SmartShunt_2") memcpy(encKey,key_SS,sizeof(key_S2));   // key_S2 -> encKey[]
-  else if (VICTRON_NAME == "My_BMV712_P1")    memcpy(encKey,key_P1,sizeof(key_P1));   // key_P1 -> encKey[]
-  else {
-    Serial << "\n\n *** Program HALTED: encryption key not set!\n";
-    while(1);
-  }
-}
-*/
-
 // =====================================================================================
 
-bool inf_TTG = false;
-bool na_batV = false;
-bool na_aux  = false;
-bool na_batA = false;
-bool na_Ah   = false;
-bool na_soc  = false;
-
 int dudvals = 0, maxduds = 0;
+VLine report;                 // one report line, see VictronCore/VFormat.h
+
+// the windows just closed, one line each, for the levels AGGREGATE selects
+static void printAggregates(int dev, uint8_t closed){
+  if (!AGGREGATE || BINARY) return;
+  for (int l = AGGREGATE - 1; l < VAGG_LEVELS; l++) {
+    if (!((closed >> l) & 1)) continue;
+    lineClear(report);
+    lineChar(report, '\t');
+    formatAgg(report, aggs[dev], l);
+    if (targets.count > 1) {lineStr(report, "  "); lineStr(report, targets.dev[dev].name);}
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+}
+
+// close the windows that have ended with no reading since, e.g. the device went out of range
+void tickAggregates(uint32_t ms){
+  for (int i = 0; i < targets.count; i++) printAggregates(i, aggTick(aggs[i], ms));
+}
 
 /* ------------------------------------------------------------------------
 Report Battery Monitor values
 -----------------------------
-Extract & decode each raw values contained in the 16 decrypted bytes, calculate each final values and report. 
-
-Notes: 
-1) multiple bytes are little-endian (i.e ordering of double/triple bytes is reversed)
-2) the signed values use 2's complement, so the sign bit must be handled
-
-LSB: Least Significant bits/Byte
-MIB: Middle            bits/byte (triples only)
-MSB: Most significant  bits/byte
-
-In order of bytes received:
----------------------------
-// Time To Go in minutes (16 bits)
-byte  0 Time To Go LSB bits  7-0 
-byte  1 Time To Go MSB bits 15-8
-
-// Battery Volts (16 bits, signed, units 10mV)
-byte  2 Batt Volts LSB bits  7-0 
-byte  3 Batt Volts MSB bits 14-8 
-byte  3 Batt Volts sign bit 15    
-
-// Alarms status (2 bytes, 8 bits each)
-byte  4 Alarms status LSB bits  7-0  (Battery Monitor status) 
-byte  5 Alarms status MSB bits 15-8 (Inverter status)
-
-// when aux = 0 read Aux Volts (16 bits, signed, units 10mV)
-// (byte 8 below provides Aux input type selecxtion)
-byte  6 Auxillary Volts LSB bits  7-0 
-byte  7 Auxillary Volts MSB bits 14-8
-byte  7 Auxillary Volts sign bit 15
-// when aux = 1 read mid-point Volts (16 bits, units 10mV)
-byte  6 Mid-point Volts LSB bits 7-0 
-byte  7 Mid-point Volts MSB bits 15-8
-// when aux = 2 read temperature in Kelvin (16 bits, units 10mK)
-byte  6 Kelvin degrees LSB bits  7-0 
-byte  7 Kelvin degrees MSB bits 15-8
-
-byte  8 Aux input type: bits 0,1 =  0:aux 1:mid 2:Kelvin 3:none 
-
-// Battery milli-Amps (22 bits, signed)
-byte  8 bits 7-2  LSB Batt Amps: bottom 6 bits of mA value
-byte  9 bits 1,0  LSB Batt Amps:  extra 2 bits 
-        bits 7-2  MIB Batt Amps: middle 6 bits 
-byte 10 bits 1,0  MIB Batt Amps:  extra 2 bits 
-        bits 6-2  MSB Batt Amps:    top 5 bits of mA value
-        bit  7        Batt A sign bit   1 bit
-
-// Consumed Ah (20 bits, units 100mAh)
-byte 11 Consumed Ah LSB bits  7-0
-byte 12 Consumed Ah MIB bits 15-8
-byte 13 Consumed Ah MSB bits  3-0 (upper 4 bits of Ah)
-
-// State of Charge (10 bits, units 0.1%)
-byte 13 SOC LSB bits 7-4 (lower 4 bits of SOC)
-byte 14 SOC MSB bits 5-9 (upper 6 bits of SOC)
-
-byte 14 bits 6,7 unused 
-byte 15 bits 0-7 unused
+Decode the 16 decrypted bytes (see decodeBM() in VictronCore/VDecode.cpp for the 
+byte mapping) into a BatteryMonitorReading, in the record's own integer units, flag
+any dud values and report. A value is a dud if outside the hard limits or out of line
+with the monitor's recent readings (outlierCheck(), VictronCore/VOutlier.cpp), all in
+integer units, no float math here. The line is formatted into a fixed buffer by
+formatBM() (VictronCore/VFormat.cpp), nothing is allocated. 
 ------------------------------------------------------------------------ */
 void reportBMvalues(){
   if (FILTERING) maxduds = 0; else maxduds = 10;              // if FILTERING this will silence dud reporting
-  float ttgDays = parseTimeToGo();                            //       0 -> 65535 mins (45.51 days)
-  float battV   = parseBattVolts();                           // -327.68 -> 327.66 V
-  uint32_t alarmBits = (static_cast<uint32_t>(output[5]) << 8) | output[4];
-  int   aux = output[8] & 0x03;                               // 0:Aux 1: Mid 2: Kelvin 3: none
-  float Aval = 0;          
-  if      (aux == 0) Aval = parseAuxVolts();                  // -327.68 -> 327.66 V;}
-  else if (aux == 1) Aval = parseMidVolts();                  //       0 -> 655.34 V
-  else if (aux == 2) Aval = parseAuxKelvin();                 //       0 -> 655.34 K (-273.15 -> 382.19 C)
-  else if (aux == 3) Aval = 999.99;
-  float   battA = parseBattAmps();                            // -2097.152 -> 2097.150 A 
-  float   Ah    = parseAmpHours();                            // 0 -> 104,857.4 Ah
-  float   SoC   = parseStateOfCharge();                       // 0 -> 100%
+  BatteryMonitorReading v;
+  uint32_t c0 = ESP.getCycleCount();
+  decodeBM(output, v);
+  int dev = rxDevice - targets.dev;
   // -- flag (& optionally filter) any dud readings ---------------------------------------
-  if (aux  != EXPECTED_AUX_MODE)                            dudvals++;
-  if (!na_batV && (battV < BATTV_MIN || battV > BATTV_MAX)) dudvals++;
-  if (!na_aux  && (Aval  <  AVAL_MIN || Aval  >  AVAL_MAX)) dudvals++;
-  if (!na_batA && (battA < BATTA_MIN || battA > BATTA_MAX)) dudvals++;
-  if (!na_soc  && (SoC   <   SOC_MIN || SoC > SOC_MAX    )) dudvals++;
-  if (!na_Ah   && (Ah    >    AH_MAX))                      dudvals++;
-  // -- in-line reporting -----------------------------------------------------------------
-  if (!VERBOSE && dudvals) Serial << " *"; // flag if this reading contains one or more dud values
+  int32_t ov[VOUT_FIELDS];
+  uint8_t checked;
+  bmOutValues(v, ov, checked);
+  uint8_t duds = outlierCheck(outliers[dev], rxMs, ov, checked);   // a bit per dud value
+  if (v.aux != EXPECTED_AUX_MODE) {dudvals++; duds |= VWIRE_DUD_AUX;}
+  for (uint8_t d = duds & ~VWIRE_DUD_AUX; d; d &= d - 1) dudvals++;   // one per dud value
+  latRecord(lat[VST_DECODE], ESP.getCycleCount() - c0);
+  if (dudvals) {stats.dev[dev].dudReadings++; stats.dev[dev].dudValues += dudvals;}
+  VHistory &h = history[dev];
+  if (h.buf) {VSample s; bmSample(v, rxMs, s); historyAppend(h, s);}
+  if (!(duds & ~VWIRE_DUD_AUX)) energyBM(energy[dev], rxMs, v);   // a dud value is not integrated, the interval spans it
+  // -- rolling summaries, without the dud readings if FILTERING --------------------------
+  if (!(FILTERING && dudvals)) {
+    int32_t x[VAGG_FIELDS];
+    uint8_t ok;
+    bmAggValues(v, x, ok);
+    printAggregates(dev, aggAdd(aggs[dev], rxMs, x, ok));
+  }
+  if (BINARY) {                                           // one record, values as decoded & the dud bits
+    uint32_t c1 = ESP.getCycleCount();
+    uint8_t  rec[VWIRE_FRAME_MAX];
+    size_t   n = FILTERING && dudvals ? 0 : wireBM(rec, dev, rxMs, duds, v);
+    uint32_t c2 = ESP.getCycleCount();
+    Serial.write(rec, n);
+    latRecord(lat[VST_FORMAT], c2 - c1);
+    latRecord(lat[VST_SERIAL], ESP.getCycleCount() - c2);
+    dudvals = 0;
+    return;
+  }
+  if (AGGREGATE && !VERBOSE) {dudvals = 0; return;}       // summaries only
+  // -- in-line reporting, built in report then written in one go -------------------------
+  uint32_t c1 = ESP.getCycleCount();
+  lineClear(report);
+  if (!VERBOSE && dudvals) lineStr(report, " *");         // flag if this reading contains one or more dud values
   if (dudvals <= maxduds){
-    if (!VERBOSE) Serial << '\t'; else Serial << " ";
-    if (inf_TTG) Serial << "inf_"; else Serial << _WIDTH(_FLOAT(ttgDays,1),4); Serial << "d ";
-    if (na_batV) Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(battV  ,2),5); Serial << "V ";
-    Serial << reportAlarms(alarmBits) << " ";
-    if (na_aux) Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(Aval,2),6);
-    if      (aux == 0 || aux == 1) Serial << "V";
-    else if (aux == 2)             Serial << "K";
-    else                           Serial << "X";
-    Serial << " |  " << aux << "  ";
-    if (na_batA) Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(battA,1),5); Serial << "A ";
-    if (na_Ah)   Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(Ah   ,1),7); Serial << "Ah ";
-    if (na_soc)  Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(SoC  ,1),5); Serial << "%";
+    lineChar(report, VERBOSE ? ' ' : '\t');
+    formatBM(report, v);
   }
-  if (dudvals) Serial << "\t[duds: " << dudvals << "]";
+  if (dudvals) {lineStr(report, "\t[duds: "); lineUInt(report, dudvals); lineChar(report, ']');}
+  if (targets.count > 1) {lineStr(report, "  "); lineStr(report, rxDevice->name);}
+  uint32_t c2 = ESP.getCycleCount();
+  Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  latRecord(lat[VST_FORMAT], c2 - c1);
+  latRecord(lat[VST_SERIAL], ESP.getCycleCount() - c2);
   // --------------------------------------------------------------------------------------
   dudvals = 0;  
-  inf_TTG = false;
-  na_batV = false;
-  na_aux  = false;
-  na_batA = false;
-  na_Ah   = false;
-  na_soc  = false;
-}
-
-// Some of the routines below use static_cast to convert integers  
-// to floats while avoiding dud fractions from integer division.
-
-// Remaining Battery 'Time to Go' in minutes
-float parseTimeToGo(){
-  uint16_t TTG_mins = (output[1] << 8) | output[0];  // NB little endian: byte[1] <-> byte[0]
-  if (TTG_mins == 0xFFFF) inf_TTG = true;
-  return (static_cast<float>(TTG_mins)/60/24);   // integer units minutes converted to hours as float
-}
-
-// Note: SC & BM use same bytes (2,3) for battery volts
-float parseBattVolts(){
-  bool    neg       =  (output[3] & 0x80) >> 7;              // extract sign bit for signed int
-  int32_t batt_mV10 = ((output[3] & 0x7F) << 8) | output[2];  // exclude sign bit from byte 3
-  if (batt_mV10 == 0x7FFF) na_batV = true;                       
-  if (neg) batt_mV10 = batt_mV10 - 32768;       // 2's complement = val - 2^(b-1) b = bit# = 16
-  return (static_cast<float>(batt_mV10)/100);   // integer units 10mV converted to V as float
-}
-
-/* -- AUX ------------------------------------------------------------------------------------
-aux = 0 selects auxilliary voltage source
-aux = 1 selects mid-point voltage
-aux = 2 selects battery temperature in degrees Kelvin 
-aux = 3 means result is 'N/A' or 'off' */
-
-// only called when aux = 0
-float parseAuxVolts(){
-  bool    neg      =  (output[7] & 0x80) >> 7;               // extract sign bit
-  int32_t aux_mV10 = ((output[7] & 0x7F) << 8) | output[6]; // exclude sign bit from byte[7]
-  if (aux_mV10 == 0x7FFF) na_aux = true;                       
-  if (neg) aux_mV10 = aux_mV10 - 32768;         // 2's complement = val - 2^(b-1) b = bit# = 16
-  return (static_cast<float>(aux_mV10)/100);   // integer units 10mV converted to V as float
 }
 
-// only called when aux = 1
-float parseMidVolts(){
-  int32_t aux_mV10 = (output[7] << 8) | output[6];
-  if (aux_mV10 == 0xFFFF) na_aux = true;                       
-  return (static_cast<float>(aux_mV10)/100);   // integer units 10mV converted to V, as float
-}
-
-// only called when aux = 2
-float parseAuxKelvin(){
-  int32_t aux_mK10 = (output[7] << 8) | output[6];
-  if  (aux_mK10 == 0xFFFF) na_aux = true;
-  return (static_cast<float>(aux_mK10)/100);    // integer units 10 milli-Kelvin, converted to Kelvin, as float
+// H entered: per monitor, the readings held and the last 10 minutes' battery volts & amps range
+void printHistory(){
+  Serial << '\n' << CF(dashes) << F("reading history") << CF(dashes) << '\n';
+  for (int i = 0; i < targets.count; i++) {
+    const VHistory &h = history[i];
+    Serial << '\t' << targets.dev[i].name << F(": ");
+    if (!h.buf)   {Serial << F("none\n"); continue;}
+    if (!h.count) {Serial << F("no readings yet\n"); continue;}
+    size_t bytes = historyBytes(h);
+    Serial << h.count << F(" readings over ") << _FLOAT(historySpanMs(h) / 60000.0, 1) << F(" min, ")
+           << bytes << '/' << h.blocks * VHIST_BLOCK << F(" bytes (") << _FLOAT(bytes / (float)h.count, 2)
+           << F(" per reading), ") << h.appended - h.count << F(" dropped as old\n");
+    VHistoryIter it;
+    VSample s;
+    int32_t vMin = INT32_MAX, vMax = INT32_MIN, aMin = INT32_MAX, aMax = INT32_MIN;
+    BatteryMonitorReading r;
+    historyBegin(h, it, millis() - 600000);
+    while (historyNext(it, s)) {
+      bmReading(s, r);
+      if (r.valid & BM_BATTV) {vMin = min(vMin, (int32_t)r.battV); vMax = max(vMax, (int32_t)r.battV);}
+      if (r.valid & BM_BATTA) {aMin = min(aMin, r.battA);          aMax = max(aMax, r.battA);}
+    }
+    lineClear(report);
+    lineStr(report, "\t  last 10 min: batt V ");
+    if (vMin <= vMax) {lineFixed(report, vMin, 100, 2); lineStr(report, " .. "); lineFixed(report, vMax, 100, 2);}
+    else lineStr(report, "-");
+    lineStr(report, ", amps ");
+    if (aMin <= aMax) {lineFixed(report, aMin, 1000, 3); lineStr(report, " .. "); lineFixed(report, aMax, 1000, 3);}
+    else lineStr(report, "-");
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-/*
-float parseAuxCelsius(){
-  int32_t aux_mK10 = (output[7] << 8) | output[6];
-  int32_t aux_mC10;
-  if  (aux_mK10 == 0xFFFF) na_aux = true;
-  else aux_mC10 = aux_mK10 - 27315;             // Celius = Kelvin - 273.15        
-  return (static_cast<float>(aux_mC10)/100);    // integer units 10mC converted to degrees C, as float
-  }*/
-
-// -------------------------------------------------------------------------------------------
-
-// Battery Current (signed) 22 bits = sign bit + 21 bits
-float parseBattAmps(){
-  bool    neg =  (output[10] & 0x80) >> 7;                                        // bit  21
-  int32_t mA  = ((output[8]  & 0xFC) >> 2) + ((output[9]  & 0x03) << 6)       | // bits  0 - 7 
-               (((output[9]  & 0xFC) >> 2) + ((output[10] & 0x03) << 6) << 8) | // bits  8 - 15
-               (((output[10] & 0x7C) >> 2)                                << 16); // bits 16 - 20
-  if (mA == 0x1FFFFF) na_batA = true;
-  if (neg) mA = mA - 2097152;                   // 2's complement = val - 2^(b-1) where b = bits = 22
-  return (static_cast<float>(mA)/1000);         // convert mA to float A
+// E entered: per monitor, the energy & charge integrated since startup, the rates and the cross-check
+void printEnergy(){
+  Serial << '\n' << CF(dashes) << F("energy") << CF(dashes) << '\n';
+  for (int i = 0; i < targets.count; i++) {
+    const VEnergy &e = energy[i];
+    Serial << '\t' << targets.dev[i].name << F(": ");
+    if (!e.readings) {Serial << F("no readings yet\n"); continue;}
+    lineClear(report);
+    formatEnergy(report, e);
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-// Amp Hours consumed 20 bits (unsigned) integer units 0.1Ah (100mAh). 
-float parseAmpHours(){
-  uint32_t mAh100 = output[11]       |            // bits  0 - 7 
-                   (output[12] << 8) |            // bits  8 - 15
-                  ((output[13] & 0x0F) << 16);    // bits 16 - 19
-  if (mAh100 == 0xFFFFF) na_Ah = true;
-  return (static_cast<float>(mAh100)/10);           // integer units 100mAh converted to Ah as float 
+// L entered: p50 / p99 / max of each stage since startup, one JSON line each. The callback
+// stage is written by the BLE task as this reads it, so it is a snapshot
+void printLatency(){
+  Serial << '\n';
+  for (int i = 0; i < VST_COUNT; i++) {
+    lineClear(report);
+    formatLatency(report, stageName[i], lat[i], ESP.getCpuFreqMHz());
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-// State of charge 0-100% in units of 0.1%, as 10 bits (unsigned)  
-float parseStateOfCharge(){
-  uint16_t soc01 = ((output[13] & 0xF0) >> 4) |   // bits 0 - 3
-                   ((output[14] & 0x0F) << 4) |   // bits 4 - 7
-                   ((output[14] & 0x30) << 4);    // bits 8 - 9
-  if (soc01 == 0x3FF) na_soc = true;
-  if (soc01  > 1000) soc01 = 9999;                  // flag error if > 100% = 1000/10 
-  return (static_cast<float>(soc01)/10);            // integer units 0.1% converted to % as float 
+// S entered: the counters since startup, one line per target, then the IV gap & interval histograms
+void printStats(){
+  Serial << '\n' << CF(dashes) << F("stats") << CF(dashes) << '\n';
+  uint32_t calls, maxCycles;
+  uint64_t cycles;
+  callbackStats(calls, cycles, maxCycles);
+  Serial << F("\tadverts: ") << calls << F(" seen, ") << rxRing.pushed << F(" queued, ") << rxRing.dropped << F(" dropped (loop() behind)\n");
+  Serial << F("\tscans  : ") << stats.scanStarts << F(" started, ") << stats.notFound << F(" not found\n");
+  Serial << F("\tstack  : intake task ") << taskStackFree(intakeHandle) << F(" of ") << VPIPE_STACK << F(" bytes never used\n");
+  Serial << F("\tboot   : config (") << configSource << F(") loaded in ") << configUs << F(" us, first reading ");
+  if (firstReadingMs) Serial << firstReadingMs << F(" ms after boot\n"); else Serial << F("not yet\n");
+  for (int i = 0; i < targets.count + 2; i++) {
+    lineClear(report);
+    lineChar(report, '\t');
+    if      (i < targets.count)     formatDevStats(report, stats, i, targets.dev[i]);
+    else if (i == targets.count)    formatGapHist(report, stats);
+    else                            formatIntervalHist(report, stats);
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-
-// Gemini recommends new/delete to avoid memory leaks
-//  char* alarms = new reportAlarms();
-//  Serial << alarms << " ";
-//  delete[] alarms; // Free the dynamically allocated memory
-
-// NB: according to VE_REG_ALARM_REASONS list (see .png)
-// values <= 0x0080 are for Battery Monitors  (i.e. bits from lower byte only)
-// values >= 0x0100 are for Victron Inverters (i.e. bits from upper byte only)
-char * reportAlarms(uint32_t alarmBits){
-  char * alarmState = new char[5];                        // Gemini recommends new/delete to avoid memory leaks
-  strcpy(alarmState, "none");
-  if (countBitsSet(alarmBits) == 1){
-    if (alarmBits == 0x0001) strcpy(alarmState, "lo_V");
-    if (alarmBits == 0x0002) strcpy(alarmState, "hi_V");
-    if (alarmBits == 0x0004) strcpy(alarmState, "socL");
-    if (alarmBits == 0x0008) strcpy(alarmState, "lo_S");
-    if (alarmBits == 0x0010) strcpy(alarmState, "hi_S");
-    if (alarmBits == 0x0020) strcpy(alarmState, "lo_C");
-    if (alarmBits == 0x0040) strcpy(alarmState, "hi_C");
-    if (alarmBits == 0x0080) strcpy(alarmState, "midV");
-    if (alarmBits == 0x0100) strcpy(alarmState, "OVRL");
-    if (alarmBits == 0x0200) strcpy(alarmState, "DCrp");
-    if (alarmBits == 0x0400) strcpy(alarmState, "loAC");
-    if (alarmBits == 0x0800) strcpy(alarmState, "hiAC");
-    if (alarmBits == 0x1000) strcpy(alarmState, "Shrt");
-    if (alarmBits == 0x2000) strcpy(alarmState, "Lock");} 
-  else if (alarmBits > 0) strcpy(alarmState, "Mult");
-  return alarmState;
+// K entered: the dud test steps k = 5 -> 8 -> 3 -> off (hard limits only) -> 5 spreads, then prints the settings
+// (record units, as decodeBM()) and what it has flagged per target
+void stepDudTest(){
+  static const uint8_t ks[] = {5, 8, 3, 0};
+  int i = 0;
+  while (i < 4 && ks[i] != outlierCfg.k) i++;
+  outlierCfg.k = ks[(i + 1) % 4];
+  Serial << F("\nDUD TEST - ");
+  if (outlierCfg.k) Serial << F("outside ") << outlierCfg.k << F(" spreads of the median of the last ") << VOUT_WINDOW
+                           << F(" good values, or the hard limits; a step after ") << outlierCfg.confirm << F(" in a row\n");
+  else              Serial << F("hard limits only\n");
+  for (int f = 0; f < outlierCfg.fields; f++) {
+    const VOutFieldCfg &c = outlierCfg.f[f];
+    Serial << '\t' << c.label << F(": ") << c.min << F(" .. ") << c.max << F(", floor ") << c.floor;
+    if (c.maxRate) Serial << F(", ") << c.maxRate << F("/sec at most");
+    Serial << '\n';
+  }
+  for (int t = 0; t < targets.count; t++) {
+    const VOutlier &o = outliers[t];
+    Serial << '\t' << targets.dev[t].name << F(": ") << o.readings << F(" readings, ") << o.outliers << F(" outliers, ")
+           << o.limits << F(" over limits, ") << o.steps << F(" steps followed\n");
+  }
+  Serial << '\n';
 }
 
-// returns count of bits that are set in val
-uint32_t countBitsSet(uint32_t val){
-  uint32_t count = 0;
-  while (val) {count += val & 1;     // Check the least significant bit
-               val >>= 1;}           // Right-shift to check the next bit
-  return count;
+// U entered: a site config blob (host/mkconfig) follows within 2 secs. Checked in full, kept in NVS, then a restart
+// loads it. A blob without devices sets flags & dud test only, the targets stay as devices[]
+void uploadConfig(){
+  static byte    blob[VCFG_MAX];
+  static VConfig c;
+  Serial << F("\nUPLOAD - send the config blob\n");
+  Serial.setTimeout(2000);
+  size_t n   = Serial.readBytes(blob, VCFG_HEADER);
+  size_t len = n == VCFG_HEADER ? configLength(blob) : 0;
+  if (len > VCFG_HEADER && len <= sizeof(blob)) n += Serial.readBytes(blob + n, len - n);
+  if (!len || n != len || !configParse(blob, n, c)) {
+    while (Serial.available()) Serial.read();
+    Serial << F("** not a valid config blob (") << n << F(" bytes), nothing changed\n\n");
+    return;
+  }
+  if (!configStore(VCFG_NVS_KEY, blob, n)) {Serial << F("** config blob not stored, NVS write failed\n\n"); return;}
+  Serial << F("UPLOAD - ") << n << F(" bytes, ") << c.count << F(" devices kept in NVS, restarting\n");
+  Serial.flush();
+  ESP.restart();
 }
 
 // --------------------------------- Shared routines ---------------------------------------------
-bool checkForbadArgs(){
-  int x = wc_AesCtrEncrypt(   NULL, output, cipher, sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
-  int y = wc_AesCtrEncrypt(&aesDec, NULL,   cipher, sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
-  int z = wc_AesCtrEncrypt(&aesDec, output, NULL,   sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
+// one-off check at startup that wolfssl rejects bad arguments
+bool checkForbadArgs(Aes *aes){
+  int x = wc_AesCtrEncrypt(NULL, output, cipher, sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
+  int y = wc_AesCtrEncrypt(aes,  NULL,   cipher, sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
+  int z = wc_AesCtrEncrypt(aes,  output, NULL,   sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
   if (x == WC_NO_ERR_TRACE(BAD_FUNC_ARG) && 
       y == WC_NO_ERR_TRACE(BAD_FUNC_ARG) && 
       z == WC_NO_ERR_TRACE(BAD_FUNC_ARG)) 
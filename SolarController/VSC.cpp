@@ -9,32 +9,45 @@
 #error "Missing AES, WOLFSSL_AES_COUNTER or WOLFSSL_AES_128"
 #endif
 
-Aes aesEnc;
-Aes aesDec;
-
 byte BIGarray[26]    = {0};   // for all manufacturer data including encypted data
-byte   encKey[16];      // for nominated encryption key
 byte     iv[blkSize];   // initialisation vector 
 byte cipher[blkSize];   // encrypted data
 byte output[blkSize];   // decrypted result
 
-bool mfrDataReceived = false;
+VRing rxRing;                 // readings from the BLE callback to the intake task
+VRing frameRing;              // ... and on from the intake task to loop(), in batches
+VIntake intake;               // see intakeTask()
+VTask intakeHandle;           // the intake task, for its stack in printStats()
+volatile bool mfrRepeat       = false;   // a repeat of the last reading was dropped
+unsigned int mfrLen  = 0;         // bytes held in BIGarray
+VDevice *rxDevice    = nullptr;   // device that sent BIGarray
+uint32_t cbCalls     = 0;     // onResult() calls, for every advertiser in range
+uint64_t cbCycles    = 0;     // CPU cycles spent in onResult()
+uint32_t cbMaxCycles = 0;
+portMUX_TYPE cbMux   = portMUX_INITIALIZER_UNLOCKED;   // the callback counters: updated & read as one, from the other core
+
+// replace with actual address, name & key values (NB: use lower case), one line per controller
+const DeviceInit devices[] = {
+  {"ff:ff:ff:ff:ff:ff", "My_Solar_Controller", {0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff}},
+};
 
-// replace with actual key values (NB: use lower case)
-byte key_SC[] = {0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff}; // My_Solar_Controller
+VConfig config;                   // the site config, stored or devices[]: the targets' names live here
+VDeviceTable targets;             // config devices by address, with key schedules expanded
+const char *configSource = "devices[]";   // where the targets came from
+uint32_t configUs    = 0;         // loadDevices() time at boot
+uint32_t firstReadingMs = 0;      // millis() at the first reading decrypted
+VStats stats;                     // counters, printed by S
+VScheduler sched;                 // adaptive scan windows, see scanWindow()
+VAggregator aggs[VDEV_MAX];   // rolling summaries, one per target
+VLatency lat[VST_COUNT];      // per stage, in CPU cycles
+VHistory history[VDEV_MAX];       // decoded readings, one per target
+VEnergy energy[VDEV_MAX];         // integrated readings, one per target
+VOutlierCfg outlierCfg = scOutlierDefaults;   // dud test settings, shared by the targets
+VOutlier outliers[VDEV_MAX];      // dud test state, one per target
+uint32_t rxMs        = 0;         // millis() when the reading in BIGarray was received
 
 // fwd decs
-//id decryptAesCtr(bool VERBOSE);
-void loadKey();
-//id reportSCvalues();
-void reportDeviceState();
-void reportChargerError();
-float parseBattVolts();
-float parseBattAmps();
-float parseKWHtoday();
-float parsePVpower();
-float parseLoadAmps();
-bool checkForbadArgs();
+bool checkForbadArgs(Aes *aes);
 void printBIGarray();
 void printByteArray(byte byteArray[16]);
 void printBins();
@@ -42,182 +55,327 @@ void printBins();
 // ----------------------------------------------------------------------
 BLEScan *pBLEScan = nullptr;                                            // avoids calling getScan() immediately (prevents repeating crash dumps)
 
+// --------------------------------------------------------------------------------
+// Load the targets, expanding each key schedule once here rather than per reading: from the site config blob
+// kept in NVS (see uploadConfig()) if there is one, else from devices[]. The blob may set the flags & dud test too
+void loadDevices(){
+  uint32_t c0 = ESP.getCycleCount();
+  static byte blob[VCFG_MAX];
+  size_t n = configRead(VCFG_NVS_KEY, blob, sizeof(blob));
+  bool stored = n && configParse(blob, n, config);
+  if (n && !stored) Serial << F("** Config blob in NVS is not valid, ignored\n");
+  if (!stored) initConfig(config);
+  if (config.hasFlags) {
+    FILTERING = config.flags & VCFG_FILTERING;
+    LOAD_AMPS = config.flags & VCFG_LOAD_AMPS;
+    VERBOSE   = config.flags & VCFG_VERBOSE;
+  }
+  if (config.hasSC) outlierCfg = config.sc;
+  configSource = config.count ? "stored blob" : stored ? "stored blob & devices[]" : "devices[]";
+  if (!config.count)
+    for (const DeviceInit &d : devices)
+      if (!configAddDevice(config, macFromString(d.address), d.key, d.name)) {
+        Serial << "\n\n *** Program HALTED: bad or duplicate address " << d.address << " for " << d.name << '\n';
+        while(1);
+      }
+  configDevices(config, targets);
+  configUs = (ESP.getCycleCount() - c0) / ESP.getCpuFreqMHz();
+  if (checkForbadArgs(&targets.dev[0].aes.aes)) Serial << F("**FAIL** bad args detected!\n");
+  initStats(stats);
+  initScheduler(sched, targets.count, millis());
+  for (VLatency &l : lat) initLatency(l);
+  for (int i = 0; i < targets.count; i++) initAggregator(aggs[i], scAggFields, VAGG_SC_FIELDS);
+  for (int i = 0; i < targets.count; i++) initOutlier(outliers[i], &outlierCfg);
+  for (int i = 0; i < targets.count; i++) initEnergy(energy[i]);
+  // allocated once, here: nothing is allocated per reading
+  size_t per  = HISTORY_BYTES / targets.count;
+  byte  *hbuf = static_cast<byte *>(malloc(HISTORY_BYTES));
+  for (int i = 0; i < targets.count; i++)
+    if (!hbuf || !initHistory(history[i], hbuf + i * per, per, VHIST_SC_FIELDS, VHIST_SC_XOR)) {
+      Serial << F("** No reading history: HISTORY_BYTES too small or not available\n");
+      break;
+    }
+}
+
 // --------------------------------------------------------------------------------
 // Scan for BLE servers for the advertising service we seek. Called for each advertising server
 void AdDataCallback::onResult(BLEAdvertisedDevice advertiser) {
-  if (!mfrDataReceived){
-    if (advertiser.getAddress().toString() == VICTRON_ADDRESS){         // select a specific advertising device
-      unsigned int len = advertiser.getManufacturerData().length();
-      if (len >= 11 && advertiser.getManufacturerData()[0] == 0xE1      // second byte of Victron company identifier 0x02E1 (little endian)
-                    && advertiser.getManufacturerData()[1] == 0x02      // first byte
-                    && advertiser.getManufacturerData()[2] == 0x10) {   // indicates manufacturer data follows next
-        BLEDevice::getScan()->stop();                                         // stop this scan
-        for (int i = 0; i < min(len,sizeof(BIGarray)); i++) BIGarray[i] = advertiser.getManufacturerData()[i];
-        mfrDataReceived = true;
-      }
+  uint32_t t0 = ESP.getCycleCount();
+  VDevice *dev = findDevice(targets, macFromBytes(*advertiser.getAddress().getNative()));
+  if (dev){                                                           // select a target device
+    size_t len;
+    const byte *mfr = findVictronData(advertiser.getPayload(), advertiser.getPayloadLength(), len);  // view into the raw payload
+    if (mfr) {                                                        // Victron company id 0x02E1 + 0x10 manufacturer data
+      stats.dev[dev - targets.dev].adverts++;
+      if (!CAPTURE && isDuplicate(*dev, mfr, len)) mfrRepeat = true;  // same IV & data as last time: drop it here (kept in a capture)
+      else if (ringPush(rxRing, dev->mac, advertiser.getRSSI(), millis(), mfr, len) && !CAPTURE)   // bounded time, counted as dropped if loop() is behind
+        dedupAccept(*dev, mfr, len);                                    // kept only once queued, so a dropped frame's repeat is let through
     }
   }
+  uint32_t cycles = ESP.getCycleCount() - t0;
+  latRecord(lat[VST_CALLBACK], cycles);
+  portENTER_CRITICAL(&cbMux);                                         // cbCycles is 64 bit: never read half written
+  cbCycles += cycles;
+  if (cycles > cbMaxCycles) cbMaxCycles = cycles;
+  cbCalls++;
+  portEXIT_CRITICAL(&cbMux);
+}
+
+// the callback counters as one consistent copy, for loop()
+void callbackStats(uint32_t &calls, uint64_t &cycles, uint32_t &maxCycles){
+  portENTER_CRITICAL(&cbMux);
+  calls     = cbCalls;
+  cycles    = cbCycles;
+  maxCycles = cbMaxCycles;
+  portEXIT_CRITICAL(&cbMux);
+}
+
+// copy a reading taken from the ring into BIGarray, and its decrypted record (see loop()) into output
+void loadFrame(const VFrame &f, const byte plain[16]){
+  rxDevice = findDevice(targets, f.mac);                  // always found, the callback checked
+  rxMs     = f.ms;
+  mfrLen   = f.len;
+  memcpy(BIGarray, f.data, f.len);
+  memcpy(output, plain, blkSize);
 }
 
 // --------------------------------------------------------------------------------
 // encryption routine not required here (covered in AES_CTR_enc_dec.ino)
-// decrypt cipher -> outputs  
-void decryptAesCtr(bool VERBOSE){
-  memcpy(encKey,key_SC,sizeof(key_SC));       // key_SC -> encKey[]  
-  //loadKey();                                // replaced by line above. enable loadKey() for multiple SC                        
-  iv[0] = BIGarray[7];                        // copy LSB into iv
-  iv[1] = BIGarray[8];                        // copy MSB into iv
-  memcpy(cipher, BIGarray + 10, 16);          // BIGarray[11:26] -> cipher[1:16]
-  memset(&aesDec,0,sizeof(Aes));              // Init stack variables
+// the batch was decrypted in one pass by decryptFrames() in loop() (ok: this frame was): print the details. false if wrong key
+bool decryptAesCtr(bool VERBOSE, bool ok){
   if (VERBOSE) {
-    Serial << "key   : "; printByteArray(encKey); Serial << '\n';
-    Serial << "salt  : "; printByteArray(iv);     Serial << '\n';
-    Serial << "cipher: "; printByteArray(cipher); Serial << '\n';
+    iv[0] = BIGarray[7];                        // copy LSB into iv
+    iv[1] = BIGarray[8];                        // copy MSB into iv
+    memcpy(cipher, BIGarray + 10, 16);          // BIGarray[11:26] -> cipher[1:16]
+    Serial << "device: " << rxDevice->name << '\n';
+    Serial << "key   : "; printByteArray(rxDevice->key); Serial << '\n';
+    Serial << "salt  : "; printByteArray(iv);            Serial << '\n';
+    Serial << "cipher: "; printByteArray(cipher);        Serial << '\n';
   } 
-  wc_AesInit      (&aesDec, NULL, INVALID_DEVID);                         // init aesDec 
-  wc_AesSetKey    (&aesDec, encKey, blkSize, iv, AES_ENCRYPTION);         // load dec key 
-  wc_AesCtrEncrypt(&aesDec, output, cipher, sizeof(cipher)/sizeof(byte)); // do decryption
-  if (checkForbadArgs()) Serial << F("**FAIL** bad args detected!");      //
-  wc_AesFree(&aesDec);    // free up resources
+  return ok;
 }
 
-/* Activate for use on multiple controllers
-void loadKey(){
-  if      (VICTRON_NAME == "My_Solar_Controller") memcpy(encKey,key_SC,sizeof(key_SC));   // key_SC -> encKey[]
-  else if (VICTRON_NAME == "My_SmartShunt_1")     memcpy(encKey,key_SS,sizeof(key_SS));   // key_SS -> encKey[]
-  else if (VICTRON_NAME == "My_BMV712_P1")        memcpy(encKey,key_P1,sizeof(key_P1));   // key_P1 -> encKey[]
-  else if (VICTRON_NAME == "My_BMV712_P2")        memcpy(encKey,key_P2,sizeof(key_P2));   // key_P2 -> encKey[]
-  else if (VICTRON_NAME == "My_BMV712_P3")        memcpy(encKey,key_P3,sizeof(key_P3));   // key_P3 -> encKey[]
-  else {
-    Serial << "\n\n *** Program HALTED: encryption key not set!\n";
-    while(1);
+int dudvals = 0, maxduds = 0;           // count of dud values in one set of readings
+VLine report;                           // one report line, see VictronCore/VFormat.h
+
+// the windows just closed, one line each, for the levels AGGREGATE selects
+static void printAggregates(int dev, uint8_t closed){
+  if (!AGGREGATE || BINARY) return;
+  for (int l = AGGREGATE - 1; l < VAGG_LEVELS; l++) {
+    if (!((closed >> l) & 1)) continue;
+    lineClear(report);
+    lineChar(report, '\t');
+    formatAgg(report, aggs[dev], l);
+    if (targets.count > 1) {lineStr(report, "  "); lineStr(report, targets.dev[dev].name);}
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
   }
 }
-*/
-
-bool na_batV = false;
-bool na_batA = false;
-bool na_kWh  = false;
-bool na_pvW  = false;
-bool na_lodA = false;
 
-int dudvals = 0, maxduds = 0;           // count of dud values in one set of readings
+// close the windows that have ended with no reading since, e.g. the device went out of range
+void tickAggregates(uint32_t ms){
+  for (int i = 0; i < targets.count; i++) printAggregates(i, aggTick(aggs[i], ms));
+}
 
 /* ------------------------------------------------------------------------
-Extract & decode bytes received and report current values. 
-NB: multiple bytes are little-endian (i.e order of double/triple bytes reversed)
-signed ints use 2's complement, so the first mask excises the sign bit */
+Decode bytes received (see decodeSC() in VictronCore/VDecode.cpp) into a SolarChargerReading,
+in the record's own integer units, and report current values. A value is a dud if outside the hard
+limits or out of line with the controller's recent readings (outlierCheck(), VictronCore/VOutlier.cpp),
+all in integer units, no float math here.
+The line is formatted into a fixed buffer by formatSC() (VictronCore/VFormat.cpp), nothing is allocated. */
 void reportSCvalues(){
   if (FILTERING) maxduds = 0; else maxduds = 10;              // if FILTERING, silences dud reporting  
   //if (TESTMODE) memcpy(output,testArray,16);                  // override output array with test values
-  float battV = parseBattVolts();       // -327.68 -> 327.66 V
-  float battA = parseBattAmps();        // -3276.8 -> 3276.6 A
-  float kWh   = parseKWHtoday();        //       0 -> 655.34 kWh
-  float PV_W  = parsePVpower();         //       0 -> 65534  W
-  float loadA = parseLoadAmps();        //       0 -> 51.0   A
-  //Serial << '\t'; 
+  SolarChargerReading v;
+  uint32_t c0 = ESP.getCycleCount();
+  decodeSC(output, v);
+  int dev = rxDevice - targets.dev;
   // -- flag (& optionally filter) any dud readings ---------------------------------------
-  if (!na_batV && (battV < BATTV_MIN || battV > BATTV_MAX)) dudvals++;
-  if (!na_batA && (battA < BATTA_MIN || battA > BATTA_MAX)) dudvals++;
-  if (!na_pvW  && (PV_W  >   PVW_MAX ))                     dudvals++;
-  if (!na_kWh  && (kWh   >   KWH_MAX ))                     dudvals++;
-  if (LOAD_AMPS){ if (!na_lodA  && (loadA< LOADA_MIN || loadA > LOADA_MAX)) dudvals++; }
-  // -- in-line reporting -----------------------------------------------------------------
-  if (!VERBOSE && dudvals) Serial << " *"; // flag if this reading contains one or more dud values
+  int32_t ov[VOUT_FIELDS];
+  uint8_t checked;
+  scOutValues(v, ov, checked);
+  if (!LOAD_AMPS) checked &= 0x0F;                        // load amps not checked
+  uint8_t duds = outlierCheck(outliers[dev], rxMs, ov, checked);   // a bit per dud value
+  for (uint8_t d = duds; d; d &= d - 1) dudvals++;         // one per dud value
+  latRecord(lat[VST_DECODE], ESP.getCycleCount() - c0);
+  if (dudvals) {stats.dev[dev].dudReadings++; stats.dev[dev].dudValues += dudvals;}
+  VHistory &h = history[dev];
+  if (h.buf) {VSample s; scSample(v, rxMs, s); historyAppend(h, s);}
+  if (!duds) energySC(energy[dev], rxMs, v);              // a dud value is not integrated, the interval spans it
+  // -- rolling summaries, without the dud readings if FILTERING --------------------------
+  if (!(FILTERING && dudvals)) {
+    int32_t x[VAGG_FIELDS];
+    uint8_t ok;
+    scAggValues(v, x, ok);
+    printAggregates(dev, aggAdd(aggs[dev], rxMs, x, ok));
+  }
+  if (BINARY) {                                           // one record, values as decoded & the dud bits
+    uint32_t c1 = ESP.getCycleCount();
+    uint8_t  rec[VWIRE_FRAME_MAX];
+    size_t   n = FILTERING && dudvals ? 0 : wireSC(rec, dev, rxMs, duds, v);
+    uint32_t c2 = ESP.getCycleCount();
+    Serial.write(rec, n);
+    latRecord(lat[VST_FORMAT], c2 - c1);
+    latRecord(lat[VST_SERIAL], ESP.getCycleCount() - c2);
+    dudvals = 0;
+    return;
+  }
+  if (AGGREGATE && !VERBOSE) {dudvals = 0; return;}       // summaries only
+  // -- in-line reporting, built in report then written in one go -------------------------
+  uint32_t c1 = ESP.getCycleCount();
+  lineClear(report);
+  if (!VERBOSE && dudvals) lineStr(report, " *");         // flag if this reading contains one or more dud values
   if (dudvals <= maxduds){
-    if (!VERBOSE) Serial << '\t';  else Serial << " "; 
-    reportDeviceState();  Serial << " ";
-    reportChargerError(); Serial << " ";
-    if (na_batV)  Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(battV,2),5);  Serial << "V ";
-    if (na_batA)  Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(battA,1),5);  Serial << "A | ";
-    if (na_kWh)   Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(kWh  ,2),6);  Serial << "kWh ";
-    if (na_pvW)   Serial << "n/a-"; else Serial << _WIDTH(_FLOAT(PV_W ,0),3);  Serial << "W  ";
-    if (LOAD_AMPS) {if (na_lodA) 
-                  Serial << " n/a-"; else Serial << _WIDTH(_FLOAT(loadA,1),4); Serial << "A";
-    }
+    lineChar(report, VERBOSE ? ' ' : '\t');
+    formatSC(report, v, LOAD_AMPS);
   }
-  if (dudvals) Serial << "\t[duds: " << dudvals << "]";
+  if (dudvals) {lineStr(report, "\t[duds: "); lineUInt(report, dudvals); lineChar(report, ']');}
+  if (targets.count > 1) {lineStr(report, "  "); lineStr(report, rxDevice->name);}
+  uint32_t c2 = ESP.getCycleCount();
+  Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  latRecord(lat[VST_FORMAT], c2 - c1);
+  latRecord(lat[VST_SERIAL], ESP.getCycleCount() - c2);
   // --------------------------------------------------------------------------------------
   dudvals = 0;  
-  na_batV = false;
-  na_batA = false;
-  na_kWh  = false;
-  na_pvW  = false;
-  na_lodA = false;
 }
 
-void reportDeviceState(){
-  if      (output[0] == 0) Serial << "_OFF__";
-  else if (output[0] == 1) Serial << "Lo_PWR";
-  else if (output[0] == 2) Serial << "FAULT ";
-  else if (output[0] == 3) Serial << "_BULK_";
-  else if (output[0] == 4) Serial << "ABSORB";
-  else if (output[0] == 5) Serial << "FLOAT_";
-  else if (output[0] == 6) Serial << "Store ";
-  else if (output[0] == 7) Serial << "Eq_Man";
-  else  Serial << "*" << _WIDTHZ(_HEX(output[0]),2) << "*";
+// H entered: per controller, the readings held and the last 10 minutes' PV watts range & yield
+void printHistory(){
+  Serial << '\n' << CF(dashes) << F("reading history") << CF(dashes) << '\n';
+  for (int i = 0; i < targets.count; i++) {
+    const VHistory &h = history[i];
+    Serial << '\t' << targets.dev[i].name << F(": ");
+    if (!h.buf)   {Serial << F("none\n"); continue;}
+    if (!h.count) {Serial << F("no readings yet\n"); continue;}
+    size_t bytes = historyBytes(h);
+    Serial << h.count << F(" readings over ") << _FLOAT(historySpanMs(h) / 60000.0, 1) << F(" min, ")
+           << bytes << '/' << h.blocks * VHIST_BLOCK << F(" bytes (") << _FLOAT(bytes / (float)h.count, 2)
+           << F(" per reading), ") << h.appended - h.count << F(" dropped as old\n");
+    VHistoryIter it;
+    VSample s;
+    int32_t wMin = INT32_MAX, wMax = INT32_MIN, kFirst = -1, kLast = -1;
+    SolarChargerReading r;
+    historyBegin(h, it, millis() - 600000);
+    while (historyNext(it, s)) {
+      scReading(s, r);
+      if (r.valid & SC_PVW) {wMin = min(wMin, (int32_t)r.pvW); wMax = max(wMax, (int32_t)r.pvW);}
+      if (r.valid & SC_KWH) {if (kFirst < 0) kFirst = r.yield10Wh; kLast = r.yield10Wh;}
+    }
+    lineClear(report);
+    lineStr(report, "\t  last 10 min: PV W ");
+    if (wMin <= wMax) {lineUInt(report, wMin); lineStr(report, " .. "); lineUInt(report, wMax);}
+    else lineStr(report, "-");
+    lineStr(report, ", yield kWh +");
+    if (kFirst >= 0) lineFixed(report, kLast - kFirst, 100, 2); else lineStr(report, "-");
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-void reportChargerError(){
-  if      (output[1] == 0) Serial << "no_err";
-  else if (output[1] == 1) Serial << "BATHOT";
-  else if (output[1] == 2) Serial << "VOLTHI";
-  else if (output[1] == 3) Serial << "REMC_A";
-  else if (output[1] == 4) Serial << "REMC_B";
-  else if (output[1] == 5) Serial << "REMC_C";
-  else if (output[1] == 6) Serial << "REMB_A";
-  else if (output[1] == 7) Serial << "REMB_B";
-  else if (output[1] == 8) Serial << "REMB_C";
-  else  Serial << "*" << _WIDTHZ(_HEX(output[1]),2) << "*";
+// E entered: per controller, the energy & charge integrated since startup, the rates and the cross-check
+void printEnergy(){
+  Serial << '\n' << CF(dashes) << F("energy") << CF(dashes) << '\n';
+  for (int i = 0; i < targets.count; i++) {
+    const VEnergy &e = energy[i];
+    Serial << '\t' << targets.dev[i].name << F(": ");
+    if (!e.readings) {Serial << F("no readings yet\n"); continue;}
+    lineClear(report);
+    formatEnergy(report, e);
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-// Some of the routines below use static_cast to convert integers  
-// to floats while avoiding dud fractions from integer division.
-
-// Note: SC & BM use same bytes (2,3) for battery volts
-float parseBattVolts(){
-  bool    neg       =  (output[3] & 0x80) >> 7;                   // extract sign bit
-  int16_t batt_mV10 = ((output[3] & 0x7F) << 8) | output[2];      // exclude sign bit from byte 3
-  if (batt_mV10 == 0x7FFF) na_batV = true;                       
-  if (neg) batt_mV10 = batt_mV10 - 32768;                         // 2's complement = val - 2^(b-1) b = bit# = 16
-  return (static_cast<float>(batt_mV10)/100);                     // integer units 10mV converted to V as float
+// L entered: p50 / p99 / max of each stage since startup, one JSON line each. The callback
+// stage is written by the BLE task as this reads it, so it is a snapshot
+void printLatency(){
+  Serial << '\n';
+  for (int i = 0; i < VST_COUNT; i++) {
+    lineClear(report);
+    formatLatency(report, stageName[i], lat[i], ESP.getCpuFreqMHz());
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-// Battery Current (signed) 16 bits = sign bit + 15 bits
-float parseBattAmps(){
-  bool neg = ((output[5]  & 0x80) >> 7);                          // extract sign bit
-  int16_t ma100 = ((output[5] & 0x7F) << 8) | output[4];          // exclude sign bit from byte 5
-  if (ma100 == 0x7FFF) na_batA = true;
-  if (neg) ma100 = ma100 - 32768;                                 // 2's complement = val - 2^(b-1) b = bit# = 16
-  return (static_cast<float>(ma100)/10);                          // convert mA100 to float A
+// S entered: the counters since startup, one line per target, then the IV gap & interval histograms
+void printStats(){
+  Serial << '\n' << CF(dashes) << F("stats") << CF(dashes) << '\n';
+  uint32_t calls, maxCycles;
+  uint64_t cycles;
+  callbackStats(calls, cycles, maxCycles);
+  Serial << F("\tadverts: ") << calls << F(" seen, ") << rxRing.pushed << F(" queued, ") << rxRing.dropped << F(" dropped (loop() behind)\n");
+  Serial << F("\tscans  : ") << stats.scanStarts << F(" started, ") << stats.notFound << F(" not found\n");
+  Serial << F("\tstack  : intake task ") << taskStackFree(intakeHandle) << F(" of ") << VPIPE_STACK << F(" bytes never used\n");
+  Serial << F("\tboot   : config (") << configSource << F(") loaded in ") << configUs << F(" us, first reading ");
+  if (firstReadingMs) Serial << firstReadingMs << F(" ms after boot\n"); else Serial << F("not yet\n");
+  for (int i = 0; i < targets.count + 2; i++) {
+    lineClear(report);
+    lineChar(report, '\t');
+    if      (i < targets.count)     formatDevStats(report, stats, i, targets.dev[i]);
+    else if (i == targets.count)    formatGapHist(report, stats);
+    else                            formatIntervalHist(report, stats);
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
 }
 
-// Today's Yield 16bits (unsigned int) units 0.01kWh (10Wh). 
-float parseKWHtoday(){
-  uint16_t Wh10     = (output[7] << 8) | output[6];               // NB little endian: byte[7] <-> byte[6]  
-  if (Wh10 == 0xFFFF) na_kWh = true;
-  return (static_cast<float>(Wh10)/100);                          // convert integer in 10Wh units to kWh as float 
+// K entered: the dud test steps k = 5 -> 8 -> 3 -> off (hard limits only) -> 5 spreads, then prints the settings
+// (record units, as decodeSC()) and what it has flagged per target
+void stepDudTest(){
+  static const uint8_t ks[] = {5, 8, 3, 0};
+  int i = 0;
+  while (i < 4 && ks[i] != outlierCfg.k) i++;
+  outlierCfg.k = ks[(i + 1) % 4];
+  Serial << F("\nDUD TEST - ");
+  if (outlierCfg.k) Serial << F("outside ") << outlierCfg.k << F(" spreads of the median of the last ") << VOUT_WINDOW
+                           << F(" good values, or the hard limits; a step after ") << outlierCfg.confirm << F(" in a row\n");
+  else              Serial << F("hard limits only\n");
+  for (int f = 0; f < outlierCfg.fields; f++) {
+    const VOutFieldCfg &c = outlierCfg.f[f];
+    Serial << '\t' << c.label << F(": ") << c.min << F(" .. ") << c.max << F(", floor ") << c.floor;
+    if (c.maxRate) Serial << F(", ") << c.maxRate << F("/sec at most");
+    Serial << '\n';
+  }
+  for (int t = 0; t < targets.count; t++) {
+    const VOutlier &o = outliers[t];
+    Serial << '\t' << targets.dev[t].name << F(": ") << o.readings << F(" readings, ") << o.outliers << F(" outliers, ")
+           << o.limits << F(" over limits, ") << o.steps << F(" steps followed\n");
+  }
+  Serial << '\n';
 }
 
-// PV panel power in Watts
-float parsePVpower(){
-  uint16_t pvW = (output[9] << 8) | output[8];                    // NB little endian: byte[9] <-> byte[8]
-  if (pvW == 0xFFFF) na_pvW = true;
-  return (static_cast<float>(pvW));                               // convert integer Watts to float 
+// U entered: a site config blob (host/mkconfig) follows within 2 secs. Checked in full, kept in NVS, then a restart
+// loads it. A blob without devices sets flags & dud test only, the targets stay as devices[]
+void uploadConfig(){
+  static byte    blob[VCFG_MAX];
+  static VConfig c;
+  Serial << F("\nUPLOAD - send the config blob\n");
+  Serial.setTimeout(2000);
+  size_t n   = Serial.readBytes(blob, VCFG_HEADER);
+  size_t len = n == VCFG_HEADER ? configLength(blob) : 0;
+  if (len > VCFG_HEADER && len <= sizeof(blob)) n += Serial.readBytes(blob + n, len - n);
+  if (!len || n != len || !configParse(blob, n, c)) {
+    while (Serial.available()) Serial.read();
+    Serial << F("** not a valid config blob (") << n << F(" bytes), nothing changed\n\n");
+    return;
+  }
+  if (!configStore(VCFG_NVS_KEY, blob, n)) {Serial << F("** config blob not stored, NVS write failed\n\n"); return;}
+  Serial << F("UPLOAD - ") << n << F(" bytes, ") << c.count << F(" devices kept in NVS, restarting\n");
+  Serial.flush();
+  ESP.restart();
 }
 
-// Load current? (Possibly irrelevant as VictronConnect doesn't even display this)
-float parseLoadAmps(){
-  uint16_t PVma100 = ((output[11] & 0x01) << 8) | output[10];     // NB little endian: byte[11] <-> byte[10] 
-  if (PVma100 == 0x1FF) na_lodA = true;
-  return (static_cast<float>(PVma100)/10);                        //  convert integer in 100mA units to Amps as float 
-} 
-
 // --------------------------------- Shared routines ---------------------------------------------
-bool checkForbadArgs(){
-  int x = wc_AesCtrEncrypt(   NULL, output, cipher, sizeof(cipher)/sizeof(byte)); 
-  int y = wc_AesCtrEncrypt(&aesDec, NULL,   cipher, sizeof(cipher)/sizeof(byte)); 
-  int z = wc_AesCtrEncrypt(&aesDec, output, NULL,   sizeof(cipher)/sizeof(byte)); 
+// one-off check at startup that wolfssl rejects bad arguments
+bool checkForbadArgs(Aes *aes){
+  int x = wc_AesCtrEncrypt(NULL, output, cipher, sizeof(cipher)/sizeof(byte)); 
+  int y = wc_AesCtrEncrypt(aes,  NULL,   cipher, sizeof(cipher)/sizeof(byte)); 
+  int z = wc_AesCtrEncrypt(aes,  output, NULL,   sizeof(cipher)/sizeof(byte)); 
   if (x == WC_NO_ERR_TRACE(BAD_FUNC_ARG) && 
       y == WC_NO_ERR_TRACE(BAD_FUNC_ARG) && 
       z == WC_NO_ERR_TRACE(BAD_FUNC_ARG)) 
@@ -2,20 +2,52 @@
 
 // -----------------------------------------------------------------
 #include "BLEDevice.h"
+#include <VictronCore.h>        // device table, decodeSC()
 
-// replace with actual Name and Address
-#define VICTRON_ADDRESS "ff:ff:ff:ff:ff:ff"     // Solar Controller address (lower case)
-#define VICTRON_NAME    "My_Solar_Controller"
+// The target controllers (address, name & key) come from the site config blob kept in NVS (see
+// VictronCore/VConfig.h, host/mkconfig, U), or if there is none are listed in devices[] in VSC.cpp
+struct DeviceInit {
+  const char *address;          // lower case, e.g. "aa:bb:cc:dd:ee:ff"
+  const char *name;
+  byte        key[16];
+};
+extern VConfig config;
+extern VDeviceTable targets;
+extern void loadDevices();
+extern void uploadConfig();
+extern const char *configSource;
+extern uint32_t configUs, firstReadingMs;   // boot: config load time, first reading
+
+// counters & histograms, always on (see VictronCore/VStats.h)
+extern VStats stats;
+extern void printStats();
+
+// learned scan windows for the adaptive scan mode (see VictronCore/VSchedule.h)
+extern VScheduler sched;
+
+// RAM kept for the reading history, split evenly between the targets (see VictronCore/VHistory.h)
+#define HISTORY_BYTES 65536     // 45 min or more of 5 readings/sec, if only one controller is listed
+extern VHistory history[VDEV_MAX];
+extern void printHistory();
+
+// energy & charge in/out, rates and a cross-check with the device's own count, per target (see VictronCore/VEnergy.h)
+extern VEnergy energy[VDEV_MAX];
+extern void printEnergy();
+
+// 1 sec / 1 min / 1 hour min/mean/max/last of volts, amps & PV watts per target (see VictronCore/VAggregate.h)
+extern VAggregator aggs[VDEV_MAX];
+extern void tickAggregates(uint32_t ms);
+
+// p50 / p99 / max of each pipeline stage, in CPU cycles (see VictronCore/VLatency.h)
+extern VLatency lat[VST_COUNT];
+extern void printLatency();
 
-// Set upper & lower threshholds for detecting dud readings 
-#define BATTV_MIN   20    // volts
-#define BATTV_MAX   34    // volts
-#define BATTA_MIN    0    // amps
-#define BATTA_MAX  200    // amps
-#define   KWH_MAX  500    // kilo watt hours
-#define   PVW_MAX 1000    // watts
-#define LOADA_MIN    0    // amps
-#define LOADA_MAX  200    // amps
+// Dud readings: each value is tested against the controller's own recent readings, per field
+// (see VictronCore/VOutlier.h), so nothing here depends on the site. The hard limits in
+// outlierCfg (VSC.cpp) take 12, 24 & 48 V systems; it is in RAM, K steps the test at runtime
+extern VOutlierCfg outlierCfg;
+extern VOutlier outliers[VDEV_MAX];
+extern void stepDudTest();
 
 extern BLEScan *pBLEScan; // = BLEDevice::getScan();
 
@@ -29,19 +61,22 @@ class AdDataCallback : public BLEAdvertisedDeviceCallbacks {
 #include "wolfssl.h"
 #include "wolfssl/wolfcrypt/aes.h" // was #include <wolfssl/wolfcrypt/aes.h>
 
-extern void encryptAesCtr();
-extern void decryptAesCtr(bool quiet);
+extern void loadFrame(const VFrame &f, const byte plain[16]);
+extern bool decryptAesCtr(bool quiet, bool ok);
 
 const word32 blkSize = AES_BLOCK_SIZE * 1; 
 
-extern byte inputs[blkSize]; 
 extern byte cipher[blkSize]; 
 extern byte output[blkSize]; 
 
-extern bool mfrDataReceived;
+extern VRing rxRing, frameRing;
+extern VIntake intake;
+extern VTask intakeHandle;
+extern volatile bool mfrRepeat;
+extern VDevice *rxDevice;
+extern void callbackStats(uint32_t &calls, uint64_t &cycles, uint32_t &maxCycles);
 
 extern void reportSCvalues();
-extern float parseBattVolts();
 
 extern void printBIGarray();
 extern void printByteArray(byte byteArray[16]);
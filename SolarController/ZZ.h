@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Streaming.h> 
+#include <atomic>
 
 extern const char dashes[];                                                     // in PROGMEM
 extern const char line[];  
@@ -9,6 +10,18 @@ extern void processSerialCommands();
 
 extern bool VERBOSE;
 extern bool FILTERING;
+extern bool HISTORY;
+extern bool ENERGY;
+extern int  AGGREGATE;
+extern const char *aggModes[];                                                  // AGGREGATE names
+extern bool LATENCY;
+extern bool STATS;
+extern bool DUDTEST;
+extern bool UPLOAD;
+extern std::atomic<bool> CAPTURE;                                               // read by the BLE callback, on the other core
+extern bool BINARY;
+extern std::atomic<bool> CONTINUOUS;                                            // read by the intake task, on the other core
+extern std::atomic<bool> ADAPTIVE;                                              // read by the intake task, on the other core
 extern bool LOAD_AMPS;
 
 #define CF(x) ((const __FlashStringHelper *)x)                                  // to stream a const char[]
@@ -0,0 +1,486 @@
+/* Routines for a receiver serving any mix of Victron devices to
+- retrieve the data advertised over Bluetooth Low Energy (BLE)   
+- decrypt, then decode & report each record with the codec for its type (VictronCore/VRecord.h) */ 
+
+#include "ZZ.h"
+#include "VRX.h"
+
+#if defined(NO_AES) or !defined(WOLFSSL_AES_COUNTER) or !defined(WOLFSSL_AES_128)
+#error "Missing AES, WOLFSSL_AES_COUNTER or WOLFSSL_AES_128"
+#endif
+
+byte BIGarray[26]    = {0};   // for all manufacturer data including encypted data
+byte     iv[blkSize] = {0};   // initialisation vector 
+byte cipher[blkSize] = {0};   // encrypted data
+byte output[blkSize] = {0};   // decrypted result
+
+VRing rxRing;                 // readings from the BLE callback to the intake task
+VRing frameRing;              // ... and on from the intake task to loop(), in batches
+VIntake intake;               // see intakeTask()
+VTask intakeHandle;           // the intake task, for its stack in printStats()
+volatile bool mfrRepeat       = false;   // a repeat of the last reading was dropped
+unsigned int mfrLen  = 0;     // bytes held in BIGarray
+VDevice *rxDevice    = nullptr;   // device that sent BIGarray
+uint32_t rxMs        = 0;     // millis() when the reading in BIGarray was received
+uint32_t cbCalls     = 0;     // onResult() calls, for every advertiser in range
+uint64_t cbCycles    = 0;     // CPU cycles spent in onResult()
+uint32_t cbMaxCycles = 0;
+portMUX_TYPE cbMux   = portMUX_INITIALIZER_UNLOCKED;   // the callback counters: updated & read as one, from the other core
+
+// replace with actual address, name & key values (in lower case), one line per device of any type
+const DeviceInit devices[] = {
+  {"ff:ff:ff:ff:ff:ff", "My_SmartShunt",   {0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff}},
+//{"ff:ff:ff:ff:ff:fe", "My_SmartSolar",   {0x96,0x52,0x4c,0xc1,0x1d,0x95,0x1b,0x63,0x79,0x6d,0x05,0xa9,0xac,0xce,0x73,0x18}},
+//{"ff:ff:ff:ff:ff:fd", "My_Orion_DCDC",   {0x21,0x4e,0x63,0x51,0x1c,0xa9,0xff,0x90,0xdb,0xf9,0xce,0x3d,0xf0,0x53,0x15,0x28}},
+//{"ff:ff:ff:ff:ff:fc", "My_BatteryProt",  {0x5c,0x0b,0x8e,0x27,0x6a,0x31,0xd4,0x90,0x13,0x7f,0xe2,0x48,0xa6,0x05,0xbb,0x71}},
+};
+
+VConfig config;               // the site config, stored or devices[]: the targets' names live here
+VDeviceTable targets;         // config devices by address, with key schedules expanded
+const char *configSource = "devices[]";   // where the targets came from
+uint32_t configUs    = 0;     // loadDevices() time at boot
+uint32_t firstReadingMs = 0;  // millis() at the first reading decrypted
+VStats stats;                 // counters, printed by S
+VScheduler sched;             // adaptive scan windows, see scanWindow()
+VBalance balance;             // the bank's power balance, see balanceRecord()
+VLatency lat[VST_COUNT];      // per stage, in CPU cycles
+// the Battery Monitors & Solar Controllers among the targets, each set up by its first reading, see keepReading()
+uint8_t kinds[VDEV_MAX];      // record type kept per target, 0 none yet
+VAggregator aggs[VDEV_MAX];   // rolling summaries
+VHistory history[VDEV_MAX];   // decoded readings, in a share of hbuf
+VEnergy energy[VDEV_MAX];     // integrated readings
+VOutlierCfg bmOutlierCfg = bmOutlierDefaults;   // dud test settings, shared by the Battery Monitors
+VOutlierCfg scOutlierCfg = scOutlierDefaults;   // ... and by the Solar Controllers
+VOutlier outliers[VDEV_MAX];  // dud test state
+byte *hbuf = nullptr;         // HISTORY_BYTES, split evenly between the targets
+
+// --- forward declarations ---
+bool checkForbadArgs(Aes *aes);
+void printBIGarray();
+void printByteArray(byte byteArray[16]);
+void printBins();
+
+BLEScan *pBLEScan = nullptr;                                            // don't call getScan() immediately (else crash dumps happen!)
+
+// --------------------------------------------------------------------------------
+// Load the targets, expanding each key schedule once here rather than per reading: from the site config blob
+// kept in NVS (see uploadConfig()) if there is one, else from devices[]. The blob may set the flags & dud test too
+void loadDevices(){
+  uint32_t c0 = ESP.getCycleCount();
+  static byte blob[VCFG_MAX];
+  size_t n = configRead(VCFG_NVS_KEY, blob, sizeof(blob));
+  bool stored = n && configParse(blob, n, config);
+  if (n && !stored) Serial << F("** Config blob in NVS is not valid, ignored\n");
+  if (!stored) initConfig(config);
+  if (config.hasFlags) {
+    FILTERING = config.flags & VCFG_FILTERING;
+    VERBOSE   = config.flags & VCFG_VERBOSE;
+  }
+  if (config.hasBM) bmOutlierCfg = config.bm;
+  if (config.hasSC) scOutlierCfg = config.sc;
+  configSource = config.count ? "stored blob" : stored ? "stored blob & devices[]" : "devices[]";
+  if (!config.count)
+    for (const DeviceInit &d : devices)
+      if (!configAddDevice(config, macFromString(d.address), d.key, d.name)) {
+        Serial << "\n\n *** Program HALTED: bad or duplicate address " << d.address << " for " << d.name << '\n';
+        while(1);
+      }
+  configDevices(config, targets);
+  configUs = (ESP.getCycleCount() - c0) / ESP.getCpuFreqMHz();
+  if (checkForbadArgs(&targets.dev[0].aes.aes)) Serial << F("**FAIL** bad args detected!\n");
+  initStats(stats);
+  initScheduler(sched, targets.count, millis());
+  initBalance(balance);
+  for (VLatency &l : lat) initLatency(l);
+  memset(kinds, 0, sizeof(kinds));
+  hbuf = static_cast<byte *>(malloc(HISTORY_BYTES));      // allocated once, here: nothing is allocated per reading
+  if (!hbuf) Serial << F("** No reading history: HISTORY_BYTES not available\n");
+}
+
+// --------------------------------------------------------------------------------
+// Scan for BLE servers for the advertising service we seek. Called for each advertising server
+void AdDataCallback::onResult(BLEAdvertisedDevice advertiser) {
+  uint32_t t0 = ESP.getCycleCount();
+  VDevice *dev = findDevice(targets, macFromBytes(*advertiser.getAddress().getNative()));
+  if (dev){                                                           // select a target device
+    size_t len;
+    const byte *mfr = findVictronData(advertiser.getPayload(), advertiser.getPayloadLength(), len);  // view into the raw payload
+    if (mfr) {                                                        // Victron company id 0x02E1 + 0x10 manufacturer data
+      stats.dev[dev - targets.dev].adverts++;
+      if (!CAPTURE && isDuplicate(*dev, mfr, len)) mfrRepeat = true;  // same IV & data as last time: drop it here (kept in a capture)
+      else if (ringPush(rxRing, dev->mac, advertiser.getRSSI(), millis(), mfr, len) && !CAPTURE)   // bounded time, counted as dropped if loop() is behind
+        dedupAccept(*dev, mfr, len);                                    // kept only once queued, so a dropped frame's repeat is let through
+    }
+  }
+  uint32_t cycles = ESP.getCycleCount() - t0;
+  latRecord(lat[VST_CALLBACK], cycles);
+  portENTER_CRITICAL(&cbMux);                                         // cbCycles is 64 bit: never read half written
+  cbCycles += cycles;
+  if (cycles > cbMaxCycles) cbMaxCycles = cycles;
+  cbCalls++;
+  portEXIT_CRITICAL(&cbMux);
+}
+
+// the callback counters as one consistent copy, for loop()
+void callbackStats(uint32_t &calls, uint64_t &cycles, uint32_t &maxCycles){
+  portENTER_CRITICAL(&cbMux);
+  calls     = cbCalls;
+  cycles    = cbCycles;
+  maxCycles = cbMaxCycles;
+  portEXIT_CRITICAL(&cbMux);
+}
+
+// copy a reading taken from the ring into BIGarray, and its decrypted record (see loop()) into output
+void loadFrame(const VFrame &f, const byte plain[16]){
+  rxDevice = findDevice(targets, f.mac);                  // always found, the callback checked
+  rxMs     = f.ms;
+  mfrLen   = f.len;
+  memcpy(BIGarray, f.data, f.len);
+  memcpy(output, plain, blkSize);
+}
+
+// --------------------------------------------------------------------------------
+// the batch was decrypted in one pass by decryptFrames() in loop() (ok: this frame was): print the details. false if wrong key
+bool decryptAesCtr(bool VERBOSE, bool ok){
+  if (VERBOSE) {
+    iv[0] = BIGarray[7];                        // copy LSB into iv
+    iv[1] = BIGarray[8];                        // copy MSB into iv
+    memcpy(cipher, BIGarray + 10, 16);          // BIGarray[11:26] -> cipher[1:16]
+    Serial << F("device: ") << rxDevice->name << '\n';
+    Serial << F("key   : "); printByteArray(rxDevice->key); Serial << '\n';
+    Serial << F("salt  : "); printByteArray(iv);            Serial << '\n';
+    Serial << F("cipher: "); printByteArray(cipher);        Serial << '\n';
+    } 
+  return ok;
+}
+
+// =====================================================================================
+
+int dudvals = 0;               // dud values in the reading being reported
+VLine report;                 // one report line, see VictronCore/VFormat.h
+
+// the windows just closed, one line each, for the levels AGGREGATE selects
+static void printAggregates(int dev, uint8_t closed){
+  if (!AGGREGATE || BINARY) return;
+  for (int l = AGGREGATE - 1; l < VAGG_LEVELS; l++) {
+    if (!((closed >> l) & 1)) continue;
+    lineClear(report);
+    lineChar(report, '\t');
+    formatAgg(report, aggs[dev], l);
+    lineStr(report, "  ");
+    lineStr(report, targets.dev[dev].name);
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+}
+
+// close the windows that have ended with no reading since, e.g. the device went out of range
+void tickAggregates(uint32_t ms){
+  for (int i = 0; i < targets.count; i++) if (kinds[i]) printAggregates(i, aggTick(aggs[i], ms));
+}
+
+// a target's first Battery Monitor or Solar Controller reading: its summaries, dud test, energy & history
+// set up for that kind
+static void setupKind(int dev, uint8_t type){
+  bool   bm  = type == VREC_BATTERY_MONITOR;
+  size_t per = HISTORY_BYTES / targets.count;
+  kinds[dev] = type;
+  initAggregator(aggs[dev], bm ? bmAggFields : scAggFields, bm ? VAGG_BM_FIELDS : VAGG_SC_FIELDS);
+  initOutlier(outliers[dev], bm ? &bmOutlierCfg : &scOutlierCfg);
+  initEnergy(energy[dev]);
+  if (hbuf && !initHistory(history[dev], hbuf + dev * per, per, bm ? VHIST_BM_FIELDS : VHIST_SC_FIELDS, bm ? VHIST_BM_XOR : VHIST_SC_XOR))
+    Serial << F("** No reading history for ") << targets.dev[dev].name << F(": HISTORY_BYTES too small\n");
+}
+
+// true if rxDevice's readings are kept: a Battery Monitor or a Solar Controller, of the kind it first sent
+bool kept(){
+  uint8_t type = BIGarray[VMFR_RECORD], kind = kinds[rxDevice - targets.dev];
+  return (type == VREC_BATTERY_MONITOR || type == VREC_SOLAR_CHARGER) && (!kind || kind == type);
+}
+
+/* ------------------------------------------------------------------------
+Keep a Battery Monitor's or a Solar Controller's reading
+--------------------------------------------------------
+As the BatteryMonitor & SolarController sketches do: the reading is decoded, its values
+tested for duds (outlierCheck(), VictronCore/VOutlier.cpp, the settings for its kind),
+appended to its history, summarised (without the dud readings if FILTERING) and, with
+no dud value, integrated. Returns the dud bits, counted in dudvals. Other types are
+reported as decoded, nothing is kept.
+------------------------------------------------------------------------ */
+uint8_t keepReading(){
+  dudvals = 0;
+  if (!kept()) return 0;
+  uint32_t c0 = ESP.getCycleCount();
+  uint8_t type = BIGarray[VMFR_RECORD];
+  int dev = rxDevice - targets.dev;
+  if (!kinds[dev]) setupKind(dev, type);
+  int32_t ov[VOUT_FIELDS], x[VAGG_FIELDS];
+  uint8_t checked, ok, duds;
+  VSample s;
+  if (type == VREC_BATTERY_MONITOR) {
+    BatteryMonitorReading r;
+    decodeBM(output, r);
+    bmOutValues(r, ov, checked);
+    duds = outlierCheck(outliers[dev], rxMs, ov, checked);
+    bmSample(r, rxMs, s);
+    bmAggValues(r, x, ok);
+    if (!duds) energyBM(energy[dev], rxMs, r);            // a dud value is not integrated, the interval spans it
+  }
+  else {
+    SolarChargerReading r;
+    decodeSC(output, r);
+    scOutValues(r, ov, checked);
+    duds = outlierCheck(outliers[dev], rxMs, ov, checked);
+    scSample(r, rxMs, s);
+    scAggValues(r, x, ok);
+    if (!duds) energySC(energy[dev], rxMs, r);
+  }
+  for (uint8_t d = duds; d; d &= d - 1) dudvals++;         // one per dud value
+  latRecord(lat[VST_DECODE], ESP.getCycleCount() - c0);
+  if (dudvals) {stats.dev[dev].dudReadings++; stats.dev[dev].dudValues += dudvals;}
+  if (history[dev].buf) historyAppend(history[dev], s);
+  if (!(FILTERING && dudvals)) printAggregates(dev, aggAdd(aggs[dev], rxMs, x, ok));
+  return duds;
+}
+
+/* ------------------------------------------------------------------------
+Report any record
+-----------------
+The record type (BIGarray[VMFR_RECORD]) selects the codec from the registry in 
+VictronCore/VRecord.cpp, which decodes the 16 decrypted bytes into labelled fields. 
+formatRecord() (VictronCore/VFormat.cpp) prints them as "label value" pairs into a 
+fixed buffer, nothing is allocated. Unknown types are reported, not decoded. A reading
+with dud values (see keepReading()) is flagged, its values left out if FILTERING.
+------------------------------------------------------------------------ */
+void reportRecord(){
+  uint32_t c1 = ESP.getCycleCount();
+  uint8_t type = BIGarray[VMFR_RECORD];
+  VRecord r;
+  lineClear(report);
+  if (!VERBOSE && dudvals) lineStr(report, " *");         // flag if this reading contains one or more dud values
+  lineChar(report, VERBOSE ? ' ' : '\t');
+  lineStr(report, rxDevice->name);
+  lineStr(report, ": ");
+  if (FILTERING && dudvals) lineChar(report, '-');
+  else if (decodeRecord(type, output, r)) formatRecord(report, r);
+  else {lineStr(report, "record type 0x"); lineHex2(report, type); lineStr(report, " not supported");}
+  if (dudvals) {lineStr(report, "\t[duds: "); lineUInt(report, dudvals); lineChar(report, ']');}
+  uint32_t c2 = ESP.getCycleCount();
+  Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  latRecord(lat[VST_FORMAT], c2 - c1);
+  latRecord(lat[VST_SERIAL], ESP.getCycleCount() - c2);
+}
+
+// binary mode: the record received at ms, see setBinary(). A kept reading goes out decoded with its dud
+// bits (dropped if FILTERING) as in the other sketches, any other record as is
+void writeRecord(uint32_t ms, uint8_t duds){
+  uint32_t c1 = ESP.getCycleCount();
+  uint8_t  rec[VWIRE_FRAME_MAX];
+  uint8_t  dev  = rxDevice - targets.dev, type = BIGarray[VMFR_RECORD];
+  size_t   n    = 0;
+  if (!kept()) n = wireRecord(rec, dev, ms, type, output);
+  else if (FILTERING && duds) n = 0;
+  else if (type == VREC_BATTERY_MONITOR) {BatteryMonitorReading r; decodeBM(output, r); n = wireBM(rec, dev, ms, duds, r);}
+  else                                   {SolarChargerReading   r; decodeSC(output, r); n = wireSC(rec, dev, ms, duds, r);}
+  uint32_t c2 = ESP.getCycleCount();
+  Serial.write(rec, n);
+  latRecord(lat[VST_FORMAT], c2 - c1);
+  latRecord(lat[VST_SERIAL], ESP.getCycleCount() - c2);
+}
+
+// a Battery Monitor's or a Solar Controller's reading, received at ms, into the bank's power balance:
+// true if a new balance was made. A reading with a dud value (duds, from keepReading()) is left out, as
+// a wild current would skew every balance it is interpolated into. Decoded again here, a few shifts
+bool balanceRecord(uint32_t ms, uint8_t duds){
+  if (duds) return false;
+  int dev = rxDevice - targets.dev;
+  switch (BIGarray[VMFR_RECORD]) {
+    case VREC_BATTERY_MONITOR: {BatteryMonitorReading r; decodeBM(output, r); return balanceBM(balance, dev, ms, r);}
+    case VREC_SOLAR_CHARGER:   {SolarChargerReading   r; decodeSC(output, r); return balanceSC(balance, dev, ms, r);}
+  }
+  return false;
+}
+
+// P on: the balance just made, on a line of its own after the reading that made it
+void printBalance(){
+  lineClear(report);
+  lineStr(report, "\n\t= ");
+  formatBalance(report, balance);
+  Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+}
+
+// H entered: per Battery Monitor & Solar Controller, the readings held and the last 10 minutes' range of
+// battery volts & amps (BM) or PV watts & the yield (SC)
+void printHistory(){
+  Serial << '\n' << CF(dashes) << F("reading history") << CF(dashes) << '\n';
+  for (int i = 0; i < targets.count; i++) {
+    const VHistory &h = history[i];
+    Serial << '\t' << targets.dev[i].name << F(": ");
+    if (!kinds[i]) {Serial << F("none kept (no reading yet, or not a Battery Monitor or Solar Controller)\n"); continue;}
+    if (!h.buf)    {Serial << F("none\n"); continue;}
+    size_t bytes = historyBytes(h);
+    Serial << h.count << F(" readings over ") << _FLOAT(historySpanMs(h) / 60000.0, 1) << F(" min, ")
+           << bytes << '/' << h.blocks * VHIST_BLOCK << F(" bytes (") << _FLOAT(bytes / (float)(h.count ? h.count : 1), 2)
+           << F(" per reading), ") << h.appended - h.count << F(" dropped as old\n");
+    VHistoryIter it;
+    VSample s;
+    int32_t lo[2] = {INT32_MAX, INT32_MAX}, hi[2] = {INT32_MIN, INT32_MIN}, kFirst = -1, kLast = -1;
+    historyBegin(h, it, millis() - 600000);
+    while (historyNext(it, s)) {
+      if (kinds[i] == VREC_BATTERY_MONITOR) {
+        BatteryMonitorReading r;
+        bmReading(s, r);
+        if (r.valid & BM_BATTV) {lo[0] = min(lo[0], (int32_t)r.battV); hi[0] = max(hi[0], (int32_t)r.battV);}
+        if (r.valid & BM_BATTA) {lo[1] = min(lo[1], r.battA);          hi[1] = max(hi[1], r.battA);}
+      }
+      else {
+        SolarChargerReading r;
+        scReading(s, r);
+        if (r.valid & SC_PVW) {lo[0] = min(lo[0], (int32_t)r.pvW); hi[0] = max(hi[0], (int32_t)r.pvW);}
+        if (r.valid & SC_KWH) {if (kFirst < 0) kFirst = r.yield10Wh; kLast = r.yield10Wh;}
+      }
+    }
+    lineClear(report);
+    if (kinds[i] == VREC_BATTERY_MONITOR) {
+      lineStr(report, "\t  last 10 min: batt V ");
+      if (lo[0] <= hi[0]) {lineFixed(report, lo[0], 100, 2); lineStr(report, " .. "); lineFixed(report, hi[0], 100, 2);}
+      else lineStr(report, "-");
+      lineStr(report, ", amps ");
+      if (lo[1] <= hi[1]) {lineFixed(report, lo[1], 1000, 3); lineStr(report, " .. "); lineFixed(report, hi[1], 1000, 3);}
+      else lineStr(report, "-");
+    }
+    else {
+      lineStr(report, "\t  last 10 min: PV W ");
+      if (lo[0] <= hi[0]) {lineUInt(report, lo[0]); lineStr(report, " .. "); lineUInt(report, hi[0]);}
+      else lineStr(report, "-");
+      lineStr(report, ", yield kWh +");
+      if (kFirst >= 0) lineFixed(report, kLast - kFirst, 100, 2); else lineStr(report, "-");
+    }
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
+}
+
+// E entered: per Battery Monitor & Solar Controller, the energy & charge integrated since startup, the rates
+// and the cross-check
+void printEnergy(){
+  Serial << '\n' << CF(dashes) << F("energy") << CF(dashes) << '\n';
+  for (int i = 0; i < targets.count; i++) {
+    const VEnergy &e = energy[i];
+    Serial << '\t' << targets.dev[i].name << F(": ");
+    if (!kinds[i] || !e.readings) {Serial << F("no readings yet\n"); continue;}
+    lineClear(report);
+    formatEnergy(report, e);
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
+}
+
+// L entered: p50 / p99 / max of each stage since startup, one JSON line each. The callback
+// stage is written by the BLE task as this reads it, so it is a snapshot
+void printLatency(){
+  Serial << '\n';
+  for (int i = 0; i < VST_COUNT; i++) {
+    lineClear(report);
+    formatLatency(report, stageName[i], lat[i], ESP.getCpuFreqMHz());
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
+}
+
+// S entered: the counters since startup, one line per target, then the IV gap & interval histograms
+void printStats(){
+  Serial << '\n' << CF(dashes) << F("stats") << CF(dashes) << '\n';
+  uint32_t calls, maxCycles;
+  uint64_t cycles;
+  callbackStats(calls, cycles, maxCycles);
+  Serial << F("\tadverts: ") << calls << F(" seen, ") << rxRing.pushed << F(" queued, ") << rxRing.dropped << F(" dropped (loop() behind)\n");
+  Serial << F("\tscans  : ") << stats.scanStarts << F(" started, ") << stats.notFound << F(" not found\n");
+  Serial << F("\tstack  : intake task ") << taskStackFree(intakeHandle) << F(" of ") << VPIPE_STACK << F(" bytes never used\n");
+  Serial << F("\tboot   : config (") << configSource << F(") loaded in ") << configUs << F(" us, first reading ");
+  if (firstReadingMs) Serial << firstReadingMs << F(" ms after boot\n"); else Serial << F("not yet\n");
+  Serial << F("\tbalance: ") << balance.balances << F(" made, ") << balance.partial << F(" partial (a charger stale), ")
+         << balance.unaligned << F(" unaligned, ") << balance.extra << F(" readings not taken (a second monitor, over ")
+         << VBAL_CHARGERS << F(" chargers)\n");
+  for (int i = 0; i < targets.count + 2; i++) {
+    lineClear(report);
+    lineChar(report, '\t');
+    if      (i < targets.count)     formatDevStats(report, stats, i, targets.dev[i]);
+    else if (i == targets.count)    formatGapHist(report, stats);
+    else                            formatIntervalHist(report, stats);
+    lineChar(report, '\n');
+    Serial.write(reinterpret_cast<const uint8_t *>(report.buf), report.len);
+  }
+  Serial << '\n';
+}
+
+// U entered: a site config blob (host/mkconfig) follows within 2 secs. Checked in full, kept in NVS, then a restart
+// loads it. A blob without devices leaves the targets as devices[]
+void uploadConfig(){
+  static byte    blob[VCFG_MAX];
+  static VConfig c;
+  Serial << F("\nUPLOAD - send the config blob\n");
+  Serial.setTimeout(2000);
+  size_t n   = Serial.readBytes(blob, VCFG_HEADER);
+  size_t len = n == VCFG_HEADER ? configLength(blob) : 0;
+  if (len > VCFG_HEADER && len <= sizeof(blob)) n += Serial.readBytes(blob + n, len - n);
+  if (!len || n != len || !configParse(blob, n, c)) {
+    while (Serial.available()) Serial.read();
+    Serial << F("** not a valid config blob (") << n << F(" bytes), nothing changed\n\n");
+    return;
+  }
+  if (!configStore(VCFG_NVS_KEY, blob, n)) {Serial << F("** config blob not stored, NVS write failed\n\n"); return;}
+  Serial << F("UPLOAD - ") << n << F(" bytes, ") << c.count << F(" devices kept in NVS, restarting\n");
+  Serial.flush();
+  ESP.restart();
+}
+
+// --------------------------------- Shared routines ---------------------------------------------
+// one-off check at startup that wolfssl rejects bad arguments
+bool checkForbadArgs(Aes *aes){
+  int x = wc_AesCtrEncrypt(NULL, output, cipher, sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
+  int y = wc_AesCtrEncrypt(aes,  NULL,   cipher, sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
+  int z = wc_AesCtrEncrypt(aes,  output, NULL,   sizeof(cipher)/sizeof(byte)); //, WC_NO_ERR_TRACE(BAD_FUNC_ARG));
+  if (x == WC_NO_ERR_TRACE(BAD_FUNC_ARG) && 
+      y == WC_NO_ERR_TRACE(BAD_FUNC_ARG) && 
+      z == WC_NO_ERR_TRACE(BAD_FUNC_ARG)) 
+       return false;
+  else return true;
+}
+
+// print all bytes, before decryption
+void printBIGarray(){
+  Serial << "[";   
+  int sz = sizeof(BIGarray);
+  for (int i=0; i<sz; i++) {
+    if (BIGarray[i] < 0x10) Serial << "0"; 
+    Serial << _HEX(BIGarray[i]);
+    if      (i ==  6) Serial << " (";
+    else if (i ==  8) Serial << ") ";
+    else if (i ==  9) Serial <<  "] ";
+    else if (i == 17) Serial << " | ";
+    else if (i<sz-1)  Serial << " ";
+  } 
+//Serial << '\n';
+}
+
+// print out HEX bytes for the nominated 16 byte array
+void printByteArray(byte byteArray[16]) {
+  for (int i = 0; i < 16; i++) { 
+    if (byteArray[i] < 0x10) Serial << "0";
+    Serial << _HEX(byteArray[i]);
+    if      (i == 7) Serial << " | "; // half way marker
+    else if (i < 15) Serial << " "; 
+  }
+}
+
+void printBins(byte byteArray[16]){
+  for (int i=0; i<16; i++) {
+    Serial << '\t';
+    if (i < 10) Serial << " ";
+    Serial << "[" << i << "] " << _WIDTHZ(_BIN(byteArray[i]),8) << " | " << _WIDTHZ(_HEX(byteArray[i]),2) << '\n'; 
+  }
+}
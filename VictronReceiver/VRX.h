@@ -0,0 +1,88 @@
+#pragma once
+
+// -----------------------------------------------------------------
+#include "BLEDevice.h"
+#include <VictronCore.h>        // device table, codec registry, formatRecord()
+
+// The target devices (address, name & key), of any type, come from the site config blob kept in NVS
+// (see VictronCore/VConfig.h, host/mkconfig, U), or if there is none are listed in devices[] in VRX.cpp
+struct DeviceInit {
+  const char *address;          // lower case, e.g. "aa:bb:cc:dd:ee:ff"
+  const char *name;
+  byte        key[16];
+};
+extern VConfig config;
+extern VDeviceTable targets;
+extern void loadDevices();
+extern void uploadConfig();
+extern const char *configSource;
+extern uint32_t configUs, firstReadingMs;   // boot: config load time, first reading
+
+// counters & histograms, always on (see VictronCore/VStats.h)
+extern VStats stats;
+extern void printStats();
+
+// learned scan windows for the adaptive scan mode (see VictronCore/VSchedule.h)
+extern VScheduler sched;
+
+// live power balance of the bank: the Battery Monitor's net current against the Solar Controllers'
+// output, their readings aligned in time (see VictronCore/VBalance.h)
+extern VBalance balance;
+extern bool balanceRecord(uint32_t ms, uint8_t duds);
+extern void printBalance();
+
+// the Battery Monitors & Solar Controllers among the targets are kept as in the BatteryMonitor & SolarController
+// sketches, each set up for its kind by its first reading: dud test (see VictronCore/VOutlier.h; the settings
+// are bmOutlierCfg & scOutlierCfg in VRX.cpp, or the config blob's), reading history (VHistory.h, in
+// HISTORY_BYTES split evenly between the targets), rolling summaries (VAggregate.h) and energy (VEnergy.h)
+#define HISTORY_BYTES 65536
+extern uint8_t kinds[VDEV_MAX];
+extern VOutlierCfg bmOutlierCfg, scOutlierCfg;
+extern VOutlier outliers[VDEV_MAX];
+extern VHistory history[VDEV_MAX];
+extern VAggregator aggs[VDEV_MAX];
+extern VEnergy energy[VDEV_MAX];
+extern bool    kept();
+extern uint8_t keepReading();
+extern void tickAggregates(uint32_t ms);
+extern void printHistory();
+extern void printEnergy();
+
+// p50 / p99 / max of each pipeline stage, in CPU cycles (see VictronCore/VLatency.h)
+extern VLatency lat[VST_COUNT];
+extern void printLatency();
+
+extern BLEScan *pBLEScan; // = BLEDevice::getScan();
+
+// Scan for BLE servers for the advertising service we seek. Called for each advertising server
+class AdDataCallback : public BLEAdvertisedDeviceCallbacks {
+  void onResult(BLEAdvertisedDevice advertisedDevice);
+};
+
+// -----------------------------------------------------------------
+
+#include "wolfssl.h"
+#include "wolfssl/wolfcrypt/aes.h" // was #include <wolfssl/wolfcrypt/aes.h>
+
+extern void loadFrame(const VFrame &f, const byte plain[16]);
+extern bool decryptAesCtr(bool quiet, bool ok);
+
+const word32 blkSize = AES_BLOCK_SIZE * 1; 
+
+extern byte cipher[blkSize]; 
+extern byte output[blkSize]; 
+
+extern VRing rxRing, frameRing;
+extern VIntake intake;
+extern VTask intakeHandle;
+extern volatile bool mfrRepeat;
+extern VDevice *rxDevice;
+extern uint32_t rxMs;
+extern void callbackStats(uint32_t &calls, uint64_t &cycles, uint32_t &maxCycles);
+
+extern void  reportRecord();
+extern void  writeRecord(uint32_t ms, uint8_t duds);
+
+extern void printBIGarray();
+extern void printByteArray(byte byteArray[16]);
+extern void printBins(byte byteArray[16]);
@@ -0,0 +1,55 @@
+// Global definitions
+
+#include "ZZ.h"
+
+#include <ctype.h>                                             // provides toupper() function
+
+bool VERBOSE   = false;                                        // true = verbose,         false = quiet mode
+bool FILTERING = false;                                        // true = filtering on,  false = off 
+bool HISTORY    = false;                                       // one-shot: true = print the reading history summary
+bool ENERGY     = false;                                       // one-shot: true = print the energy integrated per target, see printEnergy()
+int  AGGREGATE  = 0;                                           // 0 = every reading, 1..3 = 1 sec / 1 min / 1 hour summaries only
+bool LATENCY    = false;                                       // one-shot: true = print the per stage latency (JSON lines)
+bool STATS      = false;                                       // one-shot: true = print the runtime counters
+bool UPLOAD     = false;                                       // one-shot: true = take a config blob over Serial, see uploadConfig()
+std::atomic<bool> CAPTURE(false);                              // true = raw advertisements streamed out in binary, see setCapture()
+bool BINARY     = false;                                       // true = one COBS framed binary record per reading, see setBinary()
+bool BALANCE    = false;                                       // true = a power balance line as each is made, see printBalance()
+std::atomic<bool> CONTINUOUS(true);                            // true = continuous scanning, false = see ADAPTIVE
+std::atomic<bool> ADAPTIVE(true);                              // not continuous: true = adaptive scan windows, false = start/stop scans
+
+const char dashes[] PROGMEM = " ------------------- ";
+const char line[]   PROGMEM = "..........................................................\n";
+const char *aggModes[] = {"off", "1 sec, 1 min & 1 hour summaries", "1 min & 1 hour summaries", "1 hour summaries"};
+
+// NB: Beware - Serial Monitor must be set with no line ending, else will be CR/LF detected here
+void processSerialCommands() {
+  if(Serial.available() > 0) {
+    char readChar = Serial.read();
+    if (readChar >= 42 && readChar <= 122) {                    // ignore if not between '*' and 'z' in ASCII table 
+      readChar = toupper(readChar);                             // convert lower case characters to upper case
+      if ((CAPTURE && readChar != 'C') || (BINARY && readChar != 'B')) return;   // binary output only while capturing / in binary mode
+      switch(readChar){
+        case 'V': if (VERBOSE)  {VERBOSE  = false; Serial << F("\nVERBOSE - off\n\n") ;}
+                  else          {VERBOSE  = true;  Serial << F("\nVERBOSE - ON\n")    ;} break;
+        case 'S': STATS = true; break;
+        
+        case 'F': if (FILTERING){FILTERING = false; Serial << F("\nFILTERING - off\n\n");}
+                  else          {FILTERING = true;  Serial << F("\nFILTERING - ON\n\n" );} break;        
+        case 'M': if (CONTINUOUS)    {ADAPTIVE = true; CONTINUOUS = false; Serial << F("\nSCAN MODE - adaptive\n\n");}
+                  else if (ADAPTIVE) {ADAPTIVE = false;                    Serial << F("\nSCAN MODE - start/stop\n\n");}
+                  else               {CONTINUOUS = true;                   Serial << F("\nSCAN MODE - continuous\n\n");} break;
+        case 'C': CAPTURE = !CAPTURE; break;                       // reported by setCapture(), in order with the binary
+        case 'B': BINARY = !BINARY; break;                         // reported by setBinary(), in order with the binary
+        case 'H': HISTORY = true; break;
+        case 'E': ENERGY = true; break;
+        case 'L': LATENCY = true; break;
+        case 'U': UPLOAD = true; break;
+        case 'A': AGGREGATE = (AGGREGATE + 1) % 4;
+                  Serial << F("\nAGGREGATE - ") << aggModes[AGGREGATE] << F("\n\n"); break;
+        case 'P': if (BALANCE) {BALANCE = false; Serial << F("\nPOWER BALANCE - off\n\n");}
+                  else         {BALANCE = true;  Serial << F("\nPOWER BALANCE - ON\n\n");} break;
+      } 
+    } 
+  } 
+}
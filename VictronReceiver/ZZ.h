@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Streaming.h> 
+#include <atomic>
+
+extern const char dashes[];
+extern const char line[];  
+extern void processSerialCommands();
+extern bool VERBOSE;
+extern bool FILTERING;
+extern bool HISTORY;
+extern bool ENERGY;
+extern int  AGGREGATE;
+extern const char *aggModes[];                                                  // AGGREGATE names
+extern bool LATENCY;
+extern bool STATS;
+extern bool UPLOAD;
+extern std::atomic<bool> CAPTURE;                                               // read by the BLE callback, on the other core
+extern bool BINARY;
+extern bool BALANCE;
+extern std::atomic<bool> CONTINUOUS;                                            // read by the intake task, on the other core
+extern std::atomic<bool> ADAPTIVE;                                              // read by the intake task, on the other core
+
+// -----------------------------------------------------------------------------------------------
+// refer forum thread "Squeezing Code into UNO ..." post #70 (Aug 2016) re: __FlashStringHelper and the F() macro for accessing PROGMEM
+#define CF(x) ((const __FlashStringHelper *)x)                                  // to stream a const char[]
@@ -0,0 +1,75 @@
+#pragma once
+
+// Small helpers shared by the host benchmarks and tools
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "VDevices.h"
+
+// monotonic clock in nano-seconds
+inline uint64_t nowNs(){
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+// one line per benchmark: count, ns/frame and frames/sec
+inline void reportRate(const char *name, uint64_t frames, uint64_t ns){
+  double nsPer = frames ? static_cast<double>(ns) / frames : 0;
+  double perSec = ns ? frames * 1e9 / ns : 0;
+  printf("%-20s %12llu frames %9.2f ns/frame %14.0f frames/s\n",
+         name, static_cast<unsigned long long>(frames), nsPer, perSec);
+}
+
+// read a whole (binary) file into buf, false if it can't be read
+inline bool readFile(const char *file, std::vector<uint8_t> &buf){
+  FILE *f = fopen(file, "rb");
+  if (!f) return false;
+  uint8_t chunk[4096];
+  size_t n;
+  buf.clear();
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buf.insert(buf.end(), chunk, chunk + n);
+  fclose(f);
+  return true;
+}
+
+// a device on the command line (-d), as in devices[] of the sketches
+struct DeviceArg {
+  uint64_t mac;
+  uint8_t  key[16];
+  char     name[32];
+};
+
+inline int hexVal(char c){
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// "aa:bb:cc:dd:ee:ff,<32 hex digits>[,name]"
+inline bool parseDevice(const char *s, DeviceArg &d){
+  char addr[18];
+  const char *comma = strchr(s, ',');
+  if (!comma || comma - s != 17) return false;
+  memcpy(addr, s, 17);
+  addr[17] = 0;
+  d.mac = macFromString(addr);
+  const char *k = comma + 1;
+  for (int i = 0; i < 16; i++) {
+    int hi = hexVal(k[2 * i]), lo = hi < 0 ? -1 : hexVal(k[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    d.key[i] = hi << 4 | lo;
+  }
+  k += 32;
+  snprintf(d.name, sizeof(d.name), "%s", *k == ',' ? k + 1 : addr);
+  return d.mac && (*k == 0 || *k == ',');
+}
+
+inline void loadTable(VDeviceTable &t, const std::vector<DeviceArg> &devs){
+  initDevices(t);
+  for (const DeviceArg &d : devs) addDevice(t, d.mac, d.key, d.name);
+}
@@ -0,0 +1,149 @@
+/* Rolling window benchmark - runs on Linux, no ESP32 needed
+
+Feeds readings at ~5 Hz (with BLE jitter, missing values and gaps of up to a few
+minutes when the device is out of range) through aggAdd(), calling aggTick() now
+and then between readings as loop() does, and checks every window emitted at every
+level (1 sec, 1 min, 1 hour) against min/max/sum/count/last recomputed from the raw
+readings grouped by window: same windows, same order, same values, none missed.
+Then reports ns per reading and how many records each level emits per reading.
+
+usage: bench_aggregate [-n readings] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t seed = 4242;
+static uint32_t rnd(uint32_t n){
+  seed = seed * 1664525u + 1013904223u;
+  return (seed >> 8) % n;
+}
+
+struct Reading {
+  uint32_t ms;
+  int32_t  v[VAGG_FIELDS];
+  uint8_t  valid;
+};
+
+struct Emitted {
+  int        level;
+  VAggWindow w;
+};
+
+// readings every 200 +-10 ms, a gap of up to 5 minutes now and then, volts / amps / SOC
+static void makeReadings(std::vector<Reading> &in, uint64_t n){
+  uint32_t ms = 1000;
+  int32_t mA = -5000;
+  in.resize(n);
+  for (uint64_t i = 0; i < n; i++) {
+    Reading &r = in[i];
+    ms += 190 + rnd(21);
+    if (rnd(5000) == 0) ms += rnd(300000);
+    if (rnd(50) == 0) mA = -20000 + static_cast<int32_t>(rnd(30000));   // load change
+    r.ms    = ms;
+    r.v[0]  = 2600 + rnd(40);
+    r.v[1]  = mA + static_cast<int32_t>(rnd(200)) - 100 + (rnd(1000) == 0 ? -150000 : 0);   // the odd spike
+    r.v[2]  = 900 + rnd(5);
+    r.v[3]  = 0;
+    r.valid = rnd(100) ? 0x7 : rnd(8);                  // now and then N/A values
+  }
+}
+
+static void add(VAggStat &s, int32_t x){
+  if (!s.count || x < s.min) s.min = x;
+  if (!s.count || x > s.max) s.max = x;
+  s.sum += x;
+  s.count++;
+  s.last = x;
+}
+
+// the windows of one level, straight from the readings
+static void reference(const std::vector<Reading> &in, int level, std::vector<VAggWindow> &out){
+  out.clear();
+  for (const Reading &r : in) {
+    uint32_t start = r.ms - r.ms % aggLenMs[level];
+    if (out.empty() || out.back().startMs != start) {
+      out.emplace_back();
+      memset(&out.back(), 0, sizeof(VAggWindow));
+      out.back().startMs = start;
+    }
+    VAggWindow &w = out.back();
+    w.count++;
+    for (int i = 0; i < 3; i++) if ((r.valid >> i) & 1) add(w.f[i], r.v[i]);
+  }
+}
+
+static bool sameWindow(const VAggWindow &a, const VAggWindow &b, int fields){
+  if (a.startMs != b.startMs || a.count != b.count) return false;
+  for (int i = 0; i < fields; i++) {
+    const VAggStat &x = a.f[i], &y = b.f[i];
+    if (x.count != y.count) return false;
+    if (x.count && (x.min != y.min || x.max != y.max || x.sum != y.sum || x.last != y.last)) return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  uint64_t n = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) n = strtoull(argv[++i], nullptr, 10);
+    else { fprintf(stderr, "usage: %s [-n readings]\n", argv[0]); return 2; }
+  }
+  std::vector<Reading> in;
+  makeReadings(in, n);
+
+  // -- check: every window at every level, against the raw readings -----------------------
+  VAggregator a;
+  initAggregator(a, bmAggFields, VAGG_BM_FIELDS);
+  std::vector<Emitted> got;
+  auto collect = [&](uint8_t closed){
+    for (int l = 0; l < VAGG_LEVELS; l++) if ((closed >> l) & 1) got.push_back({l, a.closed[l]});
+  };
+  for (size_t i = 0; i < in.size(); i++) {
+    collect(aggAdd(a, in[i].ms, in[i].v, in[i].valid));
+    if (i + 1 < in.size() && rnd(3) == 0)               // loop() ticking between readings
+      collect(aggTick(a, in[i].ms + rnd(in[i + 1].ms - in[i].ms)));
+  }
+  collect(aggTick(a, in.back().ms + 2 * aggLenMs[VAGG_LEVELS - 1]));   // close everything
+  for (int l = 0; l < VAGG_LEVELS; l++) {
+    std::vector<VAggWindow> want;
+    reference(in, l, want);
+    size_t k = 0;
+    for (const Emitted &e : got) {
+      if (e.level != l) continue;
+      if (k >= want.size() || !sameWindow(e.w, want[k], 3)) {
+        printf("**FAIL** %s window %zu (start %u ms) does not match the readings\n", aggName[l], k, e.w.startMs);
+        return 1;
+      }
+      k++;
+    }
+    if (k != want.size()) { printf("**FAIL** %s: %zu windows emitted, %zu expected\n", aggName[l], k, want.size()); return 1; }
+    printf("%s: %zu windows match  (%.5f records per reading, 1 in %.0f)\n", aggName[l], k,
+           static_cast<double>(k) / n, static_cast<double>(n) / k);
+  }
+  VLine line;
+  for (int l = 0; l < VAGG_LEVELS; l++) {
+    lineClear(line);
+    formatAgg(line, a, l);
+    printf("  %s\n", lineText(line));
+  }
+
+  // -- timing -----------------------------------------------------------------------------
+  initAggregator(a, bmAggFields, VAGG_BM_FIELDS);
+  uint32_t sum = 0;
+  uint64_t t0 = nowNs();
+  for (const Reading &r : in) sum += aggAdd(a, r.ms, r.v, r.valid);
+  uint64_t t1 = nowNs();
+  printf("\n");
+  reportRate("aggAdd", n, t1 - t0);
+  uint64_t t2 = nowNs();
+  for (const Reading &r : in) sum += aggTick(a, r.ms);
+  uint64_t t3 = nowNs();
+  reportRate("aggTick", n, t3 - t2);
+  if (sum == 1) printf(" ");
+  return 0;
+}
@@ -0,0 +1,213 @@
+/* Power balance benchmark - runs on Linux, no ESP32 needed
+
+Simulates a 24 V bank with a Battery Monitor and two Solar Controllers on it: the sun
+through passing clouds on each array (PV watts ramping), DC loads switching on and off,
+the chargers' output at a MPPT efficiency of TRUE_EFF, the battery taking the difference.
+Each device sends a reading on its own schedule, about a second apart (jittered, now and
+then one missed), in its own units; a second Battery Monitor on another bank is heard
+too, and one charger goes quiet for 30 sec. The readings go through balanceBM() /
+balanceSC() (VictronCore/VBalance.h) in the order received, and each balance made is
+checked against the true values at its time:
+  load      the inferred load current, against the same from the latest readings
+            as they are (no alignment): the aligned error must be the smaller, and
+            its median within LOAD_MAX_MA
+  MPPT      the efficiency's median within EFF_MAX_PERMILLE of TRUE_EFF
+  rate      a balance for (nearly) every reading of the slowest device
+  partial   the quiet charger left out, then taken back; the second monitor not taken
+then the bytes held and the ns per reading. Two cases on their own: a charger with PV N/A
+is left out of the efficiency, not counted as 0 W, and 1.3 kW out over 20 W of PV gives
+no efficiency (-1, printed "-"), not a figure far over 100%.
+
+usage: bench_balance [-h hours] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define STEP_MS           10        // simulation step
+#define TRUE_EFF          0.96
+#define LOAD_MAX_MA       150       // median error of the inferred load
+#define EFF_MAX_PERMILLE  10        // median error of the efficiency
+#define QUIET_AT_MS       3600000u  // charger 2 quiet for 30 sec from here
+#define QUIET_MS          30000
+#define HISTORY_STEPS     1024      // true values kept, ~10 sec, to check a balance at its time
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+static double   uniform(){ return (xorshift() + 0.5) / 4294967296.0; }
+static double   gauss(){ return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform()); }
+static uint32_t between(uint32_t lo, uint32_t hi){ return lo + xorshift() % (hi - lo + 1); }
+
+static int fails = 0;
+static void check(bool ok, const char *what){
+  if (ok) return;
+  printf("**FAIL** %s\n", what);
+  fails++;
+}
+
+static double median(std::vector<double> v){
+  if (v.empty()) return 0;
+  std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+  return v[v.size() / 2];
+}
+
+// the true state at one step
+struct Truth {
+  double pv[2], out[2], load, batt, volts;   // W, A, A, A, V
+};
+
+// an array's PV watts: the cloud cover ramps to each new level over a few seconds
+struct Array {
+  double peak, cover, target;
+  uint32_t nextCloud;
+  double step(uint32_t t){
+    if (t >= nextCloud) {target = (xorshift() % 4 == 0) ? 0.2 + 0.3 * uniform() : 0.85 + 0.15 * uniform(); nextCloud = t + between(20000, 120000);}
+    cover += (target - cover) * STEP_MS / 4000.0;
+    return peak * cover;
+  }
+};
+
+// a fresh balance: a Battery Monitor at 26.00 V, charger 1 at amps1 (100 mA) over pv1 W, charger 2
+// at 10 A with PV 0 W (pv2) or N/A; a reading each at 0 and 1000 ms
+static void edgeCase(VBalance &b, int32_t pv1, int16_t amps1, bool pv2){
+  initBalance(b);
+  for (uint32_t t = 0; t <= 1000; t += 1000) {
+    BatteryMonitorReading m = {};
+    m.battV = 2600;
+    m.valid = BM_BATTV | BM_BATTA;
+    balanceBM(b, 0, t, m);
+    for (int d = 1; d <= 2; d++) {
+      SolarChargerReading r = {};
+      r.battV = 2600;
+      r.battA = d == 1 ? amps1 : 100;                         // 100 mA
+      r.pvW   = static_cast<uint16_t>(d == 1 ? pv1 : 0);
+      r.valid = SC_BATTV | SC_BATTA | (d == 1 || pv2 ? SC_PVW : 0);
+      balanceSC(b, d, t + 10 * d, r);
+    }
+  }
+}
+
+static void edgeCases(){
+  static VBalance b;
+  edgeCase(b, 270, 100, false);                               // 10 A x 26 V over 270 W, the other 10 A with no PV
+  check(b.valid && b.pvW == 270 && b.chargeA == 20000 && abs(b.effPermille - 962) <= 1, "a charger with PV N/A left out of the efficiency");
+  printf("  PV N/A             %d W, %d permille from the charger reporting it\n", b.pvW, b.effPermille);
+  edgeCase(b, 20, 500, true);                                 // 1.3 kW over 20 W (the other: 0 W)
+  check(b.valid && b.effPermille == -1, "efficiency far over 100% not given");
+  printf("  1.3 kW over %d W   %d permille\n", b.pvW, b.effPermille);
+}
+
+struct Sender {
+  int      dev;
+  uint32_t next;
+  uint32_t readings;
+};
+
+int main(int argc, char **argv){
+  double hours = 4;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-h") && i + 1 < argc) hours = atof(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-h hours]\n", argv[0]); return 2; }
+  }
+  static const double loads[] = {1.5, 6, 12, 25, 40};
+  static Truth hist[HISTORY_STEPS];
+  static VBalance b;
+  initBalance(b);
+  Array arrays[2] = {{420, 0.9, 0.9, 0}, {300, 0.9, 0.9, 0}};
+  double load = 6, consumed = 0;
+  uint32_t nextLoad = 0, end = static_cast<uint32_t>(hours * 3600000);
+  Sender tx[4] = {{0, between(0, 1000), 0}, {1, between(0, 1000), 0}, {2, between(0, 1000), 0}, {3, between(0, 1000), 0}};
+  int32_t lastMA[3] = {0, 0, 0};                            // latest readings, unaligned
+  std::vector<double> errAligned, errNaive, errEff;
+  uint32_t balances = 0, quietBalances = 0, quietPartial = 0, other = 0, backAfter = 0;
+  uint64_t feedNs = 0, fed = 0;
+  for (uint32_t t = 0; t < end; t += STEP_MS) {
+    if (t >= nextLoad) {load = loads[xorshift() % 5]; nextLoad = t + between(10000, 90000);}
+    Truth &h = hist[(t / STEP_MS) % HISTORY_STEPS];
+    h.load = load;
+    for (int i = 0; i < 2; i++) {h.pv[i] = arrays[i].step(t); h.out[i] = 0;}
+    h.volts = 26.2 - 0.01 * consumed;
+    for (int i = 0; i < 2; i++) h.out[i] = h.pv[i] * TRUE_EFF / h.volts;
+    h.batt = h.out[0] + h.out[1] - load;
+    h.volts += 0.01 * h.batt;
+    consumed -= h.batt * STEP_MS / 3.6e6;
+    for (Sender &s : tx) {
+      if (t < s.next) continue;
+      s.next = t + between(800, 1200) + (xorshift() % 100 == 0 ? 1000 : 0);   // now and then one missed
+      bool quiet = s.dev == 2 && t >= QUIET_AT_MS && t < QUIET_AT_MS + QUIET_MS;
+      if (quiet) continue;
+      s.readings++;
+      bool made = false;
+      uint64_t t0 = nowNs();
+      if (s.dev == 0 || s.dev == 3) {
+        BatteryMonitorReading r = {};
+        r.battV = static_cast<int16_t>(lround(h.volts * 100));
+        r.battA = static_cast<int32_t>(lround(s.dev == 0 ? h.batt * 1000 + gauss() * 20 : -3000));
+        r.valid = BM_BATTV | BM_BATTA;
+        made = balanceBM(b, s.dev, t, r);
+        if (s.dev == 0) lastMA[0] = r.battA; else other++;
+      }
+      else {
+        SolarChargerReading r = {};
+        r.battV = static_cast<int16_t>(lround(h.volts * 100));
+        r.battA = static_cast<int16_t>(lround(h.out[s.dev - 1] * 10));
+        r.pvW   = static_cast<uint16_t>(lround(h.pv[s.dev - 1]));
+        r.valid = SC_BATTV | SC_BATTA | SC_PVW;
+        made = balanceSC(b, s.dev, t, r);
+        lastMA[s.dev] = r.battA * 100;
+      }
+      feedNs += nowNs() - t0;
+      fed++;
+      if (lastMA[1] && lastMA[2]) {
+        double naive = (lastMA[1] + lastMA[2] - lastMA[0]) / 1000.0;   // the latest of each, as they are
+        errNaive.push_back(fabs(naive - load));
+      }
+      if (!made) continue;
+      balances++;
+      if (t - b.ms >= HISTORY_STEPS * STEP_MS) continue;
+      const Truth &at = hist[(b.ms / STEP_MS) % HISTORY_STEPS];
+      double trueLoad = at.load - (b.used < 2 ? at.out[1] : 0);        // a charger left out: its current looks like less load
+      errAligned.push_back(fabs(b.loadA / 1000.0 - trueLoad));
+      if (b.used == 2 && at.pv[0] + at.pv[1] >= 100) errEff.push_back(fabs(b.effPermille - TRUE_EFF * 1000));
+      if (t >= QUIET_AT_MS + 15000 && t < QUIET_AT_MS + QUIET_MS) {quietBalances++; quietPartial += b.used == 1;}
+      if (t >= QUIET_AT_MS + QUIET_MS + 5000 && t < QUIET_AT_MS + QUIET_MS + 10000 && b.used == 2) backAfter++;
+    }
+  }
+  double medAligned = median(errAligned), medNaive = median(errNaive), medEff = median(errEff);
+  double meanAligned = 0, meanNaive = 0;
+  for (double e : errAligned) meanAligned += e;
+  for (double e : errNaive)   meanNaive   += e;
+  meanAligned /= errAligned.size() ? errAligned.size() : 1;
+  meanNaive   /= errNaive.size() ? errNaive.size() : 1;
+  uint32_t slowest = std::min(tx[0].readings, std::min(tx[1].readings, tx[2].readings));
+  VLine l;
+  lineClear(l);
+  formatBalance(l, b);
+  printf("%.1f hours: %u readings (%u + %u + %u, %u from another bank), %u balances, %u partial, %u unaligned\n",
+         hours, static_cast<uint32_t>(fed), tx[0].readings, tx[1].readings, tx[2].readings, tx[3].readings,
+         balances, b.partial, b.unaligned);
+  printf("  last  %.*s\n", static_cast<int>(l.len), l.buf);
+  printf("  load error, A      median %.3f mean %.3f aligned, median %.3f mean %.3f latest as they are\n",
+         medAligned, meanAligned, medNaive, meanNaive);
+  printf("  MPPT efficiency    median error %.1f permille, true %.0f\n", medEff, TRUE_EFF * 1000);
+  printf("  memory             %zu bytes, %d devices x %d readings\n", sizeof(VBalance), VBAL_CHARGERS + 1, VBAL_SAMPLES);
+  check(medAligned * 1000 <= LOAD_MAX_MA, "inferred load: median error");
+  check(meanAligned < meanNaive, "inferred load: aligned no better than the latest as they are");
+  check(medEff <= EFF_MAX_PERMILLE, "MPPT efficiency: median error");
+  check(balances >= slowest * 9 / 10, "a balance for nearly every reading of the slowest device");
+  check(quietBalances > 0 && quietPartial == quietBalances && b.partial > 0, "quiet charger left out");
+  check(backAfter > 0, "quiet charger taken back");
+  check(b.shunt.dev == 0 && b.extra <= other && b.extra + 2 >= other, "second monitor not taken");   // bar 1 or 2 heard before the first
+  check(sizeof(VBalance) <= 1024, "memory bounded");
+  edgeCases();
+  reportRate("balance", fed, feedNs);
+  if (fails) return 1;
+  printf("balance: all checks pass\n");
+  return 0;
+}
@@ -0,0 +1,179 @@
+/* Batched AES-CTR benchmark - runs on Linux, no ESP32 needed
+
+First checks the batch path against the scalar one:
+- aesEncryptBlocks() against aesEncryptBlock() block by block, for every batch
+  size up to VAES_BATCH under a random mix of keys (and the FIPS-197 example)
+- decryptFrames() against decryptFrame() frame by frame, on two copies of the same
+  device table, for random batches: any mix of devices, repeats of an IV in the
+  same batch, IVs sharing a cache slot, unknown devices, wrong key bytes, short frames
+Then times the AES alone (blocks/sec, scalar and batched, as the batch grows), and
+whole ring batches through decryptFrames() against decryptFrame() in a loop, with
+every frame a new IV so each one needs the AES.
+
+usage: bench_batch [-n blocks] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+
+static VDeviceTable scalarTable, batchTable;
+
+static void loadTables(int count){
+  initDevices(scalarTable);
+  initDevices(batchTable);
+  for (int d = 0; d < count; d++) {
+    uint8_t key[16];
+    for (int j = 0; j < 16; j++) key[j] = static_cast<uint8_t>(xorshift());
+    addDevice(scalarTable, 0xc0ffee000000ull + d, key, "dev");
+    addDevice(batchTable,  0xc0ffee000000ull + d, key, "dev");
+  }
+}
+
+static void makeFrame(VFrame &f, const VDeviceTable &t, int d, uint16_t iv){
+  f.mac  = t.dev[d].mac;
+  f.ms   = 0;
+  f.rssi = -70;
+  f.len  = VMFR_MAX;
+  const uint8_t hdr[VMFR_RECORD + 1] = {0xE1, 0x02, 0x10, 0xA3, 0x02, 0x00, 0x02};
+  memcpy(f.data, hdr, sizeof(hdr));
+  f.data[VMFR_IV]     = iv & 0xFF;
+  f.data[VMFR_IV + 1] = iv >> 8;
+  f.data[VMFR_KEY0]   = t.dev[d].key[0];
+  for (int j = VMFR_CIPHER; j < VMFR_MAX; j++) f.data[j] = static_cast<uint8_t>(xorshift());
+}
+
+static bool checkBlocks(){
+  const uint8_t key[16] = {0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f};
+  const uint8_t pt[16]  = {0x00,0x11,0x22,0x33,0x44,0x55,0x66,0x77,0x88,0x99,0xaa,0xbb,0xcc,0xdd,0xee,0xff};
+  const uint8_t ct[16]  = {0x69,0xc4,0xe0,0xd8,0x6a,0x7b,0x04,0x30,0xd8,0xcd,0xb7,0x80,0x70,0xb4,0xc5,0x5a};
+  static VAesKey fips;
+  aesSetKey(fips, key);
+  VAesKey *keys[VAES_BATCH];
+  uint8_t  in[VAES_BATCH][16], out[VAES_BATCH][16], one[16];
+  for (int i = 0; i < VAES_BATCH; i++) { keys[i] = &fips; memcpy(in[i], pt, 16); }
+  aesEncryptBlocks(keys, in, out, VAES_BATCH);
+  for (int i = 0; i < VAES_BATCH; i++) if (memcmp(out[i], ct, 16)) return false;
+  loadTables(VDEV_MAX);
+  for (int trial = 0; trial < 20000; trial++) {
+    int n = trial % (VAES_BATCH + 1);
+    for (int i = 0; i < n; i++) {
+      keys[i] = &batchTable.dev[xorshift() % VDEV_MAX].aes;
+      for (int j = 0; j < 16; j++) in[i][j] = static_cast<uint8_t>(xorshift());
+    }
+    aesEncryptBlocks(keys, in, out, n);
+    for (int i = 0; i < n; i++) {
+      aesEncryptBlock(*keys[i], in[i], one);
+      if (memcmp(one, out[i], 16)) return false;
+    }
+  }
+  return true;
+}
+
+static bool checkFrames(){
+  loadTables(8);
+  VFrame  f[VRING_SIZE];
+  uint8_t out[VRING_SIZE][16], one[16];
+  bool    ok[VRING_SIZE];
+  uint16_t iv[8] = {0};
+  for (int trial = 0; trial < 20000; trial++) {
+    int n = 1 + trial % VRING_SIZE;
+    for (int i = 0; i < n; i++) {
+      int d = xorshift() % 8;
+      uint32_t r = xorshift() % 16;
+      if      (r < 8)   iv[d]++;                        // next update
+      else if (r == 8)  iv[d] += VKS_CACHE;             // same cache slot, another IV
+      else if (r == 9)  iv[d] -= 1;                     // back one
+      makeFrame(f[i], batchTable, d, iv[d]);            // else a repeat of the IV
+      if (r == 10) f[i].data[VMFR_KEY0] ^= 0x5A;        // key byte does not match
+      if (r == 11) f[i].mac = 0xdeadbeef0000ull;        // not a target
+      if (r == 12) f[i].len = VMFR_MIN + xorshift() % (VMFR_MAX - VMFR_MIN);   // short
+      if (r == 13) f[i].len = VMFR_MIN - 1;             // too short
+    }
+    int got = decryptFrames(batchTable, f, n, out, ok), want = 0;
+    for (int i = 0; i < n; i++) {
+      VDevice *d = findDevice(scalarTable, f[i].mac);
+      bool o = d && decryptFrame(*d, f[i].data, f[i].len, one);
+      want += o;
+      if (o != ok[i] || (o && memcmp(one, out[i], 16))) return false;
+    }
+    if (got != want) return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  uint64_t blocks = 4000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) blocks = strtoull(argv[++i], nullptr, 10);
+    else { fprintf(stderr, "usage: %s [-n blocks]\n", argv[0]); return 2; }
+  }
+  if (!checkBlocks()) { printf("**FAIL** aesEncryptBlocks() differs from aesEncryptBlock()\n"); return 1; }
+  printf("aesEncryptBlocks() = aesEncryptBlock(), every batch size, mixed keys: ok\n");
+  if (!checkFrames()) { printf("**FAIL** decryptFrames() differs from decryptFrame()\n"); return 1; }
+  printf("decryptFrames() = decryptFrame(), mixed devices, repeats, bad frames: ok\n");
+
+  // -- AES alone: 32 keys, the next key for each block
+  printf("batch AES: %s\n", aesBatchImpl());
+  loadTables(VDEV_MAX);
+  VAesKey *keys[VAES_BATCH];
+  uint8_t  in[VAES_BATCH][16] = {{0}}, out[VAES_BATCH][16];
+  volatile uint8_t sink = 0;
+  uint64_t t0 = nowNs();
+  for (uint64_t b = 0; b < blocks; b++) {
+    in[0][0] = static_cast<uint8_t>(b);
+    aesEncryptBlock(batchTable.dev[b % VDEV_MAX].aes, in[0], out[0]);
+    sink ^= out[0][0];
+  }
+  double scalar = blocks * 1e9 / (nowNs() - t0);
+  printf("%-20s %14.0f blocks/s\n", "aesEncryptBlock", scalar);
+  for (int n = 1; n <= VAES_BATCH; n *= 2) {
+    for (int i = 0; i < n; i++) keys[i] = &batchTable.dev[i % VDEV_MAX].aes;
+    uint64_t passes = blocks / n;
+    t0 = nowNs();
+    for (uint64_t p = 0; p < passes; p++) {
+      in[0][0] = static_cast<uint8_t>(p);
+      aesEncryptBlocks(keys, in, out, n);
+      sink ^= out[0][0];
+    }
+    double rate = passes * n * 1e9 / (nowNs() - t0);
+    printf("aesEncryptBlocks x%-3d %14.0f blocks/s  %5.2fx\n", n, rate, rate / scalar);
+  }
+
+  // -- ring batches, every frame a new IV (cache misses), devices interleaved
+  std::vector<VFrame> frames(4096);
+  uint16_t iv[VDEV_MAX] = {0};
+  for (size_t i = 0; i < frames.size(); i++) { int d = i % VDEV_MAX; makeFrame(frames[i], batchTable, d, ++iv[d]); }
+  uint64_t rounds = blocks / frames.size() + 1;
+  uint8_t  dec[VRING_SIZE][16];
+  bool     ok[VRING_SIZE];
+  t0 = nowNs();
+  for (uint64_t r = 0; r < rounds; r++)
+    for (size_t i = 0; i < frames.size(); i++) {
+      VFrame &f = frames[i];
+      f.data[VMFR_IV + 1] = static_cast<uint8_t>(r);    // a new IV every round
+      decryptFrame(*findDevice(scalarTable, f.mac), f.data, f.len, dec[0]);
+      sink ^= dec[0][0];
+    }
+  uint64_t ns = nowNs() - t0;
+  reportRate("decryptFrame", rounds * frames.size(), ns);
+  for (int n = 1; n <= VRING_SIZE; n *= 2) {
+    t0 = nowNs();
+    for (uint64_t r = 0; r < rounds; r++)
+      for (size_t i = 0; i + n <= frames.size(); i += n) {
+        for (int j = 0; j < n; j++) frames[i + j].data[VMFR_IV + 1] = static_cast<uint8_t>(r + 128);
+        decryptFrames(batchTable, &frames[i], n, dec, ok);
+        sink ^= dec[0][0];
+      }
+    char name[32];
+    snprintf(name, sizeof(name), "decryptFrames x%d", n);
+    reportRate(name, rounds * (frames.size() / n * n), nowNs() - t0);
+  }
+  return 0;
+}
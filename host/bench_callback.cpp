@@ -0,0 +1,138 @@
+/* BLE callback benchmark - runs on Linux, no ESP32 needed
+
+Replays a crowded air: many advertisers, only a few of them target Victron
+devices, through two versions of the AdDataCallback::onResult() body:
+- "string copies": the original sketch code. BLEAddress::toString() compared
+  with the target address string, then getManufacturerData() (a std::string
+  copy of what the BLE library parsed) called 5 times plus once per byte
+- "borrowed view": the current code. The 48 bit address looked up in the
+  device table, then findVictronData() walks the raw payload in place,
+  isDuplicate() and ringPush()
+Reports ns and heap allocations per advertisement (operator new is counted).
+
+usage: bench_callback [-n adverts] [-t targets%] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+
+static uint64_t allocs = 0;
+void *operator new(size_t n){
+  allocs++;
+  if (void *p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+struct Advert {
+  uint8_t     addr[6];
+  uint8_t     payload[62];    // advertising data + scan response, as handed to the callback
+  size_t      payloadLen;
+  std::string mfr;            // what the BLE library parses out (getManufacturerData())
+};
+
+// stand-ins for the BLE library calls used by the original callback
+static std::string addressToString(const uint8_t a[6]){
+  char s[18];
+  snprintf(s, sizeof(s), "%02x:%02x:%02x:%02x:%02x:%02x", a[0], a[1], a[2], a[3], a[4], a[5]);
+  return std::string(s);
+}
+static std::string getManufacturerData(const Advert &a){ return a.mfr; }
+
+static uint8_t  BIGarray[26];
+static volatile bool mfrDataReceived;
+
+static void onResultStrings(const Advert &a, const char *target){
+  if (addressToString(a.addr) == target) {
+    unsigned int len = getManufacturerData(a).length();
+    if (len >= 11 && static_cast<uint8_t>(getManufacturerData(a)[0]) == 0xE1
+                  && static_cast<uint8_t>(getManufacturerData(a)[1]) == 0x02
+                  && static_cast<uint8_t>(getManufacturerData(a)[2]) == 0x10) {
+      for (unsigned int i = 0; i < len && i < sizeof(BIGarray); i++) BIGarray[i] = getManufacturerData(a)[i];
+      mfrDataReceived = true;
+    }
+  }
+}
+
+static VDeviceTable table;
+static VRing ring;
+
+static void onResultView(const Advert &a){
+  VDevice *dev = findDevice(table, macFromBytes(a.addr));
+  if (dev) {
+    size_t len;
+    const uint8_t *mfr = findVictronData(a.payload, a.payloadLen, len);
+    if (mfr && !isDuplicate(*dev, mfr, len) && ringPush(ring, dev->mac, -70, 0, mfr, len)) dedupAccept(*dev, mfr, len);
+  }
+}
+
+int main(int argc, char **argv){
+  uint64_t adverts = 2000000;
+  int targetPct = 5;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i + 1 < argc) adverts = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) targetPct = atoi(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-n adverts] [-t targets%%]\n", argv[0]); return 2; }
+  }
+
+  const uint8_t target[6] = {0xc0, 0xff, 0xee, 0x12, 0x34, 0x56};
+  const uint8_t key[16]   = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+  initDevices(table);
+  addDevice(table, macFromBytes(target), key, "dev");
+
+  const int nAdverts = 1024;
+  std::vector<Advert> air(nAdverts);
+  srand(1);
+  for (int f = 0; f < nAdverts; f++) {
+    Advert &a = air[f];
+    bool victron = (f * 37 % 100) < targetPct;
+    if (victron) memcpy(a.addr, target, 6);
+    else for (int i = 0; i < 6; i++) a.addr[i] = rand();
+    uint8_t *p = a.payload;
+    *p++ = 2; *p++ = 0x01; *p++ = 0x06;                 // flags
+    uint8_t mfr[25];
+    if (victron) {                                      // Battery Monitor record, new IV every 8 adverts
+      const uint8_t hdr[10] = {0xE1, 0x02, 0x10, 0x02, 0x81, 0xA3, 0x02, uint8_t(f / 8), 0x00, key[0]};
+      memcpy(mfr, hdr, 10);
+      for (int i = 10; i < 25; i++) mfr[i] = rand();
+    }
+    else {                                              // someone else's manufacturer data
+      mfr[0] = 0x4C; mfr[1] = 0x00;
+      for (int i = 2; i < 25; i++) mfr[i] = rand();
+    }
+    *p++ = 26; *p++ = 0xFF; memcpy(p, mfr, 25); p += 25;
+    a.payloadLen = p - a.payload;
+    a.mfr.assign(reinterpret_cast<const char *>(mfr), 25);
+    size_t len;
+    const uint8_t *view = findVictronData(a.payload, a.payloadLen, len);
+    if ((view != nullptr) != victron || (view && (len != 25 || memcmp(view, mfr, 25)))) {
+      printf("**FAIL** findVictronData() advert %d\n", f);
+      return 1;
+    }
+  }
+
+  printf("%d%% of adverts from a target device\n", targetPct);
+  for (int version = 0; version < 2; version++) {
+    initRing(ring);
+    VFrame out[VRING_SIZE];
+    uint64_t a0 = allocs, t0 = nowNs();
+    for (uint64_t f = 0; f < adverts; f++) {
+      const Advert &a = air[f % nAdverts];
+      if (version == 0) onResultStrings(a, "c0:ff:ee:12:34:56");
+      else              onResultView(a);
+      if ((f & 7) == 7) ringPop(ring, out, VRING_SIZE);   // the consumer keeps up
+    }
+    uint64_t t1 = nowNs(), a1 = allocs;
+    reportRate(version ? "borrowed view" : "string copies", adverts, t1 - t0);
+    printf("%-20s %.2f heap allocations/advert\n", "", static_cast<double>(a1 - a0) / adverts);
+    if (version == 1 && a1 != a0) { printf("**FAIL** the callback path allocated\n"); return 1; }
+  }
+  return 0;
+}
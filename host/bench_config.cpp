@@ -0,0 +1,214 @@
+/* Config blob benchmark - runs on Linux, no ESP32 needed
+
+First checks the blob (VictronCore/VConfig.h):
+- CRC-32 against the standard check value
+- build & parse round trips for random configs, 1 to 32 devices, any flags and dud tests
+- every bit flipped and every length cut short is rejected, leaving the VConfig as it was
+- a record of a kind not known here is skipped, a repeated address rejected
+- dud test settings that make no sense (confirm under 2, min over max, a negative
+  floor or maxRate) are rejected, as a bad CRC is; k 0 (hard limits only) is taken
+Then times boot for 32 devices: the devices[] array the sketches compile in (address
+strings parsed, keys expanded) against a blob read from a file, checked and loaded into
+the device table, and on to the first reading, a frame found, decrypted and decoded.
+On the ESP32 the same steps are printed by setup() ("* CONFIG") and "S" (first reading).
+
+usage: bench_config [-n boots] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+
+static VConfig a, b;
+
+static void randomConfig(VConfig &c, int devices){
+  initConfig(c);
+  for (int i = 0; i < devices; i++) {
+    uint8_t key[16];
+    char    name[VCFG_NAME + 8];
+    for (int j = 0; j < 16; j++) key[j] = static_cast<uint8_t>(xorshift());
+    int len = xorshift() % (VCFG_NAME + 4);
+    for (int j = 0; j < len; j++) name[j] = 'a' + xorshift() % 26;
+    name[len] = 0;
+    configAddDevice(c, (0xc0ffee000000ull + (xorshift() & 0xFFFFFF)) | 1, key, name);
+  }
+  c.hasFlags = xorshift() & 1;
+  c.flags    = xorshift() & 7;
+  c.hasBM    = xorshift() & 1;
+  c.hasSC    = xorshift() & 1;
+  for (VOutlierCfg *o : {&c.bm, &c.sc}) {
+    o->k       = xorshift() % 10;
+    o->confirm = 2 + xorshift() % 3;
+    for (int i = 0; i < o->fields; i++) {
+      VOutFieldCfg &f = o->f[i];
+      f.min     = -static_cast<int32_t>(xorshift() % 100000);
+      f.max     = xorshift() % 100000;
+      f.floor   = xorshift() % 100;
+      f.maxRate = xorshift() % 10;
+    }
+  }
+}
+
+static bool sameDud(const VOutlierCfg &x, const VOutlierCfg &y){
+  if (x.k != y.k || x.confirm != y.confirm || x.fields != y.fields) return false;
+  for (int i = 0; i < x.fields; i++)
+    if (x.f[i].min != y.f[i].min || x.f[i].max != y.f[i].max || x.f[i].floor != y.f[i].floor || x.f[i].maxRate != y.f[i].maxRate) return false;
+  return true;
+}
+
+static bool same(const VConfig &x, const VConfig &y){
+  if (x.count != y.count || x.hasFlags != y.hasFlags || x.hasBM != y.hasBM || x.hasSC != y.hasSC) return false;
+  if (x.hasFlags && x.flags != y.flags) return false;
+  if ((x.hasBM && !sameDud(x.bm, y.bm)) || (x.hasSC && !sameDud(x.sc, y.sc))) return false;
+  for (int i = 0; i < x.count; i++)
+    if (x.dev[i].mac != y.dev[i].mac || memcmp(x.dev[i].key, y.dev[i].key, 16) || strcmp(x.dev[i].name, y.dev[i].name)) return false;
+  return true;
+}
+
+// blob with one more record before the CRC, length & CRC fixed up
+static std::vector<uint8_t> withRecord(const uint8_t *blob, size_t n, const uint8_t *rec, size_t len){
+  std::vector<uint8_t> v(blob, blob + n - 4);
+  v.insert(v.end(), rec, rec + len);
+  size_t body = v.size() - VCFG_HEADER;
+  v[5] = body & 0xFF;
+  v[6] = body >> 8;
+  uint32_t crc = crc32(v.data(), v.size());
+  for (int i = 0; i < 4; i++) v.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+  return v;
+}
+
+static bool checks(){
+  const uint8_t check[] = "123456789";
+  if (crc32(check, 9) != 0xCBF43926u) { printf("**FAIL** CRC-32 check value\n"); return false; }
+  uint8_t blob[VCFG_MAX];
+  for (int trial = 0; trial < 2000; trial++) {
+    randomConfig(a, 1 + trial % VDEV_MAX);
+    size_t n = configBuild(a, blob, sizeof(blob));
+    if (!n || configLength(blob) != n || !configParse(blob, n, b) || !same(a, b)) { printf("**FAIL** round trip, %d devices\n", a.count); return false; }
+  }
+  size_t n = configBuild(a, blob, sizeof(blob));           // the last one, 32 devices
+  for (size_t i = 0; i < n; i++)
+    for (int bit = 0; bit < 8; bit++) {
+      blob[i] ^= 1 << bit;
+      bool taken = configParse(blob, n, b);
+      blob[i] ^= 1 << bit;
+      if (taken || !same(a, b)) { printf("**FAIL** bit %d of byte %zu flipped: taken\n", bit, i); return false; }
+    }
+  for (size_t len = 0; len < n; len++)
+    if (configParse(blob, len, b)) { printf("**FAIL** cut to %zu bytes: taken\n", len); return false; }
+  const uint8_t future[] = {'Z', 3, 1, 2, 3};
+  std::vector<uint8_t> v = withRecord(blob, n, future, sizeof(future));
+  if (!configParse(v.data(), v.size(), b) || !same(a, b)) { printf("**FAIL** unknown record not skipped\n"); return false; }
+  const uint8_t *dev = blob + VCFG_HEADER;                  // first record, a device
+  v = withRecord(blob, n, dev, 2 + dev[1]);
+  initConfig(b);
+  if (configParse(v.data(), v.size(), b)) { printf("**FAIL** repeated address taken\n"); return false; }
+  static const char *const cases[] = {"k 0", "confirm 1", "min over max", "negative floor", "negative maxRate"};
+  for (int i = 0; i < 5; i++) {                             // k 0 (i 0): hard limits only, taken
+    static VConfig d;
+    initConfig(d);
+    d.hasBM = true;
+    VOutlierCfg &o = i & 1 ? d.sc : d.bm;                   // each kind of record
+    d.hasSC = i & 1;
+    VOutFieldCfg &f = o.f[o.fields - 1];
+    if      (i == 0) o.k = 0;
+    else if (i == 1) o.confirm = 1;
+    else if (i == 2) f.min = f.max + 1;
+    else if (i == 3) f.floor = -1;
+    else             f.maxRate = -1;
+    n = configBuild(d, blob, sizeof(blob));
+    initConfig(b);
+    if (!n) { printf("**FAIL** dud test with %s not built\n", cases[i]); return false; }
+    if (i == 0 && (!configParse(blob, n, b) || !b.hasBM || b.bm.k != 0)) { printf("**FAIL** dud test with %s not taken\n", cases[i]); return false; }
+    if (i > 0 && (configParse(blob, n, b) || b.hasBM || b.hasSC))   { printf("**FAIL** dud test with %s taken\n", cases[i]); return false; }
+  }
+  return true;
+}
+
+// the sketches' devices[], compiled in
+struct DeviceInit {
+  char    address[18];
+  char    name[VCFG_NAME];
+  uint8_t key[16];
+};
+
+int main(int argc, char **argv){
+  int boots = 2000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) boots = atoi(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-n boots]\n", argv[0]); return 2; }
+  }
+  if (boots < 1) boots = 1;
+  if (!checks()) return 1;
+  printf("CRC, round trips, flipped bits, cut blobs, unknown & repeated records, bad dud tests: ok\n");
+
+  // -- 32 devices, as devices[] and as a blob in a file
+  static DeviceInit devices[VDEV_MAX];
+  static VConfig    site;
+  initConfig(site);
+  for (int d = 0; d < VDEV_MAX; d++) {
+    DeviceInit &di = devices[d];
+    snprintf(di.address, sizeof(di.address), "c0:ff:ee:00:%02x:%02x", d >> 8, d & 0xFF);
+    snprintf(di.name, sizeof(di.name), "My_SmartShunt_%d", d + 1);
+    for (int j = 0; j < 16; j++) di.key[j] = static_cast<uint8_t>(xorshift());
+    configAddDevice(site, macFromString(di.address), di.key, di.name);
+  }
+  site.hasFlags = site.hasBM = site.hasSC = true;
+  site.flags    = VCFG_LOAD_AMPS;
+  uint8_t blob[VCFG_MAX];
+  size_t n = configBuild(site, blob, sizeof(blob));
+  const char *file = "build/bench_config.cfg";
+  if (!configStore(file, blob, n)) { printf("**FAIL** cannot write %s\n", file); return 1; }
+  printf("%d devices: %zu byte blob (%.1f bytes/device)\n", VDEV_MAX, n, static_cast<double>(n) / VDEV_MAX);
+
+  // one frame from the last device, to decode once loaded
+  VFrame f;
+  f.mac = site.dev[VDEV_MAX - 1].mac;
+  f.len = VMFR_MAX;
+  const uint8_t hdr[VMFR_RECORD + 1] = {0xE1, 0x02, 0x10, 0xA3, 0x02, 0x00, VREC_BATTERY_MONITOR};
+  memcpy(f.data, hdr, sizeof(hdr));
+  f.data[VMFR_IV] = 1;
+  f.data[VMFR_IV + 1] = 0;
+  f.data[VMFR_KEY0] = site.dev[VDEV_MAX - 1].key[0];
+  for (int j = VMFR_CIPHER; j < VMFR_MAX; j++) f.data[j] = static_cast<uint8_t>(xorshift());
+
+  static VDeviceTable t;
+  uint64_t best[5] = {~0ull, ~0ull, ~0ull, ~0ull, ~0ull};   // devices[], read, parse, tables, first reading
+  volatile int sink = 0;
+  for (int boot = 0; boot < boots; boot++) {
+    uint64_t t0 = nowNs();
+    initDevices(t);
+    for (const DeviceInit &di : devices) addDevice(t, macFromString(di.address), di.key, di.name);
+    uint64_t t1 = nowNs();
+    for (int d = 0; d < t.count; d++) aesFreeKey(t.dev[d].aes);
+    uint8_t buf[VCFG_MAX];
+    static VConfig c;
+    uint64_t t2 = nowNs();
+    size_t got = configRead(file, buf, sizeof(buf));
+    uint64_t t3 = nowNs();
+    if (!configParse(buf, got, c)) { printf("**FAIL** blob read back is not valid\n"); return 1; }
+    uint64_t t4 = nowNs();
+    sink += configDevices(c, t);
+    uint64_t t5 = nowNs();
+    VDevice *dev = findDevice(t, f.mac);
+    uint8_t out[16];
+    VRecord r;
+    if (!dev || !decryptFrame(*dev, f.data, f.len, out) || !decodeRecord(f.data[VMFR_RECORD], out, r)) { printf("**FAIL** first frame not decoded\n"); return 1; }
+    uint64_t t6 = nowNs();
+    for (int d = 0; d < t.count; d++) aesFreeKey(t.dev[d].aes);
+    uint64_t step[5] = {t1 - t0, t3 - t2, t4 - t3, t5 - t4, t6 - t2};
+    for (int i = 0; i < 5; i++) if (step[i] < best[i]) best[i] = step[i];
+  }
+  printf("%-28s %9.1f us\n", "devices[] (compiled in)", best[0] / 1e3);
+  printf("%-28s %9.1f us\n", "blob: read file", best[1] / 1e3);
+  printf("%-28s %9.1f us\n", "blob: check & parse", best[2] / 1e3);
+  printf("%-28s %9.1f us  (key schedules expanded)\n", "blob: load device table", best[3] / 1e3);
+  printf("%-28s %9.1f us  (best of %d boots)\n", "blob to first reading", best[4] / 1e3, boots);
+  return 0;
+}
@@ -0,0 +1,171 @@
+/* Decode benchmark - runs on Linux, no ESP32 needed
+
+Pushes 16 byte plaintext (already decrypted) records through decodeBM() and
+decodeSC() and reports ns/frame and frames/sec for each.
+Then checks the codec registry (decodeRecord()) agrees with decodeBM() and
+decodeSC(), and times it for every supported record type, including the
+registry lookup.
+
+usage: bench_decode [-n frames] [-bm file] [-sc file]
+  -n  frames  number of frames to decode per decoder (default 10,000,000)
+  -bm file    captured BM plaintext records, 16 bytes each (default: synthetic)
+  -sc file    captured SC plaintext records, 16 bytes each (default: synthetic)
+
+The captured records are cycled until the frame count is reached. */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// -- synthetic records, plausible values for a 24V system -------------------------------
+static void makeBMrecord(uint8_t *r, uint32_t i){
+  uint16_t ttg  = 600 + (i % 5000);                     // mins
+  int16_t  mV10 = 2400 + (i % 400);                     // 24.00 -> 27.99 V
+  uint16_t mid  = 1200 + (i % 200);                     // 12.00 -> 13.99 V
+  int32_t  mA   = static_cast<int32_t>(i % 100000) - 50000;   // -50 -> 50 A
+  uint32_t Ah10 = i % 2000;                             // 0 -> 199.9 Ah
+  uint16_t soc  = 500 + (i % 500);                      // 50.0 -> 99.9 %
+  uint32_t mA22 = static_cast<uint32_t>(mA) & 0x3FFFFF;
+  memset(r, 0xFF, 16);
+  r[0]  = ttg & 0xFF;  r[1] = ttg >> 8;
+  r[2]  = mV10 & 0xFF; r[3] = (mV10 >> 8) & 0xFF;
+  r[4]  = 0;           r[5] = 0;
+  r[6]  = mid & 0xFF;  r[7] = mid >> 8;
+  r[8]  = 0x01 | ((mA22 & 0x3F) << 2);                  // aux = 1 (mid volts)
+  r[9]  = (mA22 >> 6) & 0xFF;
+  r[10] = (mA22 >> 14) & 0xFF;
+  r[11] = Ah10 & 0xFF; r[12] = (Ah10 >> 8) & 0xFF;
+  r[13] = ((Ah10 >> 16) & 0x0F) | ((soc & 0x0F) << 4);
+  r[14] = 0xC0 | (soc >> 4);
+}
+
+static void makeSCrecord(uint8_t *r, uint32_t i){
+  int16_t  mV10 = 2400 + (i % 400);
+  int16_t  ma100 = i % 300;                             // 0 -> 29.9 A
+  uint16_t Wh10 = i % 500;
+  uint16_t pvW  = i % 800;
+  memset(r, 0xFF, 16);
+  r[0] = 3 + (i % 3);                                   // bulk, absorb, float
+  r[1] = 0;
+  r[2] = mV10 & 0xFF;  r[3] = (mV10 >> 8) & 0xFF;
+  r[4] = ma100 & 0xFF; r[5] = (ma100 >> 8) & 0xFF;
+  r[6] = Wh10 & 0xFF;  r[7] = Wh10 >> 8;
+  r[8] = pvW & 0xFF;   r[9] = pvW >> 8;
+}
+
+typedef void (*MakeRecord)(uint8_t *r, uint32_t i);
+
+static std::vector<uint8_t> loadRecords(const char *file, MakeRecord make){
+  std::vector<uint8_t> recs;
+  if (file) {
+    if (!readFile(file, recs) || recs.size() < 16) {
+      fprintf(stderr, "** cannot read records from %s\n", file);
+      exit(1);
+    }
+    recs.resize(recs.size() / 16 * 16);                 // drop any partial record
+  }
+  else {
+    const uint32_t count = 4096;
+    recs.resize(count * 16);
+    for (uint32_t i = 0; i < count; i++) make(&recs[i * 16], i * 7919);
+  }
+  return recs;
+}
+
+// value of the field with this label, false if the record has none
+static bool fieldValue(const VRecord &r, const char *label, int32_t &value, bool &na){
+  for (int i = 0; i < r.count; i++)
+    if (!strcmp(r.field[i].label, label)) { value = r.field[i].value; na = r.field[i].na; return true; }
+  return false;
+}
+
+// both in the record's own units, so they must match exactly
+static bool same(const VRecord &r, const char *label, int32_t want, bool wantValid){
+  int32_t v = 0; bool na = false;
+  if (!fieldValue(r, label, v, na) || na == wantValid || (!na && v != want)) {
+    printf("**FAIL** registry %s: %s = %d%s, decodeBM/SC gives %d%s\n", codecFor(r.type)->name, label,
+           v, na ? " (n/a)" : "", want, wantValid ? "" : " (n/a)");
+    return false;
+  }
+  return true;
+}
+
+static bool checkRegistry(const std::vector<uint8_t> &bm, const std::vector<uint8_t> &sc){
+  for (size_t i = 0; i < bm.size(); i += 16) {
+    BatteryMonitorReading v; VRecord r;
+    decodeBM(&bm[i], v);
+    decodeRecord(VREC_BATTERY_MONITOR, &bm[i], r);
+    if (!same(r, "ttg",   v.ttgMin, v.valid & BM_TTG)   || !same(r, "battV", v.battV, v.valid & BM_BATTV) ||
+        !same(r, "battA", v.battA,  v.valid & BM_BATTA) || !same(r, "used",  v.usedAh, v.valid & BM_AH) ||
+        !same(r, "SOC",   v.soc,    v.valid & BM_SOC)) return false;
+  }
+  for (size_t i = 0; i < sc.size(); i += 16) {
+    SolarChargerReading v; VRecord r;
+    decodeSC(&sc[i], v);
+    decodeRecord(VREC_SOLAR_CHARGER, &sc[i], r);
+    if (!same(r, "battV", v.battV, v.valid & SC_BATTV) || !same(r, "battA", v.battA, v.valid & SC_BATTA) ||
+        !same(r, "yield", v.yield10Wh, v.valid & SC_KWH) || !same(r, "PV", v.pvW, v.valid & SC_PVW) ||
+        !same(r, "load",  v.loadA, v.valid & SC_LOADA)) return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  uint64_t frames = 10000000;
+  const char *bmFile = nullptr, *scFile = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n")  && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-bm") && i + 1 < argc) bmFile = argv[++i];
+    else if (!strcmp(argv[i], "-sc") && i + 1 < argc) scFile = argv[++i];
+    else { fprintf(stderr, "usage: %s [-n frames] [-bm file] [-sc file]\n", argv[0]); return 2; }
+  }
+  std::vector<uint8_t> bm = loadRecords(bmFile, makeBMrecord);
+  std::vector<uint8_t> sc = loadRecords(scFile, makeSCrecord);
+  size_t nBM = bm.size() / 16, nSC = sc.size() / 16;
+
+  double sum = 0;                                       // keeps the optimiser honest
+  uint64_t t0 = nowNs();
+  for (uint64_t f = 0; f < frames; f++) {
+    BatteryMonitorReading v;
+    decodeBM(&bm[(f % nBM) * 16], v);
+    sum += v.battV + v.battA + v.soc + v.valid;
+  }
+  uint64_t t1 = nowNs();
+  for (uint64_t f = 0; f < frames; f++) {
+    SolarChargerReading v;
+    decodeSC(&sc[(f % nSC) * 16], v);
+    sum += v.battV + v.pvW + v.valid;
+  }
+  uint64_t t2 = nowNs();
+
+  printf("records: BM %zu (%s)  SC %zu (%s)\n", nBM, bmFile ? bmFile : "synthetic",
+                                                  nSC, scFile ? scFile : "synthetic");
+  reportRate("decodeBM", frames, t1 - t0);
+  reportRate("decodeSC", frames, t2 - t1);
+  printf("checksum: %.1f\n", sum);
+
+  // -- codec registry ---------------------------------------------------------------------
+  if (!checkRegistry(bm, sc)) return 1;
+  printf("\nregistry agrees with decodeBM/decodeSC: ok\n");
+  std::vector<uint8_t> any(4096 * 16);                  // random records for the other types
+  for (size_t i = 0; i < any.size(); i++) any[i] = static_cast<uint8_t>((i * 2654435761u) >> 13);
+  for (int type = 0; type < VREC_TYPES; type++) {
+    const VCodec *c = codecFor(type);
+    if (!c) continue;
+    const std::vector<uint8_t> &recs = type == VREC_BATTERY_MONITOR ? bm : type == VREC_SOLAR_CHARGER ? sc : any;
+    size_t n = recs.size() / 16;
+    uint64_t t3 = nowNs();
+    for (uint64_t f = 0; f < frames; f++) {
+      VRecord r;
+      decodeRecord(static_cast<uint8_t>(type), &recs[(f % n) * 16], r);
+      sum += r.field[r.count - 1].value;
+    }
+    reportRate(c->name, frames, nowNs() - t3);
+  }
+  printf("checksum: %.1f\n", sum);
+  return 0;
+}
@@ -0,0 +1,138 @@
+/* Device table benchmark - runs on Linux, no ESP32 needed
+
+Times findDevice() + decryptFrame() per frame as the number of target devices
+grows from 1 to VDEV_MAX, to show the per-frame cost stays flat (every frame a
+new IV, so the keystream cache misses).
+Then replays advertising-like traffic (each IV repeated several times) with and
+without precomputeKeystreams() between frames, reporting keystream hits/misses,
+and again with isDuplicate() dropping the repeats before decryption.
+Also checks the AES-128 block against the FIPS-197 example before timing.
+
+usage: bench_devices [-n frames] [-r repeats]
+  -r repeats  times each IV is advertised before it moves on (default 5) */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// FIPS-197 appendix C.1
+static bool checkAes(){
+  const uint8_t key[16] = {0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f};
+  const uint8_t pt[16]  = {0x00,0x11,0x22,0x33,0x44,0x55,0x66,0x77,0x88,0x99,0xaa,0xbb,0xcc,0xdd,0xee,0xff};
+  const uint8_t ct[16]  = {0x69,0xc4,0xe0,0xd8,0x6a,0x7b,0x04,0x30,0xd8,0xcd,0xb7,0x80,0x70,0xb4,0xc5,0x5a};
+  VAesKey k;
+  uint8_t out[16];
+  aesSetKey(k, key);
+  aesEncryptBlock(k, pt, out);
+  return memcmp(out, ct, 16) == 0;
+}
+
+// build a BM advertisement for device d: plaintext p[] encrypted with nonce iv
+static void makeFrame(VDevice &d, uint16_t iv, const uint8_t p[16], uint8_t mfr[25]){
+  const uint8_t hdr[7] = {0xE1, 0x02, 0x10, 0x02, 0x81, 0xA3, 0x02};
+  uint8_t ks[16];
+  memcpy(mfr, hdr, 7);
+  mfr[VMFR_IV]     = iv & 0xFF;
+  mfr[VMFR_IV + 1] = iv >> 8;
+  mfr[VMFR_KEY0]   = d.key[0];
+  aesKeystream(d.aes, iv, ks);
+  for (int i = 0; i < 15; i++) mfr[VMFR_CIPHER + i] = p[i] ^ ks[i];
+}
+
+int main(int argc, char **argv){
+  uint64_t frames = 2000000;
+  int repeats = 5;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc) repeats = atoi(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-n frames] [-r repeats]\n", argv[0]); return 2; }
+  }
+  if (repeats < 1) repeats = 1;
+  if (!checkAes()) { printf("**FAIL** AES-128 does not match FIPS-197\n"); return 1; }
+  printf("AES-128 FIPS-197 check: ok\n");
+
+  static VDeviceTable table;
+  const int nFrames = 1024;
+  std::vector<uint8_t> mfr(nFrames * 25);
+  std::vector<uint64_t> macs(nFrames);
+  for (int devs = 1; devs <= VDEV_MAX; devs *= 2) {
+    initDevices(table);
+    for (int i = 0; i < devs; i++) {
+      uint8_t key[16];
+      for (int j = 0; j < 16; j++) key[j] = static_cast<uint8_t>(i * 31 + j * 7 + 1);
+      addDevice(table, 0xC0FFEE000000ull + i * 0x10101, key, "dev");
+    }
+    for (int f = 0; f < nFrames; f++) {                 // frames spread over all devices
+      VDevice &d = table.dev[f % devs];
+      uint8_t p[16];
+      for (int j = 0; j < 16; j++) p[j] = static_cast<uint8_t>(f + j);
+      makeFrame(d, static_cast<uint16_t>(f), p, &mfr[f * 25]);
+      macs[f] = d.mac;
+      uint8_t out[16];
+      if (!decryptFrame(d, &mfr[f * 25], 25, out) || memcmp(out, p, 15)) {
+        printf("**FAIL** decrypt round trip, device %d frame %d\n", f % devs, f);
+        return 1;
+      }
+    }
+    uint32_t sum = 0;
+    uint64_t t0 = nowNs();
+    for (uint64_t f = 0; f < frames; f++) {
+      uint32_t i = f % nFrames;
+      VDevice *d = findDevice(table, macs[i]);
+      uint8_t out[16];
+      if (d && decryptFrame(*d, &mfr[i * 25], 25, out)) sum += out[0];
+    }
+    uint64_t t1 = nowNs();
+    char name[32];
+    snprintf(name, sizeof(name), "%2d devices", devs);
+    reportRate(name, frames, t1 - t0);
+    if (sum == 0xFFFFFFFF) printf(" ");                 // keeps the optimiser honest
+  }
+
+  // -- keystream cache: 8 devices, each IV advertised 'repeats' times ---------------------
+  const int devs = 8;
+  printf("\nkeystream cache: %d devices, each IV repeated %d times\n", devs, repeats);
+  for (int pre = 0; pre <= 2; pre++) {                  // 0: cache only, 1: + precompute, 2: + dedup
+    initDevices(table);
+    for (int i = 0; i < devs; i++) {
+      uint8_t key[16];
+      for (int j = 0; j < 16; j++) key[j] = static_cast<uint8_t>(i * 31 + j * 7 + 1);
+      addDevice(table, 0xC0FFEE000000ull + i * 0x10101, key, "dev");
+    }
+    uint8_t p[16] = {0};
+    std::vector<uint8_t> traffic(nFrames * 25);
+    for (int f = 0; f < nFrames; f++) {
+      VDevice &d = table.dev[f % devs];
+      makeFrame(d, static_cast<uint16_t>(f / devs / repeats), p, &traffic[f * 25]);
+    }
+    uint32_t sum = 0;
+    uint64_t aesIdle = 0;
+    uint64_t t0 = nowNs();
+    for (uint64_t f = 0; f < frames; f++) {
+      uint32_t i = f % nFrames;
+      VDevice &d = table.dev[i % devs];
+      uint8_t out[16];
+      if (pre == 2) {
+        if (isDuplicate(d, &traffic[i * 25], 25)) continue;
+        dedupAccept(d, &traffic[i * 25], 25);
+      }
+      if (decryptFrame(d, &traffic[i * 25], 25, out)) sum += out[0];
+      if (pre) aesIdle += precomputeKeystreams(table, 1);   // stands in for idle time between frames
+    }
+    uint64_t t1 = nowNs();
+    uint32_t hits, misses, accepted, suppressed;
+    keystreamStats(table, hits, misses);
+    dedupStats(table, accepted, suppressed);
+    const char *names[] = {"cache only", "+precompute", "+dedup"};
+    reportRate(names[pre], frames, t1 - t0);           // +precompute includes the idle AES time
+    printf("%-20s hits %u  misses %u  (%.2f%% hit)  idle AES blocks %llu\n", "", hits, misses,
+           100.0 * hits / (hits + misses), static_cast<unsigned long long>(aesIdle));
+    if (pre == 2) printf("%-20s accepted %u  suppressed %u\n", "", accepted, suppressed);
+    if (sum == 0xFFFFFFFF) printf(" ");
+  }
+  return 0;
+}
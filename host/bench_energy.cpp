@@ -0,0 +1,287 @@
+/* Energy integration benchmark - runs on Linux, no ESP32 needed
+
+Simulates a day of a Battery Monitor on a 24 V battery (loads and a charger switching,
+the current crossing zero, a ripple on it) and of a Solar Controller (the sun, clouds,
+a constant load, the yield back to 0 at midnight), the true volts and amps integrated
+every 10 ms. Readings are taken as the receiver sees them: one about a second (700 to
+1300 ms apart), now and then a few missed, in the devices' own units, with noise on the
+amps; the Battery Monitor also has a 150 sec gap and is synchronised to 0 Ah. Each
+reading goes through energyBM() / energySC() (VictronCore/VEnergy.h), and checks:
+  truth     energy & charge in / out and the PV energy within MAX_ERR_PCT of the true
+            integral, over the time the receiver integrated (the gap left out)
+  exact     within 1 ppm of a double precision trapezoid of the same readings
+  drift     the drift from the device's own count (consumed Ah, yield) within
+            MAX_ERR_PCT of the throughput (+ a unit of the count), the sync and
+            midnight each taken as a new baseline, the gap not counted as one
+  corners   the zero crossing split, millis() wrapping, repeated times, N/A values,
+            a gap, the rates' time constant at 1 and 5 sec readings
+then the ns per reading of energyBM().
+
+usage: bench_energy [-h hours] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define STEP_MS       10            // the true integral's step
+#define MAX_ERR_PCT   0.5
+#define GAP_AT_H      12            // Battery Monitor: 150 sec with no readings
+#define GAP_MS        150000
+#define SYNC_AT_H     20            // Battery Monitor: synchronised, consumed Ah back to 0
+#define START_HOUR    4             // Solar Controller: time of day the simulation starts
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+static double   uniform(){ return (xorshift() + 0.5) / 4294967296.0; }
+static double   gauss(){ return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform()); }
+static uint32_t between(uint32_t lo, uint32_t hi){ return lo + xorshift() % (hi - lo + 1); }
+
+static int fails = 0;
+static void check(bool ok, const char *what){
+  if (ok) return;
+  printf("**FAIL** %s\n", what);
+  fails++;
+}
+
+static bool near(double got, double want, double pct, double abs = 0){
+  return fabs(got - want) <= fabs(want) * pct / 100 + abs;
+}
+
+// energy split by sign, as VEnergy keeps it
+struct Split {
+  double in, out;
+  void add(double v, double dt){ if (v >= 0) in += v * dt; else out -= v * dt; }
+};
+
+// the readings integrated in double: trapezoids, split where the line crosses zero
+struct Reference {
+  Split  e, q;
+  bool   held;
+  double t, p, a;
+  static void trap(Split &s, double a, double b, double dt){
+    if ((a >= 0) == (b >= 0)) {s.add((a + b) / 2, dt); return;}
+    double t0 = dt * a / (a - b);
+    s.add(a / 2, t0);
+    s.add(b / 2, dt - t0);
+  }
+  void add(double ms, double v, double amps){
+    double p = v * amps;
+    if (held && ms - t <= VENERGY_GAP_MS) {trap(e, this->p, p, (ms - t) / 3.6e6); trap(q, a, amps, (ms - t) / 3.6e6);}
+    held = true;
+    t = ms; this->p = p; a = amps;
+  }
+};
+
+// -- Battery Monitor -----------------------------------------------------------------------
+
+struct BmRun {
+  Split    trueE, trueQ;              // over the intervals the receiver integrated
+  Reference ref;
+  double   throughputAh;              // since the baseline
+  std::vector<BatteryMonitorReading> readings;
+  std::vector<uint32_t> ms;
+};
+
+static void simulateBM(double hours, VEnergy &e, BmRun &run){
+  static const double discharge[] = {-1.5, -4, -12, -30, -60};
+  static const double charge[]    = {10, 20, 30, 45};
+  double level = -4, consumed = 60;   // A, Ah
+  uint32_t end = static_cast<uint32_t>(hours * 3600000), nextLevel = 0, nextFrame = 1000;
+  uint32_t lastFrame = 0;
+  bool     first = true;
+  Split span = {0, 0}, spanQ = {0, 0};
+  bool synced = false;
+  initEnergy(e);
+  for (uint32_t t = 0; t < end; t += STEP_MS) {
+    if (t >= nextLevel) {
+      if      (consumed > 150) level = charge[xorshift() % 4];
+      else if (consumed < 40)  level = discharge[xorshift() % 5];
+      else level = xorshift() & 1 ? charge[xorshift() % 4] : discharge[xorshift() % 5];
+      nextLevel = t + between(120000, 600000);
+    }
+    double tm   = t + STEP_MS / 2.0;
+    double amps = level + 0.3 * sin(2 * M_PI * tm / 37000);
+    double volts = 25.8 - 0.004 * consumed + 0.01 * amps;
+    span.add(volts * amps, STEP_MS / 3.6e6);
+    spanQ.add(amps, STEP_MS / 3.6e6);
+    consumed -= amps * STEP_MS / 3.6e6;
+    if (!synced && t >= SYNC_AT_H * 3600000u) {consumed = 0; synced = true;}
+    if (t + STEP_MS < nextFrame) continue;
+    // a reading, at the end of this step
+    uint32_t ms = t + STEP_MS;
+    double now = ms;
+    double a = level + 0.3 * sin(2 * M_PI * now / 37000);
+    BatteryMonitorReading r = {};
+    r.battV  = static_cast<int16_t>(lround((25.8 - 0.004 * consumed + 0.01 * a) * 100));
+    r.battA  = static_cast<int32_t>(lround(a * 1000 + gauss() * 20));
+    r.usedAh = static_cast<uint32_t>(lround(fmax(consumed, 0) * 10));
+    r.aux    = 3;
+    r.valid  = BM_BATTV | BM_BATTA | BM_AH;
+    if (!first && ms - lastFrame <= VENERGY_GAP_MS) {
+      run.trueE.in += span.in; run.trueE.out += span.out;
+      run.trueQ.in += spanQ.in; run.trueQ.out += spanQ.out;
+    }
+    span = spanQ = {0, 0};
+    uint32_t rebased = e.check.rebased;
+    energyBM(e, ms, r);
+    if (e.check.rebased != rebased || e.check.acc == e.check.acc0) run.throughputAh = 0;
+    else run.throughputAh += fabs(a) * (ms - lastFrame) / 3.6e6;
+    lastFrame = ms;
+    first = false;
+    run.ref.add(ms, r.battV / 100.0, r.battA / 1000.0);
+    run.readings.push_back(r);
+    run.ms.push_back(ms);
+    nextFrame = ms + between(700, 1300);
+    if (xorshift() % 100 == 0) nextFrame += between(1, 4) * 1000;       // missed
+    if (ms < GAP_AT_H * 3600000u && nextFrame >= GAP_AT_H * 3600000u) nextFrame += GAP_MS;
+  }
+}
+
+// -- Solar Controller ----------------------------------------------------------------------
+
+struct ScRun {
+  Split  trueE, trueQ;
+  double truePV;                      // Wh
+  Reference ref;
+};
+
+static void simulateSC(double hours, VEnergy &e, ScRun &run){
+  static const double clouds[] = {1, 0.9, 0.5, 0.2};
+  double cloud = 1, yield = 0, load = 2;   // yield today, Wh
+  uint32_t end = static_cast<uint32_t>(hours * 3600000), nextCloud = 0, nextFrame = 1000;
+  uint32_t day0 = START_HOUR * 3600000u;
+  initEnergy(e);
+  auto pvAt = [&](double ms){
+    double h = fmod((day0 + ms) / 3600000.0, 24);
+    return 400 * fmax(0, sin(M_PI * (h - 6) / 12)) * cloud;
+  };
+  for (uint32_t t = 0; t < end; t += STEP_MS) {
+    if (t >= nextCloud) {cloud = clouds[xorshift() % 4]; nextCloud = t + between(60000, 300000);}
+    double pv = pvAt(t + STEP_MS / 2.0), volts = 27.0, amps = pv * 0.96 / volts - load;
+    run.trueE.add(volts * amps, STEP_MS / 3.6e6);
+    run.trueQ.add(amps, STEP_MS / 3.6e6);
+    run.truePV += pv * STEP_MS / 3.6e6;
+    if ((day0 + t) / 86400000 != (day0 + t + STEP_MS) / 86400000) yield = 0;    // midnight
+    yield += pv * STEP_MS / 3.6e6;
+    if (t + STEP_MS < nextFrame) continue;
+    uint32_t ms = t + STEP_MS;
+    double p = pvAt(ms), a = p * 0.96 / volts - load;
+    SolarChargerReading r = {};
+    r.battV     = 2700;
+    r.battA     = static_cast<int16_t>(lround(a * 10 + gauss() * 0.2));
+    r.pvW       = static_cast<uint16_t>(lround(p));
+    r.yield10Wh = static_cast<uint16_t>(yield / 10);
+    r.valid     = SC_BATTV | SC_BATTA | SC_PVW | SC_KWH;
+    energySC(e, ms, r);
+    run.ref.add(ms, r.battV / 100.0, r.battA / 10.0);
+    nextFrame = ms + between(700, 1300);
+    if (xorshift() % 100 == 0) nextFrame += between(1, 4) * 1000;
+  }
+}
+
+// -- corner cases --------------------------------------------------------------------------
+
+static void corners(){
+  VEnergy e;
+  // +10 A to -10 A over a second at 25 V: half in, half out, nothing cancelled
+  initEnergy(e);
+  energyAdd(e, 1000, 2500, 10000, true);
+  energyAdd(e, 2000, 2500, -10000, true);
+  check(e.inQ == 2500000 && e.outQ == 2500000 && e.inE == 6250000000ll && e.outE == 6250000000ll, "zero crossing split");
+  // the same across millis() wrapping
+  initEnergy(e);
+  energyAdd(e, 0xFFFFFE0Cu, 2500, 10000, true);
+  energyAdd(e, 500, 2500, -10000, true);
+  check(e.inQ == 2500000 && e.outQ == 2500000 && e.spanMs == 1000, "millis() wrapping");
+  // the same time again: held, not integrated
+  energyAdd(e, 500, 2500, -20000, true);
+  check(e.spanMs == 1000 && e.outQ == 2500000 && e.mA == -20000 && e.readings == 3, "a repeated time");
+  // N/A: not integrated across
+  energyAdd(e, 1500, 0, 0, false);
+  energyAdd(e, 2500, 2500, -20000, true);
+  check(e.gaps == 1 && e.spanMs == 1000, "N/A values");
+  // a gap
+  energyAdd(e, 2500 + VENERGY_GAP_MS + 1, 2500, -20000, true);
+  check(e.gaps == 2 && e.spanMs == 1000, "a gap");
+  // rates: a step from 0 to -12 A, 63% of the way after the time constant, whatever the spacing
+  for (uint32_t every : {1000u, 5000u}) {
+    initEnergy(e);
+    energyAdd(e, 0, 2500, 0, true);
+    for (uint32_t ms = every; ms <= VENERGY_TAU_MS; ms += every) energyAdd(e, ms, 2500, -12000, true);
+    check(near(e.rateA, -12000 * (1 - exp(-1)), 3), "rate time constant");
+    check(near(e.rateP / 1e5, -300 * (1 - exp(-1)), 3), "power rate time constant");
+  }
+  // a Battery Monitor's sync: a new baseline, counted
+  initEnergy(e);
+  BatteryMonitorReading r = {};
+  r.battV = 2500; r.battA = -10000; r.usedAh = 500; r.valid = BM_BATTV | BM_BATTA | BM_AH;
+  energyBM(e, 0, r);
+  r.usedAh = 0;
+  energyBM(e, 1000, r);
+  check(e.check.set && e.check.rebased == 1 && energyDrift(e) == 0, "sync to 0 Ah");
+}
+
+int main(int argc, char **argv){
+  double hours = 24;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-h") && i + 1 < argc) hours = atof(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-h hours]\n", argv[0]); return 2; }
+  }
+  corners();
+
+  static VEnergy bm, sc;
+  BmRun b = {};
+  ScRun s = {};
+  simulateBM(hours, bm, b);
+  simulateSC(hours, sc, s);
+  VLine l;
+  printf("%.1f hours, a reading about every second\n", hours);
+  lineClear(l); formatEnergy(l, bm); printf("  BM  %.*s\n", static_cast<int>(l.len), l.buf);
+  lineClear(l); formatEnergy(l, sc); printf("  SC  %.*s\n", static_cast<int>(l.len), l.buf);
+
+  struct { const char *what; double got, truth, exact; } rows[] = {
+    {"BM Wh in",  bm.inE  / 3.6e11, b.trueE.in,  b.ref.e.in},
+    {"BM Wh out", bm.outE / 3.6e11, b.trueE.out, b.ref.e.out},
+    {"BM Ah in",  bm.inQ  / 3.6e9,  b.trueQ.in,  b.ref.q.in},
+    {"BM Ah out", bm.outQ / 3.6e9,  b.trueQ.out, b.ref.q.out},
+    {"SC Wh in",  sc.inE  / 3.6e11, s.trueE.in,  s.ref.e.in},
+    {"SC Wh out", sc.outE / 3.6e11, s.trueE.out, s.ref.e.out},
+    {"SC Ah in",  sc.inQ  / 3.6e9,  s.trueQ.in,  s.ref.q.in},
+    {"SC Ah out", sc.outQ / 3.6e9,  s.trueQ.out, s.ref.q.out},
+    {"SC PV Wh",  sc.pvE  / 3.6e6,  s.truePV,    s.truePV},
+  };
+  printf("  %-10s %12s %12s %8s %12s\n", "", "integrated", "true", "err %", "double");
+  for (auto &r : rows) {
+    double err = r.truth ? (r.got - r.truth) / r.truth * 100 : 0;
+    printf("  %-10s %12.3f %12.3f %8.3f %12.3f\n", r.what, r.got, r.truth, err, r.exact);
+    char what[64];
+    snprintf(what, sizeof(what), "%s: %.3f, true %.3f", r.what, r.got, r.truth);
+    check(near(r.got, r.truth, MAX_ERR_PCT, 0.01), what);
+    if (r.exact != r.truth) check(near(r.got, r.exact, 1e-4, 1e-6), "integer vs double integration");
+  }
+  check(bm.gaps == 1, "BM: the gap counted once");
+  check(bm.check.rebased == 1, "BM: the sync a new baseline");
+  check(fabs(energyDrift(bm)) <= b.throughputAh * 1000 * MAX_ERR_PCT / 100 + 100, "BM: drift from consumed Ah");
+  check(sc.gaps == 0 && sc.check.rebased == 1, "SC: midnight a new baseline");
+  check(fabs(energyDrift(sc)) <= sc.pvE / 3.6e6 * MAX_ERR_PCT / 100 + 10, "SC: drift from the yield");
+  printf("  drift     BM %d mAh over %.1f Ah since the baseline, SC %d Wh\n", energyDrift(bm), b.throughputAh, energyDrift(sc));
+
+  // -- timing: the day's readings, again and again
+  const int reps = 20;
+  uint64_t t0 = nowNs(), sink = 0;
+  for (int k = 0; k < reps; k++) {
+    initEnergy(bm);
+    for (size_t i = 0; i < b.readings.size(); i++) energyBM(bm, b.ms[i], b.readings[i]);
+    sink += bm.inE;
+  }
+  reportRate("energyBM", b.readings.size() * reps, nowNs() - t0);
+  if (!sink) printf("\n");
+  if (fails) return 1;
+  printf("energy: all checks pass\n");
+  return 0;
+}
@@ -0,0 +1,330 @@
+/* Metrics exporter benchmark - runs on Linux, no ESP32 needed
+
+First checks the metrics store and exposition (VictronCore/VMetrics.h):
+- recordFromBM() / recordFromSC() give the same fields as the codecs, on random records
+- a fleet of 16 receivers x 32 devices (512), random readings of every kind, names with
+  quotes, backslashes and new lines, streamed in: every line rendered is a HELP, TYPE
+  or sample line of the text format, each family once and its samples together, every
+  value and reading count as last sent
+- a device heard by two receivers is one device, readings from an index not yet named
+  are counted not kept, a full table and a corrupt record are counted
+- nothing is allocated and the heap does not grow, ingesting or rendering
+Then times ingest per reading and a render of all 512 devices, and fails if a render
+takes 10 ms or more (100 scrapes/sec). Writes the fleet's streams to build/fleet_NN.wire
+for host/exporter -t, which scrapes them over TCP.
+
+usage: bench_exporter [-n readings] [-r renders] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <malloc.h>
+#include <map>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static uint64_t allocs = 0;
+void *operator new(size_t n){
+  allocs++;
+  if (void *p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+
+static VMetrics m;
+static char     out[VMET_RENDER_MAX];
+
+#define STREAMS  VMET_SOURCES
+#define PER      VMET_INDEXES
+
+static bool sameRecord(const VRecord &x, const VRecord &y){
+  if (x.type != y.type || x.count != y.count) return false;
+  for (int i = 0; i < x.count; i++) {
+    const VField &a = x.field[i], &b = y.field[i];
+    if (strcmp(a.label, b.label) || strcmp(a.unit, b.unit) || a.scale != b.scale || a.decimals != b.decimals ||
+        a.kind != b.kind || a.na != b.na) return false;
+    if (!a.na && (a.kind == VF_NUM ? a.value != b.value : a.raw != b.raw)) return false;
+  }
+  return true;
+}
+
+static bool checkCodecs(){
+  uint8_t rec[16];
+  for (int n = 0; n < 200000; n++) {
+    for (uint8_t &b : rec) b = static_cast<uint8_t>(xorshift());
+    VRecord x, y;
+    if (n & 1) { SolarChargerReading   s; decodeSC(rec, s); recordFromSC(s, x); decodeRecord(VREC_SOLAR_CHARGER, rec, y); }
+    else       { BatteryMonitorReading b; decodeBM(rec, b); recordFromBM(b, x); decodeRecord(VREC_BATTERY_MONITOR, rec, y); }
+    if (!sameRecord(x, y)) { printf("**FAIL** %s record %d: fields not as the codec's\n", n & 1 ? "SC" : "BM", n); return false; }
+  }
+  return true;
+}
+
+// -- the fleet ------------------------------------------------------------------------------
+
+static uint64_t fleetMac(int s, int i){ return 0xc0ffee000000ull | s << 8 | i; }
+
+static void fleetName(int s, int i, char name[VWIRE_NAME]){
+  if      (i == 0) snprintf(name, VWIRE_NAME, "say \"hi\" %d", s);        // to be escaped
+  else if (i == 1) snprintf(name, VWIRE_NAME, "back\\slash\nline %d", s);
+  else             snprintf(name, VWIRE_NAME, "Site%02d_device_%02d", s, i);
+}
+
+struct Last {                     // the last reading sent to each device, as its fields
+  VRecord  rec;
+  uint32_t readings;
+  uint32_t duds;
+};
+static Last last[STREAMS][PER];
+
+static void put(std::vector<uint8_t> &v, const uint8_t *p, size_t n){ v.insert(v.end(), p, p + n); }
+
+// stream s: device records, then readings round its devices, Battery Monitors, Solar
+// Controllers & other records, device records again every 10 secs as the sketches send them
+static void buildStream(int s, int readings, std::vector<uint8_t> &v){
+  uint8_t f[VWIRE_FRAME_MAX], rec[16];
+  char    name[VWIRE_NAME];
+  uint32_t ms = 1000, announced = 0;
+  v.clear();
+  for (int n = 0; n < readings; n++) {
+    if (n == 0 || ms - announced >= VWIRE_ANNOUNCE_MS) {
+      for (int i = 0; i < PER; i++) { fleetName(s, i, name); put(v, f, wireDevice(f, i, ms, fleetMac(s, i), name)); }
+      announced = ms;
+    }
+    int i = n % PER;
+    for (uint8_t &b : rec) b = static_cast<uint8_t>(xorshift());
+    uint8_t duds = xorshift() % 50 ? 0 : 1 << (xorshift() % 5);
+    Last &l = last[s][i];
+    if (i % 3 == 0)      { BatteryMonitorReading b; decodeBM(rec, b); recordFromBM(b, l.rec); put(v, f, wireBM(f, i, ms, duds, b)); }
+    else if (i % 3 == 1) { SolarChargerReading   c; decodeSC(rec, c); recordFromSC(c, l.rec); put(v, f, wireSC(f, i, ms, duds, c)); }
+    else                 { decodeRecord(VREC_DCDC_CONVERTER, rec, l.rec); put(v, f, wireRecord(f, i, ms, VREC_DCDC_CONVERTER, rec)); duds = 0; }
+    l.readings++;
+    if (duds) l.duds++;
+    ms += 1 + xorshift() % 20;
+  }
+}
+
+// -- the exposition, parsed back ------------------------------------------------------------
+
+struct Sample {
+  std::string name, value;
+  std::map<std::string, std::string> labels;
+};
+
+// name{k="v",...} value - false if not in the text format
+static bool parseSample(const char *p, const char *end, Sample &s){
+  const char *q = p;
+  while (q < end && ((*q >= 'a' && *q <= 'z') || *q == '_')) q++;
+  if (q == p) return false;
+  s.name.assign(p, q);
+  s.labels.clear();
+  if (q < end && *q == '{') {
+    q++;
+    while (q < end && *q != '}') {
+      const char *k = q;
+      while (q < end && *q != '=') q++;
+      if (q + 1 >= end || q[1] != '"') return false;
+      std::string key(k, q), val;
+      for (q += 2; q < end && *q != '"'; q++) {
+        if (*q == '\\') {
+          if (++q >= end) return false;
+          if      (*q == 'n')                val += '\n';
+          else if (*q == '\\' || *q == '"')  val += *q;
+          else return false;
+        }
+        else if (*q == '\n') return false;
+        else val += *q;
+      }
+      if (q >= end) return false;
+      s.labels[key] = val;
+      q++;
+      if (q < end && *q == ',') q++;
+    }
+    if (q >= end) return false;
+    q++;
+  }
+  if (q >= end || *q != ' ') return false;
+  s.value.assign(q + 1, end);
+  char *e;
+  strtod(s.value.c_str(), &e);
+  return !s.value.empty() && *e == 0;
+}
+
+static bool checkExposition(const char *buf, size_t len){
+  std::map<std::string, int> families;                      // name -> samples
+  std::string current;
+  std::map<std::string, std::string> values;               // mac/field -> value
+  std::map<std::string, uint32_t>    counts, duds;         // mac -> readings, dud readings
+  const char *p = buf, *end = buf + len;
+  int lines = 0;
+  while (p < end) {
+    const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (!nl) { printf("**FAIL** last line not ended\n"); return false; }
+    lines++;
+    if (!strncmp(p, "# HELP ", 7)) {
+      const char *sp = static_cast<const char *>(memchr(p + 7, ' ', nl - p - 7));
+      current.assign(p + 7, sp ? sp : nl);
+      if (families.count(current)) { printf("**FAIL** family %s twice\n", current.c_str()); return false; }
+      families[current] = 0;
+    }
+    else if (!strncmp(p, "# TYPE ", 7)) {
+      std::string t(p + 7, nl);
+      if (t != current + " gauge" && t != current + " counter") { printf("**FAIL** line %d: %s\n", lines, t.c_str()); return false; }
+    }
+    else {
+      Sample s;
+      if (!parseSample(p, nl, s)) { printf("**FAIL** line %d not a sample: %.*s\n", lines, static_cast<int>(nl - p), p); return false; }
+      if (s.name != current) { printf("**FAIL** line %d: %s outside its family\n", lines, s.name.c_str()); return false; }
+      families[current]++;
+      const std::string &mac = s.labels["mac"];
+      if (s.name == "victron_value" || s.name == "victron_code") values[mac + "/" + s.labels["field"]] = s.value;
+      if (s.name == "victron_readings_total")     counts[mac] = strtoul(s.value.c_str(), nullptr, 10);
+      if (s.name == "victron_dud_readings_total") duds[mac]   = strtoul(s.value.c_str(), nullptr, 10);
+      if (s.labels.count("device")) {
+        char want[VWIRE_NAME];
+        uint64_t mc = macFromString(mac.c_str());
+        fleetName((mc >> 8) & 0xFF, mc & 0xFF, want);
+        if (s.labels["device"] != want) { printf("**FAIL** line %d: device %s, not %s\n", lines, s.labels["device"].c_str(), want); return false; }
+      }
+    }
+    p = nl + 1;
+  }
+  // every field of every device, as last sent
+  size_t fields = 0;
+  VLine l;
+  for (int s = 0; s < STREAMS; s++)
+    for (int i = 0; i < PER; i++) {
+      const Last &d = last[s][i];
+      char mac[18];
+      uint64_t mc = fleetMac(s, i);
+      snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x", static_cast<int>(mc >> 40 & 0xFF), static_cast<int>(mc >> 32 & 0xFF),
+               static_cast<int>(mc >> 24 & 0xFF), static_cast<int>(mc >> 16 & 0xFF), static_cast<int>(mc >> 8 & 0xFF), static_cast<int>(mc & 0xFF));
+      if (counts[mac] != d.readings || duds[mac] != d.duds) { printf("**FAIL** %s: %u readings, %u duds, sent %u, %u\n", mac, counts[mac], duds[mac], d.readings, d.duds); return false; }
+      for (int j = 0; j < d.rec.count; j++) {
+        const VField &f = d.rec.field[j];
+        auto it = values.find(std::string(mac) + "/" + f.label);
+        if (f.na) { if (it != values.end()) { printf("**FAIL** %s %s: N/A, rendered\n", mac, f.label); return false; } continue; }
+        lineClear(l);
+        if (f.kind == VF_NUM) lineFixed(l, f.value, f.scale, f.decimals);
+        else                  lineUInt(l, f.raw);
+        if (it == values.end() || it->second != lineText(l)) {
+          printf("**FAIL** %s %s: %s, sent %s\n", mac, f.label, it == values.end() ? "missing" : it->second.c_str(), lineText(l));
+          return false;
+        }
+        fields++;
+      }
+    }
+  if (fields != values.size()) { printf("**FAIL** %zu values rendered, %zu sent\n", values.size(), fields); return false; }
+  printf("%d lines, %zu families, %zu values: all as sent\n", lines, families.size(), fields);
+  return true;
+}
+
+// -- the corner cases -----------------------------------------------------------------------
+
+static bool checkCorners(){
+  uint8_t f[VWIRE_FRAME_MAX], rec[16] = {};
+  BatteryMonitorReading b;
+  decodeBM(rec, b);
+  initMetrics(m);
+  int a = metricsAddSource(m, "a"), c = metricsAddSource(m, "c");
+  auto feed = [&](int src, size_t n){ for (size_t i = 0; i < n; i++) metricsPut(m, src, f[i], 1000); };
+  feed(a, wireBM(f, 3, 0, 0, b));                           // index 3 not named yet
+  if (m.count || m.src[a].unnamed != 1) { printf("**FAIL** reading from an unnamed index kept\n"); return false; }
+  feed(a, wireDevice(f, 3, 0, 0x112233445566ull, "shared"));
+  feed(c, wireDevice(f, 7, 0, 0x112233445566ull, "shared"));
+  feed(a, wireBM(f, 3, 1, 0, b));
+  feed(c, wireBM(f, 7, 2, 1, b));
+  if (m.count != 1 || m.dev[0].readings != 2 || m.dev[0].dudReadings != 1) { printf("**FAIL** one device heard twice is not one device\n"); return false; }
+  size_t n = wireBM(f, 3, 3, 0, b);
+  f[n / 2] ^= 0x10;
+  feed(a, n);
+  if (m.src[a].wire.bad != 1 || m.dev[0].readings != 2) { printf("**FAIL** corrupt record not counted bad\n"); return false; }
+  feed(a, wireRecord(f, 3, 4, 0x07, rec));                  // a type with no codec
+  if (m.unsupported != 1 || m.dev[0].readings != 2 || m.dev[0].rec.type != VREC_BATTERY_MONITOR) { printf("**FAIL** unsupported record not counted\n"); return false; }
+  initMetrics(m);
+  for (int s = 0; s < STREAMS; s++) metricsAddSource(m, "s");
+  for (int d = 0; d <= VMET_DEVICES; d++) {
+    size_t k = wireDevice(f, d % PER, 0, 0xAA0000000000ull + d, "x");
+    for (size_t i = 0; i < k; i++) metricsPut(m, (d / PER) % STREAMS, f[i], 0);
+  }
+  if (m.count != VMET_DEVICES || m.full != 1 || m.src[0].dev[0] != -1) { printf("**FAIL** full table not counted\n"); return false; }
+  return true;
+}
+
+int main(int argc, char **argv){
+  int readings = 200000, renders = 2000;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i + 1 < argc) readings = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc) renders  = atoi(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-n readings] [-r renders]\n", argv[0]); return 2; }
+  }
+  if (readings < STREAMS * PER) readings = STREAMS * PER;
+  if (renders < 1) renders = 1;
+  if (!checkCodecs()) return 1;
+  printf("recordFromBM() / recordFromSC() as the codecs: ok\n");
+  if (!checkCorners()) return 1;
+  printf("shared devices, unnamed indexes, corrupt & unsupported records, full table: ok\n");
+
+  // -- the fleet, streamed in
+  static std::vector<uint8_t> streams[STREAMS];
+  static const char *names[STREAMS];
+  static char        files[STREAMS][32];
+  for (int s = 0; s < STREAMS; s++) {
+    buildStream(s, readings / STREAMS, streams[s]);
+    snprintf(files[s], sizeof(files[s]), "build/fleet_%02d.wire", s);
+    names[s] = files[s];
+    FILE *fp = fopen(files[s], "wb");
+    if (!fp) { printf("**FAIL** cannot write %s\n", files[s]); return 1; }
+    fwrite(streams[s].data(), 1, streams[s].size(), fp);
+    fclose(fp);
+  }
+  initMetrics(m);
+  for (int s = 0; s < STREAMS; s++) metricsAddSource(m, names[s]);
+  struct mallinfo2 m0 = mallinfo2();
+  uint64_t a0 = allocs, bytes = 0, t0 = nowNs();
+  for (size_t i = 0;; i += 256) {                            // the streams interleaved, as they arrive
+    bool more = false;
+    for (int s = 0; s < STREAMS; s++) {
+      const std::vector<uint8_t> &v = streams[s];
+      for (size_t j = i; j < i + 256 && j < v.size(); j++) metricsPut(m, s, v[j], 1760000000000ull + j);
+      if (i + 256 < v.size()) more = true;
+      bytes += i < v.size() ? std::min<size_t>(256, v.size() - i) : 0;
+    }
+    if (!more) break;
+  }
+  uint64_t t1 = nowNs();
+  size_t len = 0;
+  uint64_t best = ~0ull;
+  for (int r = 0; r < renders; r++) {
+    uint64_t r0 = nowNs();
+    len = renderMetrics(m, out, sizeof(out));
+    uint64_t r1 = nowNs();
+    if (r1 - r0 < best) best = r1 - r0;
+  }
+  uint64_t t2 = nowNs(), a1 = allocs;
+  struct mallinfo2 m1 = mallinfo2();
+  long growth = static_cast<long>(m1.uordblks) - static_cast<long>(m0.uordblks);
+  if (!len) { printf("**FAIL** render larger than VMET_RENDER_MAX\n"); return 1; }
+  if (!checkExposition(out, len)) return 1;
+
+  uint32_t got = 0;
+  for (int i = 0; i < m.count; i++) got += m.dev[i].readings;
+  printf("%d streams, %d devices: %u readings, %.1f bytes/reading\n", STREAMS, m.count, got, static_cast<double>(bytes) / got);
+  reportRate("ingest", got, t1 - t0);
+  double avg = (t2 - t1) / 1e3 / renders;
+  printf("%-20s %zu bytes (%zu per device): %.1f us avg, %.1f us best, %.0f renders/s\n", "render",
+         len, len / m.count, avg, best / 1e3, 1e6 / avg);
+  printf("%-20s heap in use %zu -> %zu bytes (%+ld), %llu allocations\n", "",
+         m0.uordblks, m1.uordblks, growth, static_cast<unsigned long long>(a1 - a0));
+  if (growth != 0 || a1 != a0) { printf("**FAIL** heap grew or allocated\n"); return 1; }
+  if (avg >= 10000) { printf("**FAIL** a render of %d devices takes 10 ms or more\n", m.count); return 1; }
+  return 0;
+}
@@ -0,0 +1,161 @@
+/* History benchmark - runs on Linux, no ESP32 needed
+
+Appends Battery Monitor and Solar Controller readings, one every 200 ms (5 Hz,
+with BLE jitter), to a VHistory with a fixed byte budget, then:
+- checks every sample still held reads back exactly, oldest first, and that they
+  are the newest ones appended (the oldest were evicted)
+- checks a range scan starts at the right sample
+- reports bytes/sample, the compression ratio against the decoded reading (+ time)
+  and the 16 byte record (+ time), the hours the budget holds, and append, full
+  scan and last-10-minutes scan throughput
+
+Readings are simulated (a battery slowly discharging under a noisy load, a solar
+charger through a day) unless captured plaintext records are given, 16 bytes each,
+which are decoded and replayed at 5 Hz.
+
+usage: bench_history [-n samples] [-k budget KB] [-bm file] [-sc file] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t seed = 12345;
+static int32_t noise(int32_t range){                    // -range .. range
+  seed = seed * 1664525u + 1013904223u;
+  return static_cast<int32_t>((seed >> 8) % (2 * range + 1)) - range;
+}
+
+static uint32_t sampleMs(uint64_t i){ return 1000 + i * 200 + noise(4); }
+
+// 24V battery: load steps every few minutes, amps noisy by ~50 mA, volts by 10 mV
+static void simBM(uint64_t i, BatteryMonitorReading &r){
+  static int32_t loadmA = -8000, used = 0;
+  if (i % 900 == 0) loadmA = -2000 - 300 * (noise(20) + 20);   // new load every 3 minutes
+  int32_t mA = loadmA + noise(50);
+  used += -mA;                                          // mA x 200 ms
+  memset(&r, 0, sizeof(r));
+  r.battA     = mA;
+  r.usedAh    = used / 1800000;                         // 100 mAh units: mA.200ms / (100 mA x 18000)
+  r.soc       = 1000 - r.usedAh * 1000 / 2000;          // 200 Ah battery
+  r.battV     = 2650 - r.usedAh / 4 + mA / 2000 + noise(1);
+  r.aux       = 1;
+  r.auxVal    = r.battV / 2 + noise(1);
+  r.ttgMin    = -mA ? (r.soc * 12) / (-mA / 1000 + 1) : 0xFFFF;
+  r.valid     = BM_TTG | BM_BATTV | BM_AUX | BM_BATTA | BM_AH | BM_SOC;
+}
+
+// solar charger: PV follows the sun over 12 hours, with cloud noise
+static void simSC(uint64_t i, SolarChargerReading &r){
+  static uint32_t Wh10x = 0;
+  int32_t t = (i / 5) % 43200;                          // secs into the day
+  int32_t pv = t < 21600 ? t / 54 : (43200 - t) / 54;   // 0 .. 400 W
+  pv += pv ? noise(3) : 0;
+  if (pv < 0) pv = 0;
+  Wh10x += pv;                                          // W x 200 ms
+  memset(&r, 0, sizeof(r));
+  r.state     = pv ? 3 + (t > 30000) : 0;
+  r.battV     = 2650 + pv / 10 + noise(1);
+  r.battA     = pv * 10 / 26;
+  r.pvW       = pv;
+  r.yield10Wh = Wh10x / 180000;                         // W.200ms -> 10 Wh
+  r.loadA     = 0;
+  r.valid     = SC_BATTV | SC_BATTA | SC_KWH | SC_PVW;
+}
+
+static std::vector<uint8_t> loadRecords(const char *file){
+  std::vector<uint8_t> recs;
+  if (file && (!readFile(file, recs) || recs.size() < 16)) {
+    fprintf(stderr, "** cannot read records from %s\n", file);
+    exit(1);
+  }
+  recs.resize(recs.size() / 16 * 16);
+  return recs;
+}
+
+static bool run(const char *name, std::vector<VSample> &in, uint8_t fields, uint8_t xorMask,
+                size_t budget, size_t readingBytes){
+  std::vector<uint8_t> buf(budget);
+  VHistory h;
+  if (!initHistory(h, buf.data(), budget, fields, xorMask)) { printf("**FAIL** initHistory\n"); return false; }
+  uint64_t t0 = nowNs();
+  for (const VSample &s : in) historyAppend(h, s);
+  uint64_t t1 = nowNs();
+
+  // everything held reads back exactly, and is the newest
+  VHistoryIter it;
+  VSample s;
+  size_t k = in.size() - h.count, n = 0;
+  historyBegin(h, it);
+  while (historyNext(it, s)) {
+    const VSample &want = in[k + n++];
+    if (s.ms != want.ms || memcmp(s.v, want.v, fields * sizeof(int32_t))) {
+      printf("**FAIL** %s: sample %zu does not read back\n", name, k + n - 1);
+      return false;
+    }
+  }
+  if (n != h.count) { printf("**FAIL** %s: %zu samples read, %u held\n", name, n, h.count); return false; }
+
+  // range scan: last 10 minutes
+  uint32_t from = in.back().ms - 600000;
+  size_t first = in.size();
+  while (first > 0 && static_cast<int32_t>(in[first - 1].ms - from) >= 0) first--;
+  historyBegin(h, it, from);
+  if (!historyNext(it, s) || s.ms != in[first].ms) { printf("**FAIL** %s: range scan start\n", name); return false; }
+
+  // timing
+  uint64_t t2 = nowNs(), sum = 0;
+  const int scans = 20;
+  for (int i = 0; i < scans; i++) { historyBegin(h, it); while (historyNext(it, s)) sum += s.v[0]; }
+  uint64_t t3 = nowNs();
+  size_t ranged = 0;
+  for (int i = 0; i < scans * 10; i++) { historyBegin(h, it, from); while (historyNext(it, s)) { sum += s.v[0]; ranged++; } }
+  uint64_t t4 = nowNs();
+
+  size_t bytes = historyBytes(h);
+  double perSample = static_cast<double>(bytes) / h.count;
+  double hours = budget / perSample / 5 / 3600;
+  printf("%s: %u samples held of %zu, %.0f min span, %zu of %zu bytes used\n", name, h.count, in.size(),
+         historySpanMs(h) / 60000.0, bytes, budget);
+  printf("%-20s %.2f bytes/sample, ratio %.1fx vs reading+ms (%zu bytes), %.1fx vs record+ms (20 bytes)\n", "",
+         perSample, (readingBytes + 4) / perSample, readingBytes + 4, 20 / perSample);
+  printf("%-20s %.1f hours of 5 Hz readings in %zu KB\n", "", hours, budget / 1024);
+  reportRate("append", in.size(), t1 - t0);
+  reportRate("full scan", static_cast<uint64_t>(h.count) * scans, t3 - t2);
+  reportRate("last 10 min scan", ranged, t4 - t3);
+  if (sum == 1) printf(" ");
+  return true;
+}
+
+int main(int argc, char **argv){
+  uint64_t samples = 1000000;
+  size_t kb = 32;
+  const char *bmFile = nullptr, *scFile = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n")  && i + 1 < argc) samples = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-k")  && i + 1 < argc) kb = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-bm") && i + 1 < argc) bmFile = argv[++i];
+    else if (!strcmp(argv[i], "-sc") && i + 1 < argc) scFile = argv[++i];
+    else { fprintf(stderr, "usage: %s [-n samples] [-k budget KB] [-bm file] [-sc file]\n", argv[0]); return 2; }
+  }
+  std::vector<uint8_t> bmRecs = loadRecords(bmFile), scRecs = loadRecords(scFile);
+  std::vector<VSample> bm(samples), sc(samples);
+  for (uint64_t i = 0; i < samples; i++) {
+    BatteryMonitorReading b;
+    SolarChargerReading   c;
+    if (bmFile) decodeBM(&bmRecs[(i % (bmRecs.size() / 16)) * 16], b); else simBM(i, b);
+    if (scFile) decodeSC(&scRecs[(i % (scRecs.size() / 16)) * 16], c); else simSC(i, c);
+    uint32_t ms = sampleMs(i);
+    bmSample(b, ms, bm[i]);
+    scSample(c, ms, sc[i]);
+  }
+  printf("readings: BM %s  SC %s, %llu each at 5 Hz\n\n", bmFile ? bmFile : "simulated", scFile ? scFile : "simulated",
+         static_cast<unsigned long long>(samples));
+  if (!run("Battery Monitor", bm, VHIST_BM_FIELDS, VHIST_BM_XOR, kb * 1024, sizeof(BatteryMonitorReading))) return 1;
+  printf("\n");
+  if (!run("Solar Controller", sc, VHIST_SC_FIELDS, VHIST_SC_XOR, kb * 1024, sizeof(SolarChargerReading))) return 1;
+  return 0;
+}
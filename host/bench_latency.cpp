@@ -0,0 +1,150 @@
+/* Per stage latency benchmark - runs on Linux, no ESP32 needed
+
+Runs Battery Monitor and Solar Controller advertisements through the stages of
+the sketches one frame at a time, timing each stage of each frame separately
+with the Linux monotonic clock (standing in for the ESP32 cycle counter), and
+reports p50 / p99 / max per stage from VLatency:
+  callback  address lookup, find the Victron data, drop repeats, queue (onResult())
+  decrypt   decryptFrame() (decryptAesCtr())
+  decode    decodeBM() / decodeSC() (reportBMvalues() / reportSCvalues())
+  format    formatBM() / formatSC() into the report line
+  serial    the line written out (fwrite to /dev/null here)
+  frame     decrypt to written out
+The sketches keep the same histograms on the ESP32 (enter L). The cost of reading
+the clock itself is shown first: stages close to it are at the limit of what can
+be measured one at a time. First checks the percentiles on a known distribution.
+
+usage: bench_latency [-n frames] [-j]
+  -j  JSON lines only, one per stage, to track regressions between releases */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// p50 / p99 of 1 .. 100000 within the bucket width
+static bool checkPercentiles(){
+  static VLatency l;
+  initLatency(l);
+  for (uint32_t v = 100000; v >= 1; v--) latRecord(l, v);
+  uint32_t p50 = latPercentile(l, 500), p99 = latPercentile(l, 990);
+  return l.count == 100000 && l.max == 100000 && p50 > 50000 * 0.968 && p50 < 50000 * 1.032 &&
+         p99 > 99000 * 0.968 && p99 < 99000 * 1.032 && latPercentile(l, 1000) == 100000;
+}
+
+struct Advert {
+  uint8_t addr[6];
+  uint8_t payload[31];
+  size_t  payloadLen;
+};
+
+int main(int argc, char **argv){
+  uint64_t frames = 200000;
+  bool json = false;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-j")) json = true;
+    else { fprintf(stderr, "usage: %s [-n frames] [-j]\n", argv[0]); return 2; }
+  }
+  if (!checkPercentiles()) { printf("**FAIL** percentiles of a known distribution\n"); return 1; }
+
+  // two devices, a BM and an SC, every advertisement new data (as the callback passes on)
+  static VDeviceTable table;
+  const uint8_t addr[2][6] = {{0xc0, 0xff, 0xee, 0x00, 0x00, 0x01}, {0xc0, 0xff, 0xee, 0x00, 0x00, 0x02}};
+  const uint8_t key[16]    = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+  initDevices(table);
+  for (int d = 0; d < 2; d++) addDevice(table, macFromBytes(addr[d]), key, d ? "solar" : "shunt");
+  const int nAdverts = 4096;
+  std::vector<Advert> air(nAdverts);
+  srand(7);
+  for (int f = 0; f < nAdverts; f++) {
+    Advert &a = air[f];
+    int d = f & 1;
+    memcpy(a.addr, addr[d], 6);
+    uint16_t iv = static_cast<uint16_t>(f / 2);
+    uint8_t mfr[VMFR_MAX] = {0xE1, 0x02, 0x10, 0xA3, 0x02, 0x00, static_cast<uint8_t>(d ? 0x01 : 0x02),
+                             static_cast<uint8_t>(iv), static_cast<uint8_t>(iv >> 8), key[0]};
+    uint8_t ks[16];
+    aesKeystream(table.dev[d].aes, iv, ks);
+    for (int i = 0; i < 16; i++) mfr[VMFR_CIPHER + i] = static_cast<uint8_t>(rand()) ^ ks[i];
+    uint8_t *p = a.payload;
+    *p++ = 27; *p++ = 0xFF; memcpy(p, mfr, 26); p += 26;
+    a.payloadLen = p - a.payload;
+  }
+
+  static VLatency lat[VST_COUNT], clockCost;
+  for (VLatency &l : lat) initLatency(l);
+  initLatency(clockCost);
+  static VRing ring;
+  initRing(ring);
+  FILE *out = fopen("/dev/null", "w");
+  if (!out) { printf("**FAIL** cannot open /dev/null\n"); return 1; }
+  VLine line;
+  uint32_t sum = 0;
+  for (uint64_t f = 0; f < frames; f++) {
+    const Advert &a = air[f % nAdverts];
+    uint64_t c0 = nowNs(), c1 = nowNs();
+    latRecord(clockCost, c1 - c0);
+
+    uint64_t t0 = nowNs();                              // -- callback
+    VDevice *dev = findDevice(table, macFromBytes(a.addr));
+    if (dev) {
+      size_t len;
+      const uint8_t *mfr = findVictronData(a.payload, a.payloadLen, len);
+      if (mfr && !isDuplicate(*dev, mfr, len) && ringPush(ring, dev->mac, -70, 0, mfr, len)) dedupAccept(*dev, mfr, len);
+    }
+    uint64_t t1 = nowNs();
+    latRecord(lat[VST_CALLBACK], t1 - t0);
+
+    VFrame fr;                                          // -- loop()
+    if (ringPop(ring, &fr, 1) != 1) { printf("**FAIL** frame %llu not queued\n", static_cast<unsigned long long>(f)); return 1; }
+    VDevice *d = findDevice(table, fr.mac);
+    uint8_t plain[16];
+    BatteryMonitorReading bm;
+    SolarChargerReading   sc;
+    bool isBM = fr.data[VMFR_RECORD] == 0x02;
+    uint64_t s0 = nowNs();
+    bool ok = decryptFrame(*d, fr.data, fr.len, plain);
+    uint64_t s1 = nowNs();
+    if (isBM) decodeBM(plain, bm); else decodeSC(plain, sc);
+    uint64_t s2 = nowNs();
+    lineClear(line);
+    lineChar(line, '\t');
+    if (isBM) formatBM(line, bm); else formatSC(line, sc, true);
+    lineStr(line, "  ");
+    lineStr(line, d->name);
+    lineChar(line, '\n');
+    uint64_t s3 = nowNs();
+    fwrite(line.buf, 1, line.len, out);
+    uint64_t s4 = nowNs();
+    if (!ok) { printf("**FAIL** frame %llu did not decrypt\n", static_cast<unsigned long long>(f)); return 1; }
+    latRecord(lat[VST_DECRYPT], s1 - s0);
+    latRecord(lat[VST_DECODE],  s2 - s1);
+    latRecord(lat[VST_FORMAT],  s3 - s2);
+    latRecord(lat[VST_SERIAL],  s4 - s3);
+    latRecord(lat[VST_FRAME],   s4 - s0);
+    sum += line.len;
+  }
+  fclose(out);
+
+  if (json) {
+    for (int s = 0; s < VST_COUNT; s++) {
+      lineClear(line);
+      formatLatency(line, stageName[s], lat[s], 1000);
+      printf("%s\n", lineText(line));
+    }
+    return 0;
+  }
+  printf("percentiles of a known distribution: ok\n\n");
+  printf("%-10s %10s %10s %10s %10s   (ns)\n", "stage", "n", "p50", "p99", "max");
+  printf("%-10s %10u %10u %10u %10u\n", "(clock)", clockCost.count, latPercentile(clockCost, 500),
+         latPercentile(clockCost, 990), clockCost.max);
+  for (int s = 0; s < VST_COUNT; s++)
+    printf("%-10s %10u %10u %10u %10u\n", stageName[s], lat[s].count, latPercentile(lat[s], 500),
+           latPercentile(lat[s], 990), lat[s].max);
+  if (sum == 1) printf(" ");
+  return 0;
+}
@@ -0,0 +1,294 @@
+/* Bit field layout benchmark - runs on Linux, no ESP32 needed
+
+decodeBM() and decodeSC() now extract every field with the templates in VLayout.h,
+generated from the constexpr layout descriptors, into fixed point readings. This
+compares them with the hand-written shift, mask & float code they replaced (copied
+below, unchanged, with the float structs it filled in):
+- checks both give the same values & N/A flags for a million random records
+- times the odd width Battery Monitor fields on their own (22 bit signed amps,
+  20 bit Ah, 10 bit SOC), then the whole decoders
+and fails if a generated extractor is more than 10% slower than the hand-written one.
+
+The hand-written code tests the N/A value without the sign bit, so it also reports
+-1 (e.g. -0.01 V) as N/A; the descriptors follow the document (0x7FFF etc. only).
+That one difference is allowed for.
+
+usage: bench_layout [-n frames] */
+
+#include "VictronCore.h"
+#include "VLayout.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// -- the hand-written decoders, as they were in VDecode.cpp --------------------------------
+
+struct BMvalues {
+  float    ttgDays;
+  float    battV;
+  uint32_t alarmBits;
+  int      aux;
+  float    Aval;
+  float    battA;
+  float    Ah;
+  float    SoC;
+  bool inf_TTG, na_batV, na_aux, na_batA, na_Ah, na_soc;
+};
+
+struct SCvalues {
+  uint8_t state;
+  uint8_t error;
+  float   battV, battA, kWh, PV_W, loadA;
+  bool na_batV, na_batA, na_kWh, na_pvW, na_lodA;
+};
+
+// Remaining Battery 'Time to Go' in minutes
+static float parseTimeToGo(const uint8_t *output, bool &inf){
+  uint16_t TTG_mins = (output[1] << 8) | output[0];  // NB little endian: byte[1] <-> byte[0]
+  if (TTG_mins == 0xFFFF) inf = true;
+  return (static_cast<float>(TTG_mins)/60/24);   // integer units minutes converted to hours as float
+}
+
+// Note: SC & BM use same bytes (2,3) for battery volts
+static float parseBattVolts(const uint8_t *output, bool &na){
+  bool    neg       =  (output[3] & 0x80) >> 7;              // extract sign bit for signed int
+  int32_t batt_mV10 = ((output[3] & 0x7F) << 8) | output[2];  // exclude sign bit from byte 3
+  if (batt_mV10 == 0x7FFF) na = true;
+  if (neg) batt_mV10 = batt_mV10 - 32768;       // 2's complement = val - 2^(b-1) b = bit# = 16
+  return (static_cast<float>(batt_mV10)/100);   // integer units 10mV converted to V as float
+}
+
+/* -- AUX ------------------------------------------------------------------------------------
+aux = 0 selects auxilliary voltage source
+aux = 1 selects mid-point voltage
+aux = 2 selects battery temperature in degrees Kelvin
+aux = 3 means result is 'N/A' or 'off' */
+
+// only called when aux = 0
+static float parseAuxVolts(const uint8_t *output, bool &na){
+  bool    neg      =  (output[7] & 0x80) >> 7;               // extract sign bit
+  int32_t aux_mV10 = ((output[7] & 0x7F) << 8) | output[6]; // exclude sign bit from byte[7]
+  if (aux_mV10 == 0x7FFF) na = true;
+  if (neg) aux_mV10 = aux_mV10 - 32768;         // 2's complement = val - 2^(b-1) b = bit# = 16
+  return (static_cast<float>(aux_mV10)/100);   // integer units 10mV converted to V as float
+}
+
+// only called when aux = 1
+static float parseMidVolts(const uint8_t *output, bool &na){
+  int32_t aux_mV10 = (output[7] << 8) | output[6];
+  if (aux_mV10 == 0xFFFF) na = true;
+  return (static_cast<float>(aux_mV10)/100);   // integer units 10mV converted to V, as float
+}
+
+// only called when aux = 2
+static float parseAuxKelvin(const uint8_t *output, bool &na){
+  int32_t aux_mK10 = (output[7] << 8) | output[6];
+  if  (aux_mK10 == 0xFFFF) na = true;
+  return (static_cast<float>(aux_mK10)/100);    // integer units 10 milli-Kelvin, converted to Kelvin, as float
+}
+
+// Battery Current (signed) 22 bits = sign bit + 21 bits
+static float parseBattAmps(const uint8_t *output, bool &na){
+  bool    neg =  (output[10] & 0x80) >> 7;                                        // bit  21
+  int32_t mA  =(((output[8]  & 0xFC) >> 2) + ((output[9]  & 0x03) << 6))      | // bits  0 - 7
+               ((((output[9]  & 0xFC) >> 2) + ((output[10] & 0x03) << 6)) << 8) | // bits  8 - 15
+               (((output[10] & 0x7C) >> 2)                                << 16); // bits 16 - 20
+  if (mA == 0x1FFFFF) na = true;
+  if (neg) mA = mA - 2097152;                   // 2's complement = val - 2^(b-1) where b = bits = 22
+  return (static_cast<float>(mA)/1000);         // convert mA to float A
+}
+
+// Amp Hours consumed 20 bits (unsigned) integer units 0.1Ah (100mAh).
+static float parseAmpHours(const uint8_t *output, bool &na){
+  uint32_t mAh100 = output[11]       |            // bits  0 - 7
+                   (output[12] << 8) |            // bits  8 - 15
+                  ((output[13] & 0x0F) << 16);    // bits 16 - 19
+  if (mAh100 == 0xFFFFF) na = true;
+  return (static_cast<float>(mAh100)/10);           // integer units 100mAh converted to Ah as float
+}
+
+// State of charge 0-100% in units of 0.1%, as 10 bits (unsigned)
+static float parseStateOfCharge(const uint8_t *output, bool &na){
+  uint16_t soc01 = ((output[13] & 0xF0) >> 4) |   // bits 0 - 3
+                   ((output[14] & 0x0F) << 4) |   // bits 4 - 7
+                   ((output[14] & 0x30) << 4);    // bits 8 - 9
+  if (soc01 == 0x3FF) na = true;
+  if (soc01  > 1000) soc01 = 9999;                  // flag error if > 100% = 1000/10
+  return (static_cast<float>(soc01)/10);            // integer units 0.1% converted to % as float
+}
+
+__attribute__((noinline)) static void handBM(const uint8_t output[16], BMvalues &v){
+  v.inf_TTG = v.na_batV = v.na_aux = v.na_batA = v.na_Ah = v.na_soc = false;
+  v.ttgDays   = parseTimeToGo(output, v.inf_TTG);
+  v.battV     = parseBattVolts(output, v.na_batV);
+  v.alarmBits = (static_cast<uint32_t>(output[5]) << 8) | output[4];
+  v.aux       = output[8] & 0x03;
+  if      (v.aux == 0) v.Aval = parseAuxVolts (output, v.na_aux);
+  else if (v.aux == 1) v.Aval = parseMidVolts (output, v.na_aux);
+  else if (v.aux == 2) v.Aval = parseAuxKelvin(output, v.na_aux);
+  else                 v.Aval = 999.99;
+  v.battA     = parseBattAmps(output, v.na_batA);
+  v.Ah        = parseAmpHours(output, v.na_Ah);
+  v.SoC       = parseStateOfCharge(output, v.na_soc);
+}
+
+/* ------------------------------------------------------------------------
+Solar Controller
+----------------
+NB: multiple bytes are little-endian (i.e order of double/triple bytes reversed)
+signed ints use 2's complement, so the first mask excises the sign bit */
+
+// Battery Current (signed) 16 bits = sign bit + 15 bits
+static float parseSCbattAmps(const uint8_t *output, bool &na){
+  bool neg = ((output[5]  & 0x80) >> 7);                          // extract sign bit
+  int32_t ma100 = ((output[5] & 0x7F) << 8) | output[4];          // exclude sign bit from byte 5
+  if (ma100 == 0x7FFF) na = true;
+  if (neg) ma100 = ma100 - 32768;                                 // 2's complement = val - 2^(b-1) b = bit# = 16
+  return (static_cast<float>(ma100)/10);                          // convert mA100 to float A
+}
+
+// Today's Yield 16bits (unsigned int) units 0.01kWh (10Wh).
+static float parseKWHtoday(const uint8_t *output, bool &na){
+  uint16_t Wh10     = (output[7] << 8) | output[6];               // NB little endian: byte[7] <-> byte[6]
+  if (Wh10 == 0xFFFF) na = true;
+  return (static_cast<float>(Wh10)/100);                          // convert integer in 10Wh units to kWh as float
+}
+
+// PV panel power in Watts
+static float parsePVpower(const uint8_t *output, bool &na){
+  uint16_t pvW = (output[9] << 8) | output[8];                    // NB little endian: byte[9] <-> byte[8]
+  if (pvW == 0xFFFF) na = true;
+  return (static_cast<float>(pvW));                               // convert integer Watts to float
+}
+
+// Load current? (Possibly irrelevant as VictronConnect doesn't even display this)
+static float parseLoadAmps(const uint8_t *output, bool &na){
+  uint16_t PVma100 = ((output[11] & 0x01) << 8) | output[10];     // NB little endian: byte[11] <-> byte[10]
+  if (PVma100 == 0x1FF) na = true;
+  return (static_cast<float>(PVma100)/10);                        //  convert integer in 100mA units to Amps as float
+}
+
+__attribute__((noinline)) static void handSC(const uint8_t output[16], SCvalues &v){
+  v.na_batV = v.na_batA = v.na_kWh = v.na_pvW = v.na_lodA = false;
+  v.state = output[0];
+  v.error = output[1];
+  v.battV = parseBattVolts (output, v.na_batV);
+  v.battA = parseSCbattAmps(output, v.na_batA);
+  v.kWh   = parseKWHtoday  (output, v.na_kWh);
+  v.PV_W  = parsePVpower   (output, v.na_pvW);
+  v.loadA = parseLoadAmps  (output, v.na_lodA);
+}
+
+// -- agreement -----------------------------------------------------------------------------
+
+// same value (ttg is divided by 60 then 24 by hand, by 1440 generated: 1 ulp apart at most),
+// and the same N/A flag unless the hand-written code flagged -1 LSB (see above)
+static bool agree(const char *name, float hand, bool handNa, float gen, bool genNa, float lsb, uint32_t rec){
+  bool valueOk = hand == gen || fabsf(hand - gen) <= fabsf(hand) * 1e-6f;
+  bool naOk    = handNa == genNa || (handNa && !genNa && gen == -lsb);
+  if (valueOk && naOk) return true;
+  printf("**FAIL** record %u %s: hand-written %f%s, generated %f%s\n", rec, name,
+         hand, handNa ? " (n/a)" : "", gen, genNa ? " (n/a)" : "");
+  return false;
+}
+
+static bool checkAgree(const std::vector<uint8_t> &recs){
+  for (size_t i = 0; i < recs.size(); i += 16) {
+    const uint8_t *p = &recs[i];
+    uint32_t n = i / 16;
+    BMvalues h; BatteryMonitorReading g;
+    handBM(p, h);
+    decodeBM(p, g);
+    float soc = g.soc > 1000 ? 999.9f : g.soc / 10.0f;
+    if (!agree("ttg",   h.ttgDays, h.inf_TTG, g.ttgMin / 1440.0f, !(g.valid & BM_TTG),   0,      n) ||
+        !agree("battV", h.battV,   h.na_batV, g.battV  / 100.0f,  !(g.valid & BM_BATTV), 0.01f,  n) ||
+        !agree("alarm", h.alarmBits, false,   g.alarmBits,        false,                 0,      n) ||
+        !agree("aux",   h.aux,     false,     g.aux,              false,                 0,      n) ||
+        (g.aux != 3 &&                                                                   // hand-written: 999.99
+        !agree("Aval",  h.Aval,    h.na_aux,  g.auxVal / 100.0f,  !(g.valid & BM_AUX),   0.01f,  n)) ||
+        !agree("battA", h.battA,   h.na_batA, g.battA  / 1000.0f, !(g.valid & BM_BATTA), 0.001f, n) ||
+        !agree("Ah",    h.Ah,      h.na_Ah,   g.usedAh / 10.0f,   !(g.valid & BM_AH),    0,      n) ||
+        !agree("SoC",   h.SoC,     h.na_soc,  soc,                !(g.valid & BM_SOC),   0,      n)) return false;
+    SCvalues hs; SolarChargerReading gs;
+    handSC(p, hs);
+    decodeSC(p, gs);
+    if (!agree("state", hs.state, false,      gs.state,              false,                  0,     n) ||
+        !agree("error", hs.error, false,      gs.error,              false,                  0,     n) ||
+        !agree("battV", hs.battV, hs.na_batV, gs.battV / 100.0f,     !(gs.valid & SC_BATTV), 0.01f, n) ||
+        !agree("battA", hs.battA, hs.na_batA, gs.battA / 10.0f,      !(gs.valid & SC_BATTA), 0.1f,  n) ||
+        !agree("kWh",   hs.kWh,   hs.na_kWh,  gs.yield10Wh / 100.0f, !(gs.valid & SC_KWH),   0,     n) ||
+        !agree("PV_W",  hs.PV_W,  hs.na_pvW,  gs.pvW,                !(gs.valid & SC_PVW),   0,     n) ||
+        !agree("loadA", hs.loadA, hs.na_lodA, gs.loadA / 10.0f,      !(gs.valid & SC_LOADA), 0,     n)) return false;
+  }
+  return true;
+}
+
+// -- timing ----------------------------------------------------------------------------------
+
+static uint64_t frames = 20000000;
+static std::vector<uint8_t> recs;
+static double sink = 0;                                 // keeps the optimiser honest
+
+// best of 3 runs, ns per frame
+template <typename F>
+static double timeIt(const char *name, F f){
+  size_t n = recs.size() / 16;
+  uint64_t best = ~0ull;
+  for (int run = 0; run < 3; run++) {
+    float sum = 0;
+    uint64_t t0 = nowNs();
+    for (uint64_t i = 0; i < frames; i++) sum += f(&recs[(i % n) * 16]);
+    uint64_t ns = nowNs() - t0;
+    if (ns < best) best = ns;
+    sink += sum;
+  }
+  reportRate(name, frames, best);
+  return static_cast<double>(best) / frames;
+}
+
+static bool compare(const char *what, double hand, double gen){
+  bool ok = gen <= hand * 1.10;
+  printf("%-20s generated / hand-written = %.2f  %s\n", what, gen / hand, ok ? "ok" : "**FAIL** slower");
+  return ok;
+}
+
+int main(int argc, char **argv){
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else { fprintf(stderr, "usage: %s [-n frames]\n", argv[0]); return 2; }
+  }
+  recs.resize(1000000 * 16);
+  uint32_t x = 2463534242u;                             // xorshift32
+  for (size_t i = 0; i < recs.size(); i++) { x ^= x << 13; x ^= x >> 17; x ^= x << 5; recs[i] = x; }
+  for (size_t i = 0; i < 16 * 16; i++) recs[i] = (i / 16) & 1 ? 0xFF : 0x00;   // all N/A, all zero
+  if (!checkAgree(recs)) return 1;
+  printf("hand-written and generated decoders agree on %zu records: ok\n\n", recs.size() / 16);
+  recs.resize(4096 * 16);                               // stays in cache for the timing
+
+  using namespace BatteryMonitorLayout;
+  bool ok = true, na;
+  double h, g;
+  h = timeIt("parseBattAmps",      [&](const uint8_t *p){ na = false; float v = parseBattAmps(p, na);      return v + na; });
+  g = timeIt("field<battA>",       [ ](const uint8_t *p){ return fieldValue<battA>(p) + fieldNA<battA>(p); });
+  ok &= compare("22 bit signed amps", h, g);
+  h = timeIt("parseAmpHours",      [&](const uint8_t *p){ na = false; float v = parseAmpHours(p, na);      return v + na; });
+  g = timeIt("field<usedAh>",      [ ](const uint8_t *p){ return fieldValue<usedAh>(p) + fieldNA<usedAh>(p); });
+  ok &= compare("20 bit Ah", h, g);
+  h = timeIt("parseStateOfCharge", [&](const uint8_t *p){ na = false; float v = parseStateOfCharge(p, na); return v + na; });
+  g = timeIt("field<soc>",         [ ](const uint8_t *p){ uint32_t s = fieldRaw<soc>(p);
+                                                          return (s > 1000 ? 999.9f : fieldValue<soc>(p)) + (s == soc.na); });
+  ok &= compare("10 bit SOC", h, g);
+  printf("\n");
+  h = timeIt("hand-written BM",    [ ](const uint8_t *p){ BMvalues v; handBM(p, v);   return v.battA + v.Ah + v.SoC; });
+  g = timeIt("decodeBM",           [ ](const uint8_t *p){ BatteryMonitorReading v; decodeBM(p, v); return v.battA + v.usedAh + v.soc; });
+  ok &= compare("Battery Monitor", h, g);
+  h = timeIt("hand-written SC",    [ ](const uint8_t *p){ SCvalues v; handSC(p, v);   return v.battV + v.PV_W + v.loadA; });
+  g = timeIt("decodeSC",           [ ](const uint8_t *p){ SolarChargerReading v;   decodeSC(p, v); return v.battV + v.pvW + v.loadA; });
+  ok &= compare("Solar Controller", h, g);
+  if (sink == 1) printf(" ");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,376 @@
+/* Outlier filter benchmark - runs on Linux, no ESP32 needed
+
+Builds a capture of simulated devices, one update a second for -h hours: Battery
+Monitors on a 12, a 24 and a 48 V battery and a Solar Controller on 24 V, doing what
+a real system does: loads switched on and off and the charger starting and stopping
+(amps and volts step), SOC & Ah used following the current, sun and cloud on the
+panels (PV watts step), the load output switched, the yield back to 0 at midnight.
+Then -p % of the frames are corrupted, 1 to 4 bits of the cipher text flipped as a
+bad packet would be (AES-CTR: the same bits flip in the decrypted record).
+
+The capture is replayed as the sketches do - isDuplicate(), decryptFrame(), decodeBM()
+or decodeSC() - and each reading checked by the outlier filter (VictronCore/VOutlier.h)
+and by the fixed thresholds it replaced (set for 24 V), against what was sent:
+  false pos   clean readings flagged, not counting the first reading of a genuine
+              step, which the filter holds back until the next one confirms it (held)
+  caught      corrupt readings flagged, of those with a value off by more than
+              GROSS_FLOORS floors (smaller errors are noise: caught or not, no harm)
+then the ns per reading of outlierCheck(). Fails if the filter's false positives are
+over MAX_FALSE_PCT, or it catches less than MIN_CAUGHT_PCT of the gross corruptions.
+-w writes the capture, to replay elsewhere (host/replay).
+
+Given a capture (with -d as replay, for a real one), checks that instead and prints
+every reading flagged, the value and the median & spread it was tested against; with
+no record of what was sent, every flag on a clean capture is a false positive.
+
+usage: bench_outlier [-h hours] [-p corrupt%] [-k spreads] [-w capture]
+       bench_outlier [-d address,key[,name]]... [-k spreads] capture */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define SIM_DEVICES     4           // BM 12 V, BM 24 V, BM 48 V, SC 24 V
+#define START_HOUR      4           // time of day the simulation starts
+#define GROSS_FLOORS    8           // a corrupt value further than this from what was sent is gross
+#define MAX_FALSE_PCT   0.5
+#define MIN_CAUGHT_PCT  95
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+static double   uniform(){ return (xorshift() + 0.5) / 4294967296.0; }
+static double   gauss(){ return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform()); }
+static bool     chance(double p){ return uniform() < p; }
+
+static VOutlierCfg bmCfg, scCfg;
+
+// -- the simulated capture ----------------------------------------------------------------
+
+// what was sent, one per frame
+struct Truth {
+  uint8_t plain[16];
+  bool    corrupt;
+  bool    step;                     // first reading at a new level (load, charger, cloud ...)
+};
+
+struct Sim {
+  const char *name;
+  bool        bm;
+  double      nominal;              // V
+  double      base, soc, cloud, load, yield;
+};
+
+static void putField(uint8_t rec[16], const VBitField &f, int64_t v){
+  uint32_t raw = static_cast<uint32_t>(v) & vMask(f.width);
+  for (int b = 0; b < f.width; b++) {
+    int bit = f.pos + b;
+    if ((raw >> b) & 1) rec[bit >> 3] |=  1 << (bit & 7);
+    else                rec[bit >> 3] &= ~(1 << (bit & 7));
+  }
+}
+
+// the next second of device s at time of day tod: its record, true if a level stepped
+static bool simulate(Sim &s, uint32_t tod, uint8_t rec[16]){
+  static const double loads[] = {-1.5, -4, -12, -30, -60, 20, 45};   // A: loads on / off, charger
+  bool step = false;
+  memset(rec, 0, 16);
+  if (s.bm) {
+    namespace L = BatteryMonitorLayout;
+    if (chance(1 / 600.0))                  { s.base = loads[xorshift() % 7]; step = true; }
+    if (s.soc >= 100 && s.base > 0)         { s.base = -1.5; step = true; }   // charged
+    if (s.soc <= 20  && s.base < 0)         { s.base = 45;   step = true; }   // charger on
+    double a = s.base + gauss() * (0.01 * fabs(s.base) + 0.05), cap = 200;
+    s.soc = fmin(100, fmax(5, s.soc + a / 3600 / cap * 100));
+    double v = s.nominal * (0.95 + 0.1 * s.soc / 100) + a * 0.005 * s.nominal / 24 + gauss() * 0.01;
+    putField(rec, L::ttg,    0xFFFF);
+    putField(rec, L::battV,  lround(v * 100));
+    putField(rec, L::alarm,  0);
+    putField(rec, L::midV,   lround(v * 50 + gauss() * 0.5));
+    putField(rec, L::aux,    1);
+    putField(rec, L::battA,  lround(a * 1000));
+    putField(rec, L::usedAh, lround((100 - s.soc) / 100 * cap * 10));
+    putField(rec, L::soc,    lround(s.soc * 10));
+  }
+  else {
+    namespace L = SolarChargerLayout;
+    double sun = tod > 6 * 3600 && tod < 18 * 3600 ? sin(M_PI * (tod - 6 * 3600) / (12 * 3600.0)) : 0;
+    if (sun > 0.1 && chance(1 / 300.0))     { s.cloud = 0.2 + 0.8 * uniform(); step = true; }
+    if (chance(1 / 900.0))                  { s.load = s.load > 0 ? 0 : 1 + 9 * uniform(); step = true; }
+    if (tod == 0)                           { s.yield = 0; step = true; }     // midnight
+    double pv = fmax(0, 800 * sun * s.cloud + gauss() * 3);
+    double v  = s.nominal * 1.08 + gauss() * 0.01;
+    s.yield  += pv / 3600;
+    putField(rec, L::state,  pv > 0 ? 3 : 0);
+    putField(rec, L::error,  0);
+    putField(rec, L::battV,  lround(v * 100));
+    putField(rec, L::battA,  lround(fmax(0, pv * 0.97 / v + gauss() * 0.05) * 10));
+    putField(rec, L::kWh,    lround(s.yield / 10));
+    putField(rec, L::pvW,    lround(pv));
+    putField(rec, L::loadA,  lround((s.load > 0 ? s.load + gauss() * 0.05 : 0) * 10));
+  }
+  return step;
+}
+
+static void simulatedCapture(double hours, double corruptPct, std::vector<DeviceArg> &devs,
+                             std::vector<uint8_t> &cap, std::vector<Truth> &truth){
+  Sim sims[SIM_DEVICES] = {{"BM 12 V", true, 12, -4, 80, 1, 0, 0}, {"BM 24 V", true, 24, -12, 60, 1, 0, 0},
+                           {"BM 48 V", true, 48, 20, 40, 1, 0, 0}, {"SC 24 V", false, 24, 0, 0, 1, 0, 0}};
+  static VAesKey keys[SIM_DEVICES];
+  devs.clear();
+  for (int d = 0; d < SIM_DEVICES; d++) {
+    DeviceArg a;
+    a.mac = 0xc0ffee000000ull + d;
+    for (int j = 0; j < 16; j++) a.key[j] = static_cast<uint8_t>(xorshift());
+    snprintf(a.name, sizeof(a.name), "%s", sims[d].name);
+    devs.push_back(a);
+    aesSetKey(keys[d], a.key);
+  }
+  uint8_t rec[VCAP_RECORD_MAX];
+  cap.resize(captureHeader(rec));
+  memcpy(cap.data(), rec, cap.size());
+  truth.clear();
+  uint32_t secs = static_cast<uint32_t>(hours * 3600);
+  for (uint32_t t = 0; t < secs; t++)
+    for (int d = 0; d < SIM_DEVICES; d++) {
+      Truth tr;
+      tr.step = simulate(sims[d], (START_HOUR * 3600 + t) % 86400, tr.plain);
+      uint16_t iv = static_cast<uint16_t>(t);
+      uint8_t ks[16];
+      aesKeystream(keys[d], iv, ks);
+      VFrame f;
+      f.mac  = devs[d].mac;
+      f.ms   = t * 1000 + d * 37;
+      f.rssi = -70;
+      f.len  = VMFR_MAX;
+      const uint8_t hdr[VMFR_RECORD + 1] = {0xE1, 0x02, 0x10, 0xA3, 0x02, 0x00,
+                                            static_cast<uint8_t>(sims[d].bm ? VREC_BATTERY_MONITOR : VREC_SOLAR_CHARGER)};
+      memcpy(f.data, hdr, sizeof(hdr));
+      f.data[VMFR_IV]     = iv & 0xFF;
+      f.data[VMFR_IV + 1] = iv >> 8;
+      f.data[VMFR_KEY0]   = devs[d].key[0];
+      for (int j = 0; j < 16; j++) f.data[VMFR_CIPHER + j] = tr.plain[j] ^ ks[j];
+      tr.corrupt = chance(corruptPct / 100);
+      if (tr.corrupt)
+        for (int b = 1 + xorshift() % 4; b > 0; b--) { int bit = xorshift() % 128; f.data[VMFR_CIPHER + bit / 8] ^= 1 << (bit % 8); }
+      truth.push_back(tr);
+      size_t n = captureFrame(f, rec);
+      cap.insert(cap.end(), rec, rec + n);
+    }
+  cap.push_back(VCAP_END);
+  for (VAesKey &k : keys) aesFreeKey(k);
+}
+
+// -- checking readings --------------------------------------------------------------------
+
+// a reading as the filter sees it
+struct Reading {
+  int      dev;
+  uint32_t ms;
+  int32_t  v[VOUT_FIELDS];
+  uint8_t  valid;
+  bool     auxOk;
+};
+
+static bool toReading(uint8_t type, const uint8_t plain[16], Reading &r){
+  if (type == VREC_BATTERY_MONITOR) {
+    BatteryMonitorReading b;
+    decodeBM(plain, b);
+    bmOutValues(b, r.v, r.valid);
+    r.auxOk = b.aux == 1;                                   // EXPECTED_AUX_MODE
+    return true;
+  }
+  if (type == VREC_SOLAR_CHARGER) {
+    SolarChargerReading c;
+    decodeSC(plain, c);
+    scOutValues(c, r.v, r.valid);
+    r.auxOk = true;
+    return true;
+  }
+  return false;
+}
+
+// the fixed thresholds the filter replaced (VBM.h / VSC.h, 24 V), in record units
+static int staticDuds(bool bm, const Reading &r){
+  static const int32_t bmMin[] = {2000, 1000, -200000,  100, 0}, bmMax[] = {3400, 1700, 200000, 1000, 10000};
+  static const int32_t scMin[] = {2000,    0,       0,    0, 0}, scMax[] = {3400, 2000,   1000, 50000, 2000};
+  const int32_t *lo = bm ? bmMin : scMin, *hi = bm ? bmMax : scMax;
+  int duds = !r.auxOk;
+  for (int i = 0; i < VOUT_FIELDS; i++)
+    if (((r.valid >> i) & 1) && (r.v[i] < lo[i] || r.v[i] > hi[i])) duds++;
+  return duds;
+}
+
+static int popcount(uint8_t b){ int n = 0; for (; b; b &= b - 1) n++; return n; }
+
+struct Tally {
+  uint64_t readings, clean, falsePos, held, corrupt, gross, caught;
+  uint64_t staticFalse, staticCaught;
+};
+
+static void report(const char *name, const Tally &t){
+  auto pct = [](uint64_t a, uint64_t b){ return b ? 100.0 * a / b : 0.0; };
+  printf("%-14s %9llu %8llu %8.3f%% %6llu %8llu %8.2f%%   %8.3f%% %8.2f%%\n", name,
+         static_cast<unsigned long long>(t.readings), static_cast<unsigned long long>(t.corrupt),
+         pct(t.falsePos, t.clean), static_cast<unsigned long long>(t.held), static_cast<unsigned long long>(t.gross),
+         pct(t.caught, t.gross), pct(t.staticFalse, t.clean), pct(t.staticCaught, t.gross));
+}
+
+int main(int argc, char **argv){
+  std::vector<DeviceArg> devs;
+  const char *file = nullptr, *out = nullptr;
+  double hours = 24, corruptPct = 2;
+  int k = -1;
+  for (int i = 1; i < argc; i++) {
+    DeviceArg d;
+    if      (!strcmp(argv[i], "-d") && i + 1 < argc) {
+      if (!parseDevice(argv[++i], d)) { fprintf(stderr, "** bad device %s\n", argv[i]); return 2; }
+      devs.push_back(d);
+    }
+    else if (!strcmp(argv[i], "-h") && i + 1 < argc) hours = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc) corruptPct = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-k") && i + 1 < argc) k = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc) out = argv[++i];
+    else if (argv[i][0] != '-' && !file) file = argv[i];
+    else {
+      fprintf(stderr, "usage: %s [-h hours] [-p corrupt%%] [-k spreads] [-w capture]\n"
+                      "       %s [-d address,key[,name]]... [-k spreads] capture\n", argv[0], argv[0]);
+      return 2;
+    }
+  }
+  bmCfg = bmOutlierDefaults;
+  scCfg = scOutlierDefaults;
+  if (k >= 0) bmCfg.k = scCfg.k = static_cast<uint8_t>(k);
+
+  std::vector<uint8_t> cap;
+  std::vector<Truth>   truth;
+  if (file) {
+    if (!readFile(file, cap)) { fprintf(stderr, "** cannot read %s\n", file); return 1; }
+    if (devs.empty())
+      for (const char *s : {"ff:ff:ff:ff:ff:ff,ffffffffffffffffffffffffffffffff,My_SmartShunt_1",
+                            "ff:ff:ff:ff:ff:fe,ffffffffffffffffffffffffffffffff,My_Solar_Controller"}) {
+        DeviceArg d;
+        parseDevice(s, d);
+        devs.push_back(d);
+      }
+  }
+  else {
+    simulatedCapture(hours, corruptPct, devs, cap, truth);
+    printf("%d devices, %.1f hours, 1 reading/sec, %.1f%% of frames corrupted\n", SIM_DEVICES, hours, corruptPct);
+    if (out) {
+      FILE *f = fopen(out, "wb");
+      if (!f || fwrite(cap.data(), 1, cap.size(), f) != cap.size()) { fprintf(stderr, "** cannot write %s\n", out); return 1; }
+      fclose(f);
+    }
+  }
+  const uint8_t *p = captureFind(cap.data(), cap.size());
+  if (!p) { fprintf(stderr, "** no capture header\n"); return 1; }
+
+  // -- replay: every reading through its device's filter
+  static VDeviceTable table;
+  static VOutlier     filt[VDEV_MAX];
+  loadTable(table, devs);
+  for (int d = 0; d < table.count; d++) initOutlier(filt[d], &bmCfg);
+  std::vector<Reading> readings;
+  std::vector<Tally>   tally(table.count);
+  std::vector<int>     sinceStep(table.count, 1 << 30);
+  uint64_t flagged = 0;
+  VFrame f;
+  size_t n, frame = 0;
+  for (; (n = captureNext(p, cap.data() + cap.size() - p, f)) > 0; p += n, frame++) {
+    VDevice *dev = findDevice(table, f.mac);
+    uint8_t plain[16];
+    Reading r;
+    if (!dev || isDuplicate(*dev, f.data, f.len)) continue;
+    dedupAccept(*dev, f.data, f.len);
+    if (!decryptFrame(*dev, f.data, f.len, plain)) continue;
+    if (!toReading(f.data[VMFR_RECORD], plain, r)) continue;
+    r.dev = dev - table.dev;
+    r.ms  = f.ms;
+    bool bm = f.data[VMFR_RECORD] == VREC_BATTERY_MONITOR;
+    VOutlier &o = filt[r.dev];
+    if (!o.readings) o.cfg = bm ? &bmCfg : &scCfg;
+    readings.push_back(r);
+    uint8_t duds = outlierCheck(o, r.ms, r.v, r.valid);
+    int dudvals = popcount(duds) + !r.auxOk;
+    Tally &t = tally[r.dev];
+    t.readings++;
+    if (truth.empty()) {                                    // a real capture: show what is flagged
+      if (!dudvals) continue;
+      flagged++;
+      printf("%10.3f s  %-20s", f.ms / 1000.0, dev->name);
+      if (!r.auxOk) printf("  aux mode");
+      for (int i = 0; i < o.cfg->fields; i++) {
+        if (!((duds >> i) & 1)) continue;
+        int32_t med, spread;
+        printf("  %s %d", o.cfg->f[i].label, r.v[i]);
+        if (outlierBand(o, i, med, spread)) printf(" (median %d, spread %d)", med, spread);
+        else                                printf(" (limits)");
+      }
+      printf("\n");
+      continue;
+    }
+    // -- simulated: against what was sent
+    const Truth &tr = truth[frame];
+    Reading sent;
+    toReading(f.data[VMFR_RECORD], tr.plain, sent);
+    if (tr.step) sinceStep[r.dev] = 0;
+    else         sinceStep[r.dev]++;
+    int staticVals = staticDuds(bm, r);
+    if (!memcmp(plain, tr.plain, 16)) {
+      t.clean++;
+      if (dudvals && sinceStep[r.dev] < o.cfg->confirm - 1) t.held++;
+      else if (dudvals)                                     t.falsePos++;
+      if (staticVals) t.staticFalse++;
+      continue;
+    }
+    t.corrupt++;
+    bool gross = !r.auxOk;
+    for (int i = 0; i < o.cfg->fields; i++)
+      if ((r.valid & sent.valid) >> i & 1 && llabs(static_cast<int64_t>(r.v[i]) - sent.v[i]) > GROSS_FLOORS * o.cfg->f[i].floor) gross = true;
+    if (!gross) continue;
+    t.gross++;
+    if (dudvals)    t.caught++;
+    if (staticVals) t.staticCaught++;
+  }
+  if (readings.empty()) { fprintf(stderr, "** no Battery Monitor or Solar Controller readings\n"); return 1; }
+
+  bool ok = true;
+  if (truth.empty())
+    printf("\n%zu readings, %llu flagged (%.3f%%)\n", readings.size(), static_cast<unsigned long long>(flagged), 100.0 * flagged / readings.size());
+  else {
+    printf("\n%-14s %9s %8s %9s %6s %8s %9s   %9s %9s\n", "", "readings", "corrupt", "false pos", "held", "gross", "caught", "fixed: fp", "caught");
+    Tally all = {};
+    for (int d = 0; d < table.count; d++) {
+      const Tally &t = tally[d];
+      report(table.dev[d].name, t);
+      all.readings += t.readings; all.clean += t.clean; all.falsePos += t.falsePos; all.held += t.held;
+      all.corrupt += t.corrupt; all.gross += t.gross; all.caught += t.caught;
+      all.staticFalse += t.staticFalse; all.staticCaught += t.staticCaught;
+    }
+    report("all", all);
+    uint32_t steps = 0;
+    for (int d = 0; d < table.count; d++) steps += filt[d].steps;
+    printf("%-14s %u steps followed, k = %u, confirm = %u\n", "", steps, bmCfg.k, bmCfg.confirm);
+    if (100.0 * all.falsePos > MAX_FALSE_PCT * all.clean) { printf("**FAIL** false positives over %.1f%%\n", MAX_FALSE_PCT); ok = false; }
+    if (100.0 * all.caught < MIN_CAUGHT_PCT * all.gross)  { printf("**FAIL** caught under %d%% of gross corruptions\n", MIN_CAUGHT_PCT); ok = false; }
+  }
+
+  // -- cost: the readings again, through fresh filters
+  int rounds = static_cast<int>(2000000 / readings.size()) + 1;
+  volatile uint8_t sink = 0;
+  uint64_t t0 = nowNs();
+  for (int r = 0; r < rounds; r++) {
+    for (int d = 0; d < table.count; d++) { const VOutlierCfg *c = filt[d].cfg; initOutlier(filt[d], c); }
+    for (const Reading &x : readings) sink ^= outlierCheck(filt[x.dev], x.ms, x.v, x.valid);
+  }
+  reportRate("outlierCheck", static_cast<uint64_t>(rounds) * readings.size(), nowNs() - t0);
+  printf("%-20s %zu bytes per device\n", "", sizeof(VOutlier));
+  if (!ok) return 1;
+  if (!truth.empty()) printf("false positives under %.1f%%, %d%% or more of gross corruptions caught: ok\n", MAX_FALSE_PCT, MIN_CAUGHT_PCT);
+  return 0;
+}
@@ -0,0 +1,247 @@
+/* Pipeline benchmark - runs on Linux, no ESP32 needed
+
+Runs the sketches' two stage pipeline (VictronCore/VPipeline.h), each task a
+std::thread started by startTask():
+  radio   this thread, as the BLE callback: adverts from many targets, each update
+          sent 3 times. isDuplicate() drops the repeats, ringPush() queues the rest
+          in rxRing. It never waits on the other stages
+  intake  on VPIPE_INTAKE_CORE, as intakeTask(): intakeStep() passes the frames on
+          to frameRing in batches, schedUpdate() runs the scan windows
+  work    on VPIPE_WORK_CORE, as loop(): pops the batches, decryptFrame(),
+          decodeRecord(), formatRecord() and writes the line out
+First flat out, with output that costs nothing (only here does the radio wait for
+room in rxRing, to measure what the pipeline sustains), checking each frame is
+decrypted to the data sent. Then at a steady advert rate, with the output a 115200
+baud Serial that blocks while each line goes out: checks that the intake task never
+stalls, and that the excess is dropped and counted at rxRing, not at frameRing, where
+the callback had already kept it for isDuplicate(): an update whose frame was dropped
+must still come through from a later repeat, and every update queued be printed. The
+same run with both stages in one task, as before the pipeline, is printed to compare.
+
+usage: bench_pipeline [-n frames] [-d devices] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define REPEATS      3                // adverts per update
+#define SERIAL_BPS   11520            // 115200 baud, bytes/sec
+#define ADVERT_RATE  1000             // adverts/sec, paced runs: 3x what 32 devices send
+#define MAX_STALL_MS 50               // intake task, paced runs
+
+static VDeviceTable table;
+static VRing        rxRing, frameRing;
+static VIntake      intake;
+static VScheduler   sched;
+
+static bool              flatOut, slowSerial, oneTask;
+static std::atomic<bool> radioDone, intakeDone;
+static std::atomic<int>  running;
+static uint64_t          t0Ns;
+static uint64_t          decoded, wrong;                 // work task only
+static uint64_t          maxStallNs;                     // intake task only
+static int                devices, ivs;                 // updates: device x IV
+static std::vector<uint8_t> queued, printed;             // per update, radio / work task only
+
+enum : uint8_t { QUEUED = 1, DROPPED = 2 };
+
+static size_t update(const VFrame &f){
+  return static_cast<size_t>(f.mac & 0xFF) * ivs + (f.data[VMFR_IV] | (f.data[VMFR_IV + 1] << 8));
+}
+
+static uint32_t ms(){ return static_cast<uint32_t>((nowNs() - t0Ns) / 1000000); }
+
+// same data for the repeats of an update
+static void plaintext(int d, uint16_t iv, uint8_t p[16]){
+  uint32_t h = (iv + 1u) * 2654435761u ^ d * 40503u;
+  for (int j = 0; j < 16; j++) { h = h * 1664525u + 1013904223u; p[j] = h >> 24; }
+}
+
+static void sleepNs(uint64_t ns){
+  timespec ts = {static_cast<time_t>(ns / 1000000000ull), static_cast<long>(ns % 1000000000ull)};
+  nanosleep(&ts, nullptr);
+}
+
+// loop()'s work on one frame
+static void process(const VFrame &f){
+  VDevice *d = findDevice(table, f.mac);
+  uint8_t out[16], p[16];
+  if (!d || !decryptFrame(*d, f.data, f.len, out)) { wrong++; return; }
+  plaintext(d - table.dev, f.data[VMFR_IV] | (f.data[VMFR_IV + 1] << 8), p);
+  if (memcmp(out, p, 16)) { wrong++; return; }
+  VRecord r;
+  VLine   line;
+  lineClear(line);
+  lineStr(line, d->name);
+  lineStr(line, ": ");
+  if (decodeRecord(f.data[VMFR_RECORD], out, r)) formatRecord(line, r);
+  if (slowSerial) sleepNs((line.len + 1) * 1000000000ull / SERIAL_BPS);   // Serial.write() blocks while it goes out
+  printed[update(f)] = 1;
+  decoded++;
+}
+
+static int workStep(){
+  VFrame batch[VRING_SIZE];
+  int n = ringPop(frameRing, batch, VRING_SIZE);
+  for (int i = 0; i < n; i++) process(batch[i]);
+  if (n) precomputeKeystreams(table, VDEV_MAX);
+  return n;
+}
+
+static void intakeTask(void *){
+  uint64_t last = nowNs();
+  for (;;) {
+    bool done = radioDone.load(std::memory_order_acquire);
+    int n = intakeStep(intake);
+    schedUpdate(sched, ms());
+    if (oneTask) workStep();                            // the stall this is about
+    uint64_t now = nowNs();
+    maxStallNs = std::max(maxStallNs, now - last);
+    last = now;
+    if (done && !n && !ringCount(rxRing)) break;
+    taskSleep(flatOut ? 0 : 1);
+  }
+  intakeDone.store(true, std::memory_order_release);
+  running--;
+}
+
+static void workTask(void *){
+  for (;;) {
+    bool done = intakeDone.load(std::memory_order_acquire);
+    if (workStep()) continue;
+    if (done && !ringCount(frameRing)) break;
+    taskSleep(flatOut ? 0 : 1);
+  }
+  running--;
+}
+
+struct Result {
+  uint64_t adverts, frames, ns;
+  uint64_t maxCallbackNs;
+  uint64_t recovered;                                   // updates dropped at rxRing, then queued from a repeat
+  uint64_t unprinted;                                   // updates queued but never printed
+};
+
+static Result run(const std::vector<VFrame> &air){
+  initDevices(table);
+  for (int d = 0; d < VDEV_MAX; d++) {
+    uint8_t key[16];
+    for (int j = 0; j < 16; j++) key[j] = static_cast<uint8_t>(d * 31 + j * 7 + 1);
+    addDevice(table, 0xc0ffee000000ull + d, key, "dev");
+  }
+  initRing(rxRing);
+  initRing(frameRing);
+  initScheduler(sched, VDEV_MAX, 0);
+  initIntake(intake, rxRing, frameRing, table, &sched);
+  radioDone = intakeDone = false;
+  decoded = wrong = maxStallNs = 0;
+  queued.assign(static_cast<size_t>(devices) * ivs, 0);
+  printed.assign(queued.size(), 0);
+  t0Ns = nowNs();
+  running = oneTask ? 1 : 2;
+  startTask(intakeTask, nullptr, "intake", VPIPE_INTAKE_CORE);
+  if (!oneTask) startTask(workTask, nullptr, "work", VPIPE_WORK_CORE);
+
+  Result r = {};
+  uint64_t period = 1000000000ull / ADVERT_RATE;
+  for (size_t i = 0; i < air.size(); i++) {              // -- radio
+    const VFrame &f = air[i];
+    if (!flatOut) { uint64_t at = t0Ns + i * period, now = nowNs(); if (at > now) sleepNs(at - now); }
+    else while (ringCount(rxRing) >= VRING_SIZE) std::this_thread::yield();
+    uint64_t c0 = nowNs();
+    VDevice *dev = findDevice(table, f.mac);
+    if (dev && !isDuplicate(*dev, f.data, f.len)) {
+      uint8_t &q = queued[update(f)];
+      if (ringPush(rxRing, f.mac, f.rssi, ms(), f.data, f.len)) {
+        dedupAccept(*dev, f.data, f.len);
+        if (q == DROPPED) r.recovered++;
+        q |= QUEUED;
+      }
+      else q |= DROPPED;
+      r.frames++;
+    }
+    r.maxCallbackNs = std::max(r.maxCallbackNs, nowNs() - c0);
+    r.adverts++;
+  }
+  radioDone.store(true, std::memory_order_release);
+  while (running.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  r.ns = nowNs() - t0Ns;
+  for (size_t u = 0; u < queued.size(); u++) r.unprinted += (queued[u] & QUEUED) && !printed[u];
+  return r;
+}
+
+int main(int argc, char **argv){
+  uint64_t frames = 100000;
+  devices = VDEV_MAX;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-d") && i + 1 < argc) devices = atoi(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-n frames] [-d devices]\n", argv[0]); return 2; }
+  }
+  if (devices < 1 || devices > VDEV_MAX) devices = VDEV_MAX;
+
+  // the air: device d, update u sent REPEATS times in a row, devices interleaved
+  std::vector<VFrame> air(frames * REPEATS);
+  ivs = static_cast<int>(frames / devices) + 1;
+  for (size_t i = 0; i < air.size(); i++) {
+    int d = i % devices;
+    uint16_t iv = static_cast<uint16_t>(i / devices / REPEATS);
+    VFrame &f = air[i];
+    uint8_t key[16], p[16], ks[16];
+    for (int j = 0; j < 16; j++) key[j] = static_cast<uint8_t>(d * 31 + j * 7 + 1);
+    f.mac  = 0xc0ffee000000ull + d;
+    f.ms   = 0;
+    f.rssi = -70;
+    f.len  = VMFR_MAX;
+    const uint8_t hdr[VMFR_RECORD + 1] = {0xE1, 0x02, 0x10, 0xA3, 0x02, 0x00, 0x02};
+    memcpy(f.data, hdr, sizeof(hdr));
+    f.data[VMFR_IV]     = iv & 0xFF;
+    f.data[VMFR_IV + 1] = iv >> 8;
+    f.data[VMFR_KEY0]   = key[0];
+    static VAesKey k;
+    aesSetKey(k, key);
+    aesKeystream(k, iv, ks);
+    aesFreeKey(k);
+    plaintext(d, iv, p);
+    for (int j = 0; j < 16; j++) f.data[VMFR_CIPHER + j] = p[j] ^ ks[j];
+  }
+  printf("%d devices, %d adverts per update, %d core(s)\n", devices, REPEATS, static_cast<int>(std::thread::hardware_concurrency()));
+  bool ok = true;
+
+  flatOut = true; slowSerial = false; oneTask = false;
+  Result r = run(air);
+  reportRate("pipeline, flat out", r.frames, r.ns);
+  printf("%-20s %u batches, %.1f frames/batch (max %u), %llu wrong\n", "", intake.batches,
+         intake.batches ? static_cast<double>(intake.frames) / intake.batches : 0, intake.maxBatch, static_cast<unsigned long long>(wrong));
+  if (decoded != r.frames || wrong || rxRing.dropped || frameRing.dropped || r.unprinted) { printf("**FAIL** frames lost or wrong flat out\n"); ok = false; }
+
+  // 2 secs of adverts at ADVERT_RATE, far more lines than the Serial can take
+  std::vector<VFrame> paced(air.begin(), air.begin() + std::min<size_t>(air.size(), 2 * ADVERT_RATE));
+  flatOut = false; slowSerial = true;
+  for (int one = 0; one < 2; one++) {
+    oneTask = one;
+    r = run(paced);
+    printf("%-20s %llu adverts: %llu frames, %llu printed, dropped %u at rxRing / %u at frameRing, %llu updates from a repeat, "
+           "intake stalled %.1f ms max, callback %.1f us max\n",
+           one ? "one task" : "pipeline, Serial", static_cast<unsigned long long>(r.adverts), static_cast<unsigned long long>(r.frames),
+           static_cast<unsigned long long>(decoded), rxRing.dropped, frameRing.dropped, static_cast<unsigned long long>(r.recovered),
+           maxStallNs / 1e6, r.maxCallbackNs / 1e3);
+    if (one) break;
+    if (!rxRing.dropped)                          { printf("**FAIL** Serial kept up, nothing tested\n"); ok = false; }
+    if (frameRing.dropped)                        { printf("**FAIL** dropped at frameRing, after the callback kept them as seen\n"); ok = false; }
+    if (!r.recovered || r.unprinted)              { printf("**FAIL** %llu updates queued never printed, %llu from a repeat after a drop\n",
+                                                           static_cast<unsigned long long>(r.unprinted), static_cast<unsigned long long>(r.recovered)); ok = false; }
+    if (decoded + frameRing.dropped != intake.frames || intake.frames + rxRing.dropped != r.frames || wrong) { printf("**FAIL** frames not accounted for\n"); ok = false; }
+    if (maxStallNs > MAX_STALL_MS * 1000000ull)   { printf("**FAIL** intake task stalled over %d ms\n", MAX_STALL_MS); ok = false; }
+  }
+  if (!ok) return 1;
+  printf("radio & intake never waited on the Serial, every update queued printed: ok\n");
+  return 0;
+}
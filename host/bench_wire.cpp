@@ -0,0 +1,277 @@
+/* Binary output benchmark - runs on Linux, no ESP32 needed
+
+First checks the binary records (VictronCore/VWire.h):
+- CRC-16 against the standard check value
+- COBS round trips of random buffers, 0 to 600 bytes, from no zeros to all zeros
+- random Battery Monitor, Solar Controller, record and device records through the stream
+  decoder, every field back as sent
+- every bit of a record flipped, one at a time, never gives a record, and the next
+  record is still read (the one after, if the bit was in the closing 0); text between
+  records and a stream starting mid record are skipped
+Then times building a record against the report line (formatBM() / formatSC()) and
+decoding a stream, and prints the bytes per reading and the readings/sec a UART carries
+at -b baud (8N1, 10 bits a byte) as text and as records. Fails unless the records carry
+3 times the readings or more. Writes the stream to build/synthetic.wire (host/wiredump).
+
+usage: bench_wire [-n records] [-b baud] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+
+// any value each field can hold
+static void randomBM(BatteryMonitorReading &r){
+  r.valid     = xorshift() & 0x3F;
+  r.aux       = xorshift() & 3;
+  r.battV     = static_cast<int16_t>(xorshift());
+  r.auxVal    = static_cast<int32_t>(xorshift() % 131072) - 65536;
+  r.battA     = static_cast<int32_t>(xorshift() % 4194304) - 2097152;
+  r.usedAh    = xorshift() & 0xFFFFF;
+  r.soc       = xorshift() & 0x3FF;
+  r.ttgMin    = xorshift();
+  r.alarmBits = xorshift();
+}
+
+static void randomSC(SolarChargerReading &r){
+  r.valid     = xorshift() & 0x1F;
+  r.battV     = static_cast<int16_t>(xorshift());
+  r.battA     = static_cast<int16_t>(xorshift());
+  r.yield10Wh = xorshift();
+  r.pvW       = xorshift();
+  r.loadA     = xorshift() & 0x1FF;
+  r.state     = xorshift();
+  r.error     = xorshift();
+}
+
+// as a 24 V site reads: what the report line is for
+static void siteBM(BatteryMonitorReading &r, int i){
+  r.valid     = BM_TTG | BM_BATTV | BM_AUX | BM_BATTA | BM_AH | BM_SOC;
+  r.aux       = 1;
+  r.battV     = 2600 + i % 50;
+  r.auxVal    = 1300 + i % 20;
+  r.battA     = -6000 - static_cast<int32_t>(xorshift() % 3000);
+  r.usedAh    = 120 + i / 100;
+  r.soc       = 900 - i / 1000 % 100;
+  r.ttgMin    = 1200;
+  r.alarmBits = 0;
+}
+
+static void siteSC(SolarChargerReading &r, int i){
+  r.valid     = SC_BATTV | SC_BATTA | SC_KWH | SC_PVW | SC_LOADA;
+  r.battV     = 2650 + i % 40;
+  r.battA     = 80 + i % 30;
+  r.yield10Wh = 120 + i / 500;
+  r.pvW       = 250 + xorshift() % 200;
+  r.loadA     = 30;
+  r.state     = 3;
+  r.error     = 0;
+}
+
+static bool sameBM(const BatteryMonitorReading &a, const BatteryMonitorReading &b){
+  return a.valid == b.valid && a.aux == b.aux && a.battV == b.battV && a.auxVal == b.auxVal && a.battA == b.battA
+      && a.usedAh == b.usedAh && a.soc == b.soc && a.ttgMin == b.ttgMin && a.alarmBits == b.alarmBits;
+}
+
+static bool sameSC(const SolarChargerReading &a, const SolarChargerReading &b){
+  return a.valid == b.valid && a.battV == b.battV && a.battA == b.battA && a.yield10Wh == b.yield10Wh
+      && a.pvW == b.pvW && a.loadA == b.loadA && a.state == b.state && a.error == b.error;
+}
+
+// feed n bytes, the records read in out
+static int feed(VWireDecoder &d, const uint8_t *p, size_t n, std::vector<VWireRecord> &out){
+  VWireRecord r;
+  int got = 0;
+  for (size_t i = 0; i < n; i++)
+    if (wirePut(d, p[i], r)) {out.push_back(r); got++;}
+  return got;
+}
+
+static bool checks(){
+  const uint8_t check[] = "123456789";
+  if (crc16(check, 9) != 0x29B1) { printf("**FAIL** CRC-16 check value\n"); return false; }
+  // -- COBS
+  static uint8_t in[600], enc[700], dec[600];
+  for (int trial = 0; trial < 20000; trial++) {
+    size_t n = xorshift() % sizeof(in);
+    uint32_t zeros = trial % 5;                               // none, 1 in 256, 1 in 16, half, all
+    for (size_t i = 0; i < n; i++) {
+      uint32_t x = xorshift();
+      in[i] = zeros == 0 ? 1 + x % 255 : zeros == 1 ? x : zeros == 2 ? (x & 15 ? 1 + x % 255 : 0) : zeros == 3 ? (x & 1) * (x >> 8) : 0;
+    }
+    size_t e = cobsEncode(in, n, enc);
+    if (e > n + 1 + n / 254 || memchr(enc, 0, e)) { printf("**FAIL** COBS: %zu bytes coded to %zu, or with a 0\n", n, e); return false; }
+    if (cobsDecode(enc, e, dec, sizeof(dec)) != n || memcmp(in, dec, n)) { printf("**FAIL** COBS round trip, %zu bytes\n", n); return false; }
+  }
+  // -- records through the stream decoder
+  VWireDecoder d;
+  initWireDecoder(d);
+  uint8_t f[VWIRE_FRAME_MAX];
+  std::vector<VWireRecord> got;
+  uint32_t ms = 0;
+  for (int trial = 0; trial < 100000; trial++) {
+    uint8_t  dev = xorshift() % VDEV_MAX, duds = xorshift();
+    ms += xorshift() % 200000;                                // wraps 24 bits often, 32 bits twice
+    BatteryMonitorReading bm;
+    SolarChargerReading   sc;
+    uint8_t  data[16], type = xorshift();
+    char     name[VWIRE_NAME];
+    size_t   n;
+    int      kind = trial % 4;
+    got.clear();
+    if      (kind == 0) {randomBM(bm); n = wireBM(f, dev, ms, duds, bm);}
+    else if (kind == 1) {randomSC(sc); n = wireSC(f, dev, ms, duds, sc);}
+    else if (kind == 2) {for (uint8_t &b : data) b = xorshift(); n = wireRecord(f, dev, ms, type, data);}
+    else {
+      int len = xorshift() % VWIRE_NAME;
+      for (int i = 0; i < len; i++) name[i] = 'A' + xorshift() % 26;
+      name[len] = 0;
+      n = wireDevice(f, dev, ms, 0xc0ffee000000ull | (xorshift() & 0xFFFFFF), name);
+    }
+    if (n > VWIRE_FRAME_MAX || f[n - 1] || memchr(f, 0, n - 1)) { printf("**FAIL** frame of %zu bytes\n", n); return false; }
+    if (feed(d, f, n, got) != 1) { printf("**FAIL** record kind %d not read back\n", kind); return false; }
+    const VWireRecord &r = got[0];
+    bool ok = r.dev == dev && r.ms == ms;
+    if      (kind == 0) ok = ok && r.kind == VWIRE_BM && r.duds == duds && sameBM(r.bm, bm);
+    else if (kind == 1) ok = ok && r.kind == VWIRE_SC && r.duds == duds && sameSC(r.sc, sc);
+    else if (kind == 2) ok = ok && r.kind == VWIRE_RECORD && r.type == type && !memcmp(r.data, data, 16);
+    else                ok = ok && r.kind == VWIRE_DEVICE && !strcmp(r.name, name);
+    if (!ok) { printf("**FAIL** record kind %d read back wrong\n", kind); return false; }
+  }
+  // -- every bit flipped, then a good record
+  BatteryMonitorReading bm;
+  randomBM(bm);
+  uint8_t good[VWIRE_FRAME_MAX];
+  size_t gn = wireSC(good, 7, 1234, 0, SolarChargerReading{});
+  for (int trial = 0; trial < 200; trial++) {
+    randomBM(bm);
+    size_t n = wireBM(f, trial % VDEV_MAX, xorshift(), 0, bm);
+    for (size_t i = 0; i < n; i++)
+      for (int bit = 0; bit < 8; bit++) {
+        std::vector<uint8_t> s(f, f + n);
+        s[i] ^= 1 << bit;
+        s.insert(s.end(), good, good + gn);
+        s.insert(s.end(), good, good + gn);
+        got.clear();
+        feed(d, s.data(), s.size(), got);
+        bool ok = got.size() == (i < n - 1 ? 2u : 1u);          // the 0 at the end: the next record goes with it
+        for (const VWireRecord &r : got) ok = ok && r.kind == VWIRE_SC && r.dev == 7;
+        if (!ok) {
+          printf("**FAIL** bit %d of byte %zu flipped: %zu records read\n", bit, i, got.size());
+          return false;
+        }
+      }
+  }
+  // -- text before, a record cut short (a reader starting mid stream)
+  initWireDecoder(d);
+  std::vector<uint8_t> s;
+  const char *text = "\nBINARY - ON, COBS framed records from here: enter B to end\n";
+  s.insert(s.end(), text, text + strlen(text));
+  s.push_back(0);
+  size_t n = wireBM(f, 1, 1, 0, bm);
+  s.insert(s.end(), f + n / 2, f + n);
+  s.insert(s.end(), good, good + gn);
+  got.clear();
+  if (feed(d, s.data(), s.size(), got) != 1 || d.text != 1 || d.bad != 1) {
+    printf("**FAIL** text / cut record: %zu records, %u text, %u bad\n", got.size(), d.text, d.bad);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  int  records = 1000000;
+  long baud    = 115200;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i + 1 < argc) records = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc) baud = atol(argv[++i]);
+    else { fprintf(stderr, "usage: %s [-n records] [-b baud]\n", argv[0]); return 2; }
+  }
+  if (records < 2) records = 2;
+  if (baud < 300) baud = 300;
+  if (!checks()) return 1;
+  printf("CRC, COBS, round trips, flipped bits, text & cut records: ok\n");
+
+  // -- site readings, BM & SC in turn, as records and as report lines
+  std::vector<BatteryMonitorReading> bms(records / 2);
+  std::vector<SolarChargerReading>   scs(records / 2);
+  for (int i = 0; i < records / 2; i++) {siteBM(bms[i], i); siteSC(scs[i], i);}
+  std::vector<uint8_t> stream;
+  stream.reserve(static_cast<size_t>(records) * VWIRE_FRAME_MAX + 1024);
+  uint8_t f[VWIRE_FRAME_MAX];
+  const char *names[2] = {"My_SmartShunt_1", "My_Solar_Controller"};
+  for (int dev = 0; dev < 2; dev++) {
+    size_t n = wireDevice(f, dev, 0, 0xffffffffffffull - dev, names[dev]);
+    stream.insert(stream.end(), f, f + n);
+  }
+  size_t start = stream.size();
+  uint64_t t0 = nowNs();
+  for (int i = 0; i < records / 2; i++) {
+    size_t n = wireBM(f, 0, 200 * i, 0, bms[i]);
+    stream.insert(stream.end(), f, f + n);
+    n = wireSC(f, 1, 200 * i + 100, 0, scs[i]);
+    stream.insert(stream.end(), f, f + n);
+  }
+  uint64_t t1 = nowNs();
+  size_t wireBytes = stream.size() - start;
+
+  // the line reportBMvalues() / reportSCvalues() writes: loop count, tab, values, the name (more than one target), newline
+  VLine l;
+  uint64_t textBytes = 0;
+  uint64_t t2 = nowNs();
+  for (int i = 0; i < records / 2; i++) {
+    lineClear(l);
+    lineStr(l, "042\t");
+    formatBM(l, bms[i]);
+    lineStr(l, "  ");
+    lineStr(l, names[0]);
+    lineChar(l, '\n');
+    textBytes += l.len;
+    lineClear(l);
+    lineStr(l, "043\t");
+    formatSC(l, scs[i], true);
+    lineStr(l, "  ");
+    lineStr(l, names[1]);
+    lineChar(l, '\n');
+    textBytes += l.len;
+  }
+  uint64_t t3 = nowNs();
+
+  VWireDecoder d;
+  initWireDecoder(d);
+  VWireRecord r;
+  uint32_t bmRead = 0, scRead = 0;
+  uint64_t t4 = nowNs();
+  for (uint8_t b : stream)
+    if (wirePut(d, b, r)) {
+      if      (r.kind == VWIRE_BM) bmRead += sameBM(r.bm, bms[r.ms / 200]);
+      else if (r.kind == VWIRE_SC) scRead += sameSC(r.sc, scs[r.ms / 200]);
+    }
+  uint64_t t5 = nowNs();
+  if (bmRead + scRead != static_cast<uint32_t>(records / 2 * 2) || d.bad) {
+    printf("**FAIL** stream: %u + %u readings read back of %d, %u bad frames\n", bmRead, scRead, records / 2 * 2, d.bad);
+    return 1;
+  }
+  FILE *out = fopen("build/synthetic.wire", "wb");
+  if (!out || fwrite(stream.data(), 1, stream.size(), out) != stream.size()) printf("** cannot write build/synthetic.wire\n");
+  if (out) fclose(out);
+
+  int readings = records / 2 * 2;
+  reportRate("record (build)",  readings, t1 - t0);
+  reportRate("line (format)",   readings, t3 - t2);
+  reportRate("record (decode)", readings, t5 - t4);
+  double wirePer = static_cast<double>(wireBytes) / readings, textPer = static_cast<double>(textBytes) / readings;
+  double bytesSec = baud / 10.0;
+  printf("\n%ld baud (%.0f bytes/sec)      bytes/reading   readings/sec\n", baud, bytesSec);
+  printf("  report lines                 %6.1f        %9.0f\n", textPer, bytesSec / textPer);
+  printf("  binary records               %6.1f        %9.0f   (%.1fx)\n", wirePer, bytesSec / wirePer, textPer / wirePer);
+  printf("  targets at 2 readings/sec    %6.0f lines, %4.0f records\n", bytesSec / textPer / 2, bytesSec / wirePer / 2);
+  if (textPer / wirePer < 3) { printf("**FAIL** records carry under 3x the readings\n"); return 1; }
+  return 0;
+}
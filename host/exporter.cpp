@@ -0,0 +1,343 @@
+/* Metrics exporter - a Linux daemon, no ESP32 needed
+
+Reads the binary output of one or more receivers ("B", see VictronCore/VWire.h) from
+serial ports, pipes or files ("-" for stdin), keeps the last reading of every device
+(VictronCore/VMetrics.h) and serves them on http://127.0.0.1:port/metrics in the
+Prometheus text format. A serial port must be raw first, e.g.
+  stty -F /dev/ttyUSB0 115200 raw && exporter /dev/ttyUSB0 /dev/ttyUSB1
+One thread: poll() on the streams, the listening socket and the connections, every
+socket non-blocking, so a slow or idle scraper never holds up the streams (a tty buffer
+fills in well under a second at 115200 baud). A connection's request is read as it
+comes, then the response written as the socket takes it, up to CLIENTS at once; one
+not done within CLIENT_MS is closed. A scrape is rendered into a buffer sized for
+every device (VMET_RENDER_MAX), allocated once: the scrapes being written at the time
+share a render, a new one is made once none is. Then the connection is closed. A
+stream that ends (a file read to the end, a pipe closed) is dropped, its devices kept.
+Only localhost is listened on.
+
+Tested with recorded streams, no radio:
+-o reads the streams to the end, prints the exposition once and exits.
+-t scrapes reads the streams to the end, then serves on a free port while a second
+   thread scrapes it that many times over TCP, checking every response is whole and
+   the same as a render, with a third connection open and idle all the while: no
+   scrape may wait on it (MAX_SCRAPE_MS). Prints scrapes/sec and the render time.
+-c fails (exit 1) if a stream had a bad record or there were no readings.
+
+usage: exporter [-l port] [-o] [-t scrapes] [-c] stream... */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#define CLIENTS        64           // connections served at once
+#define CLIENT_MS      2000         // a connection not done by then is closed
+#define MAX_SCRAPE_MS  250          // -t: longest a scrape may take
+
+static VMetrics metrics;
+static char     body[VMET_RENDER_MAX];                       // one render, shared by the scrapes being written
+static size_t   bodyLen = 0;
+static int      bodyUsers = 0;                               // connections writing it: no new render till 0
+static uint64_t scrapes = 0, renderNs = 0;
+
+// wall clock in ms, for the last reading times
+static uint64_t nowMs(){
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+// -- streams --------------------------------------------------------------------------------
+
+// a chunk from stream src: false once it has ended
+static bool readStream(int fd, int src){
+  uint8_t chunk[4096];
+  ssize_t n = read(fd, chunk, sizeof(chunk));
+  if (n < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+  if (n <= 0) return false;
+  uint64_t ms = nowMs();                                    // one clock read per chunk
+  for (ssize_t i = 0; i < n; i++) metricsPut(metrics, src, chunk[i], ms);
+  return true;
+}
+
+// -- http -----------------------------------------------------------------------------------
+
+static int listenOn(int port){
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s < 0) return -1;
+  int on = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in a = {};
+  a.sin_family      = AF_INET;
+  a.sin_port        = htons(port);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(s, reinterpret_cast<sockaddr *>(&a), sizeof(a)) || listen(s, 64)) { close(s); return -1; }
+  return s;
+}
+
+static int boundPort(int s){
+  sockaddr_in a = {};
+  socklen_t len = sizeof(a);
+  getsockname(s, reinterpret_cast<sockaddr *>(&a), &len);
+  return ntohs(a.sin_port);
+}
+
+// a connection, from accept to close: the request read, then the head and body written
+struct Client {
+  int         fd;                                           // -1 free
+  uint64_t    since;                                        // accepted, ms
+  size_t      n;                                            // request bytes read, then head bytes written
+  bool        writing;
+  bool        hasBody;                                      // writing body[] after the head
+  size_t      headLen, sent;                                // sent: body bytes written
+  char        req[2048];
+  char        head[160];
+};
+
+static Client clients[CLIENTS];
+
+static void closeClient(Client &c){
+  if (c.hasBody) bodyUsers--;
+  close(c.fd);
+  c.fd = -1;
+}
+
+// every connection waiting on the listener, while there are free slots
+static void acceptClients(int listener){
+  for (Client &c : clients) {
+    if (c.fd >= 0) continue;
+    int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+    if (fd < 0) return;                                     // none left (EAGAIN) or an error: poll() again
+    c = {};
+    c.fd    = fd;
+    c.since = nowMs();
+  }
+}
+
+// the request as far as it has come; once whole (or the client has sent all it will), the response
+// made: the metrics, rendered now unless another scrape is still writing the last render, or a 404
+static void clientRead(Client &c){
+  for (;;) {
+    ssize_t r = read(c.fd, c.req + c.n, sizeof(c.req) - 1 - c.n);
+    if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+      if (errno == EAGAIN) return;
+      continue;
+    }
+    if (r < 0) { closeClient(c); return; }
+    c.n += r;
+    c.req[c.n] = 0;
+    if (!r || c.n == sizeof(c.req) - 1 || strstr(c.req, "\r\n\r\n") || strstr(c.req, "\n\n")) break;   // to the end of the headers
+  }
+  if (!strncmp(c.req, "GET /metrics ", 13) || !strncmp(c.req, "GET / ", 6)) {
+    if (!bodyUsers) {
+      uint64_t t0 = nowNs();
+      bodyLen = renderMetrics(metrics, body, sizeof(body));
+      renderNs += nowNs() - t0;
+    }
+    scrapes++;
+    bodyUsers++;
+    c.hasBody = true;
+    c.headLen = snprintf(c.head, sizeof(c.head), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                                 "Content-Length: %zu\r\nConnection: close\r\n\r\n", bodyLen);
+  }
+  else c.headLen = snprintf(c.head, sizeof(c.head), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+  c.writing = true;
+  c.n       = 0;
+}
+
+// as much of the response as the socket takes, closed when it is all out
+static void clientWrite(Client &c){
+  for (;;) {
+    bool inHead = c.n < c.headLen;
+    if (!inHead && (!c.hasBody || c.sent == bodyLen)) { closeClient(c); return; }
+    ssize_t w = inHead ? write(c.fd, c.head + c.n, c.headLen - c.n) : write(c.fd, body + c.sent, bodyLen - c.sent);
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0 && errno == EAGAIN) return;
+    if (w <= 0) { closeClient(c); return; }
+    if (inHead) c.n += w; else c.sent += w;
+  }
+}
+
+// -- self test (-t) -------------------------------------------------------------------------
+
+static char got[VMET_RENDER_MAX + 256];
+
+static bool writeAll(int fd, const char *p, size_t n){
+  while (n) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) return false;
+    p += w;
+    n -= w;
+  }
+  return true;
+}
+
+static int connectTo(int port){
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in a = {};
+  a.sin_family      = AF_INET;
+  a.sin_port        = htons(port);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (s >= 0 && connect(s, reinterpret_cast<sockaddr *>(&a), sizeof(a))) { close(s); return -1; }
+  return s;
+}
+
+// one scrape of port: false unless a whole 200 response with the body expected
+static bool scrape(int port, const char *expect, size_t expectLen){
+  int s = connectTo(port);
+  if (s < 0) return false;
+  const char req[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  bool ok = writeAll(s, req, sizeof(req) - 1);
+  size_t n = 0;
+  ssize_t r;
+  while (ok && n < sizeof(got) - 1 && (r = read(s, got + n, sizeof(got) - 1 - n)) > 0) n += r;
+  close(s);
+  got[n] = 0;
+  const char *cl = strstr(got, "Content-Length: ");
+  const char *b  = strstr(got, "\r\n\r\n");
+  if (!ok || strncmp(got, "HTTP/1.1 200 ", 13) || !cl || !b) return false;
+  b += 4;
+  size_t len = strtoul(cl + 16, nullptr, 10);
+  return len == expectLen && static_cast<size_t>(got + n - b) == len && !memcmp(b, expect, len);
+}
+
+int main(int argc, char **argv){
+  int port = 9480, tests = 0;
+  bool once = false, check = false;
+  const char *files[VMET_SOURCES];
+  int nfiles = 0;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-l") && i + 1 < argc) port = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i + 1 < argc) tests = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-o")) once = true;
+    else if (!strcmp(argv[i], "-c")) check = true;
+    else if ((argv[i][0] != '-' || !strcmp(argv[i], "-")) && nfiles < VMET_SOURCES) files[nfiles++] = argv[i];
+    else { fprintf(stderr, "usage: %s [-l port] [-o] [-t scrapes] [-c] stream... (up to %d)\n", argv[0], VMET_SOURCES); return 2; }
+  }
+  if (!nfiles) { fprintf(stderr, "** no stream given (- for stdin)\n"); return 2; }
+  signal(SIGPIPE, SIG_IGN);                                 // a scraper gone mid response
+
+  initMetrics(metrics);
+  pollfd fds[VMET_SOURCES + 1];
+  int    srcOf[VMET_SOURCES + 1];
+  int    streams = 0;
+  for (int i = 0; i < nfiles; i++) {
+    int fd = strcmp(files[i], "-") ? open(files[i], O_RDONLY | O_NONBLOCK) : 0;
+    if (fd < 0) { fprintf(stderr, "** cannot read %s\n", files[i]); return 1; }
+    fds[streams]   = {fd, POLLIN, 0};
+    srcOf[streams] = metricsAddSource(metrics, files[i]);
+    streams++;
+  }
+  bool toEnd = once || tests;                               // recorded streams: read them all first
+  uint64_t t0 = nowNs();
+  while (toEnd && streams) {
+    if (poll(fds, streams, -1) < 0 && errno != EINTR) break;
+    for (int i = 0; i < streams; i++) {
+      if (!fds[i].revents) continue;
+      if (readStream(fds[i].fd, srcOf[i])) continue;
+      if (fds[i].fd) close(fds[i].fd);
+      fds[i]   = fds[--streams];                          // ended: dropped
+      srcOf[i] = srcOf[streams];
+      i--;
+    }
+  }
+  uint64_t t1 = nowNs();
+  uint32_t records = 0, bad = 0, readings = 0;
+  for (int i = 0; i < metrics.sources; i++) { records += metrics.src[i].wire.records; bad += metrics.src[i].wire.bad; }
+  for (int i = 0; i < metrics.count; i++) readings += metrics.dev[i].readings;
+
+  if (once) {
+    size_t len = renderMetrics(metrics, body, sizeof(body));
+    fwrite(body, 1, len, stdout);
+  }
+  else {
+    int listener = listenOn(tests ? 0 : port);
+    if (listener < 0) { fprintf(stderr, "** cannot listen on 127.0.0.1:%d\n", port); return 1; }
+    port = boundPort(listener);
+    fprintf(stderr, "* %d streams, serving http://127.0.0.1:%d/metrics\n", nfiles, port);
+    std::atomic<bool> done(false);
+    std::atomic<int>  good(0);
+    uint64_t maxScrapeNs = 0;
+    std::thread client;
+    static char expect[VMET_RENDER_MAX];
+    size_t expectLen = renderMetrics(metrics, expect, sizeof(expect));
+    uint64_t s0 = nowNs();
+    if (tests) client = std::thread([&]{
+      int idle = connectTo(port);                           // half a request, then nothing: must hold up no one
+      if (idle >= 0) writeAll(idle, "GET /met", 8);
+      for (int i = 0; i < tests; i++) {
+        uint64_t c0 = nowNs();
+        good += scrape(port, expect, expectLen);
+        maxScrapeNs = std::max(maxScrapeNs, nowNs() - c0);
+      }
+      if (idle >= 0) close(idle);
+      done = true;
+    });
+    int flags = fcntl(listener, F_GETFL);
+    fcntl(listener, F_SETFL, flags | O_NONBLOCK);
+    for (Client &c : clients) c.fd = -1;
+    pollfd all[VMET_SOURCES + 1 + CLIENTS];
+    Client *of[CLIENTS];
+    while (!done) {
+      int n = streams + 1, open = 0;
+      memcpy(all, fds, streams * sizeof(pollfd));
+      uint64_t now = nowMs();
+      for (Client &c : clients) {
+        if (c.fd < 0) continue;
+        if (now - c.since > CLIENT_MS) { closeClient(c); continue; }  // stalled or idle: let go
+        of[open++] = &c;
+        all[n++]   = {c.fd, static_cast<short>(c.writing ? POLLOUT : POLLIN), 0};
+      }
+      all[streams] = {open < CLIENTS ? listener : -1, POLLIN, 0};    // no free slot: leave them queued
+      if (poll(all, n, open || tests ? 100 : -1) < 0 && errno != EINTR) break;
+      for (int i = 0; i < open; i++) {
+        Client &c = *of[i];
+        short ev = all[streams + 1 + i].revents;
+        if (!ev) continue;
+        if (ev & (POLLERR | POLLNVAL)) closeClient(c);
+        else if (c.writing)            clientWrite(c);
+        else                           clientRead(c);
+      }
+      if (all[streams].revents) acceptClients(listener);
+      for (int i = 0; i < streams; i++) {
+        if (!all[i].revents) continue;
+        if (readStream(fds[i].fd, srcOf[i])) continue;
+        if (fds[i].fd) close(fds[i].fd);
+        fprintf(stderr, "* stream %s ended\n", metrics.src[srcOf[i]].name);
+        fds[i]    = fds[--streams];
+        all[i]    = all[streams];                           // its revents, as fds[i] now holds that stream
+        srcOf[i]  = srcOf[streams];
+        i--;
+      }
+    }
+    uint64_t s1 = nowNs();
+    if (client.joinable()) client.join();
+    for (Client &c : clients) if (c.fd >= 0) closeClient(c);
+    close(listener);
+    if (tests) {
+      printf("%d streams, %d devices: %u records (%u readings) in %.3f s, %u bad\n", nfiles, metrics.count,
+             records, readings, (t1 - t0) / 1e9, bad);
+      printf("%-20s %d scrapes over TCP, %d good, %.0f scrapes/s, render %.1f us for %zu bytes\n", "exporter",
+             tests, good.load(), tests * 1e9 / (s1 - s0), scrapes ? renderNs / 1e3 / scrapes : 0, expectLen);
+      printf("%-20s longest scrape %.1f ms with an idle connection open (max %d)\n", "", maxScrapeNs / 1e6,
+             MAX_SCRAPE_MS);
+      if (good != tests) { printf("**FAIL** a scrape was not whole or not as rendered\n"); return 1; }
+      if (maxScrapeNs > MAX_SCRAPE_MS * 1000000ull) { printf("**FAIL** a scrape waited on the idle connection\n"); return 1; }
+    }
+  }
+  if (check && (bad || !readings)) { fprintf(stderr, "**FAIL** bad records, or no readings\n"); return 1; }
+  return 0;
+}
@@ -0,0 +1,116 @@
+/* Config blob generator - runs on Linux, no ESP32 needed
+
+Writes the site configuration blob the sketches load at boot (see VictronCore/VConfig.h):
+the devices, each as -d address,key[,name] (lower case, key as 32 hex digits, as in
+devices[] of the sketches), and optionally the flags and the dud test settings, which
+otherwise stay as compiled in. The sketches take a blob over Serial: "U", then the blob
+within 2 secs, e.g.
+  stty -F /dev/ttyUSB0 115200 raw && (printf U; cat site.cfg) > /dev/ttyUSB0
+keep it in NVS and restart with it. The host tools load one with -f (replay). -r prints
+a blob back.
+
+  -flags FLV    FILTERING, LOAD_AMPS, VERBOSE on (any of the letters; 0 = all off)
+  -k spreads    dud test k, Battery Monitors & Solar Controllers (0 = hard limits only)
+  -c confirm    outliers in a row that are a genuine step, 2 or more
+  -bm label=min,max[,floor[,maxRate]]   a Battery Monitor field, in record units, e.g. -bm V=1100,1500
+  -sc label=...                         a Solar Controller field (labels as printed by -r)
+
+usage: mkconfig [-d address,key[,name]]... [-flags FLV] [-k spreads] [-c confirm] [-bm ...]... [-sc ...]... -o blob
+       mkconfig -r blob */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool setField(VOutlierCfg &o, const char *arg){
+  const char *eq = strchr(arg, '=');
+  if (!eq) return false;
+  for (int i = 0; i < o.fields; i++) {
+    VOutFieldCfg &f = o.f[i];
+    if (strlen(f.label) != static_cast<size_t>(eq - arg) || strncmp(f.label, arg, eq - arg)) continue;
+    long v[4] = {f.min, f.max, f.floor, f.maxRate};
+    int n = sscanf(eq + 1, "%ld,%ld,%ld,%ld", &v[0], &v[1], &v[2], &v[3]);
+    if (n < 2 || v[0] > v[1]) return false;
+    f.min = v[0]; f.max = v[1]; f.floor = v[2]; f.maxRate = v[3];
+    return true;
+  }
+  return false;
+}
+
+static void printDud(const char *kind, const VOutlierCfg &o){
+  printf("dud test, %s: k = %u, confirm = %u\n", kind, o.k, o.confirm);
+  for (int i = 0; i < o.fields; i++) {
+    const VOutFieldCfg &f = o.f[i];
+    printf("  %-8s %9d .. %-9d floor %-5d maxRate %d\n", f.label, f.min, f.max, f.floor, f.maxRate);
+  }
+}
+
+static int dump(const char *file){
+  uint8_t blob[VCFG_MAX];
+  static VConfig c;
+  size_t n = configRead(file, blob, sizeof(blob));
+  if (!n)                          { fprintf(stderr, "** cannot read %s (or over %d bytes)\n", file, VCFG_MAX); return 1; }
+  if (!configParse(blob, n, c))    { fprintf(stderr, "** %s is not a valid config blob\n", file); return 1; }
+  printf("%s: %zu bytes, version %d, %d devices\n", file, n, VCFG_VERSION, c.count);
+  for (int i = 0; i < c.count; i++) {
+    const VCfgDevice &d = c.dev[i];
+    printf("  ");
+    for (int j = 0; j < 6; j++) printf(j ? ":%02x" : "%02x", static_cast<unsigned>(d.mac >> (40 - 8 * j)) & 0xFF);
+    printf(" ");
+    for (int j = 0; j < 16; j++) printf("%02x", d.key[j]);
+    printf(" %s\n", d.name);
+  }
+  if (c.hasFlags) printf("flags: FILTERING %s, LOAD_AMPS %s, VERBOSE %s\n", c.flags & VCFG_FILTERING ? "on" : "off",
+                         c.flags & VCFG_LOAD_AMPS ? "on" : "off", c.flags & VCFG_VERBOSE ? "on" : "off");
+  else            printf("flags: as compiled in\n");
+  if (c.hasBM) printDud("Battery Monitors", c.bm);
+  if (c.hasSC) printDud("Solar Controllers", c.sc);
+  return 0;
+}
+
+int main(int argc, char **argv){
+  static VConfig c;
+  initConfig(c);
+  const char *out = nullptr;
+  for (int i = 1; i < argc; i++) {
+    DeviceArg d;
+    bool ok = true;
+    if      (!strcmp(argv[i], "-r") && i + 1 < argc) return dump(argv[i + 1]);
+    else if (!strcmp(argv[i], "-d") && i + 1 < argc) ok = parseDevice(argv[++i], d) && configAddDevice(c, d.mac, d.key, d.name);
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc) out = argv[++i];
+    else if (!strcmp(argv[i], "-flags") && i + 1 < argc) {
+      c.hasFlags = true;
+      for (const char *f = argv[++i]; *f && ok; f++)
+        if      (*f == 'F') c.flags |= VCFG_FILTERING;
+        else if (*f == 'L') c.flags |= VCFG_LOAD_AMPS;
+        else if (*f == 'V') c.flags |= VCFG_VERBOSE;
+        else ok = *f == '0';
+    }
+    else if (!strcmp(argv[i], "-k") && i + 1 < argc)  { c.bm.k = c.sc.k = atoi(argv[++i]);             c.hasBM = c.hasSC = true; }
+    else if (!strcmp(argv[i], "-c") && i + 1 < argc)  { c.bm.confirm = c.sc.confirm = atoi(argv[++i]); c.hasBM = c.hasSC = true; }
+    else if (!strcmp(argv[i], "-bm") && i + 1 < argc) { ok = setField(c.bm, argv[++i]);                c.hasBM = true; }
+    else if (!strcmp(argv[i], "-sc") && i + 1 < argc) { ok = setField(c.sc, argv[++i]);                c.hasSC = true; }
+    else {
+      fprintf(stderr, "usage: %s [-d address,key[,name]]... [-flags FLV] [-k spreads] [-c confirm] [-bm label=min,max[,floor[,maxRate]]]...\n"
+                      "          [-sc label=...]... -o blob\n"
+                      "       %s -r blob\n", argv[0], argv[0]);
+      return 2;
+    }
+    if (!ok) { fprintf(stderr, "** bad or duplicate %s %s\n", argv[i - 1], argv[i]); return 2; }
+  }
+  if (!out)     { fprintf(stderr, "** no output given (-o)\n"); return 2; }
+  if ((c.hasBM && !configDudValid(c.bm)) || (c.hasSC && !configDudValid(c.sc))) {
+    fprintf(stderr, "** dud test: confirm must be 2 or more, min <= max, floor & maxRate not negative (the sketches would not load it)\n");
+    return 2;
+  }
+  if (!c.count) fprintf(stderr, "** no devices: the sketches go back to their devices[] with this blob\n");
+  uint8_t blob[VCFG_MAX];
+  size_t n = configBuild(c, blob, sizeof(blob));
+  if (!n)                          { fprintf(stderr, "** over %d bytes\n", VCFG_MAX); return 1; }
+  if (!configStore(out, blob, n))  { fprintf(stderr, "** cannot write %s\n", out); return 1; }
+  printf("%s: %zu bytes, %d devices\n", out, n, c.count);
+  return 0;
+}
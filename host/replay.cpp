@@ -0,0 +1,246 @@
+/* Capture replay - runs on Linux, no ESP32 needed
+
+Feeds a capture (see VictronCore/VCapture.h, streamed out by the sketches in
+capture mode, C) through the same library calls as the ESP32: findDevice(),
+isDuplicate() & dedupAccept() as the BLE callback, then in batches of up to
+VRING_SIZE as loop() takes them from the ring, decryptFrames(), the dud test of a
+Battery Monitor's or Solar Controller's reading (outlierCheck(), as VictronReceiver's
+keepReading(), the settings for its kind: defaults or the config blob's) and the
+codec for the record type. It prints every reading with its time, device and RSSI -
+a reading with dud values flagged "*", nothing is filtered - or, with -q, just the
+counts and the rate. As fast as possible by default, or with the original timing
+(-t, one frame per batch), sped up by -x.
+
+Devices are given as -d address,key[,name] (lower case, key as 32 hex digits),
+as in devices[] of the sketches, or with -f from a config blob (host/mkconfig).
+Without either, the two placeholder devices of the sketches (ff:ff:ff:ff:ff:ff and
+ff:ff:ff:ff:ff:fe, key all ff) are used.
+
+-w file writes a synthetic capture instead: -n frames from the devices, the first
+a Battery Monitor, the next a Solar Controller and so on, each IV advertised 3
+times as a real device does. -c fails (exit 1) unless every frame was decoded or
+dropped as a repeat, as for a synthetic capture.
+
+usage: replay [-d address,key[,name]]... [-f blob] [-q] [-v] [-t] [-x speed] [-r repeats] [-c] capture
+       replay [-d address,key[,name]]... -w capture [-n frames] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+static void sleepUntil(uint64_t ns){
+  uint64_t now = nowNs();
+  if (ns <= now) return;
+  timespec ts = {static_cast<time_t>((ns - now) / 1000000000ull), static_cast<long>((ns - now) % 1000000000ull)};
+  nanosleep(&ts, nullptr);
+}
+
+static void printHex(const uint8_t *p, size_t n){
+  for (size_t i = 0; i < n; i++) printf("%02x", p[i]);
+}
+
+// -- synthetic capture ------------------------------------------------------------------------
+
+static int writeSynthetic(const char *file, uint64_t frames, const std::vector<DeviceArg> &devs){
+  static VDeviceTable t;
+  loadTable(t, devs);
+  FILE *f = fopen(file, "wb");
+  if (!f) { fprintf(stderr, "** cannot write %s\n", file); return 1; }
+  uint8_t buf[VCAP_RECORD_MAX];
+  fwrite(buf, 1, captureHeader(buf), f);
+  for (uint64_t i = 0; i < frames; i++) {
+    int d = i % t.count;
+    uint64_t n = i / t.count;
+    VDevice &dev = t.dev[d];
+    uint16_t iv = static_cast<uint16_t>(n / 3);             // each IV advertised 3 times
+    VFrame fr;
+    fr.mac  = dev.mac;
+    fr.ms   = 1000 + n * 100 + d;
+    fr.rssi = -60 - static_cast<int>(n % 20);
+    fr.len  = VMFR_MAX;
+    const uint8_t hdr[VMFR_RECORD + 1] = {0xE1, 0x02, 0x10, 0xA3, 0x02, 0x00, static_cast<uint8_t>(d & 1 ? 0x01 : 0x02)};
+    memcpy(fr.data, hdr, sizeof(hdr));
+    fr.data[VMFR_IV]     = iv & 0xFF;
+    fr.data[VMFR_IV + 1] = iv >> 8;
+    fr.data[VMFR_KEY0]   = dev.key[0];
+    uint8_t p[16], ks[16];
+    uint32_t h = (iv + 1u) * 2654435761u ^ d * 40503u;     // same plaintext for the repeats of an IV
+    for (int j = 0; j < 16; j++) { h = h * 1664525u + 1013904223u; p[j] = h >> 24; }
+    aesKeystream(dev.aes, iv, ks);
+    for (int j = 0; j < 16; j++) fr.data[VMFR_CIPHER + j] = p[j] ^ ks[j];
+    fwrite(buf, 1, captureFrame(fr, buf), f);
+  }
+  buf[0] = VCAP_END;
+  fwrite(buf, 1, 1, f);
+  fclose(f);
+  printf("%llu frames from %d devices written to %s\n", static_cast<unsigned long long>(frames), t.count, file);
+  return 0;
+}
+
+// -- replay -----------------------------------------------------------------------------------
+
+struct Counts {
+  uint64_t frames, unknown, repeats, badKey, unsupported, decoded, dudReadings;
+};
+
+// the dud test state per device, set up for its kind by its first Battery Monitor or Solar Controller reading
+struct DudTest {
+  const VOutlierCfg *bm, *sc;
+  uint8_t  kind[VDEV_MAX];
+  VOutlier o[VDEV_MAX];
+};
+
+// the dud bits of a decrypted reading, 0 for other types
+static uint8_t dudCheck(DudTest &dt, int dev, const VFrame &f, const uint8_t plain[16]){
+  uint8_t type = f.data[VMFR_RECORD];
+  if (type != VREC_BATTERY_MONITOR && type != VREC_SOLAR_CHARGER) return 0;
+  if (!dt.kind[dev]) { dt.kind[dev] = type; initOutlier(dt.o[dev], type == VREC_BATTERY_MONITOR ? dt.bm : dt.sc); }
+  if (dt.kind[dev] != type) return 0;
+  int32_t v[VOUT_FIELDS];
+  uint8_t checked;
+  if (type == VREC_BATTERY_MONITOR) { BatteryMonitorReading r; decodeBM(plain, r); bmOutValues(r, v, checked); }
+  else                              { SolarChargerReading   r; decodeSC(plain, r); scOutValues(r, v, checked); }
+  return outlierCheck(dt.o[dev], f.ms, v, checked);
+}
+
+// one batch as loop() takes it from the ring: decrypted in one pass, then each frame decoded & printed
+static void replayBatch(const VFrame *batch, int n, VDeviceTable &t, DudTest &dt, bool quiet, bool verbose, Counts &c){
+  static uint8_t plain[VRING_SIZE][16];
+  static bool    ok[VRING_SIZE];
+  VLine line;
+  decryptFrames(t, batch, n, plain, ok);
+  for (int i = 0; i < n; i++) {
+    const VFrame &f = batch[i];
+    VDevice *d = findDevice(t, f.mac);
+    VRecord r;
+    bool decoded = ok[i] && decodeRecord(f.data[VMFR_RECORD], plain[i], r);
+    uint8_t duds = ok[i] ? dudCheck(dt, d - t.dev, f, plain[i]) : 0;
+    if (!ok[i]) c.badKey++;
+    else if (!decoded) c.unsupported++;
+    else c.decoded++;
+    if (duds) c.dudReadings++;
+    if (quiet) continue;
+    printf("%10.3f s  %-20s %4d dBm %s", f.ms / 1000.0, d->name, f.rssi, duds ? "* " : "  ");
+    if (!ok[i]) printf("** key does not match");
+    else if (!decoded) printf("record type 0x%02X not supported", f.data[VMFR_RECORD]);
+    else { lineClear(line); formatRecord(line, r); printf("%s", lineText(line)); }
+    if (duds) { int k = 0; for (uint8_t b = duds; b; b &= b - 1) k++; printf("\t[duds: %d]", k); }
+    if (verbose) { printf("\n%36s data ", ""); printHex(f.data, f.len); if (ok[i]) { printf(" -> "); printHex(plain[i], 16); } }
+    printf("\n");
+  }
+}
+
+static void replay(const std::vector<VFrame> &frames, VDeviceTable &t, DudTest &dt, bool quiet, bool verbose, bool timed,
+                   double speed, Counts &c){
+  uint64_t t0 = nowNs();
+  VFrame batch[VRING_SIZE];
+  int    n = 0;
+  for (const VFrame &f : frames) {
+    c.frames++;
+    if (timed) sleepUntil(t0 + static_cast<uint64_t>((f.ms - frames[0].ms) * 1e6 / speed));
+    VDevice *d = findDevice(t, f.mac);
+    if (!d) { c.unknown++; continue; }
+    if (isDuplicate(*d, f.data, f.len)) { c.repeats++; continue; }
+    dedupAccept(*d, f.data, f.len);
+    batch[n++] = f;
+    if (timed || n == VRING_SIZE) { replayBatch(batch, n, t, dt, quiet, verbose, c); n = 0; }
+  }
+  if (n) replayBatch(batch, n, t, dt, quiet, verbose, c);
+}
+
+int main(int argc, char **argv){
+  std::vector<DeviceArg> devs;
+  const char *file = nullptr, *out = nullptr, *blob = nullptr;
+  bool quiet = false, verbose = false, timed = false, check = false;
+  double speed = 1;
+  int repeats = 1;
+  uint64_t frames = 100000;
+  for (int i = 1; i < argc; i++) {
+    DeviceArg d;
+    if      (!strcmp(argv[i], "-d") && i + 1 < argc) {
+      if (!parseDevice(argv[++i], d)) { fprintf(stderr, "** bad device %s\n", argv[i]); return 2; }
+      devs.push_back(d);
+    }
+    else if (!strcmp(argv[i], "-f") && i + 1 < argc) blob = argv[++i];
+    else if (!strcmp(argv[i], "-q")) quiet = true;
+    else if (!strcmp(argv[i], "-v")) verbose = true;
+    else if (!strcmp(argv[i], "-t")) timed = true;
+    else if (!strcmp(argv[i], "-c")) check = true;
+    else if (!strcmp(argv[i], "-x") && i + 1 < argc) speed = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc) repeats = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc) out = argv[++i];
+    else if (argv[i][0] != '-' && !file) file = argv[i];
+    else {
+      fprintf(stderr, "usage: %s [-d address,key[,name]]... [-f blob] [-q] [-v] [-t] [-x speed] [-r repeats] [-c] capture\n"
+                      "       %s [-d address,key[,name]]... -w capture [-n frames]\n", argv[0], argv[0]);
+      return 2;
+    }
+  }
+  static VConfig cfg;
+  initConfig(cfg);
+  if (blob) {
+    VConfig &c = cfg;
+    uint8_t buf[VCFG_MAX];
+    size_t n = configRead(blob, buf, sizeof(buf));
+    if (!n || !configParse(buf, n, c)) { fprintf(stderr, "** %s is not a valid config blob\n", blob); return 2; }
+    for (int i = 0; i < c.count; i++) {
+      DeviceArg d;
+      d.mac = c.dev[i].mac;
+      memcpy(d.key, c.dev[i].key, 16);
+      snprintf(d.name, sizeof(d.name), "%s", c.dev[i].name);
+      devs.push_back(d);
+    }
+  }
+  if (devs.empty())
+    for (const char *s : {"ff:ff:ff:ff:ff:ff,ffffffffffffffffffffffffffffffff,My_SmartShunt_1",
+                          "ff:ff:ff:ff:ff:fe,ffffffffffffffffffffffffffffffff,My_Solar_Controller"}) {
+      DeviceArg d;
+      parseDevice(s, d);
+      devs.push_back(d);
+    }
+  if (out) return writeSynthetic(out, frames, devs);
+  if (!file) { fprintf(stderr, "** no capture given\n"); return 2; }
+  if (speed <= 0) speed = 1;
+  if (repeats < 1) repeats = 1;
+
+  std::vector<uint8_t> buf;
+  if (!readFile(file, buf)) { fprintf(stderr, "** cannot read %s\n", file); return 1; }
+  const uint8_t *p = captureFind(buf.data(), buf.size());
+  if (!p) { fprintf(stderr, "** no capture header in %s\n", file); return 1; }
+  std::vector<VFrame> capture;
+  VFrame f;
+  size_t n;
+  while ((n = captureNext(p, buf.data() + buf.size() - p, f)) > 0) { capture.push_back(f); p += n; }
+  if (capture.empty()) { fprintf(stderr, "** no frames in %s\n", file); return 1; }
+  if (p == buf.data() + buf.size() || *p != VCAP_END) fprintf(stderr, "** capture cut off after %zu frames\n", capture.size());
+
+  static VDeviceTable t;
+  static DudTest dt;
+  Counts c = {};
+  uint64_t t0 = nowNs();
+  for (int r = 0; r < repeats; r++) {
+    loadTable(t, devs);                                     // fresh repeat, keystream & dud test state each time
+    memset(&dt, 0, sizeof(dt));
+    dt.bm = cfg.hasBM ? &cfg.bm : &bmOutlierDefaults;
+    dt.sc = cfg.hasSC ? &cfg.sc : &scOutlierDefaults;
+    replay(capture, t, dt, quiet, verbose, timed, speed, c);
+  }
+  uint64_t t1 = nowNs();
+  double span = (capture.back().ms - capture.front().ms) / 1000.0 * repeats;
+  printf("\n%llu frames: %llu decoded, %llu repeats dropped, %llu unknown device, %llu key mismatch, %llu type not supported, "
+         "%llu readings with duds\n",
+         static_cast<unsigned long long>(c.frames), static_cast<unsigned long long>(c.decoded),
+         static_cast<unsigned long long>(c.repeats), static_cast<unsigned long long>(c.unknown),
+         static_cast<unsigned long long>(c.badKey), static_cast<unsigned long long>(c.unsupported),
+         static_cast<unsigned long long>(c.dudReadings));
+  reportRate("replay", c.frames, t1 - t0);
+  if (span > 0) printf("%-20s %.1f s of capture in %.3f s: %.0fx real time\n", "", span, (t1 - t0) / 1e9, span * 1e9 / (t1 - t0));
+  if (check && c.decoded + c.repeats != c.frames) { printf("**FAIL** not every frame was decoded\n"); return 1; }
+  return 0;
+}
@@ -0,0 +1,178 @@
+/* Scan scheduling simulation - runs on Linux, no ESP32 needed
+
+Simulates targets advertising on a millisecond clock, each changing its data
+(and IV) at its own rate and sending the latest data every advertising interval
+plus the 0-10 ms random delay BLE adds, and a radio that hears an advert only
+while it is listening (95% of the time even then: collisions). Runs the same air
+through three ways of scanning:
+  continuous  always listening (the default scan mode)
+  start/stop  the original loop: scan until the first new reading or 2 secs,
+              then 500 ms off, listening 30 ms in each 50 ms while scanning
+  adaptive    windows from VSchedule, learnt from the frames heard
+and prints, for each, the radio on time against how fresh the data is: the
+updates heard, their delay after first going on air, and the mean age of the
+data held (since it went on air). Checks that adaptive keeps the data about as
+fresh as continuous for much less radio time, and that a target switched off
+for 10 minutes costs little and is found again soon after it is back, and that
+a target learnt from frames all received in one millisecond (a burst queued while
+the intake task was held up) gets a change time of at least 1 ms, then backs off
+when silent without dividing by it.
+
+usage: sim_scan [-v]   -v  also prints the windows opened and missed */
+
+#include "VictronCore.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+enum Policy {CONTINUOUS, START_STOP, ADAPTIVE};
+static const char *policyName[] = {"continuous", "start/stop", "adaptive"};
+
+struct Target {
+  const char *name;
+  uint32_t    advMs;                  // advertising interval, + 0-10 ms each time
+  double      changeMs;               // between updates, not a whole number: the clocks drift
+  uint32_t    offFrom, offTo;         // switched off over this time (ms), if offTo
+};
+
+struct Result {
+  uint64_t onMs, totalMs;
+  uint32_t updates, heard;            // sent (and on air), heard
+  std::vector<uint32_t> delay;        // on air to heard, per update heard
+  uint64_t ageSum, ageMs;             // age of the data held, summed each ms
+  uint32_t windows, misses;
+  uint32_t offOnMs, offMs;            // radio on time while a target was off
+  uint32_t backMs;                    // first heard after coming back on, 0 if never
+};
+
+static uint32_t rnd = 2463534242u;
+static uint32_t xorshift(){ rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return rnd; }
+
+static Result run(Policy policy, const Target *tg, int n, uint32_t simMs){
+  struct State {
+    double   nextChange, nextAdv;
+    uint16_t iv, rxIv;
+    bool     onAir, rxAny;            // iv has been advertised / anything heard
+    uint32_t airMs, rxAirMs;          // when iv, and the iv held, first went on air
+  } st[VDEV_MAX];
+  Result r = {};
+  rnd = 2463534242u;
+  for (int d = 0; d < n; d++) {
+    st[d] = {};
+    st[d].nextChange = tg[d].changeMs * (d + 1) / (n + 1);          // out of step
+    st[d].nextAdv    = xorshift() % tg[d].advMs;
+  }
+  static VScheduler sched;
+  initScheduler(sched, n, 0);
+  bool     scanning = true;           // start/stop state
+  uint32_t phaseMs  = 0;
+  for (uint32_t t = 0; t < simMs; t++) {
+    bool on;                                                      // -- radio
+    if      (policy == CONTINUOUS) on = true;
+    else if (policy == ADAPTIVE)   on = schedUpdate(sched, t);
+    else {
+      if (scanning && t - phaseMs >= 2000) {scanning = false; phaseMs = t;}
+      if (!scanning && t - phaseMs >= 500) {scanning = true;  phaseMs = t;}
+      on = scanning && t % 50 < 30;
+    }
+    if (on) r.onMs++;
+    r.totalMs++;
+    bool anyOff = false;
+    for (int d = 0; d < n; d++) {                                 // -- air
+      State &s = st[d];
+      bool off = tg[d].offTo && t >= tg[d].offFrom && t < tg[d].offTo;
+      anyOff |= off;
+      while (t >= s.nextChange) {
+        s.nextChange += tg[d].changeMs;
+        if (off) continue;
+        s.iv++;
+        s.onAir = false;
+      }
+      if (t < s.nextAdv) continue;
+      s.nextAdv += tg[d].advMs + xorshift() % 11;
+      if (off) continue;
+      if (!s.onAir) {s.onAir = true; s.airMs = t; r.updates++;}
+      if (!on || xorshift() % 100 >= 95 || (s.rxAny && s.rxIv == s.iv)) continue;   // not heard, or a repeat
+      if (tg[d].offTo && !r.backMs && t >= tg[d].offTo) r.backMs = t - tg[d].offTo;
+      s.rxAny   = true;
+      s.rxIv    = s.iv;
+      s.rxAirMs = s.airMs;
+      r.heard++;
+      r.delay.push_back(t - s.airMs);
+      if (policy == ADAPTIVE) schedFrame(sched, d, s.iv, t);
+      if (policy == START_STOP && scanning) {scanning = false; phaseMs = t;}   // the callback stops the scan
+    }
+    for (int d = 0; d < n; d++)
+      if (st[d].rxAny && !(tg[d].offTo && t >= tg[d].offFrom && t < tg[d].offTo)) {r.ageSum += t - st[d].rxAirMs; r.ageMs++;}
+    if (anyOff) {r.offMs++; if (on) r.offOnMs++;}
+  }
+  r.windows = sched.windows;
+  r.misses  = sched.misses;
+  std::sort(r.delay.begin(), r.delay.end());
+  return r;
+}
+
+static uint32_t pct(const std::vector<uint32_t> &v, int permille){
+  return v.empty() ? 0 : v[std::min(v.size() - 1, v.size() * permille / 1000)];
+}
+
+static double mean(const std::vector<uint32_t> &v){
+  double sum = 0;
+  for (uint32_t x : v) sum += x;
+  return v.empty() ? 0 : sum / v.size();
+}
+
+static void print(Policy p, const Result &r, bool verbose){
+  printf("%-11s %7.1f%% %9.1f%% %8.0f %6u %8.0f ms", policyName[p], 100.0 * r.onMs / r.totalMs,
+         100.0 * r.heard / r.updates, mean(r.delay), pct(r.delay, 990), r.ageMs ? static_cast<double>(r.ageSum) / r.ageMs : 0);
+  if (verbose && p == ADAPTIVE) printf("   %u windows, %u missed", r.windows, r.misses);
+  printf("\n");
+}
+
+static void header(const char *what, const Target *tg, int n, uint32_t simMs){
+  printf("\n%s, %u min:", what, simMs / 60000);
+  for (int d = 0; d < n; d++) printf(" %s (adverts %u ms, updates %.1f ms)", tg[d].name, tg[d].advMs, tg[d].changeMs);
+  printf("\n%-11s %8s %10s %8s %6s %8s\n", "scan", "radio on", "updates", "delay", "p99", "data age");
+}
+
+// every learning frame in the same millisecond, then silence: the change time must not be 0
+static bool sameMsBurst(){
+  static VScheduler s;
+  initScheduler(s, 1, 0);
+  for (uint16_t iv = 0; iv <= VSCHED_LEARN + 1; iv++) schedFrame(s, 0, iv, iv ? 2000 : 1000);
+  bool changeSet = s.dev[0].changeMs >= 1;
+  for (uint32_t now = 2000; now < 2000 + 10 * VSCHED_MAX_GAP_MS; now += 5) schedUpdate(s, now);   // misses, backing off
+  printf("\nburst in one ms: change %u ms, %u misses after, backing off: %s\n", s.dev[0].changeMs, s.misses, changeSet ? "ok" : "**FAIL**");
+  return changeSet && s.misses > 0;
+}
+
+int main(int argc, char **argv){
+  bool verbose = argc > 1 && !strcmp(argv[1], "-v");
+  if (argc > 1 && !verbose) { fprintf(stderr, "usage: %s [-v]\n", argv[0]); return 2; }
+  bool ok = true;
+
+  const Target three[] = {{"shunt", 150, 1000.15, 0, 0}, {"solar", 250, 1999.7, 0, 0}, {"inverter", 80, 500.05, 0, 0}};
+  const uint32_t hour = 3600000;
+  header("three targets", three, 3, hour);
+  Result res[3];
+  for (int p = CONTINUOUS; p <= ADAPTIVE; p++) print(static_cast<Policy>(p), res[p] = run(static_cast<Policy>(p), three, 3, hour), verbose);
+  const Result &c = res[CONTINUOUS], &a = res[ADAPTIVE];
+  double ageC = static_cast<double>(c.ageSum) / c.ageMs, ageA = static_cast<double>(a.ageSum) / a.ageMs;
+  if (a.onMs * 100 > a.totalMs * 40) { printf("**FAIL** adaptive radio on more than 40%%\n"); ok = false; }
+  if (ageA > ageC * 1.10)            { printf("**FAIL** adaptive data more than 10%% older than continuous\n"); ok = false; }
+  if (a.heard * 100 < a.updates * 90) { printf("**FAIL** adaptive heard under 90%% of the updates\n"); ok = false; }
+
+  const Target silent[] = {{"shunt", 150, 1000.15, 600000, 1200000}};
+  header("one target, off from 10 to 20 min", silent, 1, 2 * 900000);
+  Result s = run(ADAPTIVE, silent, 1, 2 * 900000);
+  print(ADAPTIVE, s, verbose);
+  printf("while off: radio on %.1f%%, heard again %.1f s after back on\n", 100.0 * s.offOnMs / s.offMs, s.backMs / 1000.0);
+  if (s.offOnMs * 100 > s.offMs * 10)              { printf("**FAIL** radio on more than 10%% for a silent target\n"); ok = false; }
+  if (!s.backMs || s.backMs > VSCHED_MAX_GAP_MS + 5000) { printf("**FAIL** not found again within %u ms\n", VSCHED_MAX_GAP_MS + 5000); ok = false; }
+  if (!sameMsBurst()) { printf("**FAIL** burst in one ms\n"); ok = false; }
+  if (!ok) return 1;
+  printf("adaptive vs continuous: radio on %.1f%% of the time, data age %+.1f%%: ok\n", 100.0 * a.onMs / a.totalMs, 100.0 * (ageA - ageC) / ageC);
+  return 0;
+}
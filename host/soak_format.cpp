@@ -0,0 +1,101 @@
+/* Report formatter soak test - runs on Linux, no ESP32 needed
+
+Decodes and formats a million random Battery Monitor and Solar Controller
+records, as reportBMvalues() / reportSCvalues() do on every reading, and fails
+if the heap grows at all or anything is allocated on the way (operator new and
+the glibc heap are both watched). A few known records are checked first, so the
+text stays the same as the Streaming/Serial output it replaced.
+
+usage: soak_format [-n frames] */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+static uint64_t allocs = 0;
+void *operator new(size_t n){
+  allocs++;
+  if (void *p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static bool expect(const char *what, VLine &l, const char *want){
+  if (strcmp(lineText(l), want) == 0) return true;
+  printf("**FAIL** %s\n  got  [%s]\n  want [%s]\n", what, l.buf, want);
+  return false;
+}
+
+static bool checkKnown(){
+  VLine l;
+  bool ok = true;
+  struct { float v; int d, w; const char *want; } nums[] = {
+    {24.314f, 2, 5, "24.31"}, {-5.64f, 1, 5, " -5.6"}, {0.04f, 1, 5, "  0.0"}, {-0.04f, 1, 0, "-0.0"},
+    {1234.5f, 0, 3, "1235"}, {99.96f, 1, 5, "100.0"}, {0, 2, 6, "  0.00"},
+  };
+  for (auto &n : nums) { lineClear(l); lineFloat(l, n.v, n.d, n.w); ok &= expect("lineFloat", l, n.want); }
+
+  struct { int32_t v; uint32_t div; int d, w; const char *want; } fixed[] = {
+    {2431, 100, 2, 5, "24.31"}, {-5640, 1000, 1, 5, " -5.6"}, {-5650, 1000, 1, 0, "-5.7"}, {-40, 1000, 1, 0, "-0.0"},
+    {2160, 1440, 1, 4, " 1.5"}, {9996, 100, 1, 5, "100.0"}, {0, 100, 2, 6, "  0.00"}, {-2097152, 1000, 3, 0, "-2097.152"},
+  };
+  for (auto &n : fixed) { lineClear(l); lineFixed(l, n.v, n.div, n.d, n.w); ok &= expect("lineFixed", l, n.want); }
+
+  BatteryMonitorReading bm = {};
+  bm.ttgMin = 2160; bm.battV = 2560; bm.alarmBits = 0x0002; bm.aux = 1; bm.auxVal = 1281;
+  bm.battA = -5600; bm.usedAh = 123; bm.soc = 875;
+  bm.valid = BM_TTG | BM_BATTV | BM_AUX | BM_BATTA | BM_AH | BM_SOC;
+  lineClear(l); formatBM(l, bm);
+  ok &= expect("formatBM", l, " 1.5d 25.60V hi_V  12.81V |  1   -5.6A    12.3Ah  87.5%");
+  bm.valid = 0; bm.alarmBits = 0x0011; bm.aux = 2;
+  lineClear(l); formatBM(l, bm);
+  ok &= expect("formatBM n/a", l, "inf_d n/a-V Mult n/a-K |  2  n/a-A n/a-Ah n/a-%");
+
+  SolarChargerReading sc = {};
+  sc.state = 3; sc.battV = 2645; sc.battA = 72; sc.yield10Wh = 123; sc.pvW = 190;
+  sc.valid = SC_BATTV | SC_BATTA | SC_KWH | SC_PVW;
+  lineClear(l); formatSC(l, sc, true);
+  ok &= expect("formatSC", l, "_BULK_ no_err 26.45V   7.2A |   1.23kWh 190W   n/a-A");
+  sc.state = 0x22; sc.error = 0x74;
+  lineClear(l); formatSC(l, sc, false);
+  ok &= expect("formatSC codes", l, "*22* *74* 26.45V   7.2A |   1.23kWh 190W  ");
+  return ok;
+}
+
+int main(int argc, char **argv){
+  uint64_t frames = 1000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else { fprintf(stderr, "usage: %s [-n frames]\n", argv[0]); return 2; }
+  }
+  if (!checkKnown()) return 1;
+  printf("known records: ok\n");
+
+  static VLine line;                                    // preallocated, as in the sketches
+  uint8_t rec[16];
+  uint32_t seed = 1, sum = 0;
+  struct mallinfo2 m0 = mallinfo2();
+  uint64_t a0 = allocs, t0 = nowNs();
+  for (uint64_t f = 0; f < frames; f++) {
+    for (int i = 0; i < 16; i++) { seed = seed * 1664525u + 1013904223u; rec[i] = seed >> 24; }
+    lineClear(line);
+    if (f & 1) { SolarChargerReading   v; decodeSC(rec, v); formatSC(line, v, true); }
+    else       { BatteryMonitorReading v; decodeBM(rec, v); formatBM(line, v); }
+    sum += line.len;
+  }
+  uint64_t t1 = nowNs(), a1 = allocs;
+  struct mallinfo2 m1 = mallinfo2();
+  reportRate("decode+format", frames, t1 - t0);
+  long growth = static_cast<long>(m1.uordblks) - static_cast<long>(m0.uordblks);
+  printf("%-20s heap in use %zu -> %zu bytes (%+ld), %llu allocations, %.1f chars/line\n", "",
+         m0.uordblks, m1.uordblks, growth, static_cast<unsigned long long>(a1 - a0), static_cast<double>(sum) / frames);
+  if (growth != 0 || a1 != a0) { printf("**FAIL** heap grew or allocated\n"); return 1; }
+  printf("%-20s ok: zero heap growth\n", "");
+  return 0;
+}
@@ -0,0 +1,95 @@
+/* VRing stress test - runs on Linux, no ESP32 needed
+
+A producer thread pushes numbered frames as fast as it can (as the BLE callback
+would), while the consumer thread pops them in batches (as loop() does),
+optionally spinning for a while after each batch to play a slow decode & print.
+Every frame carries its sequence number in mac and a pattern derived from it
+in data[], so the consumer can check that
+- no frame is torn (data[] matches its sequence number)
+- frames come out in order, with no duplicates
+- every frame pushed is either popped or counted as dropped
+
+usage: stress_ring [-n frames] [-b batch] [-s spin] [-y every]
+  -b batch  most frames taken per ringPop() (default VRING_SIZE)
+  -s spin   busy loop iterations after each batch, slows the consumer (default 0)
+  -y every  producer yields after every so many pushes, 0 = never (default 16).
+            On a single core the consumer otherwise only runs when the producer is preempted */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+
+static VRing ring;
+static std::atomic<bool> producerDone(false);
+
+static void fillFrame(uint64_t seq, uint8_t data[VMFR_MAX]){
+  for (int i = 0; i < VMFR_MAX; i++) data[i] = static_cast<uint8_t>(seq * 7 + i * 13);
+}
+
+int main(int argc, char **argv){
+  uint64_t frames = 2000000;
+  int batch = VRING_SIZE;
+  long spin = 0;
+  uint64_t every = 16;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-n") && i + 1 < argc) frames = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "-b") && i + 1 < argc) batch = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc) spin = atol(argv[++i]);
+    else if (!strcmp(argv[i], "-y") && i + 1 < argc) every = strtoull(argv[++i], nullptr, 10);
+    else { fprintf(stderr, "usage: %s [-n frames] [-b batch] [-s spin] [-y every]\n", argv[0]); return 2; }
+  }
+  if (batch < 1 || batch > VRING_SIZE) batch = VRING_SIZE;
+  initRing(ring);
+
+  uint64_t t0 = nowNs();
+  std::thread producer([frames, every]{
+    uint8_t data[VMFR_MAX];
+    for (uint64_t seq = 1; seq <= frames; seq++) {
+      fillFrame(seq, data);
+      ringPush(ring, seq, -70, static_cast<uint32_t>(seq), data, VMFR_MAX);
+      if (every && seq % every == 0) std::this_thread::yield();
+    }
+    producerDone.store(true, std::memory_order_release);
+  });
+
+  uint64_t popped = 0, torn = 0, disorder = 0, last = 0;
+  VFrame out[VRING_SIZE];
+  volatile long sink = 0;
+  for (;;) {
+    bool done = producerDone.load(std::memory_order_acquire);   // read before popping, so nothing is left behind
+    int n = ringPop(ring, out, batch);
+    for (int i = 0; i < n; i++) {
+      uint8_t want[VMFR_MAX];
+      fillFrame(out[i].mac, want);
+      if (out[i].len != VMFR_MAX || memcmp(out[i].data, want, VMFR_MAX) || out[i].ms != static_cast<uint32_t>(out[i].mac)) torn++;
+      if (out[i].mac <= last) disorder++;
+      last = out[i].mac;
+    }
+    popped += n;
+    for (long s = 0; s < spin; s++) sink = sink + s;
+    if (n == 0) {
+      if (done) break;
+      std::this_thread::yield();                               // nothing queued: let the producer run
+    }
+  }
+  producer.join();
+  uint64_t t1 = nowNs();
+
+  reportRate("ringPush", frames, t1 - t0);
+  printf("%-20s pushed %u  dropped %u  popped %llu  max depth %u/%d  batch %d  spin %ld\n", "",
+         ring.pushed, ring.dropped, static_cast<unsigned long long>(popped), ring.maxDepth, VRING_SIZE, batch, spin);
+  bool ok = torn == 0 && disorder == 0 && ring.popped == popped
+         && static_cast<uint64_t>(ring.pushed) + ring.dropped == frames && ring.pushed == popped;
+  if (!ok) {
+    printf("**FAIL** torn %llu  out of order %llu  pushed + dropped != frames or pushed != popped\n",
+           static_cast<unsigned long long>(torn), static_cast<unsigned long long>(disorder));
+    return 1;
+  }
+  printf("%-20s ok: no torn, lost or out of order frames\n", "");
+  return 0;
+}
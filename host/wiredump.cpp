@@ -0,0 +1,83 @@
+/* Binary output decoder - runs on Linux, no ESP32 needed
+
+Reads the binary records the sketches write in binary mode ("B", see VictronCore/VWire.h)
+from a file, a serial port or a pipe ("-" for stdin), and prints every reading with its
+time and device, values as the report lines, "*" and the dud bits if any were flagged,
+or with -q just the counts and the rate. A serial port must be raw first, e.g.
+  stty -F /dev/ttyUSB0 115200 raw && wiredump /dev/ttyUSB0
+It is read as it comes, a chunk at a time. Text between the records (the sketch's own
+messages) is skipped, as is any record cut short or corrupt, counted as bad. Device names
+come from the device records, sent as binary mode starts and every 10 secs: until one
+is seen a device shows as its index. -c fails (exit 1) if a record was bad or there
+were no readings, as for host/bench_wire's synthetic stream.
+
+usage: wiredump [-q] [-c] stream */
+
+#include "VictronCore.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static char names[32][VWIRE_NAME];
+
+static void printRecord(const VWireRecord &r, VLine &l){
+  if (r.kind == VWIRE_DEVICE) {
+    snprintf(names[r.dev], VWIRE_NAME, "%s", r.name);
+    return;
+  }
+  char dev[8];
+  snprintf(dev, sizeof(dev), "#%u", r.dev);
+  lineClear(l);
+  if      (r.kind == VWIRE_BM) formatBM(l, r.bm);
+  else if (r.kind == VWIRE_SC) formatSC(l, r.sc, true);
+  else {
+    VRecord v;
+    if (decodeRecord(r.type, r.data, v)) formatRecord(l, v);
+    else { lineStr(l, "record type 0x"); lineHex2(l, r.type); lineStr(l, " not supported"); }
+  }
+  printf("%10.3f s  %-20s %s", r.ms / 1000.0, names[r.dev][0] ? names[r.dev] : dev, lineText(l));
+  if (r.kind != VWIRE_RECORD && r.duds) printf("  * duds 0x%02X", r.duds);
+  printf("\n");
+}
+
+int main(int argc, char **argv){
+  const char *file = nullptr;
+  bool quiet = false, check = false;
+  for (int i = 1; i < argc; i++) {
+    if      (!strcmp(argv[i], "-q")) quiet = true;
+    else if (!strcmp(argv[i], "-c")) check = true;
+    else if (!file && (argv[i][0] != '-' || !strcmp(argv[i], "-"))) file = argv[i];
+    else { fprintf(stderr, "usage: %s [-q] [-c] stream\n", argv[0]); return 2; }
+  }
+  if (!file) { fprintf(stderr, "** no stream given (- for stdin)\n"); return 2; }
+  FILE *in = strcmp(file, "-") ? fopen(file, "rb") : stdin;
+  if (!in) { fprintf(stderr, "** cannot read %s\n", file); return 1; }
+
+  VWireDecoder d;
+  initWireDecoder(d);
+  VWireRecord r;
+  VLine l;
+  uint64_t bytes = 0, readings = 0;
+  uint8_t chunk[4096];
+  size_t n;
+  uint64_t t0 = nowNs();
+  while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    bytes += n;
+    for (size_t i = 0; i < n; i++) {
+      if (!wirePut(d, chunk[i], r)) continue;
+      if (r.kind != VWIRE_DEVICE) readings++;
+      if (!quiet || r.kind == VWIRE_DEVICE) printRecord(r, l);
+    }
+    if (!quiet) fflush(stdout);
+  }
+  uint64_t t1 = nowNs();
+  if (in != stdin) fclose(in);
+  printf("\n%llu bytes: %u records (%llu readings), %u text, %u bad\n", static_cast<unsigned long long>(bytes),
+         d.records, static_cast<unsigned long long>(readings), d.text, d.bad);
+  reportRate("wiredump", d.records, t1 - t0);
+  if (readings) printf("%-20s %.1f bytes/reading, %.0f readings/sec at 115200 baud\n", "",
+                       static_cast<double>(bytes) / readings, 11520.0 * readings / bytes);
+  if (check && (d.bad || !readings)) { printf("**FAIL** bad records, or no readings\n"); return 1; }
+  return 0;
+}
@@ -0,0 +1,182 @@
+/* AES-128 block encryption with a pre-expanded key schedule (see VAes.h) */
+
+#include "VAes.h"
+
+#include <string.h>
+
+#ifdef VCORE_WOLFSSL
+// ---------------------------------------------------------------------------------------
+// ESP32: wolfssl. The CTR routine is used to encrypt single blocks, as wc_AesEncryptDirect
+// is only present when wolfssl is built with WOLFSSL_AES_DIRECT.
+
+static const uint8_t zeros[16] = {0};
+
+bool aesSetKey(VAesKey &k, const uint8_t key[16]){
+  memset(&k.aes, 0, sizeof(Aes));
+  if (wc_AesInit(&k.aes, NULL, INVALID_DEVID) != 0) return false;
+  return wc_AesSetKey(&k.aes, key, 16, zeros, AES_ENCRYPTION) == 0;   // expands the key schedule
+}
+
+void aesFreeKey(VAesKey &k){
+  wc_AesFree(&k.aes);
+}
+
+// AES(k, in) == CTR encryption of a zero block with counter = in.
+// Always a whole block, so no partial keystream is left over (aes.left stays 0)
+void aesEncryptBlock(VAesKey &k, const uint8_t in[16], uint8_t out[16]){
+  wc_AesSetIV(&k.aes, in);
+  wc_AesCtrEncrypt(&k.aes, out, zeros, 16);
+}
+
+void aesEncryptBlocks(VAesKey *const *keys, const uint8_t (*in)[16], uint8_t (*out)[16], int n){
+  for (int i = 0, j; i < n; i = j) {
+    for (j = i + 1; j < n && keys[j] == keys[i]; j++);  // a run under one key
+#ifdef HAVE_AES_ECB
+    wc_AesEcbEncrypt(&keys[i]->aes, out[i], in[i], 16 * (j - i));
+#else
+    for (int b = i; b < j; b++) aesEncryptBlock(*keys[b], in[b], out[b]);
+#endif
+  }
+}
+
+const char *aesBatchImpl(){
+#ifdef HAVE_AES_ECB
+  return "wolfssl ecb";
+#else
+  return "wolfssl";
+#endif
+}
+
+#else
+// ---------------------------------------------------------------------------------------
+// Portable AES-128 (FIPS-197), encryption only
+
+static const uint8_t sbox[256] = {
+  0x63,0x7c,0x77,0x7b,0xf2,0x6b,0x6f,0xc5,0x30,0x01,0x67,0x2b,0xfe,0xd7,0xab,0x76,
+  0xca,0x82,0xc9,0x7d,0xfa,0x59,0x47,0xf0,0xad,0xd4,0xa2,0xaf,0x9c,0xa4,0x72,0xc0,
+  0xb7,0xfd,0x93,0x26,0x36,0x3f,0xf7,0xcc,0x34,0xa5,0xe5,0xf1,0x71,0xd8,0x31,0x15,
+  0x04,0xc7,0x23,0xc3,0x18,0x96,0x05,0x9a,0x07,0x12,0x80,0xe2,0xeb,0x27,0xb2,0x75,
+  0x09,0x83,0x2c,0x1a,0x1b,0x6e,0x5a,0xa0,0x52,0x3b,0xd6,0xb3,0x29,0xe3,0x2f,0x84,
+  0x53,0xd1,0x00,0xed,0x20,0xfc,0xb1,0x5b,0x6a,0xcb,0xbe,0x39,0x4a,0x4c,0x58,0xcf,
+  0xd0,0xef,0xaa,0xfb,0x43,0x4d,0x33,0x85,0x45,0xf9,0x02,0x7f,0x50,0x3c,0x9f,0xa8,
+  0x51,0xa3,0x40,0x8f,0x92,0x9d,0x38,0xf5,0xbc,0xb6,0xda,0x21,0x10,0xff,0xf3,0xd2,
+  0xcd,0x0c,0x13,0xec,0x5f,0x97,0x44,0x17,0xc4,0xa7,0x7e,0x3d,0x64,0x5d,0x19,0x73,
+  0x60,0x81,0x4f,0xdc,0x22,0x2a,0x90,0x88,0x46,0xee,0xb8,0x14,0xde,0x5e,0x0b,0xdb,
+  0xe0,0x32,0x3a,0x0a,0x49,0x06,0x24,0x5c,0xc2,0xd3,0xac,0x62,0x91,0x95,0xe4,0x79,
+  0xe7,0xc8,0x37,0x6d,0x8d,0xd5,0x4e,0xa9,0x6c,0x56,0xf4,0xea,0x65,0x7a,0xae,0x08,
+  0xba,0x78,0x25,0x2e,0x1c,0xa6,0xb4,0xc6,0xe8,0xdd,0x74,0x1f,0x4b,0xbd,0x8b,0x8a,
+  0x70,0x3e,0xb5,0x66,0x48,0x03,0xf6,0x0e,0x61,0x35,0x57,0xb9,0x86,0xc1,0x1d,0x9e,
+  0xe1,0xf8,0x98,0x11,0x69,0xd9,0x8e,0x94,0x9b,0x1e,0x87,0xe9,0xce,0x55,0x28,0xdf,
+  0x8c,0xa1,0x89,0x0d,0xbf,0xe6,0x42,0x68,0x41,0x99,0x2d,0x0f,0xb0,0x54,0xbb,0x16};
+
+static inline uint8_t xtime(uint8_t x){ return static_cast<uint8_t>((x << 1) ^ ((x >> 7) * 0x1b)); }
+
+bool aesSetKey(VAesKey &k, const uint8_t key[16]){
+  uint8_t *rk = k.rk;
+  uint8_t rcon = 0x01;
+  memcpy(rk, key, 16);
+  for (int i = 16; i < 176; i += 4) {
+    uint8_t t[4] = {rk[i-4], rk[i-3], rk[i-2], rk[i-1]};
+    if (i % 16 == 0) {                                  // RotWord, SubWord, Rcon
+      uint8_t t0 = t[0];
+      t[0] = sbox[t[1]] ^ rcon;
+      t[1] = sbox[t[2]];
+      t[2] = sbox[t[3]];
+      t[3] = sbox[t0];
+      rcon = xtime(rcon);
+    }
+    for (int j = 0; j < 4; j++) rk[i+j] = rk[i-16+j] ^ t[j];
+  }
+  return true;
+}
+
+void aesFreeKey(VAesKey &k){
+  memset(k.rk, 0, sizeof(k.rk));
+}
+
+void aesEncryptBlock(VAesKey &k, const uint8_t in[16], uint8_t out[16]){
+  const uint8_t *rk = k.rk;
+  uint8_t s[16];
+  for (int i = 0; i < 16; i++) s[i] = in[i] ^ rk[i];
+  for (int round = 1; round <= 10; round++) {
+    uint8_t t[16];
+    // SubBytes + ShiftRows (state is column major: s[col*4 + row])
+    for (int c = 0; c < 4; c++)
+      for (int r = 0; r < 4; r++) t[c*4 + r] = sbox[s[((c + r) & 3)*4 + r]];
+    if (round < 10) {                                   // MixColumns, not in the last round
+      for (int c = 0; c < 4; c++) {
+        uint8_t *col = t + c*4;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+        col[0] = a0 ^ all ^ xtime(a0 ^ a1);
+        col[1] = a1 ^ all ^ xtime(a1 ^ a2);
+        col[2] = a2 ^ all ^ xtime(a2 ^ a3);
+        col[3] = a3 ^ all ^ xtime(a3 ^ a0);
+      }
+    }
+    rk += 16;
+    for (int i = 0; i < 16; i++) s[i] = t[i] ^ rk[i];   // AddRoundKey
+  }
+  memcpy(out, s, 16);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// AES-NI: the round keys above are already in the byte order AESENC takes. Each AESENC takes a few
+// cycles to come out but a new one can start every cycle, so 4 blocks (any keys) are interleaved
+#include <immintrin.h>
+
+static inline __attribute__((target("aes,sse2"))) __m128i roundKey(const VAesKey *k, int round){
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(k->rk + round * 16));
+}
+
+__attribute__((target("aes,sse2")))
+static void encryptBlocksNi(VAesKey *const *keys, const uint8_t (*in)[16], uint8_t (*out)[16], int n){
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const VAesKey *k0 = keys[i], *k1 = keys[i + 1], *k2 = keys[i + 2], *k3 = keys[i + 3];
+    __m128i b0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[i])),     roundKey(k0, 0));
+    __m128i b1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[i + 1])), roundKey(k1, 0));
+    __m128i b2 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[i + 2])), roundKey(k2, 0));
+    __m128i b3 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[i + 3])), roundKey(k3, 0));
+    for (int round = 1; round < 10; round++) {
+      b0 = _mm_aesenc_si128(b0, roundKey(k0, round));
+      b1 = _mm_aesenc_si128(b1, roundKey(k1, round));
+      b2 = _mm_aesenc_si128(b2, roundKey(k2, round));
+      b3 = _mm_aesenc_si128(b3, roundKey(k3, round));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i]),     _mm_aesenclast_si128(b0, roundKey(k0, 10)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i + 1]), _mm_aesenclast_si128(b1, roundKey(k1, 10)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i + 2]), _mm_aesenclast_si128(b2, roundKey(k2, 10)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i + 3]), _mm_aesenclast_si128(b3, roundKey(k3, 10)));
+  }
+  for (; i < n; i++) {
+    __m128i b = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[i])), roundKey(keys[i], 0));
+    for (int round = 1; round < 10; round++) b = _mm_aesenc_si128(b, roundKey(keys[i], round));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out[i]), _mm_aesenclast_si128(b, roundKey(keys[i], 10)));
+  }
+}
+
+static bool hasAesNi(){
+  static const bool has = __builtin_cpu_supports("aes");
+  return has;
+}
+#else
+static void encryptBlocksNi(VAesKey *const *, const uint8_t (*)[16], uint8_t (*)[16], int){}
+static bool hasAesNi(){ return false; }
+#endif
+
+void aesEncryptBlocks(VAesKey *const *keys, const uint8_t (*in)[16], uint8_t (*out)[16], int n){
+  if (hasAesNi()) encryptBlocksNi(keys, in, out, n);
+  else for (int i = 0; i < n; i++) aesEncryptBlock(*keys[i], in[i], out[i]);
+}
+
+const char *aesBatchImpl(){
+  return hasAesNi() ? "aes-ni" : "portable";
+}
+
+#endif
+
+void aesKeystream(VAesKey &k, uint16_t iv, uint8_t ks[16]){
+  uint8_t ctr[16] = {static_cast<uint8_t>(iv & 0xFF), static_cast<uint8_t>(iv >> 8)};
+  aesEncryptBlock(k, ctr, ks);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+/* AES-128 with the key schedule expanded once, when the key is loaded.
+On the ESP32 this wraps wolfssl (wc_AesSetKey is called once per key, not per frame),
+on a Linux host a small portable AES-128 encryptor is used instead.
+Only encryption is needed: AES-CTR decrypts by XOR'ing the encrypted counter block. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ARDUINO) && !defined(VCORE_PORTABLE_AES)
+  #define VCORE_WOLFSSL 1
+  #include "wolfssl.h"
+  #include "wolfssl/wolfcrypt/aes.h"
+#endif
+
+struct VAesKey {
+#ifdef VCORE_WOLFSSL
+  Aes      aes;                 // wolfssl context, holds the expanded key schedule
+#else
+  uint8_t  rk[176];             // 11 round keys x 16 bytes
+#endif
+};
+
+// expand key[16] into k, false on failure
+bool aesSetKey(VAesKey &k, const uint8_t key[16]);
+// release any resources held by k
+void aesFreeKey(VAesKey &k);
+
+// one AES-128 block: out = AES(k, in)
+void aesEncryptBlock(VAesKey &k, const uint8_t in[16], uint8_t out[16]);
+
+#define VAES_BATCH   16       // blocks per aesEncryptBlocks() call, at most (= VRING_SIZE)
+
+// n blocks in one pass, each under its own key: out[i] = AES(*keys[i], in[i]). Blocks under the
+// same key are best kept together. On the ESP32 each run of them is one wolfssl ECB call (when
+// wolfssl has HAVE_AES_ECB), so the hardware AES engine is set up once per run, not per block;
+// on an x86 Linux host with AES-NI, 4 blocks go through the rounds side by side
+void aesEncryptBlocks(VAesKey *const *keys, const uint8_t (*in)[16], uint8_t (*out)[16], int n);
+// what aesEncryptBlocks() runs on: "wolfssl", "wolfssl ecb", "aes-ni" or "portable"
+const char *aesBatchImpl();
+
+// Victron AES-CTR keystream for one record: the counter block is the 16 bit
+// nonce/IV (little endian) padded with zeros, see "Extra Manufacturer Data"
+void aesKeystream(VAesKey &k, uint16_t iv, uint8_t ks[16]);
@@ -0,0 +1,121 @@
+/* Rolling window summaries (see VAggregate.h) */
+
+#include "VAggregate.h"
+#include "VFormat.h"
+
+#include <string.h>
+
+const uint32_t aggLenMs[VAGG_LEVELS] = {1000, 60000, 3600000};
+const char    *aggName[VAGG_LEVELS]  = {"1s", "1m", "1h"};
+
+const VAggField bmAggFields[VAGG_BM_FIELDS] = {{"V", 100, 2}, {"A", 1000, 2}, {"SOC%", 10, 1}};
+const VAggField scAggFields[VAGG_SC_FIELDS] = {{"V", 100, 2}, {"A",   10, 1}, {"PV W",  1, 0}};
+
+// a at or after b, across the millis() wrap
+static inline bool reached(uint32_t a, uint32_t b){ return static_cast<int32_t>(a - b) >= 0; }
+
+void initAggregator(VAggregator &a, const VAggField *desc, uint8_t fields){
+  memset(&a, 0, sizeof(a));
+  a.desc   = desc;
+  a.fields = fields > VAGG_FIELDS ? VAGG_FIELDS : fields;
+}
+
+static void openWindow(VAggWindow &w, uint32_t ms, int level){
+  memset(&w, 0, sizeof(w));
+  w.startMs = ms - ms % aggLenMs[level];
+}
+
+// fold the closed window c into w (open, and covering c)
+static void merge(VAggWindow &w, const VAggWindow &c, int fields){
+  w.count += c.count;
+  for (int i = 0; i < fields; i++) {
+    const VAggStat &s = c.f[i];
+    VAggStat &t = w.f[i];
+    if (!s.count) continue;
+    if (!t.count || s.min < t.min) t.min = s.min;
+    if (!t.count || s.max > t.max) t.max = s.max;
+    t.sum   += s.sum;
+    t.count += s.count;
+    t.last   = s.last;
+  }
+}
+
+/* Bottom up, each level closes at most once: a window that closes is merged into
+the one above (opened if need be), which is then checked in turn. So every open
+window ends after ms, and a new 1 sec window always falls inside those above it. */
+uint8_t aggTick(VAggregator &a, uint32_t ms){
+  uint8_t closed = 0;
+  if (reached(ms, a.lastMs)) a.lastMs = ms;
+  else ms = a.lastMs;
+  for (int l = 0; l < VAGG_LEVELS; l++) {
+    VAggWindow &w = a.w[l];
+    if (!w.count || !reached(ms, w.startMs + aggLenMs[l])) continue;
+    if (l + 1 < VAGG_LEVELS) {
+      if (!a.w[l + 1].count) openWindow(a.w[l + 1], w.startMs, l + 1);
+      merge(a.w[l + 1], w, a.fields);
+    }
+    a.closed[l] = w;
+    w.count = 0;
+    closed |= 1 << l;
+  }
+  return closed;
+}
+
+uint8_t aggAdd(VAggregator &a, uint32_t ms, const int32_t v[], uint8_t valid){
+  uint8_t closed = aggTick(a, ms);
+  VAggWindow &w = a.w[0];
+  if (!w.count) openWindow(w, a.lastMs, 0);
+  w.count++;
+  for (int i = 0; i < a.fields; i++) {
+    if (!((valid >> i) & 1)) continue;
+    VAggStat &s = w.f[i];
+    int32_t x = v[i];
+    if (!s.count || x < s.min) s.min = x;
+    if (!s.count || x > s.max) s.max = x;
+    s.sum += x;
+    s.count++;
+    s.last = x;
+  }
+  return closed;
+}
+
+int32_t aggMean(const VAggStat &s){
+  if (!s.count) return 0;
+  int64_t half = s.count / 2;
+  return static_cast<int32_t>(s.sum >= 0 ? (s.sum + half) / s.count : (s.sum - half) / static_cast<int64_t>(s.count));
+}
+
+// -- readings -> fields ---------------------------------------------------------------------
+
+void bmAggValues(const BatteryMonitorReading &r, int32_t v[], uint8_t &valid){
+  v[0]  = r.battV;                                          // 10 mV
+  v[1]  = r.battA;                                          // mA
+  v[2]  = r.soc;                                            // 0.1 %
+  valid = (r.valid & BM_BATTV ? 1 : 0) | (r.valid & BM_BATTA ? 2 : 0) | (r.valid & BM_SOC ? 4 : 0);
+}
+
+void scAggValues(const SolarChargerReading &r, int32_t v[], uint8_t &valid){
+  v[0]  = r.battV;                                          // 10 mV
+  v[1]  = r.battA;                                          // 100 mA
+  v[2]  = r.pvW;                                            // W
+  valid = (r.valid & SC_BATTV ? 1 : 0) | (r.valid & SC_BATTA ? 2 : 0) | (r.valid & SC_PVW ? 4 : 0);
+}
+
+void formatAgg(VLine &l, const VAggregator &a, int level){
+  const VAggWindow &w = a.closed[level];
+  lineStr(l, aggName[level]);
+  lineUInt(l, w.count, 5);
+  lineStr(l, " rdgs");
+  for (int i = 0; i < a.fields; i++) {
+    const VAggField &d = a.desc[i];
+    const VAggStat  &s = w.f[i];
+    lineStr(l, "  ");
+    lineStr(l, d.label);
+    lineChar(l, ' ');
+    if (!s.count) { lineStr(l, "n/a"); continue; }
+    lineFixed(l, s.min, d.scale, d.decimals);          lineChar(l, '/');
+    lineFixed(l, aggMean(s), d.scale, d.decimals);     lineChar(l, '/');
+    lineFixed(l, s.max, d.scale, d.decimals);          lineStr(l, " (");
+    lineFixed(l, s.last, d.scale, d.decimals);         lineChar(l, ')');
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/* Rolling 1 sec / 1 min / 1 hour summaries of a device's readings.
+For each of a few fields (battery volts, amps, PV watts, SOC ...) every window
+keeps the min, max, sum & count (for the mean) and last value, so the cost per
+reading is the same small constant however long the window. Windows are aligned
+to whole seconds / minutes / hours of millis(). Only the 1 sec window is updated
+per reading: when it closes it is merged into the 1 min window, and that into the
+1 hour window, so the extremes (e.g. a current spike) carry through to the hour.
+
+aggAdd() and aggTick() return a bit per level that closed, and the closed window
+is left in closed[level] as a single record until the level closes again.
+Windows with no readings are not emitted. Memory is fixed: nothing is allocated. */
+
+#include <stdint.h>
+#include "VDecode.h"
+
+#define VAGG_FIELDS   4           // values per reading, at most
+#define VAGG_LEVELS   3           // 1 sec, 1 min, 1 hour
+
+extern const uint32_t aggLenMs[VAGG_LEVELS];
+extern const char    *aggName[VAGG_LEVELS];   // "1s", "1m", "1h"
+
+// how a field is printed: value / scale to decimals places
+struct VAggField {
+  const char *label;
+  uint16_t    scale;
+  uint8_t     decimals;
+};
+
+struct VAggStat {
+  int64_t  sum;
+  int32_t  min, max, last;
+  uint32_t count;                 // readings with this field valid
+};
+
+struct VAggWindow {
+  uint32_t startMs;               // aligned to the window length
+  uint32_t count;                 // readings, 0 = not open
+  VAggStat f[VAGG_FIELDS];
+};
+
+struct VAggregator {
+  const VAggField *desc;
+  uint8_t    fields;
+  uint32_t   lastMs;              // time never goes back: later readings use this if older
+  VAggWindow w[VAGG_LEVELS];      // open windows
+  VAggWindow closed[VAGG_LEVELS]; // the last window closed at each level
+};
+
+void initAggregator(VAggregator &a, const VAggField *desc, uint8_t fields);
+// add a reading at ms: v[i] counts only if bit i of valid is set. Returns the levels closed
+uint8_t aggAdd(VAggregator &a, uint32_t ms, const int32_t v[], uint8_t valid);
+// close windows that ended by ms, with no reading since (call every so often)
+uint8_t aggTick(VAggregator &a, uint32_t ms);
+// mean of a field, rounded, in its own units
+int32_t aggMean(const VAggStat &s);
+
+// readings as aggregator fields: volts, amps, SOC (BM) or volts, amps, PV watts (SC)
+#define VAGG_BM_FIELDS 3
+#define VAGG_SC_FIELDS 3
+extern const VAggField bmAggFields[VAGG_BM_FIELDS];
+extern const VAggField scAggFields[VAGG_SC_FIELDS];
+void bmAggValues(const BatteryMonitorReading &r, int32_t v[], uint8_t &valid);
+void scAggValues(const SolarChargerReading &r, int32_t v[], uint8_t &valid);
+
+// a closed window as one line: "1m 300 rdgs  V 26.38/26.41/26.47 (26.40)  A ..." = min/mean/max (last)
+struct VLine;
+void formatAgg(VLine &l, const VAggregator &a, int level);
@@ -0,0 +1,137 @@
+/* Power balance of a battery bank from its devices' readings (see VBalance.h) */
+
+#include "VBalance.h"
+
+#include <string.h>
+
+void initBalance(VBalance &b){
+  memset(&b, 0, sizeof(b));
+  b.shunt.dev = -1;
+  for (VBalSource &s : b.chg) s.dev = -1;
+  b.effPermille = -1;
+}
+
+static void push(VBalSource &s, uint32_t ms, int32_t mA, int32_t cV, int32_t pvW){
+  s.s[s.head] = {ms, mA, cV, pvW};
+  s.head = (s.head + 1) % VBAL_SAMPLES;
+  if (s.n < VBAL_SAMPLES) s.n++;
+}
+
+// i = 1: the newest reading held, 2 the one before ...
+static const VBalSample &back(const VBalSource &s, int i){
+  return s.s[(s.head + VBAL_SAMPLES - i) % VBAL_SAMPLES];
+}
+
+static int32_t lerp(int32_t a, int32_t b, uint32_t d, uint32_t dt){
+  return a + static_cast<int32_t>(static_cast<int64_t>(b - a) * d / dt);
+}
+
+// s at time t, no later than its newest reading: between the two readings either side. false if
+// every one held is newer, the oldest taken
+static bool sampleAt(const VBalSource &s, uint32_t t, VBalSample &x){
+  for (int i = 1; i <= s.n; i++) {
+    const VBalSample &a = back(s, i);
+    if (static_cast<int32_t>(t - a.ms) < 0) continue;       // newer than t
+    if (i == 1 || t == a.ms) {x = a; return true;}
+    const VBalSample &c = back(s, i - 1);                   // the next one, newer than t
+    uint32_t d = t - a.ms, dt = c.ms - a.ms;
+    x = {t, lerp(a.mA, c.mA, d, dt), lerp(a.cV, c.cV, d, dt), a.pvW >= 0 && c.pvW >= 0 ? lerp(a.pvW, c.pvW, d, dt) : -1};
+    return true;
+  }
+  x = back(s, s.n);
+  return false;
+}
+
+static bool fresh(const VBalSource &s, uint32_t top){
+  return s.n && top - back(s, 1).ms <= VBAL_STALE_MS;
+}
+
+// a new balance, if the time of the oldest latest reading has moved on
+static bool update(VBalance &b){
+  if (!b.shunt.n) return false;
+  uint32_t top = back(b.shunt, 1).ms;                       // the newest reading of all
+  for (int i = 0; i < b.chargers; i++)
+    if (b.chg[i].n && static_cast<int32_t>(back(b.chg[i], 1).ms - top) > 0) top = back(b.chg[i], 1).ms;
+  if (!fresh(b.shunt, top)) return false;
+  uint32_t t = back(b.shunt, 1).ms;                         // the oldest latest reading
+  uint8_t used = 0;
+  for (int i = 0; i < b.chargers; i++) {
+    if (!fresh(b.chg[i], top)) continue;
+    used++;
+    if (static_cast<int32_t>(back(b.chg[i], 1).ms - t) < 0) t = back(b.chg[i], 1).ms;
+  }
+  if (!used || (b.valid && static_cast<int32_t>(t - b.ms) <= 0)) return false;
+  VBalSample x, c;
+  if (!sampleAt(b.shunt, t, x)) b.unaligned++;
+  int32_t chargeA = 0, pvA = 0, pvW = 0, pvs = 0;            // pvA: the output of the chargers with PV
+  for (int i = 0; i < b.chargers; i++) {
+    if (!fresh(b.chg[i], top)) continue;
+    if (!sampleAt(b.chg[i], t, c)) b.unaligned++;
+    chargeA += c.mA;
+    if (c.pvW < 0) continue;                                // PV N/A: no efficiency from this one
+    pvA += c.mA;
+    pvW += c.pvW;
+    pvs++;
+  }
+  b.valid    = true;
+  b.ms       = t;
+  b.lagMs    = top - t;
+  b.used     = used;
+  b.battV    = x.cV;
+  b.battA    = x.mA;
+  b.chargeA  = chargeA;
+  b.loadA    = chargeA - x.mA;
+  b.pvW      = pvs ? pvW : -1;
+  b.chargeMW = static_cast<int32_t>(static_cast<int64_t>(chargeA) * x.cV / 100);   // mA x 10 mV = 10 uW
+  b.loadMW   = static_cast<int32_t>(static_cast<int64_t>(b.loadA) * x.cV / 100);
+  b.effPermille = -1;
+  if (pvW >= VBAL_MIN_PV_W) {
+    int64_t eff = static_cast<int64_t>(pvA) * x.cV / 100 / pvW;                         // mW / W
+    if (eff >= 0 && eff <= VBAL_MAX_EFF) b.effPermille = static_cast<int16_t>(eff);     // else bad readings: none shown
+  }
+  b.balances++;
+  if (used < b.chargers) b.partial++;
+  return true;
+}
+
+bool balanceBM(VBalance &b, int dev, uint32_t ms, const BatteryMonitorReading &r){
+  if (b.shunt.dev < 0 || dev < b.shunt.dev) {             // the one listed first: it takes over
+    b.shunt = {};
+    b.shunt.dev = dev;
+  }
+  if (b.shunt.dev != dev) {b.extra++; return false;}
+  if ((r.valid & (BM_BATTV | BM_BATTA)) != (BM_BATTV | BM_BATTA)) return false;
+  push(b.shunt, ms, r.battA, r.battV, 0);
+  return update(b);
+}
+
+bool balanceSC(VBalance &b, int dev, uint32_t ms, const SolarChargerReading &r){
+  int i = 0;
+  while (i < b.chargers && b.chg[i].dev != dev) i++;
+  if (i == b.chargers) {
+    if (b.chargers >= VBAL_CHARGERS) {b.extra++; return false;}
+    b.chg[b.chargers++].dev = dev;
+  }
+  if ((r.valid & (SC_BATTV | SC_BATTA)) != (SC_BATTV | SC_BATTA)) return false;
+  push(b.chg[i], ms, r.battA * 100, r.battV, r.valid & SC_PVW ? r.pvW : -1);  // 100 mA
+  return update(b);
+}
+
+void formatBalance(VLine &l, const VBalance &b){
+  if (!b.valid) {lineStr(l, "no balance yet: a Battery Monitor and a Solar Controller needed"); return;}
+  lineStr(l, "PV ");
+  if (b.pvW >= 0) {lineFixed(l, b.pvW, 1, 0); lineChar(l, 'W');} else lineChar(l, '-');
+  lineStr(l, " -> ");
+  lineFixed(l, b.chargeA, 1000, 1);  lineStr(l, "A ");
+  lineFixed(l, b.chargeMW, 1000, 1); lineStr(l, "W (");
+  if (b.effPermille >= 0) {lineFixed(l, b.effPermille, 10, 1); lineChar(l, '%');}
+  else lineChar(l, '-');
+  lineStr(l, ")  batt "); if (b.battA >= 0) lineChar(l, '+');
+  lineFixed(l, b.battA, 1000, 1);    lineStr(l, "A ");
+  lineFixed(l, b.battV, 100, 2);     lineStr(l, "V  load ");
+  lineFixed(l, b.loadA, 1000, 1);    lineStr(l, "A ");
+  lineFixed(l, b.loadMW, 1000, 1);   lineStr(l, "W  | ");
+  lineUInt(l, b.used);               lineStr(l, b.used == 1 ? " charger" : " chargers");
+  if (b.used < b.chargers) {lineStr(l, " of "); lineUInt(l, b.chargers);}
+  lineStr(l, ", lag ");  lineUInt(l, b.lagMs); lineStr(l, " ms");
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/* Power balance of a battery bank, from the readings of its devices as they come.
+A Battery Monitor on the bank measures the net battery current; the Solar Controllers
+charging it report their output current and PV watts. Their readings arrive at their own
+times, about a second apart each, so the balance is worked out at the time of the oldest
+of the latest readings, every device's current and volts interpolated to that time
+between the two of its readings either side (the last VBAL_SAMPLES are kept). From them:
+  charge    the chargers' output current, and power at the bank volts
+  load      the inferred load: charge current less the net battery current, and power
+  MPPT      efficiency: the output power at the bank volts of the chargers reporting PV
+            watts, over those watts (a charger with PV N/A is left out of both); none if
+            over VBAL_MAX_EFF, as that is readings out of step or bad, not a real figure
+A balance is made each time that time moves on, so at least at the update rate of the
+slowest device. A device not heard for VBAL_STALE_MS is left out (partial), one heard again
+is taken back. The Battery Monitor listed first (the lowest device index heard) is the
+bank's, with up to VBAL_CHARGERS Solar Controllers. Fixed size, nothing allocated,
+O(devices x VBAL_SAMPLES) per reading. */
+
+#include <stdint.h>
+#include "VDecode.h"
+#include "VFormat.h"
+
+#define VBAL_CHARGERS   8         // Solar Controllers on the bank
+#define VBAL_SAMPLES    4         // readings kept per device, to align on
+#define VBAL_STALE_MS   10000     // not heard for longer: left out of the balance
+#define VBAL_MIN_PV_W   20        // less PV: no efficiency
+#define VBAL_MAX_EFF    1050      // permille: more is misaligned or bad readings, no efficiency
+
+struct VBalSample {
+  uint32_t ms;                    // received
+  int32_t  mA;                    // battery current: net (Battery Monitor), output (Solar Controller)
+  int32_t  cV;                    // battery volts, 10 mV
+  int32_t  pvW;                   // Solar Controller: PV watts, -1 if N/A
+};
+
+struct VBalSource {
+  int8_t     dev;                 // device index, -1 none
+  uint8_t    n, head;             // samples held, next written
+  VBalSample s[VBAL_SAMPLES];     // the last ones, a ring
+};
+
+struct VBalance {
+  VBalSource shunt;               // the bank's Battery Monitor
+  VBalSource chg[VBAL_CHARGERS];
+  uint8_t    chargers;
+  // the last balance, at ms
+  bool       valid;
+  uint32_t   ms;
+  uint32_t   lagMs;               // behind the newest reading it was made from
+  uint8_t    used;                // chargers in it
+  int32_t    battV;               // 10 mV, the bank's
+  int32_t    battA;               // mA, + charging
+  int32_t    chargeA;             // mA, the chargers' output
+  int32_t    loadA;               // mA, inferred
+  int32_t    pvW;                 // W, -1 if no charger in it reports it
+  int32_t    chargeMW, loadMW;    // mW, at the bank volts
+  int16_t    effPermille;         // MPPT efficiency, -1 too little PV or not within 0..VBAL_MAX_EFF
+  // counters
+  uint32_t   balances;
+  uint32_t   partial;             // balances with a charger left out, stale
+  uint32_t   unaligned;           // a device's readings all newer than the time: its oldest taken
+  uint32_t   extra;               // readings of a device not taken: another monitor, too many chargers
+};
+
+void initBalance(VBalance &b);
+// a device's decoded reading, received at ms: true if a new balance was made
+bool balanceBM(VBalance &b, int dev, uint32_t ms, const BatteryMonitorReading &r);
+bool balanceSC(VBalance &b, int dev, uint32_t ms, const SolarChargerReading &r);
+
+// "PV 412W -> 15.1A 393.2W (95.4%)  batt +7.0A 26.00V  load 8.1A 210.6W  | 2 chargers, lag 640 ms"
+void formatBalance(VLine &l, const VBalance &b);
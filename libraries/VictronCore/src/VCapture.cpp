@@ -0,0 +1,40 @@
+/* Binary capture records (see VCapture.h) */
+
+#include "VCapture.h"
+
+#include <string.h>
+
+static const uint8_t magic[4] = {'V', 'C', 'A', 'P'};
+
+size_t captureHeader(uint8_t out[VCAP_HEADER]){
+  memset(out, 0, VCAP_HEADER);
+  memcpy(out, magic, 4);
+  out[4] = VCAP_VERSION;
+  return VCAP_HEADER;
+}
+
+size_t captureFrame(const VFrame &f, uint8_t out[VCAP_RECORD_MAX]){
+  uint8_t len = f.len > VMFR_MAX ? VMFR_MAX : f.len;
+  out[0] = len;
+  for (int i = 0; i < 4; i++) out[1 + i] = f.ms >> (8 * i);
+  for (int i = 0; i < 6; i++) out[5 + i] = f.mac >> (8 * (5 - i));
+  out[11] = static_cast<uint8_t>(f.rssi);
+  memcpy(out + 12, f.data, len);
+  return 12 + len;
+}
+
+const uint8_t *captureFind(const uint8_t *buf, size_t n){
+  for (size_t i = 0; i + VCAP_HEADER <= n; i++)
+    if (!memcmp(buf + i, magic, 4) && buf[i + 4] == VCAP_VERSION) return buf + i + VCAP_HEADER;
+  return nullptr;
+}
+
+size_t captureNext(const uint8_t *p, size_t n, VFrame &f){
+  if (n < 12 || p[0] == VCAP_END || p[0] > VMFR_MAX || n < 12u + p[0]) return 0;
+  f.len  = p[0];
+  f.ms   = p[1] | (p[2] << 8) | (p[3] << 16) | (static_cast<uint32_t>(p[4]) << 24);
+  f.mac  = macFromBytes(p + 5);
+  f.rssi = static_cast<int8_t>(p[11]);
+  memcpy(f.data, p + 12, f.len);
+  return 12 + f.len;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/* Binary capture of the raw advertisements, to replay later (host/replay).
+A capture is an 8 byte header, "VCAP", version, 3 bytes 0, then one record per
+frame as the BLE callback queued it:
+  len (1)  millis() (4, little endian)  address (6, as displayed)  RSSI (1, signed)  data (len)
+i.e. 12 bytes + the manufacturer data (up to VMFR_MAX). A len of 0 (VCAP_END) ends
+the capture. Nothing is encrypted or decoded here, so a replay goes through the
+same decrypt & decode path as the original frames.
+
+The sketches stream a capture out over Serial, so it may follow some text:
+captureFind() skips to the header. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "VRing.h"
+
+#define VCAP_VERSION      1
+#define VCAP_HEADER       8
+#define VCAP_RECORD_MAX  (12 + VMFR_MAX)
+#define VCAP_END          0
+
+size_t captureHeader(uint8_t out[VCAP_HEADER]);
+size_t captureFrame(const VFrame &f, uint8_t out[VCAP_RECORD_MAX]);   // bytes written
+
+// first record after the header in buf[n] (any text before it skipped), nullptr if no header
+const uint8_t *captureFind(const uint8_t *buf, size_t n);
+// the record at p (n bytes left) into f. Returns bytes used, 0 at VCAP_END, a cut off record or
+// a length over VMFR_MAX
+size_t captureNext(const uint8_t *p, size_t n, VFrame &f);
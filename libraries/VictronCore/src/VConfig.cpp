@@ -0,0 +1,235 @@
+/* Site configuration blob (see VConfig.h) */
+
+#include "VConfig.h"
+
+#include <string.h>
+
+#define VCFG_TAG_DEVICE  'D'
+#define VCFG_TAG_FLAGS   'F'
+#define VCFG_TAG_DUD_BM  'B'
+#define VCFG_TAG_DUD_SC  'S'
+#define VCFG_DEVICE_LEN  22               // address & key, then the name
+
+static const uint8_t magic[4] = {'V', 'C', 'F', 'G'};
+
+static inline uint32_t get32(const uint8_t *p){ return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24; }
+static inline void put32(uint8_t *p, uint32_t v){ p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+// nibble at a time: 64 bytes of table, plenty for a blob read once at boot
+uint32_t crc32(const uint8_t *p, size_t n, uint32_t crc){
+  static const uint32_t t[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+                                 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  while (n--) {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ t[crc & 15];
+    crc = (crc >> 4) ^ t[crc & 15];
+  }
+  return ~crc;
+}
+
+void initConfig(VConfig &c){
+  memset(&c, 0, sizeof(c));
+  c.bm = bmOutlierDefaults;
+  c.sc = scOutlierDefaults;
+}
+
+bool configAddDevice(VConfig &c, uint64_t mac, const uint8_t key[16], const char *name){
+  if (!mac || c.count >= VDEV_MAX) return false;
+  for (int i = 0; i < c.count; i++) if (c.dev[i].mac == mac) return false;
+  VCfgDevice &d = c.dev[c.count++];
+  d.mac = mac;
+  memcpy(d.key, key, 16);
+  size_t n = name ? strlen(name) : 0;
+  if (n > VCFG_NAME - 1) n = VCFG_NAME - 1;
+  if (n) memcpy(d.name, name, n);
+  d.name[n] = 0;
+  return true;
+}
+
+// -- blob -----------------------------------------------------------------------------------
+
+// one record at p, false if it doesn't fit before end
+static bool record(uint8_t *&p, const uint8_t *end, uint8_t tag, const uint8_t *data, size_t len){
+  if (len > 255 || static_cast<size_t>(end - p) < 2 + len) return false;
+  *p++ = tag;
+  *p++ = static_cast<uint8_t>(len);
+  memcpy(p, data, len);
+  p += len;
+  return true;
+}
+
+static size_t dudRecord(const VOutlierCfg &o, uint8_t *d){
+  d[0] = o.k;
+  d[1] = o.confirm;
+  d[2] = o.fields;
+  for (int i = 0; i < o.fields; i++) {
+    const VOutFieldCfg &f = o.f[i];
+    put32(d + 3 + 16 * i,  static_cast<uint32_t>(f.min));
+    put32(d + 7 + 16 * i,  static_cast<uint32_t>(f.max));
+    put32(d + 11 + 16 * i, static_cast<uint32_t>(f.floor));
+    put32(d + 15 + 16 * i, static_cast<uint32_t>(f.maxRate));
+  }
+  return 3 + 16 * o.fields;
+}
+
+size_t configBuild(const VConfig &c, uint8_t *out, size_t max){
+  if (max < VCFG_HEADER + 4) return 0;
+  uint8_t *p = out + VCFG_HEADER, *end = out + max - 4;
+  uint8_t d[3 + 16 * VOUT_FIELDS];
+  for (int i = 0; i < c.count; i++) {
+    const VCfgDevice &v = c.dev[i];
+    for (int j = 0; j < 6; j++) d[j] = static_cast<uint8_t>(v.mac >> (40 - 8 * j));
+    memcpy(d + 6, v.key, 16);
+    size_t n = strnlen(v.name, VCFG_NAME - 1);
+    memcpy(d + VCFG_DEVICE_LEN, v.name, n);
+    if (!record(p, end, VCFG_TAG_DEVICE, d, VCFG_DEVICE_LEN + n)) return 0;
+  }
+  if (c.hasFlags && !record(p, end, VCFG_TAG_FLAGS, &c.flags, 1))                  return 0;
+  if (c.hasBM    && !record(p, end, VCFG_TAG_DUD_BM, d, dudRecord(c.bm, d)))       return 0;
+  if (c.hasSC    && !record(p, end, VCFG_TAG_DUD_SC, d, dudRecord(c.sc, d)))       return 0;
+  size_t body = p - out - VCFG_HEADER;
+  if (body > 0xFFFF) return 0;
+  memcpy(out, magic, 4);
+  out[4] = VCFG_VERSION;
+  out[5] = body & 0xFF;
+  out[6] = body >> 8;
+  put32(p, crc32(out, p - out));
+  return p + 4 - out;
+}
+
+bool configDudValid(const VOutlierCfg &o){
+  if (o.confirm < 2) return false;
+  for (int i = 0; i < o.fields; i++) {
+    const VOutFieldCfg &f = o.f[i];
+    if (f.min > f.max || f.floor < 0 || f.maxRate < 0) return false;
+  }
+  return true;
+}
+
+size_t configLength(const uint8_t *h){
+  if (memcmp(h, magic, 4) || h[4] != VCFG_VERSION) return 0;
+  return VCFG_HEADER + (h[5] | h[6] << 8) + 4;
+}
+
+/* Every record, checked. With c null nothing is kept, so configParse() checks the
+whole blob first and only then fills c: a bad blob leaves it as it was. */
+static bool walk(const uint8_t *blob, size_t n, VConfig *c){
+  if (n < VCFG_HEADER + 4 || configLength(blob) != n) return false;
+  if (crc32(blob, n - 4) != get32(blob + n - 4))     return false;
+  uint64_t macs[VDEV_MAX];
+  int count = 0;
+  const uint8_t *p = blob + VCFG_HEADER, *end = blob + n - 4;
+  while (p < end) {
+    if (end - p < 2 || end - p - 2 < p[1]) return false;
+    uint8_t tag = p[0], len = p[1];
+    const uint8_t *d = p + 2;
+    p += 2 + len;
+    switch (tag) {
+      case VCFG_TAG_DEVICE: {
+        if (len < VCFG_DEVICE_LEN || len > VCFG_DEVICE_LEN + VCFG_NAME - 1 || count == VDEV_MAX) return false;
+        uint64_t mac = macFromBytes(d);
+        if (!mac) return false;
+        for (int i = 0; i < count; i++) if (macs[i] == mac) return false;
+        macs[count++] = mac;
+        if (!c) break;
+        VCfgDevice &v = c->dev[c->count++];
+        v.mac = mac;
+        memcpy(v.key, d + 6, 16);
+        memcpy(v.name, d + VCFG_DEVICE_LEN, len - VCFG_DEVICE_LEN);
+        v.name[len - VCFG_DEVICE_LEN] = 0;
+        break;
+      }
+      case VCFG_TAG_FLAGS:
+        if (len != 1) return false;
+        if (c) { c->hasFlags = true; c->flags = d[0]; }
+        break;
+      case VCFG_TAG_DUD_BM:
+      case VCFG_TAG_DUD_SC: {
+        if (len < 3 || d[2] > VOUT_FIELDS || len != 3 + 16 * d[2]) return false;
+        VOutlierCfg o = tag == VCFG_TAG_DUD_BM ? bmOutlierDefaults : scOutlierDefaults;
+        o.k       = d[0];
+        o.confirm = d[1];
+        for (int i = 0; i < d[2] && i < o.fields; i++) {
+          VOutFieldCfg &f = o.f[i];
+          f.min     = static_cast<int32_t>(get32(d + 3 + 16 * i));
+          f.max     = static_cast<int32_t>(get32(d + 7 + 16 * i));
+          f.floor   = static_cast<int32_t>(get32(d + 11 + 16 * i));
+          f.maxRate = static_cast<int32_t>(get32(d + 15 + 16 * i));
+        }
+        if (!configDudValid(o)) return false;               // a dud test that makes no sense
+        if (!c) break;
+        (tag == VCFG_TAG_DUD_BM ? c->bm : c->sc) = o;
+        (tag == VCFG_TAG_DUD_BM ? c->hasBM : c->hasSC) = true;
+        break;
+      }
+      default: break;                                       // a newer record: skipped
+    }
+  }
+  return true;
+}
+
+bool configParse(const uint8_t *blob, size_t n, VConfig &c){
+  if (!walk(blob, n, nullptr)) return false;
+  initConfig(c);
+  return walk(blob, n, &c);
+}
+
+int configDevices(const VConfig &c, VDeviceTable &t){
+  initDevices(t);
+  int loaded = 0;
+  for (int i = 0; i < c.count; i++) loaded += addDevice(t, c.dev[i].mac, c.dev[i].key, c.dev[i].name) != nullptr;
+  return loaded;
+}
+
+// -- storage ---------------------------------------------------------------------------------
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <Preferences.h>
+
+size_t configRead(const char *where, uint8_t *buf, size_t max){
+  Preferences p;
+  if (!p.begin(VCFG_NVS_NS, true)) return 0;                // read only: fails if nothing was ever stored
+  size_t n = p.isKey(where) ? p.getBytesLength(where) : 0;
+  if (n > max) n = 0;
+  if (n) n = p.getBytes(where, buf, n);
+  p.end();
+  return n;
+}
+
+bool configStore(const char *where, const uint8_t *blob, size_t n){
+  Preferences p;
+  if (!p.begin(VCFG_NVS_NS, false)) return false;
+  bool ok = n ? p.putBytes(where, blob, n) == n : !p.isKey(where) || p.remove(where);
+  p.end();
+  return ok;
+}
+
+#else
+
+#include <stdio.h>
+
+size_t configRead(const char *where, uint8_t *buf, size_t max){
+  FILE *f = fopen(where, "rb");
+  if (!f) return 0;
+  size_t n = fread(buf, 1, max, f);
+  if (n == max && fgetc(f) != EOF) n = 0;                   // too big
+  fclose(f);
+  return n;
+}
+
+bool configStore(const char *where, const uint8_t *blob, size_t n){
+  FILE *f;
+  if (!n) {
+    remove(where);
+    if ((f = fopen(where, "rb"))) fclose(f);
+    return !f;
+  }
+  f = fopen(where, "wb");
+  if (!f) return false;
+  bool ok = fwrite(blob, 1, n, f) == n;
+  return fclose(f) == 0 && ok;
+}
+
+#endif
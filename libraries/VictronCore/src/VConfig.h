@@ -0,0 +1,80 @@
+#pragma once
+
+/* Site configuration as a compact binary blob: the devices, their keys and the dud
+test settings, loaded at boot so a new site needs no rebuild or reflash.
+
+A blob is a 7 byte header, then records, then a CRC:
+  "VCFG"  version (1)  body length (2, little endian)
+  records, each  tag (1)  length (1)  data (length)
+  CRC-32 (4, little endian) of the header and body
+Records (tags not known here are skipped, so an older program reads a newer blob):
+  'D'  a device: address (6, as displayed)  key (16)  name (the rest, up to VCFG_NAME - 1)
+  'F'  flags, 1 byte: VCFG_FILTERING | VCFG_LOAD_AMPS | VCFG_VERBOSE
+  'B'  dud test for Battery Monitors  k (1) confirm (1) fields (1), then per field
+  'S'  ... for Solar Controllers      min, max, floor, maxRate (4 each, little endian)
+A device is 24 bytes + its name, so 32 devices fit in about 1.5 KB.
+
+configParse() checks the whole blob (CRC, lengths, addresses, no duplicates, dud test
+settings that make sense) before anything is used, into a VConfig; configDevices() then loads its devices into a
+VDeviceTable, key schedules expanded, once at boot. The names stay in the VConfig,
+which must outlive the table.
+
+On the ESP32 the blob is kept in NVS (Preferences, namespace VCFG_NVS_NS) under a
+key, on Linux in a file: configRead() / configStore() take the key or the path.
+host/mkconfig writes a blob from hex keys; the sketches take one over Serial ("U"). */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "VDevices.h"
+#include "VOutlier.h"
+
+#define VCFG_VERSION   1
+#define VCFG_HEADER    7
+#define VCFG_MAX       2048           // largest blob
+#define VCFG_NAME      24             // bytes per device name, with the 0
+#define VCFG_NVS_NS    "victron"      // NVS namespace on the ESP32
+#define VCFG_NVS_KEY   "config"       // ... and key the sketches keep their blob under
+
+enum : uint8_t {                      // VConfig::flags
+  VCFG_FILTERING = 0x01,
+  VCFG_LOAD_AMPS = 0x02,
+  VCFG_VERBOSE   = 0x04,
+};
+
+struct VCfgDevice {
+  uint64_t mac;
+  uint8_t  key[16];
+  char     name[VCFG_NAME];
+};
+
+struct VConfig {
+  int         count;
+  VCfgDevice  dev[VDEV_MAX];
+  bool        hasFlags, hasBM, hasSC;   // records present: else the program's own defaults stand
+  uint8_t     flags;
+  VOutlierCfg bm, sc;                   // labels as bmOutlierDefaults / scOutlierDefaults
+};
+
+// empty: no devices or flags, dud tests as the defaults
+void initConfig(VConfig &c);
+// false if full, the address is 0 or already there
+bool configAddDevice(VConfig &c, uint64_t mac, const uint8_t key[16], const char *name);
+// c as a blob in out[max]: bytes written, 0 if it doesn't fit
+size_t configBuild(const VConfig &c, uint8_t *out, size_t max);
+// dud test settings a blob may carry: confirm 2 or more, min <= max and no negative floor
+// or maxRate per field (k 0 is hard limits only, as K steps to)
+bool configDudValid(const VOutlierCfg &o);
+// whole blob length from its first VCFG_HEADER bytes, 0 if not a header
+size_t configLength(const uint8_t *header);
+// the n byte blob into c. false (c as it was) unless all of it is good
+bool configParse(const uint8_t *blob, size_t n, VConfig &c);
+// the devices into t (emptied first), key schedules expanded. Devices loaded
+int configDevices(const VConfig &c, VDeviceTable &t);
+
+// the stored blob into buf[max]: NVS key on the ESP32, file elsewhere. Bytes read, 0 if none
+size_t configRead(const char *where, uint8_t *buf, size_t max);
+// keep the blob (n = 0: remove it), false on a write error
+bool configStore(const char *where, const uint8_t *blob, size_t n);
+
+// CRC-32 (IEEE 802.3, as zlib), continued from crc
+uint32_t crc32(const uint8_t *p, size_t n, uint32_t crc = 0);
@@ -0,0 +1,61 @@
+#pragma once
+
+/* Hardware independent decoding of the 16 decrypted bytes advertised by a
+Victron Battery Monitor (BM) or Solar Controller (SC).
+No Arduino, BLE or wolfssl dependencies, so the same code runs on the ESP32
+and on a Linux host (see host/bench_decode.cpp) */
+
+#include <stdint.h>
+
+// ----------------------------------------------------------------------------
+// Decoded readings hold each value in the record's own integer units, so decoding
+// is shifts and masks only (no float), and a value not sent (N/A) just has its bit
+// clear in valid. Plain structs, no globals: decode is re-entrant, any number of
+// devices or tasks can decode at once. Convert to float or text only when shown
+// (see VFormat.h).
+
+// Battery Monitor (see "Battery Monitor" table, p3 of "Extra Manufacturer Data")
+enum : uint8_t {              // BatteryMonitorReading::valid
+  BM_TTG   = 0x01,            // clear: infinite (not discharging)
+  BM_BATTV = 0x02,
+  BM_AUX   = 0x04,            // aux value, clear if N/A or aux = 3 (none)
+  BM_BATTA = 0x08,
+  BM_AH    = 0x10,
+  BM_SOC   = 0x20,
+};
+
+struct BatteryMonitorReading {
+  int32_t  auxVal;      // aux V or mid V in 10 mV, or 10 mK, depending on aux
+  int32_t  battA;       // mA, -2097152 -> 2097150
+  uint32_t usedAh;      // 100 mAh consumed, 0 -> 1048574
+  uint16_t ttgMin;      // minutes, 0 -> 65534
+  int16_t  battV;       // 10 mV
+  uint16_t alarmBits;   // VE_REG_ALARM_REASON
+  uint16_t soc;         // 0.1 %, 0 -> 1000 (more is an error)
+  uint8_t  aux;         // 0: aux V 1: mid V 2: Kelvin 3: none
+  uint8_t  valid;       // BM_... bits, set if the value was sent
+};
+
+// Solar Controller (see "Solar Charger" table, p3 of "Extra Manufacturer Data")
+enum : uint8_t {              // SolarChargerReading::valid
+  SC_BATTV = 0x01,
+  SC_BATTA = 0x02,
+  SC_KWH   = 0x04,
+  SC_PVW   = 0x08,
+  SC_LOADA = 0x10,
+};
+
+struct SolarChargerReading {
+  int16_t  battV;       // 10 mV
+  int16_t  battA;       // 100 mA
+  uint16_t yield10Wh;   // today, 10 Wh
+  uint16_t pvW;         // W
+  uint16_t loadA;       // 100 mA, 0 -> 510
+  uint8_t  state;       // VE_REG_DEVICE_STATE
+  uint8_t  error;       // VE_REG_CHR_ERROR_CODE
+  uint8_t  valid;       // SC_... bits, set if the value was sent
+};
+
+// decode the 16 decrypted bytes in output[] into r
+void decodeBM(const uint8_t output[16], BatteryMonitorReading &r);
+void decodeSC(const uint8_t output[16], SolarChargerReading &r);
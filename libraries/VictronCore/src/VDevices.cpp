@@ -0,0 +1,237 @@
+/* Device table: 48 bit address -> device, key & expanded key schedule (see VDevices.h) */
+
+#include "VDevices.h"
+#include "VRing.h"
+
+#include <string.h>
+
+// Fibonacci hashing: multiply by 2^64/phi, keep the top bits
+static inline uint32_t macHash(uint64_t mac){
+  return static_cast<uint32_t>((mac * 0x9E3779B97F4A7C15ull) >> 58) & (VDEV_SLOTS - 1);   // 58 = 64 - log2(VDEV_SLOTS)
+}
+static_assert(VDEV_SLOTS == 64, "macHash() shift assumes 64 slots");
+static_assert(VDEV_SLOTS >= 2 * VDEV_MAX, "hash index too small");
+
+void initDevices(VDeviceTable &t){
+  memset(t.slot, 0, sizeof(t.slot));
+  t.count = 0;
+}
+
+VDevice *addDevice(VDeviceTable &t, uint64_t mac, const uint8_t key[16], const char *name){
+  if (t.count >= VDEV_MAX || findDevice(t, mac)) return nullptr;
+  VDevice &d = t.dev[t.count];
+  d.mac  = mac;
+  d.name = name;
+  memcpy(d.key, key, 16);
+  if (!aesSetKey(d.aes, key)) return nullptr;
+  memset(d.ksCache, 0, sizeof(d.ksCache));
+  d.lastIv   = 0;
+  d.ksHits   = 0;
+  d.ksMisses = 0;
+  d.lastLen    = 0;
+  d.accepted   = 0;
+  d.suppressed = 0;
+  uint32_t h = macHash(mac);
+  while (t.slot[h]) h = (h + 1) & (VDEV_SLOTS - 1);       // linear probe, never full
+  t.slot[h] = ++t.count;
+  return &d;
+}
+
+VDevice *findDevice(VDeviceTable &t, uint64_t mac){
+  uint32_t h = macHash(mac);
+  while (uint8_t s = t.slot[h]) {
+    if (t.dev[s - 1].mac == mac) return &t.dev[s - 1];
+    h = (h + 1) & (VDEV_SLOTS - 1);
+  }
+  return nullptr;
+}
+
+uint64_t macFromBytes(const uint8_t b[6]){
+  uint64_t mac = 0;
+  for (int i = 0; i < 6; i++) mac = (mac << 8) | b[i];
+  return mac;
+}
+
+static int hexVal(char c){
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+uint64_t macFromString(const char *s){
+  uint64_t mac = 0;
+  for (int i = 0; i < 6; i++) {
+    int hi = hexVal(s[0]), lo = hi < 0 ? -1 : hexVal(s[1]);
+    if (lo < 0) return 0;
+    mac = (mac << 8) | (hi << 4) | lo;
+    s += 2;
+    if (i < 5 && *s++ != ':') return 0;
+  }
+  return *s ? 0 : mac;
+}
+
+bool isVictronData(const uint8_t *mfr, size_t len){
+  return len >= VMFR_MIN && mfr[0] == 0xE1        // second byte of Victron company identifier 0x02E1 (little endian)
+                         && mfr[1] == 0x02        // first byte
+                         && mfr[2] == 0x10;       // indicates manufacturer data follows next
+}
+
+const uint8_t *findVictronData(const uint8_t *payload, size_t payloadLen, size_t &len){
+  size_t i = 0;
+  while (i + 1 < payloadLen) {
+    size_t adLen = payload[i];                          // covers the type byte + data
+    if (adLen == 0 || i + 1 + adLen > payloadLen) break;  // end of significant part, or truncated
+    if (payload[i + 1] == 0xFF && isVictronData(payload + i + 2, adLen - 1)) {   // AD type: manufacturer specific data
+      len = adLen - 1;
+      return payload + i + 2;
+    }
+    i += 1 + adLen;
+  }
+  return nullptr;
+}
+
+// -- duplicate suppression ---------------------------------------------------------------
+
+bool isDuplicate(VDevice &d, const uint8_t *mfr, size_t len){
+  if (len > VMFR_MAX) len = VMFR_MAX;
+  if (len < VMFR_MIN) return false;                     // nothing to compare, let decryptFrame() reject it
+  size_t n = len - VMFR_IV;
+  if (n == d.lastLen && memcmp(d.last, mfr + VMFR_IV, n) == 0) {
+    d.suppressed++;
+    return true;
+  }
+  return false;
+}
+
+void dedupAccept(VDevice &d, const uint8_t *mfr, size_t len){
+  if (len > VMFR_MAX) len = VMFR_MAX;
+  if (len < VMFR_MIN) return;
+  size_t n = len - VMFR_IV;
+  memcpy(d.last, mfr + VMFR_IV, n);
+  d.lastLen = static_cast<uint8_t>(n);
+  d.accepted++;
+}
+
+void dedupStats(const VDeviceTable &t, uint32_t &accepted, uint32_t &suppressed){
+  accepted = suppressed = 0;
+  for (int i = 0; i < t.count; i++) { accepted += t.dev[i].accepted; suppressed += t.dev[i].suppressed; }
+}
+
+// -- keystream cache ---------------------------------------------------------------------
+
+static inline VKeystream &ksSlot(VDevice &d, uint16_t iv){
+  return d.ksCache[iv & (VKS_CACHE - 1)];
+}
+
+// true if a new keystream was computed
+static bool fillKeystream(VDevice &d, uint16_t iv){
+  VKeystream &e = ksSlot(d, iv);
+  if (e.valid && e.iv == iv) return false;
+  aesKeystream(d.aes, iv, e.ks);
+  e.iv    = iv;
+  e.valid = true;
+  return true;
+}
+
+static const uint8_t *getKeystream(VDevice &d, uint16_t iv){
+  VKeystream &e = ksSlot(d, iv);
+  if (e.valid && e.iv == iv) d.ksHits++;
+  else { fillKeystream(d, iv); d.ksMisses++; }
+  d.lastIv = iv;
+  return e.ks;
+}
+
+int precomputeKeystreams(VDeviceTable &t, int budget){
+  int done = 0;
+  for (int ahead = 1; ahead < VKS_CACHE; ahead++)         // nearest IVs first, across all devices
+    for (int i = 0; i < t.count && done < budget; i++) {
+      VDevice &d = t.dev[i];
+      if (d.ksHits + d.ksMisses == 0) continue;           // no IV seen yet
+      if (fillKeystream(d, static_cast<uint16_t>(d.lastIv + ahead))) done++;
+    }
+  return done;
+}
+
+void keystreamStats(const VDeviceTable &t, uint32_t &hits, uint32_t &misses){
+  hits = misses = 0;
+  for (int i = 0; i < t.count; i++) { hits += t.dev[i].ksHits; misses += t.dev[i].ksMisses; }
+}
+
+// -----------------------------------------------------------------------------------------
+
+bool decryptFrame(VDevice &d, const uint8_t *mfr, size_t len, uint8_t out[16]){
+  if (len < VMFR_MIN || mfr[VMFR_KEY0] != d.key[0]) return false;
+  size_t n = len - VMFR_CIPHER;
+  if (n > 16) n = 16;
+  const uint8_t *ks = getKeystream(d, mfr[VMFR_IV] | (mfr[VMFR_IV + 1] << 8));
+  for (size_t i = 0; i < n;  i++) out[i] = mfr[VMFR_CIPHER + i] ^ ks[i];
+  for (size_t i = n; i < 16; i++) out[i] = 0xFF;
+  return true;
+}
+
+static_assert(VAES_BATCH >= VRING_SIZE, "a batch from the ring must fit one decryptFrames() call");
+
+int decryptFrames(VDeviceTable &t, const VFrame *f, int n, uint8_t (*out)[16], bool *ok){
+  VDevice *dev[VAES_BATCH];
+  int8_t   job[VAES_BATCH];                             // each frame's keystream: -1 cached, else run[at[job]]
+  VDevice *jobDev[VAES_BATCH];                          // keystreams to compute ...
+  uint16_t jobIv[VAES_BATCH];
+  int8_t   at[VAES_BATCH];                              // ... and where each is in the pass
+  VAesKey *keys[VAES_BATCH];                            // the pass, same device together (same key runs)
+  uint8_t  ctr[VAES_BATCH][16];
+  uint8_t  run[VAES_BATCH][16];
+  int      m = 0, decrypted = 0;
+  if (n > VAES_BATCH) n = VAES_BATCH;
+  for (int i = 0; i < n; i++) {                         // -- keystreams wanted
+    ok[i]  = false;
+    job[i] = -1;
+    dev[i] = findDevice(t, f[i].mac);
+    if (!dev[i] || f[i].len < VMFR_MIN || f[i].data[VMFR_KEY0] != dev[i]->key[0]) { dev[i] = nullptr; continue; }
+    VDevice &d = *dev[i];
+    uint16_t iv = f[i].data[VMFR_IV] | (f[i].data[VMFR_IV + 1] << 8);
+    VKeystream &e = ksSlot(d, iv);
+    d.lastIv = iv;
+    if (e.valid && e.iv == iv) {d.ksHits++; continue;}
+    int k = 0;
+    while (k < m && !(jobDev[k] == &d && jobIv[k] == iv)) k++;
+    job[i] = k;
+    if (k < m) {d.ksHits++; continue;}                  // a repeat in this batch: computed once
+    d.ksMisses++;
+    jobDev[m] = &d;
+    jobIv[m]  = iv;
+    m++;
+  }
+  int8_t order[VAES_BATCH];                             // jobs by device
+  for (int k = 0; k < m; k++) {
+    int p = k;
+    for (; p > 0 && jobDev[order[p - 1]] > jobDev[k]; p--) order[p] = order[p - 1];
+    order[p] = k;
+  }
+  for (int p = 0; p < m; p++) {
+    int k = order[p];
+    at[k]   = p;
+    keys[p] = &jobDev[k]->aes;
+    memset(ctr[p], 0, 16);
+    ctr[p][0] = jobIv[k] & 0xFF;
+    ctr[p][1] = jobIv[k] >> 8;
+  }
+  if (m) aesEncryptBlocks(keys, ctr, run, m);           // -- the one pass
+  for (int i = 0; i < n; i++) {                         // -- decrypt, before the cache changes
+    if (!dev[i]) continue;
+    const uint8_t *ks = job[i] >= 0 ? run[at[job[i]]] : ksSlot(*dev[i], f[i].data[VMFR_IV] | (f[i].data[VMFR_IV + 1] << 8)).ks;
+    size_t len = f[i].len - VMFR_CIPHER;
+    if (len > 16) len = 16;
+    for (size_t b = 0; b < len;  b++) out[i][b] = f[i].data[VMFR_CIPHER + b] ^ ks[b];
+    for (size_t b = len; b < 16; b++) out[i][b] = 0xFF;
+    ok[i] = true;
+    decrypted++;
+  }
+  for (int k = 0; k < m; k++) {                         // -- and cache what was computed, in frame order
+    VKeystream &e = ksSlot(*jobDev[k], jobIv[k]);
+    memcpy(e.ks, run[at[k]], 16);
+    e.iv    = jobIv[k];
+    e.valid = true;
+  }
+  return decrypted;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+/* Table of target devices, so one receiver can serve many Victron devices.
+Devices are found by their 48 bit address through a small hash index (O(1), no
+string compares), and each holds its encryption key with the AES key schedule
+expanded once, when added.
+
+Each device also caches the AES-CTR keystream for its last few IVs. Victron repeats
+an advertisement many times before the IV moves on, so a repeat decrypts with a
+16 byte XOR. precomputeKeystreams() fills in the next IVs while idle, so a fresh
+IV is normally a cache hit too.
+
+isDuplicate() goes one step earlier: it drops a frame that is byte for byte the
+same (IV + encrypted data) as the last one accepted from that device (dedupAccept()),
+before it is copied, decrypted, decoded or reported. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "VAes.h"
+
+#define VDEV_MAX     32       // max devices served by one receiver
+#define VDEV_SLOTS   64       // hash index size, power of 2 and at least 2 x VDEV_MAX
+#define VKS_CACHE     4       // keystreams cached per device: current IV + next 3, power of 2
+
+// offsets into the manufacturer data (see docs/Ad Data Structure - *.txt)
+#define VMFR_RECORD   6       // record type: 0x01 Solar Charger, 0x02 Battery Monitor ...
+#define VMFR_IV       7       // nonce/IV, 2 bytes little endian
+#define VMFR_KEY0     9       // byte 0 of the encryption key
+#define VMFR_CIPHER  10       // encrypted data, up to 16 bytes
+#define VMFR_MIN     11       // shortest manufacturer data worth decrypting
+#define VMFR_MAX     26       // longest manufacturer data kept (IV, key byte + 16 encrypted)
+
+struct VKeystream {
+  uint16_t iv;
+  bool     valid;
+  uint8_t  ks[16];            // AES(key, iv padded with zeros)
+};
+
+struct VDevice {
+  uint64_t    mac;            // 48 bit address, aa:bb:cc:dd:ee:ff = 0xaabbccddeeff
+  const char *name;
+  uint8_t     key[16];
+  VAesKey     aes;            // key schedule, expanded by addDevice()
+  VKeystream  ksCache[VKS_CACHE];   // direct mapped on iv, so consecutive IVs never collide
+  uint16_t    lastIv;         // IV of the last frame decrypted
+  uint32_t    ksHits;         // keystream found in ksCache[]
+  uint32_t    ksMisses;       // AES run on the hot path
+  uint8_t     lastLen;        // last frame accepted: length of & bytes from VMFR_IV on
+  uint8_t     last[VMFR_MAX - VMFR_IV];
+  uint32_t    accepted;       // frames passed on, dedupAccept()
+  uint32_t    suppressed;     // repeats dropped by isDuplicate()
+};
+
+struct VDeviceTable {
+  VDevice dev[VDEV_MAX];
+  uint8_t slot[VDEV_SLOTS];   // hash index: 0 = empty, else index into dev[] + 1
+  uint8_t count;
+};
+
+void     initDevices(VDeviceTable &t);
+// add a device, expanding its key schedule. nullptr if the table is full or the mac is already present
+VDevice *addDevice(VDeviceTable &t, uint64_t mac, const uint8_t key[16], const char *name);
+// nullptr if mac is not a target device
+VDevice *findDevice(VDeviceTable &t, uint64_t mac);
+
+uint64_t macFromBytes(const uint8_t b[6]);        // b[0] is the first byte displayed
+uint64_t macFromString(const char *s);            // "aa:bb:cc:dd:ee:ff", 0 if malformed
+
+// true if mfr[] is Victron "Extra Manufacturer Data" (company id 0x02E1, record 0x10)
+bool isVictronData(const uint8_t *mfr, size_t len);
+// the Victron manufacturer data inside a raw advertising payload (AD structures: length, type,
+// data), as a view into payload[] with its length in len - nothing is copied. nullptr if none
+const uint8_t *findVictronData(const uint8_t *payload, size_t payloadLen, size_t &len);
+
+// true if mfr[] repeats the last frame accepted from d (same IV and encrypted data), counted
+// as suppressed. Nothing is kept otherwise: dedupAccept() once the frame is passed on
+bool isDuplicate(VDevice &d, const uint8_t *mfr, size_t len);
+// mfr[] becomes d's last frame, counted as accepted. Only after it is queued: a frame dropped
+// on a full ring must not make its repeats look like duplicates
+void dedupAccept(VDevice &d, const uint8_t *mfr, size_t len);
+
+// accepted & suppressed frames summed over all devices
+void dedupStats(const VDeviceTable &t, uint32_t &accepted, uint32_t &suppressed);
+
+// compute the keystreams for the IVs following each device's last IV, at most budget AES
+// blocks in all (call while idle). Returns the number of blocks computed
+int precomputeKeystreams(VDeviceTable &t, int budget);
+
+// keystream cache hits & misses summed over all devices
+void keystreamStats(const VDeviceTable &t, uint32_t &hits, uint32_t &misses);
+
+// decrypt the record in mfr[] into out[16] using d's key. Bytes not transmitted are set
+// to 0xFF (= N/A). false if the key does not match (byte 0 check) or mfr[] is too short
+bool decryptFrame(VDevice &d, const uint8_t *mfr, size_t len, uint8_t out[16]);
+
+// decryptFrame() for n frames (at most VAES_BATCH) in one pass, from any mix of devices: the keystreams
+// not already cached are computed together by aesEncryptBlocks(), grouped by device, then cached.
+// ok[i] is false if f[i]'s device is not in t or the key does not match. Returns the number decrypted
+struct VFrame;
+int decryptFrames(VDeviceTable &t, const VFrame *f, int n, uint8_t (*out)[16], bool *ok);
@@ -0,0 +1,124 @@
+/* Energy & charge integrated from the readings (see VEnergy.h) */
+
+#include "VEnergy.h"
+
+#include <string.h>
+
+#define MWH   360000000ll         // 10 uW x ms in a mWh
+#define MAH   3600000ll           // mA x ms in a mAh, W x ms in a Wh
+
+void initEnergy(VEnergy &e){
+  memset(&e, 0, sizeof(e));
+}
+
+static int32_t clamp32(int64_t v){
+  return v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : static_cast<int32_t>(v);
+}
+
+// the area under the line from a to b over dt, split by sign into pos & neg (neg <= 0)
+static void trapezoid(int64_t a, int64_t b, uint32_t dt, int64_t &pos, int64_t &neg){
+  if ((a >= 0) == (b >= 0)) {
+    int64_t area = (a + b) * dt / 2;
+    if (area >= 0) pos += area; else neg += area;
+    return;
+  }
+  int64_t t0 = static_cast<int64_t>(dt) * 1000 * a / (a - b);   // where it crosses 0, in us
+  int64_t first = a * t0 / 2000, second = b * (dt * 1000ll - t0) / 2000;
+  if (a >= 0) {pos += first; neg += second;}
+  else        {neg += first; pos += second;}
+}
+
+// one reading: integrated from the one held, if any and close enough, then held
+static void integrate(VEnergy &e, uint32_t ms, int64_t p, int32_t mA, int32_t pvW){
+  e.readings++;
+  if (e.held) {
+    uint32_t dt = ms - e.ms;
+    if (dt > VENERGY_GAP_MS) e.gaps++;
+    else if (dt) {
+      int64_t out = 0, qOut = 0, pvNeg = 0;
+      trapezoid(e.p, p, dt, e.inE, out);
+      trapezoid(e.mA, mA, dt, e.inQ, qOut);
+      if (pvW >= 0 && e.pvW >= 0) trapezoid(e.pvW, pvW, dt, e.pvE, pvNeg);
+      e.outE  -= out;
+      e.outQ  -= qOut;
+      e.rateP += (p - e.rateP) * dt / (VENERGY_TAU_MS + dt);
+      e.rateA += static_cast<int32_t>((static_cast<int64_t>(mA) - e.rateA) * dt / (VENERGY_TAU_MS + dt));
+      e.spanMs += dt;
+    }
+  }
+  else if (!e.spanMs) {                                     // the first: the rates start from it
+    e.rateP = p;
+    e.rateA = mA;
+  }
+  e.ms   = ms;
+  e.p    = p;
+  e.mA   = mA;
+  e.pvW  = pvW;
+  e.held = true;
+}
+
+void energyAdd(VEnergy &e, uint32_t ms, int32_t cV, int32_t mA, bool valid){
+  if (!valid) {
+    if (e.held) e.gaps++;
+    e.held = false;
+    return;
+  }
+  integrate(e, ms, static_cast<int64_t>(cV) * mA, mA, -1);
+}
+
+// the device's count now (ref) against the integral (acc), spanned: the interval since integrated.
+// A jump takes a new baseline, as does a gap (not counted in rebased: the integral missed it)
+static void crossCheck(VCrossCheck &c, int64_t perUnit, int64_t acc, int32_t ref, bool spanned){
+  if (c.set && spanned && (ref - c.ref) * perUnit - (acc - c.acc) <= VENERGY_JUMP * perUnit
+            && (acc - c.acc) - (ref - c.ref) * perUnit <= VENERGY_JUMP * perUnit) {
+    c.acc = acc;
+    c.ref = ref;
+    return;
+  }
+  if (c.set && spanned) c.rebased++;
+  c.perUnit = perUnit;
+  c.acc0 = c.acc = acc;
+  c.ref0 = c.ref = ref;
+  c.set  = true;
+}
+
+void energyBM(VEnergy &e, uint32_t ms, const BatteryMonitorReading &r){
+  uint32_t gaps = e.gaps;
+  bool     held = e.held;
+  energyAdd(e, ms, r.battV, r.battA, (r.valid & (BM_BATTV | BM_BATTA)) == (BM_BATTV | BM_BATTA));
+  if (r.valid & BM_AH) crossCheck(e.check, 100 * MAH, e.outQ - e.inQ, static_cast<int32_t>(r.usedAh), held && e.held && e.gaps == gaps);   // consumed, 100 mAh
+}
+
+void energySC(VEnergy &e, uint32_t ms, const SolarChargerReading &r){
+  uint32_t gaps = e.gaps;
+  bool     held = e.held;
+  e.hasPV = true;
+  if ((r.valid & (SC_BATTV | SC_BATTA)) != (SC_BATTV | SC_BATTA)) energyAdd(e, ms, 0, 0, false);
+  else {
+    int32_t mA = r.battA * 100;                             // 100 mA
+    integrate(e, ms, static_cast<int64_t>(r.battV) * mA, mA, r.valid & SC_PVW ? r.pvW : -1);
+  }
+  if (r.valid & SC_KWH) crossCheck(e.check, 10 * MAH, e.pvE, r.yield10Wh, held && e.held && e.gaps == gaps);   // today, 10 Wh
+}
+
+int32_t energyDrift(const VEnergy &e){
+  const VCrossCheck &c = e.check;
+  return clamp32(((c.acc - c.acc0) - (c.ref - c.ref0) * c.perUnit) / MAH);
+}
+
+void formatEnergy(VLine &l, const VEnergy &e){
+  lineStr(l, "in ");     lineFixed(l, clamp32(e.inE / MWH), 1000, 2);  lineStr(l, "Wh ");
+                         lineFixed(l, clamp32(e.inQ / MAH), 1000, 2);  lineStr(l, "Ah");
+  lineStr(l, "  out ");  lineFixed(l, clamp32(e.outE / MWH), 1000, 2); lineStr(l, "Wh ");
+                         lineFixed(l, clamp32(e.outQ / MAH), 1000, 2); lineStr(l, "Ah");
+  lineStr(l, "  net ");  lineFixed(l, clamp32((e.inE - e.outE) / MWH), 1000, 2); lineStr(l, "Wh");
+  lineStr(l, "  rate "); lineFixed(l, clamp32(e.rateP / 10000), 10, 1); lineStr(l, "W ");
+                         lineFixed(l, e.rateA, 1000, 2); lineChar(l, 'A');
+  if (e.hasPV) {lineStr(l, "  PV "); lineFixed(l, clamp32(e.pvE / 3600), 1000, 2); lineStr(l, "Wh");}
+  lineStr(l, "  | ");    lineUInt(l, e.spanMs / 1000); lineStr(l, " s, "); lineUInt(l, e.gaps); lineStr(l, " gaps");
+  if (!e.check.set) return;
+  lineStr(l, "  | drift ");
+  lineFixed(l, energyDrift(e), 1, 0);
+  lineStr(l, e.hasPV ? "Wh vs yield, " : "mAh vs consumed Ah, ");
+  lineUInt(l, e.check.rebased); lineStr(l, " rebased");
+}
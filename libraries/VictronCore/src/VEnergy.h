@@ -0,0 +1,67 @@
+#pragma once
+
+/* Energy & charge integrated from the readings, per device.
+Battery volts x amps is integrated over the frames' own times (millis() at receipt),
+by the trapezoid rule between successive readings, into energy in & out (Wh) and
+charge in & out (Ah): an interval where the power changes sign is split where the
+line between the two readings crosses zero, so nothing in cancels anything out. A
+Solar Controller's PV watts are integrated as well. Readings further apart than
+VENERGY_GAP_MS, or with the volts or amps N/A, are not integrated across (counted in
+gaps). The charge & discharge rates are moving averages of the power and current, with
+a time constant of VENERGY_TAU_MS whatever the spacing of the readings.
+
+The integral is checked against the device's own count: a Battery Monitor's consumed Ah
+against the net charge out, a Solar Controller's yield today against the PV energy. The
+difference since a baseline is the drift. A count that jumps by more than VENERGY_JUMP
+of its units in one interval (a Battery Monitor synchronised to 0 Ah, the yield reset at
+midnight) takes a new baseline (counted in rebased), as does a gap.
+
+All integer: power in 10 uW (10 mV x mA), energy in 10 uW x ms, charge in mA x ms, in
+64 bit accumulators (years of 50 kW). O(1) per reading, nothing allocated. */
+
+#include <stdint.h>
+#include "VDecode.h"
+#include "VFormat.h"
+
+#define VENERGY_GAP_MS   60000    // readings further apart are not integrated across
+#define VENERGY_TAU_MS   60000    // time constant of the rates
+#define VENERGY_JUMP     10       // device count units in one interval: a reset, new baseline
+
+struct VCrossCheck {
+  int64_t  perUnit;               // integral per unit of the device's count
+  int64_t  acc0, acc;             // integral at the baseline, now
+  int32_t  ref0, ref;             // device's count at the baseline, now
+  uint32_t rebased;               // new baselines taken
+  bool     set;
+};
+
+struct VEnergy {
+  uint32_t ms;                    // last reading integrated to
+  int64_t  p;                     // its power, 10 uW
+  int32_t  mA;                    // its current
+  int32_t  pvW;                   // its PV watts
+  bool     held;                  // a reading held to integrate from
+  bool     hasPV;                 // Solar Controller: PV & yield
+  int64_t  inE, outE;             // energy into / out of the battery, 10 uW x ms
+  int64_t  inQ, outQ;             // charge into / out of the battery, mA x ms
+  int64_t  pvE;                   // PV energy, W x ms
+  int64_t  rateP;                 // power, moving average, 10 uW: + charging, - discharging
+  int32_t  rateA;                 // current, moving average, mA
+  uint32_t spanMs;                // time integrated
+  uint32_t readings;
+  uint32_t gaps;                  // intervals not integrated
+  VCrossCheck check;              // Battery Monitor: net charge out vs consumed Ah, Solar Controller: PV vs yield
+};
+
+void initEnergy(VEnergy &e);
+// a reading at ms: battery volts (10 mV) and current (mA), either N/A (valid false): not integrated to
+void energyAdd(VEnergy &e, uint32_t ms, int32_t cV, int32_t mA, bool valid);
+// a decoded reading, cross-checked against the device's count
+void energyBM(VEnergy &e, uint32_t ms, const BatteryMonitorReading &r);
+void energySC(VEnergy &e, uint32_t ms, const SolarChargerReading &r);
+
+// integral since the baseline less the device's count since: mAh (Battery Monitor) or Wh (Solar Controller)
+int32_t energyDrift(const VEnergy &e);
+
+// "in 12.34Wh 0.51Ah  out ...  net ...Wh  rate ...W ...A  PV ...Wh  | 3600 s, 0 gaps  | drift ... vs ..., 0 rebased"
+void formatEnergy(VLine &l, const VEnergy &e);
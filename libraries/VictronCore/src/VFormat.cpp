@@ -0,0 +1,192 @@
+/* Report line formatting into a fixed buffer (see VFormat.h) */
+
+#include "VFormat.h"
+
+#include <math.h>
+#include <string.h>
+
+void lineClear(VLine &l){
+  l.len = 0;
+}
+
+void lineChar(VLine &l, char c){
+  if (l.len < VLINE_MAX) l.buf[l.len++] = c;
+}
+
+void lineStr(VLine &l, const char *s){
+  while (*s && l.len < VLINE_MAX) l.buf[l.len++] = *s++;
+}
+
+// n chars from s, after enough spaces to fill width
+static void linePadded(VLine &l, const char *s, int n, int width){
+  for (int i = n; i < width; i++) lineChar(l, ' ');
+  for (int i = 0; i < n; i++)     lineChar(l, s[i]);
+}
+
+// digits of v, least significant first, into the end of tmp[]. Returns the first char
+static char *utoa10(uint32_t v, char *end){
+  do { *--end = '0' + v % 10; v /= 10; } while (v);
+  return end;
+}
+
+void lineUInt(VLine &l, uint32_t v, int width){
+  char tmp[10];
+  char *s = utoa10(v, tmp + sizeof(tmp));
+  linePadded(l, s, tmp + sizeof(tmp) - s, width);
+}
+
+void lineHex2(VLine &l, uint8_t v){
+  static const char hex[] = "0123456789ABCDEF";
+  lineChar(l, hex[v >> 4]);
+  lineChar(l, hex[v & 0xF]);
+}
+
+// follows Print::printFloat() in the Arduino core, so the text is the same as before
+void lineFloat(VLine &l, float value, int decimals, int width){
+  char tmp[24];
+  int  n = 0;
+  double number = value;
+  if      (isnan(number))                                     { memcpy(tmp, "nan", 3); n = 3; }
+  else if (isinf(number))                                     { memcpy(tmp, "inf", 3); n = 3; }
+  else if (number > 4294967040.0 || number < -4294967040.0)   { memcpy(tmp, "ovf", 3); n = 3; }
+  else {
+    if (number < 0.0) { tmp[n++] = '-'; number = -number; }
+    double rounding = 0.5;
+    for (int i = 0; i < decimals; i++) rounding /= 10.0;
+    number += rounding;
+    uint32_t whole = static_cast<uint32_t>(number);
+    double remainder = number - whole;
+    char digits[10];
+    char *s = utoa10(whole, digits + sizeof(digits));
+    while (s < digits + sizeof(digits)) tmp[n++] = *s++;
+    if (decimals > 0) tmp[n++] = '.';
+    for (int i = 0; i < decimals && n < static_cast<int>(sizeof(tmp)); i++) {
+      remainder *= 10.0;
+      unsigned d = static_cast<unsigned>(remainder);
+      tmp[n++] = '0' + d;
+      remainder -= d;
+    }
+  }
+  linePadded(l, tmp, n, width);
+}
+
+// integer arithmetic only: |v| / div rounded half up to decimals places, '-' if v < 0
+// as lineFloat() would print it
+void lineFixed(VLine &l, int32_t v, uint32_t div, int decimals, int width){
+  char tmp[24];
+  int  n = 0;
+  uint64_t mag = v < 0 ? -static_cast<int64_t>(v) : v;
+  if (v < 0) tmp[n++] = '-';
+  uint32_t pow10 = 1;
+  for (int i = 0; i < decimals; i++) pow10 *= 10;
+  uint64_t q = (mag * pow10 * 2 + div) / (2ull * div);        // in units of 10^-decimals
+  char digits[10];
+  char *s = utoa10(static_cast<uint32_t>(q / pow10), digits + sizeof(digits));
+  while (s < digits + sizeof(digits)) tmp[n++] = *s++;
+  if (decimals > 0) {
+    tmp[n++] = '.';
+    uint32_t frac = q % pow10;
+    for (int i = decimals - 1; i >= 0; i--) { tmp[n + i] = '0' + frac % 10; frac /= 10; }
+    n += decimals;
+  }
+  linePadded(l, tmp, n, width);
+}
+
+const char *lineText(VLine &l){
+  l.buf[l.len] = 0;
+  return l.buf;
+}
+
+// -- names --------------------------------------------------------------------------------
+
+// VE_REG_ALARM_REASON, one per bit (see .png)
+// values <= 0x0080 are for Battery Monitors  (i.e. bits from lower byte only)
+// values >= 0x0100 are for Victron Inverters (i.e. bits from upper byte only)
+static const char alarmNames[16][5] = {
+  "lo_V", "hi_V", "socL", "lo_S", "hi_S", "lo_C", "hi_C", "midV",   // 0x0001 .. 0x0080
+  "OVRL", "DCrp", "loAC", "hiAC", "Shrt", "Lock", "none", "none",   // 0x0100 .. 0x8000
+};
+
+const char *alarmName(uint32_t alarmBits){
+  if (alarmBits == 0)                   return "none";
+  if (alarmBits & (alarmBits - 1))      return "Mult";             // more than one bit set
+  for (int i = 0; i < 16; i++)
+    if (alarmBits == (1u << i))         return alarmNames[i];
+  return "none";
+}
+
+// VE_REG_DEVICE_STATE
+static const char stateNames[][7] = {
+  "_OFF__", "Lo_PWR", "FAULT ", "_BULK_", "ABSORB", "FLOAT_", "Store ", "Eq_Man",
+};
+
+// VE_REG_CHR_ERROR_CODE
+static const char errorNames[][7] = {
+  "no_err", "BATHOT", "VOLTHI", "REMC_A", "REMC_B", "REMC_C", "REMB_A", "REMB_B", "REMB_C",
+};
+
+static void lineName(VLine &l, const char (*names)[7], unsigned count, uint8_t code){
+  if (code < count) { lineStr(l, names[code]); return; }
+  lineChar(l, '*'); lineHex2(l, code); lineChar(l, '*');
+}
+
+void lineDeviceState(VLine &l, uint8_t state){
+  lineName(l, stateNames, sizeof(stateNames) / sizeof(stateNames[0]), state);
+}
+
+void lineChargerError(VLine &l, uint8_t error){
+  lineName(l, errorNames, sizeof(errorNames) / sizeof(errorNames[0]), error);
+}
+
+// -- report columns -----------------------------------------------------------------------
+
+void formatBM(VLine &l, const BatteryMonitorReading &r){
+  if (!(r.valid & BM_TTG))   lineStr(l, "inf_"); else lineFixed(l, r.ttgMin, 1440, 1, 4);  lineStr(l, "d ");
+  if (!(r.valid & BM_BATTV)) lineStr(l, "n/a-"); else lineFixed(l, r.battV,   100, 2, 5);  lineStr(l, "V ");
+  lineStr(l, alarmName(r.alarmBits)); lineChar(l, ' ');
+  if      (r.aux == 3)          lineStr(l, "999.99");                   // no aux input
+  else if (!(r.valid & BM_AUX)) lineStr(l, "n/a-");
+  else                          lineFixed(l, r.auxVal, 100, 2, 6);
+  if      (r.aux == 0 || r.aux == 1) lineChar(l, 'V');
+  else if (r.aux == 2)               lineChar(l, 'K');
+  else                               lineChar(l, 'X');
+  lineStr(l, " |  "); lineUInt(l, r.aux); lineStr(l, "  ");
+  if (!(r.valid & BM_BATTA)) lineStr(l, "n/a-"); else lineFixed(l, r.battA,  1000, 1, 5);  lineStr(l, "A ");
+  if (!(r.valid & BM_AH))    lineStr(l, "n/a-"); else lineFixed(l, r.usedAh,   10, 1, 7);  lineStr(l, "Ah ");
+  if (!(r.valid & BM_SOC))   lineStr(l, "n/a-");
+  else if (r.soc > 1000)     lineStr(l, "999.9");                       // > 100%: flag the error
+  else                       lineFixed(l, r.soc, 10, 1, 5);
+  lineChar(l, '%');
+}
+
+void formatSC(VLine &l, const SolarChargerReading &r, bool loadAmps){
+  lineDeviceState(l, r.state);  lineChar(l, ' ');
+  lineChargerError(l, r.error); lineChar(l, ' ');
+  if (!(r.valid & SC_BATTV)) lineStr(l, "n/a-"); else lineFixed(l, r.battV,     100, 2, 5); lineStr(l, "V ");
+  if (!(r.valid & SC_BATTA)) lineStr(l, "n/a-"); else lineFixed(l, r.battA,      10, 1, 5); lineStr(l, "A | ");
+  if (!(r.valid & SC_KWH))   lineStr(l, "n/a-"); else lineFixed(l, r.yield10Wh, 100, 2, 6); lineStr(l, "kWh ");
+  if (!(r.valid & SC_PVW))   lineStr(l, "n/a-"); else lineUInt (l, r.pvW,               3); lineStr(l, "W  ");
+  if (loadAmps) {
+    if (!(r.valid & SC_LOADA)) lineStr(l, " n/a-"); else lineFixed(l, r.loadA, 10, 1, 4); lineChar(l, 'A');
+  }
+}
+
+void formatRecord(VLine &l, const VRecord &r){
+  for (int i = 0; i < r.count; i++) {
+    const VField &f = r.field[i];
+    if (i) lineChar(l, ' ');
+    lineStr(l, f.label);
+    lineChar(l, ' ');
+    if (f.na) { lineStr(l, "n/a"); continue; }
+    switch (f.kind) {
+      case VF_STATE: lineDeviceState(l, f.raw);         break;
+      case VF_ERROR: lineChargerError(l, f.raw);        break;
+      case VF_ALARM: lineStr(l, alarmName(f.raw));      break;
+      case VF_HEX:   lineStr(l, "0x");
+                     for (int s = 24; s >= 0; s -= 8) if (f.raw >> s || s == 0) lineHex2(l, f.raw >> s);
+                     break;
+      default:       lineFixed(l, f.value, f.scale, f.decimals);
+                     lineStr(l, f.unit);
+    }
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+/* Allocation free formatting of the report lines.
+A report is built up in a VLine, a fixed size char buffer, then written out in
+one call (Serial.write(line.buf, line.len)). Numbers are formatted here, not by
+printf (whose float support can allocate on the ESP32), decoded values straight
+from their fixed point units with integer arithmetic, and the alarm, state
+and error names come from constant tables. Anything past VLINE_MAX is cut off. */
+
+#include <stdint.h>
+#include "VDecode.h"
+#include "VRecord.h"
+
+#define VLINE_MAX   160       // chars in one report line
+
+struct VLine {
+  uint16_t len;
+  char     buf[VLINE_MAX + 1];  // + 1 for lineText()'s terminator
+};
+
+void lineClear(VLine &l);
+void lineChar (VLine &l, char c);
+void lineStr  (VLine &l, const char *s);
+void lineUInt (VLine &l, uint32_t v, int width = 0);            // right aligned in width
+void lineHex2 (VLine &l, uint8_t v);                            // 2 upper case hex digits
+// as Serial << _WIDTH(_FLOAT(v, decimals), width): same rounding, right aligned in width
+void lineFloat(VLine &l, float v, int decimals, int width = 0);
+// v / div to decimals places (v in fixed point units, e.g. 10 mV: div 100), right aligned in
+// width. Integer arithmetic only, rounded as lineFloat()
+void lineFixed(VLine &l, int32_t v, uint32_t div, int decimals, int width = 0);
+const char *lineText(VLine &l);                                 // zero terminated
+
+// 4 char name of a single alarm in VE_REG_ALARM_REASON, "none" or "Mult" (more than one)
+const char *alarmName(uint32_t alarmBits);
+// 6 char VE_REG_DEVICE_STATE / VE_REG_CHR_ERROR_CODE names, "*hh*" (hex) if not in the table
+void lineDeviceState(VLine &l, uint8_t state);
+void lineChargerError(VLine &l, uint8_t error);
+
+// the value columns of a Battery Monitor / Solar Controller report
+void formatBM(VLine &l, const BatteryMonitorReading &r);
+void formatSC(VLine &l, const SolarChargerReading &r, bool loadAmps);
+// any record type: "label value" for each field, e.g. "state _BULK_ battV 26.45V ... load n/a"
+void formatRecord(VLine &l, const VRecord &r);
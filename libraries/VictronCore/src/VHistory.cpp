@@ -0,0 +1,205 @@
+/* Delta compressed time series in a ring of blocks (see VHistory.h) */
+
+#include "VHistory.h"
+
+#include <string.h>
+
+// block header: first ms (4), samples (2), bytes used (2), then the key frame
+#define HDR_MS      0
+#define HDR_COUNT   4
+#define HDR_USED    6
+#define HDR_SIZE    8
+#define MAX_SAMPLE  (1 + 5 + 5 * VHIST_FIELDS)   // flags, time, every field: worst case bytes
+
+static inline uint32_t zigzag(uint32_t d)  { return (d << 1) ^ (0u - (d >> 31)); }
+static inline uint32_t unzigzag(uint32_t z){ return (z >> 1) ^ (0u - (z & 1)); }
+
+static inline uint8_t *putVarint(uint8_t *p, uint32_t v){
+  while (v >= 0x80) { *p++ = static_cast<uint8_t>(v) | 0x80; v >>= 7; }
+  *p++ = static_cast<uint8_t>(v);
+  return p;
+}
+
+static inline const uint8_t *getVarint(const uint8_t *p, uint32_t &v){
+  v = 0;
+  for (int shift = 0; ; shift += 7) {
+    uint8_t b = *p++;
+    v |= static_cast<uint32_t>(b & 0x7F) << shift;
+    if (!(b & 0x80) || shift >= 28) return p;
+  }
+}
+
+static inline uint16_t get16(const uint8_t *p){ return p[0] | (p[1] << 8); }
+static inline uint32_t get32(const uint8_t *p){ return get16(p) | (static_cast<uint32_t>(get16(p + 2)) << 16); }
+static inline void put16(uint8_t *p, uint16_t v){ p[0] = v; p[1] = v >> 8; }
+static inline void put32(uint8_t *p, uint32_t v){ put16(p, v); put16(p + 2, v >> 16); }
+
+// i-th block from the oldest
+static inline uint8_t *blockAt(const VHistory &h, uint16_t i){
+  return h.buf + static_cast<size_t>((h.first + i) % h.blocks) * VHIST_BLOCK;
+}
+
+bool initHistory(VHistory &h, uint8_t *buf, size_t bytes, uint8_t fields, uint8_t xorMask){
+  memset(&h, 0, sizeof(h));
+  if (bytes / VHIST_BLOCK < 2 || bytes / VHIST_BLOCK > 0xFFFF || fields == 0 || fields > VHIST_FIELDS) return false;
+  h.buf     = buf;
+  h.blocks  = bytes / VHIST_BLOCK;
+  h.fields  = fields;
+  h.xorMask = xorMask;
+  return true;
+}
+
+// start a block with s as its key frame, dropping the oldest block if all are in use
+static void newBlock(VHistory &h, const VSample &s){
+  if (h.used == h.blocks) {
+    h.count -= get16(blockAt(h, 0) + HDR_COUNT);
+    h.first  = (h.first + 1) % h.blocks;
+    h.used--;
+  }
+  uint8_t *b = blockAt(h, h.used++);
+  uint8_t *p = b + HDR_SIZE;
+  for (int i = 0; i < h.fields; i++) p = putVarint(p, zigzag(s.v[i]));
+  put32(b + HDR_MS, s.ms);
+  put16(b + HDR_COUNT, 1);
+  put16(b + HDR_USED, p - b);
+  h.lastDt = 0;
+}
+
+void historyAppend(VHistory &h, const VSample &s){
+  h.count++;
+  h.appended++;
+  if (!h.used) { newBlock(h, s); h.last = s; return; }
+  uint8_t tmp[MAX_SAMPLE];                                // encoded here first, to fill blocks right up
+  uint8_t *p = tmp + 1;
+  uint32_t dt = s.ms - h.last.ms;
+  p = putVarint(p, zigzag(dt - h.lastDt));                // change in the time step
+  uint8_t changed = 0;
+  for (int i = 0; i < h.fields; i++) {
+    uint32_t v = s.v[i], prev = h.last.v[i];
+    if (v == prev) continue;
+    changed |= 1 << i;
+    p = putVarint(p, (h.xorMask >> i) & 1 ? v ^ prev : zigzag(v - prev));
+  }
+  tmp[0] = changed;
+  uint8_t *b = blockAt(h, h.used - 1);
+  uint16_t used = get16(b + HDR_USED), n = p - tmp;
+  if (used + n > VHIST_BLOCK) newBlock(h, s);
+  else {
+    memcpy(b + used, tmp, n);
+    put16(b + HDR_COUNT, get16(b + HDR_COUNT) + 1);
+    put16(b + HDR_USED, used + n);
+    h.lastDt = dt;
+  }
+  h.last = s;
+}
+
+size_t historyBytes(const VHistory &h){
+  size_t n = 0;
+  for (uint16_t i = 0; i < h.used; i++) n += get16(blockAt(h, i) + HDR_USED);
+  return n;
+}
+
+uint32_t historySpanMs(const VHistory &h){
+  return h.used ? h.last.ms - get32(blockAt(h, 0) + HDR_MS) : 0;
+}
+
+// -- range iteration ------------------------------------------------------------------------
+
+static void openBlock(VHistoryIter &it){
+  it.left = it.block < it.h->used ? get16(blockAt(*it.h, it.block) + HDR_COUNT) : 0;
+  it.pos  = 0;
+}
+
+void historyBegin(const VHistory &h, VHistoryIter &it, uint32_t fromMs){
+  it.h      = &h;
+  it.fromMs = fromMs;
+  it.block  = 0;
+  if (fromMs)                                               // skip blocks that end before fromMs
+    while (it.block + 1 < h.used &&
+           static_cast<int32_t>(get32(blockAt(h, it.block + 1) + HDR_MS) - fromMs) <= 0) it.block++;
+  openBlock(it);
+}
+
+bool historyNext(VHistoryIter &it, VSample &s){
+  const VHistory &h = *it.h;
+  for (;;) {
+    while (it.left == 0) {
+      if (++it.block >= h.used) return false;
+      openBlock(it);
+    }
+    const uint8_t *b = blockAt(h, it.block);
+    const uint8_t *p = b + (it.pos ? it.pos : HDR_SIZE);
+    uint32_t u;
+    if (!it.pos) {                                          // key frame
+      it.cur.ms = get32(b + HDR_MS);
+      it.dt     = 0;
+      for (int i = 0; i < h.fields; i++) { p = getVarint(p, u); it.cur.v[i] = unzigzag(u); }
+    }
+    else {
+      uint8_t changed = *p++;
+      p = getVarint(p, u);
+      it.dt     += unzigzag(u);
+      it.cur.ms += it.dt;
+      for (int i = 0; i < h.fields; i++) {
+        if (!((changed >> i) & 1)) continue;
+        p = getVarint(p, u);
+        uint32_t prev = it.cur.v[i];
+        it.cur.v[i] = (h.xorMask >> i) & 1 ? prev ^ u : prev + unzigzag(u);
+      }
+    }
+    it.pos = p - b;
+    it.left--;
+    if (it.fromMs && static_cast<int32_t>(it.cur.ms - it.fromMs) < 0) continue;
+    s = it.cur;
+    return true;
+  }
+}
+
+// -- readings <-> samples -------------------------------------------------------------------
+
+void bmSample(const BatteryMonitorReading &r, uint32_t ms, VSample &s){
+  s.ms   = ms;
+  s.v[0] = r.battV;
+  s.v[1] = r.battA;
+  s.v[2] = r.soc;
+  s.v[3] = r.usedAh;
+  s.v[4] = r.auxVal;
+  s.v[5] = r.ttgMin;
+  s.v[6] = r.alarmBits;                                     // XOR'd
+  s.v[7] = r.valid | (r.aux << 8);                          // XOR'd
+}
+
+void bmReading(const VSample &s, BatteryMonitorReading &r){
+  r.battV     = s.v[0];
+  r.battA     = s.v[1];
+  r.soc       = s.v[2];
+  r.usedAh    = s.v[3];
+  r.auxVal    = s.v[4];
+  r.ttgMin    = s.v[5];
+  r.alarmBits = s.v[6];
+  r.valid     = s.v[7] & 0xFF;
+  r.aux       = s.v[7] >> 8;
+}
+
+void scSample(const SolarChargerReading &r, uint32_t ms, VSample &s){
+  s.ms   = ms;
+  s.v[0] = r.battV;
+  s.v[1] = r.battA;
+  s.v[2] = r.pvW;
+  s.v[3] = r.yield10Wh;
+  s.v[4] = r.loadA;
+  s.v[5] = r.state | (r.error << 8);                        // XOR'd
+  s.v[6] = r.valid;                                         // XOR'd
+  s.v[7] = 0;
+}
+
+void scReading(const VSample &s, SolarChargerReading &r){
+  r.battV     = s.v[0];
+  r.battA     = s.v[1];
+  r.pvW       = s.v[2];
+  r.yield10Wh = s.v[3];
+  r.loadA     = s.v[4];
+  r.state     = s.v[5] & 0xFF;
+  r.error     = s.v[5] >> 8;
+  r.valid     = s.v[6];
+}
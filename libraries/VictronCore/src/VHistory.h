@@ -0,0 +1,72 @@
+#pragma once
+
+/* In-RAM time series of decoded readings, one per device, in a fixed byte budget.
+Battery and solar values change slowly, so each sample is stored as the change
+from the one before: a byte flagging which fields changed, the change in the time
+step (zigzag varint, usually 1 byte at a steady 5 Hz), then only the fields that
+changed, as zigzag varint differences (XOR with the previous value for bit fields
+such as alarms and the validity mask). A steady reading costs 2 bytes.
+
+The budget is split into VHIST_BLOCK byte blocks used as a ring. Each block starts
+with its first time and a key frame (every field in full), so blocks decode on
+their own: when the budget is full the oldest block is dropped, and a range scan
+skips straight to the first block holding the start time.
+
+Nothing is allocated here: the caller hands initHistory() the buffer. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "VDecode.h"
+
+#define VHIST_FIELDS    8         // values per sample (one changed-flags byte)
+#define VHIST_BLOCK   256         // bytes per block, the unit of eviction
+
+struct VSample {
+  uint32_t ms;                    // millis() when received
+  int32_t  v[VHIST_FIELDS];       // in record units, see bmSample() / scSample()
+};
+
+struct VHistory {
+  uint8_t *buf;                   // blocks x VHIST_BLOCK bytes, from the caller
+  uint16_t blocks;
+  uint16_t first;                 // oldest block in buf
+  uint16_t used;                  // blocks holding samples
+  uint8_t  fields;                // values per sample, <= VHIST_FIELDS
+  uint8_t  xorMask;               // bit i set: field i is XOR'd, not subtracted
+  uint32_t count;                 // samples held
+  uint32_t appended;              // samples ever appended
+  VSample  last;                  // last sample appended, the base for the next one
+  uint32_t lastDt;                // its time step
+};
+
+struct VHistoryIter {
+  const VHistory *h;
+  uint32_t fromMs;
+  uint16_t block;                 // blocks from h->first
+  uint16_t left;                  // samples still to read in the block
+  uint16_t pos;                   // next byte in the block
+  uint32_t dt;
+  VSample  cur;
+};
+
+// false if the buffer holds fewer than 2 blocks or fields > VHIST_FIELDS
+bool initHistory(VHistory &h, uint8_t *buf, size_t bytes, uint8_t fields, uint8_t xorMask = 0);
+// add s (time order), dropping the oldest block if the budget is full
+void historyAppend(VHistory &h, const VSample &s);
+// bytes holding samples, and the time span held (ms)
+size_t   historyBytes(const VHistory &h);
+uint32_t historySpanMs(const VHistory &h);
+
+// iterate over the samples held from fromMs on (0: all), oldest first
+void historyBegin(const VHistory &h, VHistoryIter &it, uint32_t fromMs = 0);
+bool historyNext(VHistoryIter &it, VSample &s);            // false when there are no more
+
+// readings as samples: the fields a history holds for each device type
+#define VHIST_BM_FIELDS   8       // battV battA soc usedAh auxVal ttgMin | alarmBits valid
+#define VHIST_BM_XOR   0xC0
+#define VHIST_SC_FIELDS   7       // battV battA pvW yield10Wh loadA | state+error valid
+#define VHIST_SC_XOR   0x60
+void bmSample(const BatteryMonitorReading &r, uint32_t ms, VSample &s);
+void scSample(const SolarChargerReading &r, uint32_t ms, VSample &s);
+void bmReading(const VSample &s, BatteryMonitorReading &r);
+void scReading(const VSample &s, SolarChargerReading &r);
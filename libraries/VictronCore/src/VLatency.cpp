@@ -0,0 +1,62 @@
+/* Per stage latency histograms (see VLatency.h) */
+
+#include "VLatency.h"
+#include "VFormat.h"
+
+#include <string.h>
+
+const char *stageName[VST_COUNT] = {"callback", "decrypt", "decode", "format", "serial", "frame"};
+
+static inline int log2u(uint32_t v){ return 31 - __builtin_clz(v); }
+
+static inline int bucketOf(uint32_t v){
+  if (v < 32) return v;
+  int e = log2u(v);
+  return 32 + (e - 5) * 16 + ((v >> (e - 4)) & 15);
+}
+
+// middle of bucket i
+static inline uint32_t bucketValue(int i){
+  if (i < 32) return i;
+  int e = (i - 32) / 16 + 5, sub = (i - 32) % 16;
+  uint32_t width = 1u << (e - 4);
+  return (16u + sub) * width + width / 2;
+}
+
+void initLatency(VLatency &l){
+  memset(&l, 0, sizeof(l));
+}
+
+void latRecord(VLatency &l, uint32_t ticks){
+  l.count++;
+  l.bucket[bucketOf(ticks)]++;
+  if (ticks > l.max) l.max = ticks;
+}
+
+uint32_t latPercentile(const VLatency &l, uint32_t permille){
+  if (!l.count) return 0;
+  uint64_t want = (static_cast<uint64_t>(l.count) * permille + 999) / 1000;   // rank, rounded up
+  if (want == 0) want = 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < VLAT_BUCKETS; i++) {
+    seen += l.bucket[i];
+    if (seen >= want) return bucketValue(i) < l.max ? bucketValue(i) : l.max;
+  }
+  return l.max;
+}
+
+static void lineNs(VLine &line, const char *key, uint32_t ticks, uint32_t ticksPerUs){
+  lineStr(line, key);
+  lineUInt(line, static_cast<uint32_t>(static_cast<uint64_t>(ticks) * 1000 / (ticksPerUs ? ticksPerUs : 1)));
+}
+
+void formatLatency(VLine &line, const char *stage, const VLatency &l, uint32_t ticksPerUs){
+  lineStr(line, "{\"stage\":\"");
+  lineStr(line, stage);
+  lineStr(line, "\",\"n\":");
+  lineUInt(line, l.count);
+  lineNs(line, ",\"p50_ns\":", latPercentile(l, 500), ticksPerUs);
+  lineNs(line, ",\"p99_ns\":", latPercentile(l, 990), ticksPerUs);
+  lineNs(line, ",\"max_ns\":", l.max, ticksPerUs);
+  lineChar(line, '}');
+}
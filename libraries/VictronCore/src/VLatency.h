@@ -0,0 +1,40 @@
+#pragma once
+
+/* Latency of each stage of the receive pipeline, as p50 / p99 / max.
+Times are in ticks of whatever clock the caller has: CPU cycles on the ESP32
+(ESP.getCycleCount()), nano-seconds on Linux. latRecord() is O(1) and nothing is
+allocated: each stage keeps a fixed histogram, exact below 32 ticks then 16
+buckets per power of 2 (within about 3%), plus the exact max.
+
+formatLatency() writes a stage as one line of JSON, so runs can be compared
+between releases, e.g.
+  {"stage":"decrypt","n":5000,"p50_ns":2150,"p99_ns":3200,"max_ns":18400} */
+
+#include <stdint.h>
+
+#define VLAT_BUCKETS  464         // 32 exact + 16 per power of 2, from 2^5 to 2^31
+
+enum VStage : uint8_t {
+  VST_CALLBACK,                   // onResult(): address lookup, find the Victron data, drop repeats, queue
+  VST_DECRYPT,                    // decryptAesCtr()
+  VST_DECODE,                     // record -> reading, dud checks
+  VST_FORMAT,                     // reading -> report line
+  VST_SERIAL,                     // report line written out
+  VST_FRAME,                      // all of loop()'s work on a frame, decrypt to written out
+  VST_COUNT
+};
+extern const char *stageName[VST_COUNT];
+
+struct VLatency {
+  uint32_t count;
+  uint32_t max;
+  uint32_t bucket[VLAT_BUCKETS];
+};
+
+void     initLatency(VLatency &l);
+void     latRecord(VLatency &l, uint32_t ticks);
+uint32_t latPercentile(const VLatency &l, uint32_t permille);   // 500 = p50, 990 = p99. 0 if empty
+
+struct VLine;
+// {"stage":..,"n":..,"p50_ns":..,"p99_ns":..,"max_ns":..}, ticks converted at ticksPerUs
+void formatLatency(VLine &line, const char *stage, const VLatency &l, uint32_t ticksPerUs);
@@ -0,0 +1,265 @@
+#pragma once
+
+/* Record layouts as compile-time bit field descriptors.
+Each field of a decrypted record is declared once, as a constexpr VBitField (first
+bit, width, signed or not, scale, N/A value), and the extractors below are templates
+on that descriptor: the byte offset, shift, mask and sign extension are all constants,
+so each field compiles to a few loads, shifts and masks with no branches and no loops.
+
+Each record type lists its fields in one namespace, with all[] holding every field
+for the static_asserts: fields must fit in the 16 byte record, not overlap, have an
+N/A value that fits their width, and end where the document says the record ends.
+
+Layouts follow "Extra Manufacturer Data" (docs/Victron_Extra_Manufacturer_Data.pdf),
+bit offsets from the start of the decrypted data (the document's start bit - 32),
+with the corrections noted in README.md and VRecord.cpp. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VREC_BITS   128                 // 16 decrypted bytes
+#define VNA_NONE    0x100000000ull      // N/A value for fields that are never N/A (outside any 32 bit raw)
+
+struct VBitField {
+  uint8_t  pos;               // first bit, from bit 0 of byte 0, little endian
+  uint8_t  width;             // bits, 1 .. 32
+  bool     sign;              // 2's complement
+  uint16_t scale;             // raw units per unit: value = raw / scale
+  uint64_t na;                // raw value meaning N/A, or VNA_NONE
+};
+
+// -- compile time checks --------------------------------------------------------------------
+
+constexpr uint32_t vMask(int width){ return width >= 32 ? 0xFFFFFFFFu : (1u << width) - 1; }
+
+constexpr bool fieldValid(const VBitField &f){
+  return f.width >= 1 && f.width <= 32 && f.pos + f.width <= VREC_BITS && f.scale > 0
+      && (f.na == VNA_NONE || f.na <= vMask(f.width));
+}
+
+constexpr bool fieldsOverlap(const VBitField &a, const VBitField &b){
+  return a.pos < b.pos + b.width && b.pos < a.pos + a.width;
+}
+
+// alternative meanings of the same bits (e.g. the BM aux value)
+constexpr bool sameBits(const VBitField &a, const VBitField &b){
+  return a.pos == b.pos && a.width == b.width;
+}
+
+// C++11 constexpr, one return and recursion for the loops: the ESP32 Arduino cores up to 2.x build with gnu++11
+constexpr int vMax(int a, int b){ return a > b ? a : b; }
+
+// l[i] overlaps none of l[j..]
+template <size_t N>
+constexpr bool overlapsNone(const VBitField (&l)[N], size_t i, size_t j){
+  return j >= N || (!fieldsOverlap(l[i], l[j]) && overlapsNone(l, i, j + 1));
+}
+
+template <size_t N>
+constexpr bool layoutValid(const VBitField (&l)[N], size_t i = 0){
+  return i >= N || (fieldValid(l[i]) && overlapsNone(l, i, i + 1) && layoutValid(l, i + 1));
+}
+
+// bits up to the end of the last field
+template <size_t N>
+constexpr int layoutBits(const VBitField (&l)[N], size_t i = 0){
+  return i >= N ? 0 : vMax(l[i].pos + l[i].width, layoutBits(l, i + 1));
+}
+
+// -- extractors -----------------------------------------------------------------------------
+
+// the field's bits as sent
+template <const VBitField &F>
+inline uint32_t fieldRaw(const uint8_t *rec){
+  constexpr int first = F.pos >> 3, shift = F.pos & 7, bytes = (shift + F.width + 7) >> 3;
+  uint64_t v = 0;
+  for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | rec[first + i];   // constant count, unrolled
+  return static_cast<uint32_t>(v >> shift) & vMask(F.width);
+}
+
+// the field as an integer, sign extended if signed
+template <const VBitField &F>
+inline int32_t fieldInt(const uint8_t *rec){
+  constexpr int up = 32 - F.width;
+  uint32_t v = fieldRaw<F>(rec);
+  return F.sign ? static_cast<int32_t>(v << up) >> up : static_cast<int32_t>(v);
+}
+
+template <const VBitField &F>
+inline bool fieldNA(const uint8_t *rec){
+  return fieldRaw<F>(rec) == F.na;
+}
+
+// the field scaled to its unit
+template <const VBitField &F>
+inline float fieldValue(const uint8_t *rec){
+  return (F.sign ? static_cast<float>(fieldInt<F>(rec)) : static_cast<float>(fieldRaw<F>(rec))) / F.scale;
+}
+
+// -- layouts ----------------------------------------------------------------------------------
+//                             pos width sign scale  N/A
+
+namespace SolarChargerLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField error  = {  8,  8, false,    1, 0xFF     };
+  constexpr VBitField battV  = { 16, 16, true,   100, 0x7FFF   };   // 10 mV
+  constexpr VBitField battA  = { 32, 16, true,    10, 0x7FFF   };   // 100 mA
+  constexpr VBitField kWh    = { 48, 16, false,  100, 0xFFFF   };   // 10 Wh, today
+  constexpr VBitField pvW    = { 64, 16, false,    1, 0xFFFF   };
+  constexpr VBitField loadA  = { 80,  9, false,   10, 0x1FF    };   // 100 mA
+  constexpr VBitField all[]  = {state, error, battV, battA, kWh, pvW, loadA};
+  static_assert(layoutValid(all) && layoutBits(all) == 89, "Solar Charger layout");
+}
+
+namespace BatteryMonitorLayout {
+  constexpr VBitField ttg    = {  0, 16, false, 1440, 0xFFFF   };   // minutes, in days
+  constexpr VBitField battV  = { 16, 16, true,   100, 0x7FFF   };
+  constexpr VBitField alarm  = { 32, 16, false,    1, VNA_NONE };
+  constexpr VBitField auxV   = { 48, 16, true,   100, 0x7FFF   };   // aux = 0
+  constexpr VBitField midV   = { 48, 16, false,  100, 0xFFFF   };   // aux = 1
+  constexpr VBitField kelvin = { 48, 16, false,  100, 0xFFFF   };   // aux = 2, 10 mK
+  constexpr VBitField aux    = { 64,  2, false,    1, VNA_NONE };   // 0: aux V 1: mid V 2: Kelvin 3: none
+  constexpr VBitField battA  = { 66, 22, true,  1000, 0x1FFFFF };   // mA. N/A as README, not 0x3FFFFF
+  constexpr VBitField usedAh = { 88, 20, false,   10, 0xFFFFF  };   // 100 mAh consumed
+  constexpr VBitField soc    = {108, 10, false,   10, 0x3FF    };   // 0.1 %
+  constexpr VBitField all[]  = {ttg, battV, alarm, auxV, aux, battA, usedAh, soc};
+  static_assert(layoutValid(all) && layoutBits(all) == 118, "Battery Monitor layout");
+  static_assert(sameBits(midV, auxV) && sameBits(kelvin, auxV), "aux value bits");
+}
+
+namespace InverterLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField alarm  = {  8, 16, false,    1, VNA_NONE };
+  constexpr VBitField battV  = { 24, 16, true,   100, 0x7FFF   };
+  constexpr VBitField acVA   = { 40, 16, false,    1, 0xFFFF   };
+  constexpr VBitField acV    = { 56, 15, false,  100, 0x7FFF   };
+  constexpr VBitField acA    = { 71, 11, false,   10, 0x7FF    };
+  constexpr VBitField all[]  = {state, alarm, battV, acVA, acV, acA};
+  static_assert(layoutValid(all) && layoutBits(all) == 82, "Inverter layout");
+}
+
+namespace DcDcConverterLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField error  = {  8,  8, false,    1, 0xFF     };
+  constexpr VBitField inV    = { 16, 16, false,  100, 0xFFFF   };
+  constexpr VBitField outV   = { 32, 16, true,   100, 0x7FFF   };
+  constexpr VBitField off    = { 48, 32, false,    1, VNA_NONE };   // VE_REG_DEVICE_OFF_REASON_2
+  constexpr VBitField all[]  = {state, error, inV, outV, off};
+  static_assert(layoutValid(all) && layoutBits(all) == 80, "DC/DC Converter layout");
+}
+
+namespace SmartLithiumLayout {
+  constexpr VBitField flags  = {  0, 32, false,    1, VNA_NONE };   // VE_REG_BMS_FLAGS
+  constexpr VBitField error  = { 32, 16, false,    1, VNA_NONE };   // VE_REG_SMART_LITHIUM_ERROR_FLAGS
+  constexpr VBitField cell1  = { 48,  7, false,  100, 0x7F     };   // 10 mV above 2.60 V
+  constexpr VBitField cell2  = { 55,  7, false,  100, 0x7F     };
+  constexpr VBitField cell3  = { 62,  7, false,  100, 0x7F     };
+  constexpr VBitField cell4  = { 69,  7, false,  100, 0x7F     };
+  constexpr VBitField cell5  = { 76,  7, false,  100, 0x7F     };
+  constexpr VBitField cell6  = { 83,  7, false,  100, 0x7F     };
+  constexpr VBitField cell7  = { 90,  7, false,  100, 0x7F     };
+  constexpr VBitField cell8  = { 97,  7, false,  100, 0x7F     };
+  constexpr VBitField battV  = {104, 12, false,  100, 0x0FFF   };
+  constexpr VBitField balance= {116,  4, false,    1, 0xF      };   // balancer status, not shown
+  constexpr VBitField temp   = {120,  7, false,    1, 0x7F     };   // deg C + 40
+  constexpr VBitField all[]  = {flags, error, cell1, cell2, cell3, cell4, cell5, cell6, cell7, cell8,
+                                battV, balance, temp};
+  static_assert(layoutValid(all) && layoutBits(all) == 127, "SmartLithium layout");
+}
+
+namespace InverterRSLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField error  = {  8,  8, false,    1, 0xFF     };
+  constexpr VBitField battV  = { 16, 16, true,   100, 0x7FFF   };
+  constexpr VBitField battA  = { 32, 16, true,    10, 0x7FFF   };
+  constexpr VBitField pvW    = { 48, 16, false,    1, 0xFFFF   };
+  constexpr VBitField kWh    = { 64, 16, false,  100, 0xFFFF   };
+  constexpr VBitField acOutW = { 80, 16, true,     1, 0x7FFF   };
+  constexpr VBitField all[]  = {state, error, battV, battA, pvW, kWh, acOutW};
+  static_assert(layoutValid(all) && layoutBits(all) == 96, "Inverter RS layout");
+}
+
+namespace AcChargerLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField error  = {  8,  8, false,    1, 0xFF     };
+  constexpr VBitField batt1V = { 16, 13, false,  100, 0x1FFF   };
+  constexpr VBitField batt1A = { 29, 11, false,   10, 0x7FF    };
+  constexpr VBitField batt2V = { 40, 13, false,  100, 0x1FFF   };
+  constexpr VBitField batt2A = { 53, 11, false,   10, 0x7FF    };
+  constexpr VBitField batt3V = { 64, 13, false,  100, 0x1FFF   };
+  constexpr VBitField batt3A = { 77, 11, false,   10, 0x7FF    };
+  constexpr VBitField temp   = { 88,  7, false,    1, 0x7F     };   // deg C + 40
+  constexpr VBitField acA    = { 95,  9, false,   10, 0x1FF    };
+  constexpr VBitField all[]  = {state, error, batt1V, batt1A, batt2V, batt2A, batt3V, batt3A, temp, acA};
+  static_assert(layoutValid(all) && layoutBits(all) == 104, "AC Charger layout");
+}
+
+// NB: the document lists this record from bit 8, it actually starts at bit 0 like the others
+namespace BatteryProtectLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField output = {  8,  8, false,    1, VNA_NONE };   // VE_REG_DC_OUTPUT_STATUS
+  constexpr VBitField error  = { 16,  8, false,    1, 0xFF     };
+  constexpr VBitField alarm  = { 24, 16, false,    1, VNA_NONE };
+  constexpr VBitField warn   = { 40, 16, false,    1, VNA_NONE };   // VE_REG_WARNING_REASON
+  constexpr VBitField inV    = { 56, 16, true,   100, 0x7FFF   };
+  constexpr VBitField outV   = { 72, 16, false,  100, 0xFFFF   };
+  constexpr VBitField off    = { 88, 32, false,    1, VNA_NONE };
+  constexpr VBitField all[]  = {state, output, error, alarm, warn, inV, outV, off};
+  static_assert(layoutValid(all) && layoutBits(all) == 120, "Smart BatteryProtect layout");
+}
+
+namespace LynxBmsLayout {
+  constexpr VBitField error  = {  0,  8, false,    1, VNA_NONE };   // VE_REG_BMS_ERROR
+  constexpr VBitField ttg    = {  8, 16, false, 1440, 0xFFFF   };
+  constexpr VBitField battV  = { 24, 16, true,   100, 0x7FFF   };
+  constexpr VBitField battA  = { 40, 16, true,    10, 0x7FFF   };
+  constexpr VBitField io     = { 56, 16, false,    1, VNA_NONE };
+  constexpr VBitField warn   = { 72, 18, false,    1, VNA_NONE };   // VE_REG_BMS_WARNINGS_ALARMS
+  constexpr VBitField soc    = { 90, 10, false,   10, 0x3FF    };
+  constexpr VBitField usedAh = {100, 20, false,   10, 0xFFFFF  };
+  constexpr VBitField temp   = {120,  7, false,    1, 0x7F     };
+  constexpr VBitField all[]  = {error, ttg, battV, battA, io, warn, soc, usedAh, temp};
+  static_assert(layoutValid(all) && layoutBits(all) == 127, "Lynx Smart BMS layout");
+}
+
+namespace MultiRSLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField error  = {  8,  8, false,    1, 0xFF     };
+  constexpr VBitField battA  = { 16, 16, true,    10, 0x7FFF   };
+  constexpr VBitField battV  = { 32, 14, false,  100, 0x3FFF   };
+  constexpr VBitField acIn   = { 46,  2, false,    1, 0x3      };   // active AC input 0: in1 1: in2 2: none
+  constexpr VBitField acInW  = { 48, 16, true,     1, 0x7FFF   };
+  constexpr VBitField acOutW = { 64, 16, true,     1, 0x7FFF   };
+  constexpr VBitField pvW    = { 80, 16, false,    1, 0xFFFF   };
+  constexpr VBitField kWh    = { 96, 16, false,  100, 0xFFFF   };
+  constexpr VBitField all[]  = {state, error, battA, battV, acIn, acInW, acOutW, pvW, kWh};
+  static_assert(layoutValid(all) && layoutBits(all) == 112, "Multi RS layout");
+}
+
+namespace VeBusLayout {
+  constexpr VBitField state  = {  0,  8, false,    1, 0xFF     };
+  constexpr VBitField error  = {  8,  8, false,    1, VNA_NONE };   // VE_REG_VEBUS_VEBUS_ERROR
+  constexpr VBitField battA  = { 16, 16, true,    10, 0x7FFF   };
+  constexpr VBitField battV  = { 32, 14, false,  100, 0x3FFF   };
+  constexpr VBitField acIn   = { 46,  2, false,    1, 0x3      };
+  constexpr VBitField acInW  = { 48, 19, true,     1, 0x3FFFF  };
+  constexpr VBitField acOutW = { 67, 19, true,     1, 0x3FFFF  };
+  constexpr VBitField alarm  = { 86,  2, false,    1, 0x3      };   // 0: none 1: warning 2: alarm
+  constexpr VBitField temp   = { 88,  7, false,    1, 0x7F     };
+  constexpr VBitField soc    = { 95,  7, false,    1, 0x7F     };
+  constexpr VBitField all[]  = {state, error, battA, battV, acIn, acInW, acOutW, alarm, temp, soc};
+  static_assert(layoutValid(all) && layoutBits(all) == 102, "VE.Bus layout");
+}
+
+namespace DcEnergyMeterLayout {
+  constexpr VBitField mode   = {  0, 16, true,     1, VNA_NONE };   // VE_REG_BMV_MONITOR_MODE
+  constexpr VBitField battV  = { 16, 16, true,   100, 0x7FFF   };
+  constexpr VBitField alarm  = { 32, 16, false,    1, VNA_NONE };
+  constexpr VBitField auxV   = { 48, 16, true,   100, 0x7FFF   };   // aux = 0
+  constexpr VBitField kelvin = { 48, 16, false,  100, 0xFFFF   };   // aux = 2
+  constexpr VBitField aux    = { 64,  2, false,    1, VNA_NONE };
+  constexpr VBitField battA  = { 66, 22, true,  1000, 0x1FFFFF };
+  constexpr VBitField all[]  = {mode, battV, alarm, auxV, aux, battA};
+  static_assert(layoutValid(all) && layoutBits(all) == 88, "DC Energy Meter layout");
+  static_assert(sameBits(kelvin, auxV), "aux value bits");
+}
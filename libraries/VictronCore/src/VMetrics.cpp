@@ -0,0 +1,206 @@
+/* Latest readings per device & the Prometheus exposition (see VMetrics.h) */
+
+#include "VMetrics.h"
+
+#include <string.h>
+
+#define VMET_LABEL_MAX  64        // chars of a stream name in a label, escapes included
+
+void initMetrics(VMetrics &m){
+  memset(&m, 0, sizeof(m));
+  for (VMetSource &s : m.src) {
+    initWireDecoder(s.wire);
+    for (int16_t &d : s.dev) d = -1;
+  }
+}
+
+int metricsAddSource(VMetrics &m, const char *name){
+  if (m.sources >= VMET_SOURCES) return -1;
+  m.src[m.sources].name = name;
+  return m.sources++;
+}
+
+bool metricsPut(VMetrics &m, int src, uint8_t b, uint64_t nowMs){
+  VWireRecord r;
+  if (!wirePut(m.src[src].wire, b, r)) return false;
+  metricsUpdate(m, src, r, nowMs);
+  return true;
+}
+
+// a device record: the index named, the device added if its address is new
+static bool nameIndex(VMetrics &m, VMetSource &s, const VWireRecord &r){
+  int d = 0;
+  while (d < m.count && m.dev[d].mac != r.mac) d++;
+  if (d == m.count) {
+    if (m.count >= VMET_DEVICES) {m.full++; s.dev[r.dev] = -1; return false;}
+    m.count++;
+    m.dev[d].mac = r.mac;
+  }
+  memcpy(m.dev[d].name, r.name, VWIRE_NAME);
+  s.dev[r.dev] = d;
+  return true;
+}
+
+bool metricsUpdate(VMetrics &m, int src, const VWireRecord &r, uint64_t nowMs){
+  VMetSource &s = m.src[src];
+  if (r.kind == VWIRE_DEVICE) return nameIndex(m, s, r);
+  int d = s.dev[r.dev];
+  if (d < 0) {s.unnamed++; return false;}
+  VMetDevice &v = m.dev[d];
+  uint8_t duds = 0;
+  if      (r.kind == VWIRE_BM) {recordFromBM(r.bm, v.rec); duds = r.duds;}
+  else if (r.kind == VWIRE_SC) {recordFromSC(r.sc, v.rec); duds = r.duds;}
+  else {
+    VRecord rec;
+    if (!decodeRecord(r.type, r.data, rec)) {m.unsupported++; return false;}   // the last reading kept
+    v.rec = rec;
+  }
+  v.readings++;
+  if (duds) v.dudReadings++;
+  v.lastMs = nowMs;
+  return true;
+}
+
+// -- exposition -----------------------------------------------------------------------------
+
+struct VMetOut {
+  char  *buf;
+  size_t size, len;
+  bool   over;                    // buf too small
+};
+
+// the line built in l, ended, onto the output
+static void emit(VMetOut &o, VLine &l){
+  lineChar(l, '\n');
+  if (o.len + l.len > o.size) {o.over = true; return;}
+  memcpy(o.buf + o.len, l.buf, l.len);
+  o.len += l.len;
+}
+
+static void family(VMetOut &o, VLine &l, const char *name, const char *type, const char *help){
+  lineClear(l);
+  lineStr(l, "# HELP "); lineStr(l, name); lineChar(l, ' '); lineStr(l, help);
+  emit(o, l);
+  lineClear(l);
+  lineStr(l, "# TYPE "); lineStr(l, name); lineChar(l, ' '); lineStr(l, type);
+  emit(o, l);
+}
+
+// "s", \ " and new line escaped, at most max chars
+static void lineLabel(VLine &l, const char *s, int max){
+  lineChar(l, '"');
+  for (int n = 0; *s && n < max; s++, n++) {
+    if      (*s == '\\' || *s == '"') {lineChar(l, '\\'); lineChar(l, *s); n++;}
+    else if (*s == '\n')              {lineStr(l, "\\n"); n++;}
+    else                              lineChar(l, *s);
+  }
+  lineChar(l, '"');
+}
+
+static void lineMac(VLine &l, uint64_t mac){
+  static const char hex[] = "0123456789abcdef";
+  for (int s = 40; s >= 0; s -= 8) {
+    lineChar(l, hex[(mac >> (s + 4)) & 0xF]);
+    lineChar(l, hex[(mac >> s) & 0xF]);
+    if (s) lineChar(l, ':');
+  }
+}
+
+// name{device="..",mac=".." - the labels left open for more
+static void deviceSample(VLine &l, const char *name, const VMetDevice &d){
+  lineClear(l);
+  lineStr(l, name);
+  lineStr(l, "{device=");
+  lineLabel(l, d.name, VWIRE_NAME * 2);
+  lineStr(l, ",mac=\"");
+  lineMac(l, d.mac);
+  lineChar(l, '"');
+}
+
+static void streamSample(VLine &l, const char *name, const VMetSource &s, uint32_t v){
+  lineClear(l);
+  lineStr(l, name);
+  lineStr(l, "{stream=");
+  lineLabel(l, s.name ? s.name : "", VMET_LABEL_MAX);
+  lineStr(l, "} ");
+  lineUInt(l, v);
+}
+
+static bool isCode(const VField &f){
+  return f.kind == VF_STATE || f.kind == VF_ERROR || f.kind == VF_ALARM || f.kind == VF_HEX;
+}
+
+size_t renderMetrics(const VMetrics &m, char *buf, size_t size){
+  VMetOut o = {buf, size, 0, false};
+  VLine   l;
+  family(o, l, "victron_value", "gauge", "Last value of each field of each device, in the unit labelled");
+  for (int i = 0; i < m.count; i++) {
+    const VMetDevice &d = m.dev[i];
+    if (!d.readings) continue;
+    for (int j = 0; j < d.rec.count; j++) {
+      const VField &f = d.rec.field[j];
+      if (f.na || isCode(f)) continue;
+      deviceSample(l, "victron_value", d);
+      lineStr(l, ",field=\""); lineStr(l, f.label);
+      lineStr(l, "\",unit=\""); lineStr(l, f.unit);
+      lineStr(l, "\"} ");
+      lineFixed(l, f.value, f.scale, f.decimals);
+      emit(o, l);
+    }
+  }
+  family(o, l, "victron_code", "gauge", "Last state, error, alarm and flag codes of each device, as sent");
+  for (int i = 0; i < m.count; i++) {
+    const VMetDevice &d = m.dev[i];
+    if (!d.readings) continue;
+    for (int j = 0; j < d.rec.count; j++) {
+      const VField &f = d.rec.field[j];
+      if (f.na || !isCode(f)) continue;
+      deviceSample(l, "victron_code", d);
+      lineStr(l, ",field=\""); lineStr(l, f.label);
+      lineStr(l, "\"} ");
+      lineUInt(l, f.raw);
+      emit(o, l);
+    }
+  }
+  family(o, l, "victron_readings_total", "counter", "Readings received from each device");
+  for (int i = 0; i < m.count; i++) {
+    deviceSample(l, "victron_readings_total", m.dev[i]);
+    lineStr(l, "} ");
+    lineUInt(l, m.dev[i].readings);
+    emit(o, l);
+  }
+  family(o, l, "victron_dud_readings_total", "counter", "Readings with a value flagged as a dud by the receiver");
+  for (int i = 0; i < m.count; i++) {
+    deviceSample(l, "victron_dud_readings_total", m.dev[i]);
+    lineStr(l, "} ");
+    lineUInt(l, m.dev[i].dudReadings);
+    emit(o, l);
+  }
+  family(o, l, "victron_last_reading_timestamp_seconds", "gauge", "When the last reading of each device was received");
+  for (int i = 0; i < m.count; i++) {
+    const VMetDevice &d = m.dev[i];
+    if (!d.lastMs) continue;
+    deviceSample(l, "victron_last_reading_timestamp_seconds", d);
+    lineStr(l, "} ");
+    lineUInt(l, static_cast<uint32_t>(d.lastMs / 1000));
+    uint32_t ms = d.lastMs % 1000;
+    lineChar(l, '.');
+    lineChar(l, '0' + ms / 100); lineChar(l, '0' + ms / 10 % 10); lineChar(l, '0' + ms % 10);
+    emit(o, l);
+  }
+  family(o, l, "victron_stream_records_total", "counter", "Good records read from each stream");
+  for (int i = 0; i < m.sources; i++) {streamSample(l, "victron_stream_records_total", m.src[i], m.src[i].wire.records); emit(o, l);}
+  family(o, l, "victron_stream_text_frames_total", "counter", "Lines of text between the records of each stream");
+  for (int i = 0; i < m.sources; i++) {streamSample(l, "victron_stream_text_frames_total", m.src[i], m.src[i].wire.text); emit(o, l);}
+  family(o, l, "victron_stream_bad_frames_total", "counter", "Frames dropped as corrupt or cut short from each stream");
+  for (int i = 0; i < m.sources; i++) {streamSample(l, "victron_stream_bad_frames_total", m.src[i], m.src[i].wire.bad); emit(o, l);}
+  family(o, l, "victron_stream_unnamed_readings_total", "counter", "Readings dropped from a device index no device record has named yet");
+  for (int i = 0; i < m.sources; i++) {streamSample(l, "victron_stream_unnamed_readings_total", m.src[i], m.src[i].unnamed); emit(o, l);}
+  family(o, l, "victron_devices", "gauge", "Devices known");
+  lineClear(l); lineStr(l, "victron_devices "); lineUInt(l, m.count); emit(o, l);
+  family(o, l, "victron_devices_dropped_total", "counter", "Device records dropped, the table full");
+  lineClear(l); lineStr(l, "victron_devices_dropped_total "); lineUInt(l, m.full); emit(o, l);
+  family(o, l, "victron_unsupported_readings_total", "counter", "Readings of a record type with no codec");
+  lineClear(l); lineStr(l, "victron_unsupported_readings_total "); lineUInt(l, m.unsupported); emit(o, l);
+  return o.over ? 0 : o.len;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/* Latest readings per device, for a metrics exporter (host/exporter).
+
+The binary output of one or more receivers ("B", see VWire.h), a stream each, is fed in
+a byte at a time. Each device is known by its address from the stream's device records,
+so a device heard by two receivers is one device, its latest reading from either. Its
+reading is kept as labelled fields (a VRecord, VRecord.h) whatever the kind of record:
+Battery Monitor and Solar Controller readings are given the same fields as their codecs.
+Readings from an index not yet named by a device record are counted, not kept.
+
+renderMetrics() writes all of it in the Prometheus text exposition format, e.g.
+  victron_value{device="My_SmartShunt_1",mac="c0:ff:ee:00:00:01",field="battV",unit="V"} 26.00
+one sample a line, each family once with its HELP & TYPE: the values (N/A left out), the
+state / error / alarm codes, readings & dud readings per device, when each was last
+heard, and per stream the records, text & bad frames. Each line is built in a VLine
+(VFormat.h), fixed point as the report lines, into the caller's buffer.
+
+Fixed memory, nothing is allocated: VMET_DEVICES devices from VMET_SOURCES streams.
+An update is O(1) (device records, every 10 secs, search the devices by address), a
+render is linear in the devices. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "VFormat.h"
+#include "VWire.h"
+
+#define VMET_SOURCES   16         // streams, one per receiver
+#define VMET_INDEXES   32         // device indexes per stream (VWire: 5 bits)
+#define VMET_DEVICES   512        // devices over all the streams
+#define VMET_LINES     (VREC_FIELDS + 3)   // sample lines per device, at most
+// largest render: every device with every field, the streams and the HELP & TYPE lines
+#define VMET_RENDER_MAX  ((VMET_DEVICES * VMET_LINES + VMET_SOURCES * 4 + 40) * (VLINE_MAX + 1))
+
+struct VMetDevice {
+  uint64_t mac;
+  char     name[VWIRE_NAME];
+  uint64_t lastMs;                // host time of the last reading (ms since 1970), 0: none yet
+  uint32_t readings;
+  uint32_t dudReadings;           // readings with a dud value flagged (VWIRE_BM & VWIRE_SC only)
+  VRecord  rec;                   // the last reading
+};
+
+struct VMetSource {
+  const char  *name;              // label value, e.g. the port
+  VWireDecoder wire;
+  int16_t      dev[VMET_INDEXES]; // index in the stream -> VMetrics::dev, -1 if not named yet
+  uint32_t     unnamed;           // readings from an index with no device record yet
+};
+
+struct VMetrics {
+  VMetSource src[VMET_SOURCES];
+  uint8_t    sources;
+  VMetDevice dev[VMET_DEVICES];
+  uint16_t   count;
+  uint32_t   full;                // device records dropped: VMET_DEVICES in use
+  uint32_t   unsupported;         // readings of a record type with no codec
+};
+
+void initMetrics(VMetrics &m);
+// a stream named name (kept, not copied): its number, -1 if VMET_SOURCES are in use
+int  metricsAddSource(VMetrics &m, const char *name);
+// the next byte from stream src, received at nowMs (host time, ms since 1970): true if it ended a good record
+bool metricsPut(VMetrics &m, int src, uint8_t b, uint64_t nowMs);
+// a decoded record from stream src, as metricsPut() does. false if not kept
+bool metricsUpdate(VMetrics &m, int src, const VWireRecord &r, uint64_t nowMs);
+
+// the exposition, into buf: its length, 0 if more than size (VMET_RENDER_MAX is always enough)
+size_t renderMetrics(const VMetrics &m, char *buf, size_t size);
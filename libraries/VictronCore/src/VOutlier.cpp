@@ -0,0 +1,128 @@
+/* Streaming outlier filter (see VOutlier.h) */
+
+#include "VOutlier.h"
+
+#include <string.h>
+
+//                                         label      min       max  floor  maxRate
+const VOutlierCfg bmOutlierDefaults = {VOUT_BM_FIELDS, 5, 2, {
+                                       {"V",          0,     7000,    5,  0},   // 10 mV: 0 - 70 V
+                                       {"aux",   -32767,    65534,    5,  0},   // 10 mV or 10 mK
+                                       {"A",   -2000000,  2000000,  200,  0},   // mA: +-2000 A
+                                       {"SOC",        0,     1000,    5,  2},   // 0.1 %: 0.2 %/sec at most
+                                       {"Ah",         0,   100000,    2,  6}}}; // 100 mAh used: 0.6 Ah/sec is 2000 A
+const VOutlierCfg scOutlierDefaults = {VOUT_SC_FIELDS, 5, 2, {
+                                       {"V",          0,     7000,    5,  0},   // 10 mV: 0 - 70 V
+                                       {"A",       -100,     2000,    2,  0},   // 100 mA: to 200 A
+                                       {"PV W",       0,    20000,   10,  0},   // W
+                                       {"kWh",        0,    10000,    1,  1},   // 10 Wh today: 10 Wh/sec is 36 kW
+                                       {"load A",     0,      510,    2,  0}}}; // 100 mA
+
+void initOutlier(VOutlier &o, const VOutlierCfg *cfg){
+  memset(&o, 0, sizeof(o));
+  o.cfg = cfg;
+}
+
+static inline int64_t dist(int32_t a, int32_t b){ return a > b ? static_cast<int64_t>(a) - b : static_cast<int64_t>(b) - a; }
+
+// a good value into the window: the oldest out (once full) and x into its sorted place
+static void addGood(VOutField &s, int32_t x, uint32_t ms){
+  int i;
+  if (s.n == VOUT_WINDOW) {
+    int32_t old = s.win[s.head];
+    s.win[s.head] = x;
+    s.head = (s.head + 1) % VOUT_WINDOW;
+    for (i = 0; s.sorted[i] != old; i++) ;                // it is there
+  }
+  else {
+    s.win[s.n] = x;
+    i = s.n++;
+    s.sorted[i] = x;                                      // the hole, at the end
+  }
+  // move the hole at i to where x goes
+  while (i > 0 && s.sorted[i - 1] > x)               { s.sorted[i] = s.sorted[i - 1]; i--; }
+  while (i < s.n - 1 && s.sorted[i + 1] < x)         { s.sorted[i] = s.sorted[i + 1]; i++; }
+  s.sorted[i] = x;
+  s.last   = x;
+  s.lastMs = ms;
+  s.run    = 0;
+}
+
+/* Median absolute deviation, x1.5, at least floor. The deviations below the median,
+walking down from it, and those above, walking up, are each in order: merging the two
+up to the middle one is the median of them all, without sorting. */
+static int32_t spreadOf(const VOutField &s, int32_t med, int32_t floor){
+  int m = s.n / 2, l = m - 1, r = m;
+  int32_t d = 0;
+  for (int j = 0; j <= m; j++) {
+    if (l >= 0 && (r >= s.n || med - s.sorted[l] <= s.sorted[r] - med)) d = med - s.sorted[l--];
+    else                                                                d = s.sorted[r++] - med;
+  }
+  d += d / 2;
+  if (floor < 1) floor = 1;
+  return d > floor ? d : floor;
+}
+
+uint8_t outlierCheck(VOutlier &o, uint32_t ms, const int32_t v[], uint8_t valid){
+  const VOutlierCfg &c = *o.cfg;
+  uint8_t duds = 0;
+  o.readings++;
+  for (int i = 0; i < c.fields && i < VOUT_FIELDS; i++) {
+    if (!((valid >> i) & 1)) continue;
+    const VOutFieldCfg &fc = c.f[i];
+    VOutField &s = o.f[i];
+    int32_t x = v[i];
+    if (x < fc.min || x > fc.max) { duds |= 1 << i; o.limits++; continue; }
+    if (s.n && ms - s.lastMs > VOUT_STALE_MS) s.n = s.head = s.run = 0;
+    if (!c.k || s.n < VOUT_WARMUP) { addGood(s, x, ms); continue; }
+    int32_t med  = s.sorted[s.n / 2];
+    int64_t band = static_cast<int64_t>(c.k) * spreadOf(s, med, fc.floor);
+    bool out = dist(x, med) > band;
+    if (!out && fc.maxRate) out = dist(x, s.last) > fc.floor + static_cast<int64_t>(fc.maxRate) * (ms - s.lastMs) / 1000;
+    if (!out) { addGood(s, x, ms); continue; }
+    // -- an outlier: a step if it agrees with those just before it
+    s.run = s.run && dist(x, s.pending) <= band ? s.run + 1 : 1;
+    if (s.run >= c.confirm) {
+      int32_t p = s.pending;
+      s.n = s.head = 0;
+      addGood(s, p, ms);
+      addGood(s, x, ms);
+      o.steps++;
+      continue;
+    }
+    s.pending = x;
+    duds |= 1 << i;
+    o.outliers++;
+  }
+  return duds;
+}
+
+bool outlierBand(const VOutlier &o, int i, int32_t &median, int32_t &spread){
+  const VOutField &s = o.f[i];
+  if (!o.cfg->k || s.n < VOUT_WARMUP) return false;
+  median = s.sorted[s.n / 2];
+  spread = spreadOf(s, median, o.cfg->f[i].floor);
+  return true;
+}
+
+// -- readings -> fields ---------------------------------------------------------------------
+
+void bmOutValues(const BatteryMonitorReading &r, int32_t v[], uint8_t &valid){
+  v[0]  = r.battV;                                          // 10 mV
+  v[1]  = r.auxVal;                                         // 10 mV or 10 mK
+  v[2]  = r.battA;                                          // mA
+  v[3]  = r.soc;                                            // 0.1 %
+  v[4]  = static_cast<int32_t>(r.usedAh);                   // 100 mAh
+  valid = (r.valid & BM_BATTV ? 1 : 0) | (r.valid & BM_AUX ? 2 : 0) | (r.valid & BM_BATTA ? 4 : 0)
+        | (r.valid & BM_SOC ? 8 : 0)   | (r.valid & BM_AH ? 16 : 0);
+}
+
+void scOutValues(const SolarChargerReading &r, int32_t v[], uint8_t &valid){
+  v[0]  = r.battV;                                          // 10 mV
+  v[1]  = r.battA;                                          // 100 mA
+  v[2]  = r.pvW;                                            // W
+  v[3]  = r.yield10Wh;                                      // 10 Wh
+  v[4]  = r.loadA;                                          // 100 mA
+  valid = (r.valid & SC_BATTV ? 1 : 0) | (r.valid & SC_BATTA ? 2 : 0) | (r.valid & SC_PVW ? 4 : 0)
+        | (r.valid & SC_KWH ? 8 : 0)   | (r.valid & SC_LOADA ? 16 : 0);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+/* Streaming outlier filter: flags the dud values of a reading against the device's own
+recent readings, in place of fixed thresholds set for one site.
+
+For each field of each device the last VOUT_WINDOW good values are kept, sorted, and a
+new value is tested against their median (Hampel test): it is an outlier if it is more
+than k spreads from the median. The spread is the median absolute deviation scaled to a
+standard deviation (x1.5), but never less than the field's floor, its noise and
+resolution, so a steady value doesn't flag every last digit. A field that only changes
+slowly (SOC, Ah used, yield) can also have a rate limit: a change since the last good
+value of more than maxRate per second (plus the floor) is an outlier too. Values outside
+the hard limits, min to max, are always duds.
+
+Outliers are not added to the window, so a corrupt value doesn't move the median. A
+genuine step (a load switched on, the charger starting) also looks like an outlier at
+first, but a corrupt frame is a one off: when confirm outliers in a row agree with each
+other (within k spreads) the window restarts at the new level and the value is good. A
+step is flagged for confirm - 1 readings, then followed. A field not heard for
+VOUT_STALE_MS starts again too.
+
+The settings are a struct in RAM (defaults below), so they can be changed at runtime and
+one set serves any number of devices. Memory is fixed, 2 x VOUT_WINDOW values a field,
+and a value costs O(VOUT_WINDOW): an insert into the sorted window and a merge for the
+deviation. Nothing is allocated. */
+
+#include <stdint.h>
+#include "VDecode.h"
+
+#define VOUT_FIELDS     5         // values per reading, at most
+#define VOUT_WINDOW     9         // good values per field, the median is taken over these
+#define VOUT_WARMUP     3         // good values before the Hampel test starts
+#define VOUT_STALE_MS   60000     // a field not heard for this long starts again
+
+struct VOutFieldCfg {
+  const char *label;
+  int32_t     min, max;           // hard limits, in the field's own units
+  int32_t     floor;              // least spread: the value's noise & resolution
+  int32_t     maxRate;            // most change per second, 0 = no limit
+};
+
+struct VOutlierCfg {
+  uint8_t      fields;
+  uint8_t      k;                 // spreads from the median for an outlier, 0 = hard limits only
+  uint8_t      confirm;           // outliers in a row that agree: a genuine step (2 or more)
+  VOutFieldCfg f[VOUT_FIELDS];
+};
+
+struct VOutField {
+  int32_t  win[VOUT_WINDOW];      // good values in arrival order, oldest at head once full
+  int32_t  sorted[VOUT_WINDOW];   // the same, sorted
+  int32_t  last;                  // last good value ...
+  uint32_t lastMs;                // ... and when
+  int32_t  pending;               // last outlier, a step if the next ones agree
+  uint8_t  n, head;               // values held, oldest
+  uint8_t  run;                   // outliers in a row
+};
+
+struct VOutlier {
+  const VOutlierCfg *cfg;
+  VOutField f[VOUT_FIELDS];
+  uint32_t  readings;             // checked
+  uint32_t  outliers, limits;     // values flagged by the test / outside the hard limits
+  uint32_t  steps;                // steps followed
+};
+
+void initOutlier(VOutlier &o, const VOutlierCfg *cfg);
+// check a reading at ms: v[i] counts only if bit i of valid is set. Returns a bit per dud value
+uint8_t outlierCheck(VOutlier &o, uint32_t ms, const int32_t v[], uint8_t valid);
+// median & spread field i is tested against, false while it warms up
+bool outlierBand(const VOutlier &o, int i, int32_t &median, int32_t &spread);
+
+// readings as filter fields: volts, aux value, amps, SOC, Ah used (BM) or volts, amps,
+// PV watts, yield, load amps (SC), in the record's units. Hard limits suit 12, 24 & 48 V
+#define VOUT_BM_FIELDS 5
+#define VOUT_SC_FIELDS 5
+extern const VOutlierCfg bmOutlierDefaults;
+extern const VOutlierCfg scOutlierDefaults;
+void bmOutValues(const BatteryMonitorReading &r, int32_t v[], uint8_t &valid);
+void scOutValues(const SolarChargerReading &r, int32_t v[], uint8_t &valid);
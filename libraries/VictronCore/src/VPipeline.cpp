@@ -0,0 +1,101 @@
+/* Portable tasks and the intake stage of the pipeline (see VPipeline.h) */
+
+#include "VPipeline.h"
+
+#include <string.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+struct VTaskStart {
+  VTaskFn fn;
+  void   *arg;
+};
+
+static void taskMain(void *p){
+  VTaskStart s = *static_cast<VTaskStart *>(p);
+  delete static_cast<VTaskStart *>(p);
+  s.fn(s.arg);
+  vTaskDelete(nullptr);                                 // a FreeRTOS task must not return
+}
+
+bool startTask(VTaskFn fn, void *arg, const char *name, int core, uint32_t stack, int priority, VTask *task){
+  VTaskStart  *s = new VTaskStart{fn, arg};
+  BaseType_t   c = core < 0 ? tskNO_AFFINITY : core;
+  TaskHandle_t h = nullptr;
+  if (xTaskCreatePinnedToCore(taskMain, name, stack, s, priority, &h, c) == pdPASS) {
+    if (task) *task = h;
+    return true;
+  }
+  delete s;
+  return false;
+}
+
+void taskSleep(uint32_t ms){
+  if (!ms) {taskYIELD(); return;}
+  TickType_t ticks = pdMS_TO_TICKS(ms);
+  vTaskDelay(ticks ? ticks : 1);
+}
+
+int taskCore(){ return xPortGetCoreID(); }
+
+uint32_t taskStackFree(VTask task){
+  return task ? uxTaskGetStackHighWaterMark(static_cast<TaskHandle_t>(task)) : 0;   // bytes on the ESP32
+}
+
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <chrono>
+#include <thread>
+
+bool startTask(VTaskFn fn, void *arg, const char *, int core, uint32_t, int, VTask *task){
+  if (task) *task = nullptr;
+  std::thread t(fn, arg);
+  if (core >= 0 && static_cast<unsigned>(core) < std::thread::hardware_concurrency()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);   // best effort, as on a single core host
+  }
+  t.detach();
+  return true;
+}
+
+void taskSleep(uint32_t ms){
+  if (!ms) std::this_thread::yield();
+  else     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+int taskCore(){ return sched_getcpu(); }
+
+uint32_t taskStackFree(VTask){ return 0; }
+#endif
+
+// -----------------------------------------------------------------------------------------------
+
+void initIntake(VIntake &p, VRing &in, VRing &out, VDeviceTable &table, VScheduler *sched){
+  memset(&p, 0, sizeof(p));
+  p.in    = &in;
+  p.out   = &out;
+  p.table = &table;
+  p.sched = sched;
+}
+
+int intakeStep(VIntake &p){
+  VFrame *batch = p.batch;
+  int room = VRING_SIZE - static_cast<int>(ringCount(*p.out));   // only grows as the consumer pops: no drop at out
+  int n = room > 0 ? ringPop(*p.in, batch, room) : 0;
+  if (!n) return 0;
+  if (p.sched)
+    for (int i = 0; i < n; i++) {
+      const VDevice *d = findDevice(*p.table, batch[i].mac);
+      if (d) schedFrame(*p.sched, d - p.table->dev, batch[i].data[VMFR_IV] | (batch[i].data[VMFR_IV + 1] << 8), batch[i].ms);
+    }
+  ringPushBatch(*p.out, batch, n);                      // one hand over for the lot
+  p.batches++;
+  p.frames += n;
+  if (static_cast<uint32_t>(n) > p.maxBatch) p.maxBatch = n;
+  return n;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/* Two stage pipeline, one stage per core, so the radio side never waits on Serial.
+
+  intake   (VPIPE_INTAKE_CORE, with the BLE stack) runs the scan: starts & stops it
+           for the scan mode and the adaptive windows, takes the new frames the BLE
+           callback queued in one ring, learns their timing (VSchedule.h) and
+           passes them on to the other ring in batches
+  work     (VPIPE_WORK_CORE, the Arduino loop()) pops those batches, decrypts,
+           decodes, aggregates and prints
+
+Each ring has one producer and one consumer (VRing.h), so neither stage locks or
+waits on the other. The intake stage only takes as many frames as the work stage's
+ring has room for: if the work stage falls behind, say on a slow Serial, frames wait
+in the callback's ring and once it is full are dropped (and counted) there, before
+the callback has kept them for duplicate suppression, so a later repeat of a dropped
+update is still let through. The scan windows still open and close on time and the
+callback still returns at once.
+
+The same code runs on a Linux host for the throughput tests (host/bench_pipeline):
+there a task is a std::thread, pinned to the core if there is one. */
+
+#include <stdint.h>
+#include "VRing.h"
+#include "VSchedule.h"
+
+#define VPIPE_INTAKE_CORE    0        // scanning & frame intake, with the BLE stack
+#define VPIPE_WORK_CORE      1        // decrypt, decode, aggregate & output: Arduino runs loop() here
+#define VPIPE_STACK          4096     // bytes: the least free so far is taskStackFree(), printed by the sketches' S
+#define VPIPE_PRIORITY       2        // above loop() (1), below the BLE stack
+
+// -- portable tasks: a FreeRTOS task pinned to a core on the ESP32, a std::thread on Linux --
+typedef void (*VTaskFn)(void *arg);
+typedef void *VTask;              // a started task: its FreeRTOS handle on the ESP32, nullptr on Linux
+
+// run fn(arg) as a task on core (-1 = any). On the ESP32 fn normally loops forever (the task
+// is deleted if it returns), on Linux the thread is detached. false if it could not be started.
+// task, if given, gets the task for taskStackFree()
+bool startTask(VTaskFn fn, void *arg, const char *name, int core, uint32_t stack = VPIPE_STACK,
+               int priority = VPIPE_PRIORITY, VTask *task = nullptr);
+// sleep for ms, at least a tick on the ESP32 (so lower priority tasks run); 0 = just yield
+void taskSleep(uint32_t ms);
+// core running the caller, -1 if not known
+int  taskCore();
+// the least stack a started task has had free so far (its high water mark), in bytes; 0 if not known
+uint32_t taskStackFree(VTask task);
+
+// -- intake stage --
+struct VIntake {
+  VRing        *in;               // new frames queued by the BLE callback
+  VRing        *out;              // to the work stage, in batches
+  VDeviceTable *table;            // to find each frame's device
+  VScheduler   *sched;            // learns from each frame, nullptr for none
+  uint32_t      batches;          // batches passed on
+  uint32_t      frames;           // frames passed on
+  uint32_t      maxBatch;         // largest batch
+  VFrame        batch[VRING_SIZE];   // the one being passed on, here rather than on the task's stack
+};
+
+void initIntake(VIntake &p, VRing &in, VRing &out, VDeviceTable &table, VScheduler *sched);
+// take the frames queued at in, as many as out has room for, learn their timing and pass them
+// on to out as one batch. Never waits: returns the number of frames taken, 0 if none (or no room)
+int  intakeStep(VIntake &p);
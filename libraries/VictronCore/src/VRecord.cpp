@@ -0,0 +1,254 @@
+/* Codecs for each Victron record type, and the registry (see VRecord.h) */
+
+#include "VRecord.h"
+#include "VLayout.h"
+
+static void add(VRecord &r, const char *label, const char *unit, int32_t value, uint16_t scale, uint32_t raw,
+                uint8_t decimals, bool na, uint8_t kind = VF_NUM){
+  if (r.count >= VREC_FIELDS) return;
+  VField &f = r.field[r.count++];
+  f.label    = label;
+  f.unit     = unit;
+  f.value    = value;
+  f.scale    = scale;
+  f.raw      = raw;
+  f.decimals = decimals;
+  f.kind     = kind;
+  f.na       = na;
+}
+
+// a field from its layout descriptor (VLayout.h): in record units, N/A as declared
+template <const VBitField &F>
+static void addNum(VRecord &r, const uint8_t *rec, const char *label, const char *unit, uint8_t decimals){
+  add(r, label, unit, fieldInt<F>(rec), F.scale, fieldRaw<F>(rec), decimals, fieldNA<F>(rec));
+}
+template <const VBitField &F>
+static void addCode(VRecord &r, const uint8_t *rec, const char *label, uint8_t kind){
+  uint32_t v = fieldRaw<F>(rec);
+  add(r, label, "", v, 1, v, 0, v == F.na, kind);
+}
+// temperature, 7 bits, record value - 40 = deg C
+template <const VBitField &F>
+static void addTemp(VRecord &r, const uint8_t *rec){
+  uint32_t v = fieldRaw<F>(rec);
+  add(r, "temp", "C", static_cast<int32_t>(v) - 40, 1, v, 0, v == F.na);
+}
+// SmartLithium cell, 0.01V steps from 2.60V
+template <const VBitField &F>
+static void addCell(VRecord &r, const uint8_t *rec, const char *label){
+  add(r, label, "V", fieldInt<F>(rec) + 260, F.scale, fieldRaw<F>(rec), 2, fieldNA<F>(rec));
+}
+
+// -- codecs -------------------------------------------------------------------------------
+
+static void decodeSolarCharger(const uint8_t *p, VRecord &r){
+  using namespace SolarChargerLayout;
+  addCode<state> (r, p, "state", VF_STATE);
+  addCode<error> (r, p, "error", VF_ERROR);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addNum <battA> (r, p, "battA", "A",   1);
+  addNum <kWh>   (r, p, "yield", "kWh", 2);
+  addNum <pvW>   (r, p, "PV",    "W",   0);
+  addNum <loadA> (r, p, "load",  "A",   1);
+}
+
+static void decodeBatteryMonitor(const uint8_t *p, VRecord &r){
+  using namespace BatteryMonitorLayout;
+  addNum <ttg>   (r, p, "ttg",   "d",   1);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addCode<alarm> (r, p, "alarm", VF_ALARM);
+  uint32_t a = fieldRaw<aux>(p);                                      // what the aux value bits hold
+  if      (a == 0) addNum<auxV>  (r, p, "auxV", "V", 2);
+  else if (a == 1) addNum<midV>  (r, p, "midV", "V", 2);
+  else if (a == 2) addNum<kelvin>(r, p, "temp", "K", 2);
+  addNum <battA> (r, p, "battA", "A",   3);
+  addNum <usedAh>(r, p, "used",  "Ah",  1);                           // consumed Ah, shown positive
+  addNum <soc>   (r, p, "SOC",   "%",   1);
+}
+
+static void decodeInverter(const uint8_t *p, VRecord &r){
+  using namespace InverterLayout;
+  addCode<state> (r, p, "state", VF_STATE);
+  addCode<alarm> (r, p, "alarm", VF_ALARM);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addNum <acVA>  (r, p, "AC",    "VA",  0);
+  addNum <acV>   (r, p, "ACV",   "V",   2);
+  addNum <acA>   (r, p, "ACA",   "A",   1);
+}
+
+static void decodeDcDcConverter(const uint8_t *p, VRecord &r){
+  using namespace DcDcConverterLayout;
+  addCode<state> (r, p, "state", VF_STATE);
+  addCode<error> (r, p, "error", VF_ERROR);
+  addNum <inV>   (r, p, "inV",   "V",   2);
+  addNum <outV>  (r, p, "outV",  "V",   2);
+  addCode<off>   (r, p, "off",   VF_HEX);
+}
+
+static void decodeSmartLithium(const uint8_t *p, VRecord &r){
+  using namespace SmartLithiumLayout;
+  addCode<flags> (r, p, "flags", VF_HEX);
+  addCode<error> (r, p, "error", VF_HEX);
+  addCell<cell1> (r, p, "cell1");
+  addCell<cell2> (r, p, "cell2");
+  addCell<cell3> (r, p, "cell3");
+  addCell<cell4> (r, p, "cell4");
+  addCell<cell5> (r, p, "cell5");
+  addCell<cell6> (r, p, "cell6");
+  addCell<cell7> (r, p, "cell7");
+  addCell<cell8> (r, p, "cell8");
+  addNum <battV> (r, p, "battV", "V",   2);
+  addTemp<temp>  (r, p);                                              // balancer status not shown
+}
+
+static void decodeInverterRS(const uint8_t *p, VRecord &r){
+  using namespace InverterRSLayout;
+  addCode<state> (r, p, "state", VF_STATE);
+  addCode<error> (r, p, "error", VF_ERROR);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addNum <battA> (r, p, "battA", "A",   1);
+  addNum <pvW>   (r, p, "PV",    "W",   0);
+  addNum <kWh>   (r, p, "yield", "kWh", 2);
+  addNum <acOutW>(r, p, "ACout", "W",   0);
+}
+
+static void decodeAcCharger(const uint8_t *p, VRecord &r){
+  using namespace AcChargerLayout;
+  addCode<state> (r, p, "state", VF_STATE);
+  addCode<error> (r, p, "error", VF_ERROR);
+  addNum <batt1V>(r, p, "batt1V", "V",  2);
+  addNum <batt1A>(r, p, "batt1A", "A",  1);
+  addNum <batt2V>(r, p, "batt2V", "V",  2);
+  addNum <batt2A>(r, p, "batt2A", "A",  1);
+  addNum <batt3V>(r, p, "batt3V", "V",  2);
+  addNum <batt3A>(r, p, "batt3A", "A",  1);
+  addTemp<temp>  (r, p);
+  addNum <acA>   (r, p, "ACA",   "A",   1);
+}
+
+static void decodeBatteryProtect(const uint8_t *p, VRecord &r){
+  using namespace BatteryProtectLayout;
+  addCode<state> (r, p, "state",  VF_STATE);
+  addCode<output>(r, p, "output", VF_HEX);
+  addCode<error> (r, p, "error",  VF_ERROR);
+  addCode<alarm> (r, p, "alarm",  VF_ALARM);
+  addCode<warn>  (r, p, "warn",   VF_ALARM);                          // same bits as the alarms
+  addNum <inV>   (r, p, "inV",   "V",   2);
+  addNum <outV>  (r, p, "outV",  "V",   2);
+  addCode<off>   (r, p, "off",    VF_HEX);
+}
+
+static void decodeLynxBms(const uint8_t *p, VRecord &r){
+  using namespace LynxBmsLayout;
+  addCode<error> (r, p, "error", VF_HEX);
+  addNum <ttg>   (r, p, "ttg",   "d",   1);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addNum <battA> (r, p, "battA", "A",   1);
+  addCode<io>    (r, p, "IO",    VF_HEX);
+  addCode<warn>  (r, p, "warn",  VF_HEX);
+  addNum <soc>   (r, p, "SOC",   "%",   1);
+  addNum <usedAh>(r, p, "used",  "Ah",  1);
+  addTemp<temp>  (r, p);
+}
+
+static void decodeMultiRS(const uint8_t *p, VRecord &r){
+  using namespace MultiRSLayout;
+  addCode<state> (r, p, "state", VF_STATE);
+  addCode<error> (r, p, "error", VF_ERROR);
+  addNum <battA> (r, p, "battA", "A",   1);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addNum <acIn>  (r, p, "ACin",  "",    0);
+  addNum <acInW> (r, p, "ACinW", "W",   0);
+  addNum <acOutW>(r, p, "ACout", "W",   0);
+  addNum <pvW>   (r, p, "PV",    "W",   0);
+  addNum <kWh>   (r, p, "yield", "kWh", 2);
+}
+
+static void decodeVeBus(const uint8_t *p, VRecord &r){
+  using namespace VeBusLayout;
+  addCode<state> (r, p, "state", VF_STATE);
+  addCode<error> (r, p, "error", VF_HEX);
+  addNum <battA> (r, p, "battA", "A",   1);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addNum <acIn>  (r, p, "ACin",  "",    0);
+  addNum <acInW> (r, p, "ACinW", "W",   0);
+  addNum <acOutW>(r, p, "ACout", "W",   0);
+  addNum <alarm> (r, p, "alarm", "",    0);
+  addTemp<temp>  (r, p);
+  addNum <soc>   (r, p, "SOC",   "%",   0);
+}
+
+static void decodeDcEnergyMeter(const uint8_t *p, VRecord &r){
+  using namespace DcEnergyMeterLayout;
+  addNum <mode>  (r, p, "mode",  "",    0);
+  addNum <battV> (r, p, "battV", "V",   2);
+  addCode<alarm> (r, p, "alarm", VF_ALARM);
+  uint32_t a = fieldRaw<aux>(p);
+  if      (a == 0) addNum<auxV>  (r, p, "auxV", "V", 2);
+  else if (a == 2) addNum<kelvin>(r, p, "temp", "K", 2);
+  addNum <battA> (r, p, "battA", "A",   3);
+}
+
+// -- registry -----------------------------------------------------------------------------
+
+// indexed by record type, so dispatch is one lookup. decode = nullptr: not supported
+static const VCodec registry[VREC_TYPES] = {
+  {0x00,                 "Test record",           nullptr             },
+  {VREC_SOLAR_CHARGER,   "Solar Charger",         decodeSolarCharger  },
+  {VREC_BATTERY_MONITOR, "Battery Monitor",       decodeBatteryMonitor},
+  {VREC_INVERTER,        "Inverter",              decodeInverter      },
+  {VREC_DCDC_CONVERTER,  "DC/DC Converter",       decodeDcDcConverter },
+  {VREC_SMART_LITHIUM,   "SmartLithium",          decodeSmartLithium  },
+  {VREC_INVERTER_RS,     "Inverter RS",           decodeInverterRS    },
+  {0x07,                 "GX-Device",             nullptr             },   // layout TBD
+  {VREC_AC_CHARGER,      "AC Charger",            decodeAcCharger     },
+  {VREC_BATTERY_PROTECT, "Smart BatteryProtect",  decodeBatteryProtect},
+  {VREC_LYNX_BMS,        "Lynx Smart BMS",        decodeLynxBms       },
+  {VREC_MULTI_RS,        "Multi RS",              decodeMultiRS       },
+  {VREC_VE_BUS,          "VE.Bus",                decodeVeBus         },
+  {VREC_DC_ENERGY_METER, "DC Energy Meter",       decodeDcEnergyMeter },
+};
+
+const VCodec *codecFor(uint8_t type){
+  if (type >= VREC_TYPES || !registry[type].decode) return nullptr;
+  return &registry[type];
+}
+
+bool decodeRecord(uint8_t type, const uint8_t rec[16], VRecord &r){
+  const VCodec *c = codecFor(type);
+  r.type  = type;
+  r.count = 0;
+  if (!c) return false;
+  c->decode(rec, r);
+  return true;
+}
+
+// -- from a decoded reading -----------------------------------------------------------------
+
+// the fields decodeBatteryMonitor() gives, from the reading (VWire's VWIRE_BM records)
+void recordFromBM(const BatteryMonitorReading &b, VRecord &r){
+  r.type  = VREC_BATTERY_MONITOR;
+  r.count = 0;
+  add(r, "ttg",   "d", b.ttgMin, 1440, b.ttgMin, 1, !(b.valid & BM_TTG));
+  add(r, "battV", "V", b.battV,   100, static_cast<uint16_t>(b.battV), 2, !(b.valid & BM_BATTV));
+  add(r, "alarm", "",  b.alarmBits, 1, b.alarmBits, 0, false, VF_ALARM);
+  static const char *auxLabel[3] = {"auxV", "midV", "temp"};
+  static const char *auxUnit[3]  = {"V",    "V",    "K"};
+  if (b.aux < 3) add(r, auxLabel[b.aux], auxUnit[b.aux], b.auxVal, 100, static_cast<uint32_t>(b.auxVal), 2, !(b.valid & BM_AUX));
+  add(r, "battA", "A",  b.battA, 1000, static_cast<uint32_t>(b.battA), 3, !(b.valid & BM_BATTA));
+  add(r, "used",  "Ah", b.usedAh,  10, b.usedAh, 1, !(b.valid & BM_AH));
+  add(r, "SOC",   "%",  b.soc,     10, b.soc,    1, !(b.valid & BM_SOC));
+}
+
+// the fields decodeSolarCharger() gives, from the reading (VWire's VWIRE_SC records)
+void recordFromSC(const SolarChargerReading &s, VRecord &r){
+  r.type  = VREC_SOLAR_CHARGER;
+  r.count = 0;
+  add(r, "state", "",    s.state, 1, s.state, 0, s.state == 0xFF, VF_STATE);
+  add(r, "error", "",    s.error, 1, s.error, 0, s.error == 0xFF, VF_ERROR);
+  add(r, "battV", "V",   s.battV,   100, static_cast<uint16_t>(s.battV), 2, !(s.valid & SC_BATTV));
+  add(r, "battA", "A",   s.battA,    10, static_cast<uint16_t>(s.battA), 1, !(s.valid & SC_BATTA));
+  add(r, "yield", "kWh", s.yield10Wh, 100, s.yield10Wh, 2, !(s.valid & SC_KWH));
+  add(r, "PV",    "W",   s.pvW,       1, s.pvW,   0, !(s.valid & SC_PVW));
+  add(r, "load",  "A",   s.loadA,    10, s.loadA, 1, !(s.valid & SC_LOADA));
+}
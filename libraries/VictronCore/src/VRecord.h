@@ -0,0 +1,71 @@
+#pragma once
+
+/* Codec registry: decodes the 16 decrypted bytes of any supported Victron record type.
+The record type is byte 6 of the manufacturer data (VMFR_RECORD, sent in clear).
+codecFor() looks it up in a table indexed by type, and the codec found turns the
+record into a VRecord: a short list of labelled values, each with its unit and
+N/A flag, that formatRecord() (VFormat.h) prints whatever the device.
+
+The bit layout of each type is declared in VLayout.h, following "Extra Manufacturer
+Data" (docs/Victron_Extra_Manufacturer_Data.pdf); the codecs add labels, units and
+decimals. */
+
+#include <stdint.h>
+#include "VDecode.h"
+
+// record types (byte VMFR_RECORD)
+#define VREC_SOLAR_CHARGER    0x01
+#define VREC_BATTERY_MONITOR  0x02
+#define VREC_INVERTER         0x03
+#define VREC_DCDC_CONVERTER   0x04
+#define VREC_SMART_LITHIUM    0x05
+#define VREC_INVERTER_RS      0x06
+#define VREC_AC_CHARGER       0x08
+#define VREC_BATTERY_PROTECT  0x09
+#define VREC_LYNX_BMS         0x0A
+#define VREC_MULTI_RS         0x0B
+#define VREC_VE_BUS           0x0C
+#define VREC_DC_ENERGY_METER  0x0D
+#define VREC_TYPES            0x0E      // size of the registry, types 0x00 .. 0x0D
+
+#define VREC_FIELDS   12                // most values in one record (SmartLithium)
+
+// how a value is shown
+enum VFieldKind : uint8_t {
+  VF_NUM,                     // number, to 'decimals' places, then unit
+  VF_STATE,                   // VE_REG_DEVICE_STATE name
+  VF_ERROR,                   // VE_REG_CHR_ERROR_CODE name
+  VF_ALARM,                   // VE_REG_ALARM_REASON name
+  VF_HEX,                     // flags, in hex
+};
+
+struct VField {
+  const char *label;          // short name, e.g. "battV"
+  const char *unit;           // "V", "A", "kWh" ... or ""
+  int32_t     value;          // fixed point: value / scale in unit
+  uint32_t    raw;            // field bits as sent (state, error, alarm & flag codes)
+  uint16_t    scale;
+  uint8_t     decimals;
+  uint8_t     kind;           // VFieldKind
+  bool        na;             // not available: value not sent or not valid
+};
+
+struct VRecord {
+  uint8_t type;               // VREC_...
+  uint8_t count;              // fields used
+  VField  field[VREC_FIELDS];
+};
+
+struct VCodec {
+  uint8_t     type;
+  const char *name;           // e.g. "Solar Charger"
+  void      (*decode)(const uint8_t rec[16], VRecord &r);
+};
+
+// codec for a record type, nullptr if the type is not supported
+const VCodec *codecFor(uint8_t type);
+// decode rec[16] (decrypted) of the given type into r. false if the type is not supported
+bool decodeRecord(uint8_t type, const uint8_t rec[16], VRecord &r);
+// the same fields from a reading already decoded (decodeBM() / decodeSC()), as a codec gives them
+void recordFromBM(const BatteryMonitorReading &b, VRecord &r);
+void recordFromSC(const SolarChargerReading &s, VRecord &r);
@@ -0,0 +1,60 @@
+/* Single producer / single consumer frame ring (see VRing.h) */
+
+#include "VRing.h"
+
+#include <string.h>
+
+static_assert((VRING_SIZE & (VRING_SIZE - 1)) == 0, "VRING_SIZE must be a power of 2");
+
+void initRing(VRing &r){
+  r.head.store(0, std::memory_order_relaxed);
+  r.tail.store(0, std::memory_order_relaxed);
+  r.pushed   = 0;
+  r.dropped  = 0;
+  r.maxDepth = 0;
+  r.popped   = 0;
+}
+
+bool ringPush(VRing &r, uint64_t mac, int rssi, uint32_t ms, const uint8_t *data, size_t len){
+  uint32_t head  = r.head.load(std::memory_order_relaxed);     // only we write it
+  uint32_t depth = head - r.tail.load(std::memory_order_acquire);
+  if (depth >= VRING_SIZE) { r.dropped++; return false; }
+  VFrame &f = r.slot[head & (VRING_SIZE - 1)];
+  if (len > VMFR_MAX) len = VMFR_MAX;
+  f.mac  = mac;
+  f.ms   = ms;
+  f.rssi = static_cast<int8_t>(rssi);
+  f.len  = static_cast<uint8_t>(len);
+  memcpy(f.data, data, len);
+  r.head.store(head + 1, std::memory_order_release);          // publish the frame
+  r.pushed++;
+  if (depth + 1 > r.maxDepth) r.maxDepth = depth + 1;
+  return true;
+}
+
+int ringPushBatch(VRing &r, const VFrame *f, int n){
+  uint32_t head  = r.head.load(std::memory_order_relaxed);
+  uint32_t depth = head - r.tail.load(std::memory_order_acquire);
+  uint32_t room  = VRING_SIZE - depth;
+  uint32_t k     = static_cast<uint32_t>(n) < room ? n : room;
+  for (uint32_t i = 0; i < k; i++) r.slot[(head + i) & (VRING_SIZE - 1)] = f[i];
+  r.head.store(head + k, std::memory_order_release);          // publish the batch
+  r.pushed  += k;
+  r.dropped += n - k;
+  if (depth + k > r.maxDepth) r.maxDepth = depth + k;
+  return static_cast<int>(k);
+}
+
+int ringPop(VRing &r, VFrame *out, int max){
+  uint32_t tail = r.tail.load(std::memory_order_relaxed);     // only we write it
+  uint32_t n    = r.head.load(std::memory_order_acquire) - tail;
+  if (n > static_cast<uint32_t>(max)) n = max;
+  for (uint32_t i = 0; i < n; i++) out[i] = r.slot[(tail + i) & (VRING_SIZE - 1)];
+  r.tail.store(tail + n, std::memory_order_release);          // hand the slots back
+  r.popped += n;
+  return static_cast<int>(n);
+}
+
+uint32_t ringCount(const VRing &r){
+  return r.head.load(std::memory_order_acquire) - r.tail.load(std::memory_order_acquire);
+}
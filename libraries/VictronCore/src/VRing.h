@@ -0,0 +1,49 @@
+#pragma once
+
+/* Lock-free single producer / single consumer ring of raw advertisements.
+The BLE callback (producer, its own task) pushes each frame it accepts; loop()
+(consumer) pops them in batches. Neither side ever waits or allocates: a push
+into a full ring drops the new frame and counts it, so the callback returns in
+bounded time however slow the decode & print side is.
+
+head is only written by the producer and tail only by the consumer, each with a
+release store, and each side reads the other's index with an acquire load, so a
+slot is never read while it is being written (no torn frames). The counters have one
+writer each, as marked, and are volatile: the other side, or loop() for a print,
+reads them from another core. */
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "VDevices.h"
+
+#define VRING_SIZE   16       // frames held, power of 2
+
+struct VFrame {
+  uint64_t mac;               // 48 bit address of the sender
+  uint32_t ms;                // millis() when received
+  int8_t   rssi;              // dBm
+  uint8_t  len;               // bytes in data[]
+  uint8_t  data[VMFR_MAX];    // manufacturer data, as BIGarray
+};
+
+struct VRing {
+  std::atomic<uint32_t> head;     // next slot to write, free running (producer)
+  std::atomic<uint32_t> tail;     // next slot to read, free running (consumer)
+  volatile uint32_t pushed;   // frames queued             (written by producer only)
+  volatile uint32_t dropped;  // frames lost, ring full    (producer)
+  volatile uint32_t maxDepth; // most frames ever queued   (producer)
+  volatile uint32_t popped;   // frames taken              (consumer)
+  VFrame   slot[VRING_SIZE];
+};
+
+void initRing(VRing &r);      // call before the producer starts
+// producer: copy a frame in (data truncated to VMFR_MAX). false, and counted as dropped, if full
+bool ringPush(VRing &r, uint64_t mac, int rssi, uint32_t ms, const uint8_t *data, size_t len);
+// producer: copy n frames in and publish them together (one release store, not one per frame).
+// Returns the number queued, the rest are dropped and counted if it fills
+int  ringPushBatch(VRing &r, const VFrame *f, int n);
+// consumer: copy up to max frames out, oldest first. Returns the number copied
+int  ringPop(VRing &r, VFrame *out, int max);
+// frames waiting, either side (a snapshot)
+uint32_t ringCount(const VRing &r);
@@ -0,0 +1,153 @@
+/* Adaptive scan windows (see VSchedule.h)
+
+Per target, the update times are modelled as a grid: anchorMs, when the data
+last changed, then every changeMs. The first frame of an update arrives up to
+lateMs after it (the advertising interval), so
+  changeMs   is the time since baseMs over the updates since (IV steps), a long
+             baseline, so how late the first and last frames were hardly matters
+  anchorMs   follows the lower edge of the arrivals: a frame earlier than the
+             grid moves it there. The radio is off before a window, so every
+             VSCHED_PROBE windows one opens early by lateMs to see if there are
+             any: without that, windows that started late would only ever see
+             late frames, and stay late
+  lateMs     the top of the arrival delays, leaking down slowly
+
+A window that closes with nothing heard stays open one more lateMs (the first
+advert of an update is lost now and then) before it counts as a miss. */
+
+#include "VSchedule.h"
+
+#include <string.h>
+
+static inline bool reached(uint32_t now, uint32_t ms){ return static_cast<int32_t>(now - ms) >= 0; }
+
+// the window for update 'ahead' steps on from the anchor
+static void nextWindow(VSchedDev &t){
+  uint32_t at    = t.anchorMs + t.ahead * t.changeMs;
+  uint32_t slack = t.ahead * t.changeMs / 256;          // any error in changeMs adds up
+  if (slack > t.changeMs / 2) slack = t.changeMs / 2;
+  slack += VSCHED_MARGIN_MS;
+  if (++t.probe >= VSCHED_PROBE) {                      // now and then open early by a whole lateMs
+    t.probe = 0;
+    slack  += t.lateMs;
+  }
+  uint32_t len = t.lateMs;
+  if (t.misses >= VSCHED_SILENT) len += t.changeMs;     // may have drifted: cover a whole update
+  t.openMs   = at - slack;
+  t.closeMs  = at + len + slack;
+  t.opened   = false;
+  t.extended = false;
+}
+
+static void listen(VSchedDev &t, uint32_t from){
+  t.openMs   = from;
+  t.closeMs  = from + VSCHED_LISTEN_MS;
+  t.opened   = false;
+  t.extended = true;                                    // no second chance
+}
+
+void initScheduler(VScheduler &s, int count, uint32_t now){
+  memset(&s, 0, sizeof(s));
+  s.count  = count;
+  s.lastMs = now;
+  for (int i = 0; i < count; i++) listen(s.dev[i], now);
+}
+
+void schedFrame(VScheduler &s, int dev, uint16_t iv, uint32_t ms){
+  VSchedDev &t = s.dev[dev];
+  uint16_t n = iv - t.lastIv;
+  if (t.frames && n == 0) return;                       // same IV, new data: no timing in it
+  bool lost = t.frames >= VSCHED_LEARN && t.misses >= VSCHED_SILENT;
+  t.lastIv = iv;
+  t.misses = 0;
+  if (!t.frames || n > 0x8000 || lost) {                // first, the IV went back (restarted), or back after a gap
+    t.frames = 1;                                       // learn it again
+    listen(t, ms);
+    return;
+  }
+  if (t.frames == 1) {                                  // the first update seen start to end
+    t.frames   = 2;
+    t.baseMs   = t.anchorMs = ms;
+    t.updates  = 0;
+    t.lateMs   = 0;
+    listen(t, ms);
+    return;
+  }
+  bool learning = t.frames < VSCHED_LEARN;
+  t.updates += n;
+  uint32_t change = (ms - t.baseMs) / t.updates;
+  if (t.frames == 2) t.changeMs = change ? change : 1;    // never 0: divides the gap in missed()
+  uint32_t pred = t.anchorMs + n * t.changeMs;
+  int32_t  late = static_cast<int32_t>(ms - pred);
+  if (late < 0) t.anchorMs = ms;                        // changed earlier than the grid said
+  else {
+    t.anchorMs = pred + late / 64;                      // follow a drift (changeMs is whole ms)
+    bool inWindow = t.opened && !t.extended && n == t.ahead;    // else it was heard late, in another target's window
+    if ((learning || inWindow) && static_cast<uint32_t>(late) > t.lateMs) t.lateMs = late;
+  }
+  if (change >= VSCHED_MARGIN_MS) t.changeMs = change;
+  if (t.lateMs > t.changeMs) t.lateMs = t.changeMs;
+  if (t.updates >= 1024) {                              // keep following slow changes
+    t.updates = 256;
+    t.baseMs  = ms - 256 * t.changeMs;
+  }
+  if (learning) {
+    if (++t.frames < VSCHED_LEARN) {listen(t, ms); return;}
+  }
+  else t.lateMs -= t.lateMs / 64;
+  t.ahead = 1;
+  nextWindow(t);
+}
+
+// a window closed with nothing new: one more advert, then the next update, then back off
+static void missed(VScheduler &s, VSchedDev &t){
+  if (!t.extended) {
+    t.closeMs += t.lateMs;
+    t.extended = true;
+    return;
+  }
+  if (t.misses < 255) t.misses++;
+  s.misses++;
+  if (t.frames < VSCHED_LEARN) {
+    uint32_t gap = VSCHED_LISTEN_MS << (t.misses < 3 ? t.misses - 1 : 2);
+    listen(t, t.closeMs + (gap < VSCHED_MAX_GAP_MS ? gap : VSCHED_MAX_GAP_MS));
+    return;
+  }
+  uint32_t step = 1;
+  if (t.misses >= VSCHED_SILENT) {
+    int shift = t.misses - VSCHED_SILENT + 1;
+    uint32_t most = VSCHED_MAX_GAP_MS / t.changeMs;     // changeMs >= 1, see schedFrame()
+    step = shift < 16 ? 1u << shift : most;
+    if (step > most) step = most ? most : 1;
+  }
+  t.ahead += step;
+  nextWindow(t);
+}
+
+bool schedUpdate(VScheduler &s, uint32_t now){
+  uint32_t dt = now - s.lastMs;
+  s.totalMs += dt;
+  if (s.on) s.onMs += dt;
+  s.lastMs = now;
+  bool on = false;
+  for (int i = 0; i < s.count; i++) {
+    VSchedDev &t = s.dev[i];
+    for (int k = 0; k < 8 && reached(now, t.closeMs); k++) missed(s, t);   // 8: after a long stall, catch up a bit at a time
+    if (reached(now, t.openMs)) {
+      on = true;
+      if (!t.opened) {t.opened = true; s.windows++;}
+    }
+  }
+  s.on = on;
+  return on;
+}
+
+bool schedSilent(const VScheduler &s){
+  for (int i = 0; i < s.count; i++)
+    if (s.dev[i].misses < VSCHED_SILENT) return false;
+  return s.count > 0;
+}
+
+uint32_t schedDuty(const VScheduler &s){
+  return s.totalMs ? static_cast<uint32_t>(static_cast<uint64_t>(s.onMs) * 1000 / s.totalMs) : 0;
+}
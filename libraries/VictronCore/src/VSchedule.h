@@ -0,0 +1,71 @@
+#pragma once
+
+/* Adaptive scan windows: the radio is only on when a target is due to send new data.
+
+A Victron device repeats the same payload several times between updates, and
+puts a new IV on each update, so most of the time spent listening only hears
+repeats. For each target the scheduler learns
+  - the time between updates, from the time and IV of each new frame (missed
+    updates count, as the IV has moved on by more than 1)
+  - when the updates happen, and how late after one its first frame arrives:
+    up to one advertising interval, as the device only sends the new data with
+    its next advert. This is what sizes the window
+and opens a window around each predicted update, closed again once it arrives.
+The radio stays on while a target is learnt (VSCHED_LEARN new frames), as when
+it is off a frame earlier than expected can't be heard to correct the timing.
+A window that closes with nothing new counts a miss and the next one is further
+away and wider, the gap doubling up to VSCHED_MAX_GAP_MS, so a target that is
+switched off or out of range costs a short probe now and then; when it is heard
+again it is learnt again.
+
+Times are millis(), wrap safe. No allocation, O(targets) per call.
+
+One task owns a scheduler and is the only one to call schedFrame() / schedUpdate()
+(the intake task, VPipeline.h). Another may read it as it goes: schedSilent(), and
+onMs & totalMs. Those fields are volatile, each 32 bits or less, so it reads a
+whole value written by the owner, and no lock is needed. */
+
+#include <stdint.h>
+#include "VDevices.h"
+
+#define VSCHED_LEARN         12       // new frames before a target gets windows
+#define VSCHED_LISTEN_MS     10000    // radio on while learning, then counted as a miss
+#define VSCHED_MARGIN_MS     15       // added to each end of a window
+#define VSCHED_PROBE         8        // every 8th window opens early, to check the timing
+#define VSCHED_MAX_GAP_MS    30000    // longest gap between windows for a silent target
+#define VSCHED_SILENT        2        // misses in a row for a target to count as not found
+
+struct VSchedDev {
+  uint32_t anchorMs;              // when the data last changed, best guess
+  uint32_t changeMs;              // learned time between updates
+  uint32_t lateMs;                // learned arrival delay after an update, at most
+  uint32_t baseMs;                // changeMs is measured from here ...
+  uint32_t updates;               // ... over this many updates
+  uint32_t openMs, closeMs;       // next window
+  uint32_t ahead;                 // updates on from the anchor the window is for
+  uint16_t lastIv;
+  uint8_t  frames;                // new frames seen, up to VSCHED_LEARN
+  volatile uint8_t misses;        // windows in a row with nothing new
+  uint8_t  probe;                 // windows since one opened early
+  bool     opened;                // next window has opened
+  bool     extended;              // next window kept open for a second advert
+};
+
+struct VScheduler {
+  int       count;
+  VSchedDev dev[VDEV_MAX];
+  bool      on;                   // radio wanted on, as last returned by schedUpdate()
+  uint32_t  lastMs;               // last schedUpdate()
+  volatile uint32_t onMs, totalMs;   // time on / in all since initScheduler(), for the duty cycle
+  uint32_t  windows, misses;      // windows opened, windows missed
+};
+
+void initScheduler(VScheduler &s, int count, uint32_t now);
+// a new frame (not a repeat) from target dev with nonce iv, received at ms
+void schedFrame(VScheduler &s, int dev, uint16_t iv, uint32_t ms);
+// should the radio be on at now? Closes windows that are over (counting misses) and opens those due
+bool schedUpdate(VScheduler &s, uint32_t now);
+// every target has missed VSCHED_SILENT windows in a row
+bool schedSilent(const VScheduler &s);
+// radio on time since initScheduler(), in 0.1%
+uint32_t schedDuty(const VScheduler &s);
@@ -0,0 +1,72 @@
+/* Runtime counters (see VStats.h) */
+
+#include "VStats.h"
+#include "VFormat.h"
+
+#include <string.h>
+
+static const char *gapNames[VSTAT_BUCKETS]      = {"1", "2", "3-4", "5-8", "9-16", "17-32", "33-64", "65+"};
+static const char *intervalNames[VSTAT_BUCKETS] = {"<125ms", "<250ms", "<500ms", "<1s", "<2s", "<4s", "<8s", "8s+"};
+
+// 0 for v <= 1, then 1 + log2(v - 1): 2 -> 1, 3-4 -> 2, 5-8 -> 3 ...
+static inline int log2Bucket(uint32_t v){
+  int b = v <= 1 ? 0 : 32 - __builtin_clz(v - 1);
+  return b < VSTAT_BUCKETS ? b : VSTAT_BUCKETS - 1;
+}
+
+void initStats(VStats &s){
+  memset(&s, 0, sizeof(s));
+}
+
+void statsFrame(VStats &s, int dev, uint16_t iv, uint32_t ms){
+  VDevStats &d = s.dev[dev];
+  if (d.started) {
+    uint16_t missed = static_cast<uint16_t>(iv - d.lastIv) - 1;   // 0xFFFF: same IV, new data
+    if (missed && missed != 0xFFFF) {
+      d.ivGaps++;
+      d.ivMissed += missed;
+      s.gapHist[log2Bucket(missed)]++;
+    }
+    s.intervalHist[log2Bucket((ms - d.lastMs) / 125 + 1)]++;
+  }
+  d.started = true;
+  d.lastIv  = iv;
+  d.lastMs  = ms;
+}
+
+static void lineCount(VLine &l, uint32_t n, const char *what){
+  lineUInt(l, n);
+  lineStr(l, what);
+}
+
+void formatDevStats(VLine &l, const VStats &s, int dev, const VDevice &d){
+  const VDevStats &t = s.dev[dev];
+  lineStr(l, d.name);
+  lineStr(l, ": ");
+  lineCount(l, t.adverts,       " adverts, ");
+  lineCount(l, d.accepted,      " new, ");
+  lineCount(l, d.suppressed,    " repeats, ");
+  lineCount(l, t.keyFails,      " key fails, ");
+  lineCount(l, t.ivGaps,        " IV gaps (");
+  lineCount(l, t.ivMissed,      " missed), ");
+  lineCount(l, t.dudReadings,   " dud readings (");
+  lineCount(l, t.dudValues,     " values)");
+}
+
+static void formatHist(VLine &l, const char *label, const uint32_t h[], const char *const names[]){
+  lineStr(l, label);
+  for (int i = 0; i < VSTAT_BUCKETS; i++) {
+    lineChar(l, ' ');
+    lineStr(l, names[i]);
+    lineChar(l, ':');
+    lineUInt(l, h[i]);
+  }
+}
+
+void formatGapHist(VLine &l, const VStats &s){
+  formatHist(l, "IV gaps  ", s.gapHist, gapNames);
+}
+
+void formatIntervalHist(VLine &l, const VStats &s){
+  formatHist(l, "intervals", s.intervalHist, intervalNames);
+}
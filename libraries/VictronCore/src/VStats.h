@@ -0,0 +1,49 @@
+#pragma once
+
+/* Always-on counters and histograms of what the receiver sees, cheap enough to
+leave running: each event is an increment or two, and the histograms use log2
+buckets (a count leading zeros). Memory is fixed.
+
+Counted elsewhere already and printed with these: advertisements seen (cbCalls in
+the sketches), repeats dropped and frames passed on per device (VDevice accepted
+/ suppressed), keystream cache hits (VDevice) and frames queued / dropped (VRing).
+
+Every field has one writer, so no locking is needed: adverts per device in the
+BLE callback, scanStarts in the intake task that runs the scan (both volatile, as
+loop() reads them for the print), everything else in loop(). */
+
+#include <stdint.h>
+#include "VDevices.h"
+
+#define VSTAT_BUCKETS   8
+
+struct VDevStats {
+  volatile uint32_t adverts;      // Victron frames from the device, repeats included (callback)
+  uint32_t keyFails;              // frames that did not decrypt
+  uint32_t ivGaps;                // frames after one or more missed updates (IV jumped)
+  uint32_t ivMissed;              // updates missed in all
+  uint32_t dudReadings;           // readings with one or more dud values
+  uint32_t dudValues;
+  uint32_t lastMs;                // last new frame
+  uint16_t lastIv;
+  bool     started;
+};
+
+struct VStats {
+  volatile uint32_t scanStarts;   // BLE scans started (each start/stop scan, or the continuous one)
+  uint32_t notFound;              // 'not found' reports
+  uint32_t gapHist[VSTAT_BUCKETS];        // updates missed per gap: 1, 2, 3-4, 5-8 ... 65+
+  uint32_t intervalHist[VSTAT_BUCKETS];   // ms between new frames from a device: < 125, < 250 ... 8000+
+  VDevStats dev[VDEV_MAX];
+};
+
+void initStats(VStats &s);
+// a new (decrypted) frame from device dev with nonce iv, received at ms
+void statsFrame(VStats &s, int dev, uint16_t iv, uint32_t ms);
+
+// print helpers, one line each
+struct VLine;
+// "name: 2345 adverts, 445 new, 1900 repeats, 3 key fails, 12 IV gaps (30 missed), 4 dud readings (5 values)"
+void formatDevStats(VLine &l, const VStats &s, int dev, const VDevice &d);
+void formatGapHist(VLine &l, const VStats &s);          // "IV gaps   1:12 2:3 3-4:0 ..."
+void formatIntervalHist(VLine &l, const VStats &s);     // "intervals <125ms:0 <250ms:10 ..."
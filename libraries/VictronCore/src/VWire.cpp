@@ -0,0 +1,193 @@
+/* Binary output records (see VWire.h) */
+
+#include "VWire.h"
+
+#include <string.h>
+
+#define VWIRE_HEAD         4      // kind & device, time
+#define VWIRE_BM_LEN      23      // record lengths, CRC not included
+#define VWIRE_SC_LEN      18
+#define VWIRE_RECORD_LEN  21
+#define VWIRE_DEVICE_LEN  10      // ... and the name
+
+static inline void put16(uint8_t *p, uint32_t v){ p[0] = v; p[1] = v >> 8; }
+static inline void put24(uint8_t *p, uint32_t v){ p[0] = v; p[1] = v >> 8; p[2] = v >> 16; }
+static inline uint32_t get16(const uint8_t *p){ return p[0] | p[1] << 8; }
+static inline uint32_t get24(const uint8_t *p){ return p[0] | p[1] << 8 | p[2] << 16; }
+static inline int32_t  sign24(uint32_t v){ return static_cast<int32_t>(v << 8) >> 8; }
+
+// nibble at a time, as crc32() (VConfig.cpp): a 16 entry table
+uint16_t crc16(const uint8_t *p, size_t n){
+  static const uint16_t t[16] = {0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+                                 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+  uint16_t crc = 0xFFFF;
+  while (n--) {
+    crc = (crc << 4) ^ t[(crc >> 12) ^ (*p >> 4)];
+    crc = (crc << 4) ^ t[(crc >> 12) ^ (*p++ & 15)];
+  }
+  return crc;
+}
+
+size_t cobsEncode(const uint8_t *in, size_t n, uint8_t *out){
+  size_t  o = 1, c = 0;                                     // next byte out, the open group's code byte
+  uint8_t code = 1;
+  for (size_t i = 0; i < n; i++) {
+    if (in[i]) {out[o++] = in[i]; code++;}
+    if (!in[i] || code == 0xFF) {out[c] = code; code = 1; c = o++;}
+  }
+  out[c] = code;
+  return o;
+}
+
+size_t cobsDecode(const uint8_t *in, size_t n, uint8_t *out, size_t max){
+  size_t i = 0, o = 0;
+  while (i < n) {
+    uint8_t code = in[i++];
+    if (!code) return 0;
+    for (uint8_t j = 1; j < code; j++) {
+      if (i >= n || !in[i] || o >= max) return 0;
+      out[o++] = in[i++];
+    }
+    if (code != 0xFF && i < n) {                            // a 0 ended the group, unless it was the last
+      if (o >= max) return 0;
+      out[o++] = 0;
+    }
+  }
+  return o;
+}
+
+// -- records --------------------------------------------------------------------------------
+
+// header on rec[], CRC after len bytes, then framed into out
+static size_t frame(uint8_t *out, uint8_t *rec, size_t len, uint8_t kind, uint8_t dev, uint32_t ms){
+  rec[0] = kind << 5 | (dev & 0x1F);
+  put24(rec + 1, ms);
+  put16(rec + len, crc16(rec, len));
+  size_t n = cobsEncode(rec, len + 2, out);
+  out[n++] = 0;
+  return n;
+}
+
+size_t wireBM(uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint8_t duds, const BatteryMonitorReading &r){
+  uint8_t rec[VWIRE_MAX];
+  rec[4] = (r.valid & 0x3F) | r.aux << 6;
+  rec[5] = duds;
+  put16(rec + 6,  static_cast<uint16_t>(r.battV));
+  put24(rec + 8,  static_cast<uint32_t>(r.auxVal));
+  put24(rec + 11, static_cast<uint32_t>(r.battA));
+  put24(rec + 14, r.usedAh);
+  put16(rec + 17, r.soc);
+  put16(rec + 19, r.ttgMin);
+  put16(rec + 21, r.alarmBits);
+  return frame(out, rec, VWIRE_BM_LEN, VWIRE_BM, dev, ms);
+}
+
+size_t wireSC(uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint8_t duds, const SolarChargerReading &r){
+  uint8_t rec[VWIRE_MAX];
+  rec[4] = r.valid;
+  rec[5] = duds;
+  put16(rec + 6,  static_cast<uint16_t>(r.battV));
+  put16(rec + 8,  static_cast<uint16_t>(r.battA));
+  put16(rec + 10, r.yield10Wh);
+  put16(rec + 12, r.pvW);
+  put16(rec + 14, r.loadA);
+  rec[16] = r.state;
+  rec[17] = r.error;
+  return frame(out, rec, VWIRE_SC_LEN, VWIRE_SC, dev, ms);
+}
+
+size_t wireRecord(uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint8_t type, const uint8_t data[16]){
+  uint8_t rec[VWIRE_MAX];
+  rec[4] = type;
+  memcpy(rec + 5, data, 16);
+  return frame(out, rec, VWIRE_RECORD_LEN, VWIRE_RECORD, dev, ms);
+}
+
+size_t wireDevice(uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint64_t mac, const char *name){
+  uint8_t rec[VWIRE_MAX];
+  for (int i = 0; i < 6; i++) rec[4 + i] = mac >> (40 - 8 * i);
+  size_t n = name ? strnlen(name, VWIRE_NAME - 1) : 0;
+  if (n) memcpy(rec + VWIRE_DEVICE_LEN, name, n);
+  return frame(out, rec, VWIRE_DEVICE_LEN + n, VWIRE_DEVICE, dev, ms);
+}
+
+bool wireDecode(const uint8_t *frame, size_t n, VWireRecord &r){
+  uint8_t rec[VWIRE_MAX];
+  size_t len = cobsDecode(frame, n, rec, sizeof(rec));
+  if (len < VWIRE_HEAD + 2 || crc16(rec, len - 2) != get16(rec + len - 2)) return false;
+  len -= 2;
+  r.kind = rec[0] >> 5;
+  r.dev  = rec[0] & 0x1F;
+  r.ms   = get24(rec + 1);
+  switch (r.kind) {
+    case VWIRE_BM:
+      if (len != VWIRE_BM_LEN) return false;
+      r.bm.valid     = rec[4] & 0x3F;
+      r.bm.aux       = rec[4] >> 6;
+      r.duds         = rec[5];
+      r.bm.battV     = static_cast<int16_t>(get16(rec + 6));
+      r.bm.auxVal    = sign24(get24(rec + 8));
+      r.bm.battA     = sign24(get24(rec + 11));
+      r.bm.usedAh    = get24(rec + 14);
+      r.bm.soc       = get16(rec + 17);
+      r.bm.ttgMin    = get16(rec + 19);
+      r.bm.alarmBits = get16(rec + 21);
+      return true;
+    case VWIRE_SC:
+      if (len != VWIRE_SC_LEN) return false;
+      r.sc.valid     = rec[4];
+      r.duds         = rec[5];
+      r.sc.battV     = static_cast<int16_t>(get16(rec + 6));
+      r.sc.battA     = static_cast<int16_t>(get16(rec + 8));
+      r.sc.yield10Wh = get16(rec + 10);
+      r.sc.pvW       = get16(rec + 12);
+      r.sc.loadA     = get16(rec + 14);
+      r.sc.state     = rec[16];
+      r.sc.error     = rec[17];
+      return true;
+    case VWIRE_RECORD:
+      if (len != VWIRE_RECORD_LEN) return false;
+      r.type = rec[4];
+      memcpy(r.data, rec + 5, 16);
+      return true;
+    case VWIRE_DEVICE:
+      if (len < VWIRE_DEVICE_LEN || len > VWIRE_DEVICE_LEN + VWIRE_NAME - 1) return false;
+      r.mac = 0;
+      for (int i = 0; i < 6; i++) r.mac = r.mac << 8 | rec[4 + i];
+      memcpy(r.name, rec + VWIRE_DEVICE_LEN, len - VWIRE_DEVICE_LEN);
+      r.name[len - VWIRE_DEVICE_LEN] = 0;
+      return true;
+  }
+  return false;                                             // a kind not known here
+}
+
+// -- stream ---------------------------------------------------------------------------------
+
+void initWireDecoder(VWireDecoder &d){
+  memset(&d, 0, sizeof(d));
+  d.printable = true;
+}
+
+bool wirePut(VWireDecoder &d, uint8_t b, VWireRecord &r){
+  if (b) {
+    if (d.n < VWIRE_FRAME_MAX) d.buf[d.n++] = b;
+    else                       d.over = true;
+    if ((b < ' ' || b > '~') && b != '\n' && b != '\r' && b != '\t') d.printable = false;
+    return false;
+  }
+  bool ok = false;
+  if (d.n || d.over) {                                      // 0 0: nothing between, not a frame
+    ok = !d.over && wireDecode(d.buf, d.n, r);
+    if (ok) {                                               // the time back to 32 bits, from the last
+      r.ms = d.ms + sign24((r.ms - d.ms) & 0xFFFFFF);
+      d.ms = r.ms;
+    }
+    if      (ok)          d.records++;
+    else if (d.printable) d.text++;
+    else                  d.bad++;
+  }
+  d.n         = 0;
+  d.over      = false;
+  d.printable = true;
+  return ok;
+}
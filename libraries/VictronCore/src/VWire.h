@@ -0,0 +1,90 @@
+#pragma once
+
+/* Binary output: one reading a record, COBS framed and CRC checked, in place of the
+report line (~80 chars), so the UART carries 3 to 4 times the readings.
+
+A record, before framing:
+  kind & device (1)  kind (VWIRE_...) in the top 3 bits, the device's index in the targets below
+  millis() (3)       when the frame was received, the low 24 bits (4.6 hours)
+  the reading, by kind:
+    VWIRE_BM      valid & aux (1: aux in the top 2 bits) duds (1) battV (2) auxVal (3) battA (3)
+                  usedAh (3) soc (2) ttgMin (2) alarmBits (2)
+    VWIRE_SC      valid (1) duds (1) battV (2) battA (2) yield10Wh (2) pvW (2) loadA (2) state (1)
+                  error (1)
+    VWIRE_RECORD  record type (1) the 16 decrypted bytes: any type, decodeRecord() at the far end
+    VWIRE_DEVICE  address (6, as displayed) name (the rest, up to VWIRE_NAME - 1): which device an
+                  index is. Sent for every target as the output starts and every VWIRE_ANNOUNCE_MS
+  CRC-16 (2) of all the above (CCITT: 0x1021 from 0xFFFF)
+All little endian, values as decoded (VDecode.h, the record's own integer units). duds has
+a bit per dud test field (VOutlier.h) and VWIRE_DUD_AUX for an unexpected aux mode. The
+stream decoder takes the time back to 32 bits from the records before it (within 2.3 hours
+either way), and device records go out every 10 secs, so it never loses track.
+
+Each record is framed by COBS (Consistent Overhead Byte Stuffing): its zeros are coded
+away, for 1 byte more (per 254), and the frame ends with a 0. A reader that starts mid
+stream, or meets text or a corrupt byte, loses that one record and picks up at the next 0.
+A Battery Monitor reading is 25 bytes, 27 on the wire, a Solar Controller one 20 (22).
+
+Encoding and decoding are both here, with no Arduino dependencies: the sketches write
+records ("B"), host/wiredump and the benchmarks read them. Nothing is allocated. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "VDecode.h"
+
+#define VWIRE_MAX          40     // largest record, CRC included
+#define VWIRE_FRAME_MAX   (VWIRE_MAX + 2)   // framed: + the COBS code byte (1 per 254) and the 0
+#define VWIRE_NAME         24     // bytes per device name, with the 0
+#define VWIRE_ANNOUNCE_MS  10000  // VWIRE_DEVICE records repeated this often
+#define VWIRE_DUD_AUX      0x80   // duds: aux mode not as expected
+
+enum : uint8_t {                  // record kinds
+  VWIRE_DEVICE = 1,
+  VWIRE_BM,
+  VWIRE_SC,
+  VWIRE_RECORD,
+};
+
+struct VWireRecord {
+  uint8_t  kind;
+  uint8_t  dev;                   // index in the targets, 0 - 31
+  uint32_t ms;                    // wireDecode(): the low 24 bits only, wirePut(): all 32
+  uint8_t  duds;                  // VWIRE_BM & VWIRE_SC
+  BatteryMonitorReading bm;       // VWIRE_BM
+  SolarChargerReading   sc;       // VWIRE_SC
+  uint8_t  type;                  // VWIRE_RECORD: record type ...
+  uint8_t  data[16];              // ... and its decrypted bytes
+  uint64_t mac;                   // VWIRE_DEVICE
+  char     name[VWIRE_NAME];
+};
+
+// a reading, framed, into out: bytes written
+size_t wireBM    (uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint8_t duds, const BatteryMonitorReading &r);
+size_t wireSC    (uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint8_t duds, const SolarChargerReading &r);
+size_t wireRecord(uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint8_t type, const uint8_t rec[16]);
+size_t wireDevice(uint8_t out[VWIRE_FRAME_MAX], uint8_t dev, uint32_t ms, uint64_t mac, const char *name);
+
+// one frame (its 0 not included) into r. false if not a whole, good record
+bool wireDecode(const uint8_t *frame, size_t n, VWireRecord &r);
+
+// reads a stream a byte at a time
+struct VWireDecoder {
+  uint8_t  buf[VWIRE_FRAME_MAX];
+  uint16_t n;
+  bool     over;                  // frame longer than any record: skipped to its 0
+  bool     printable;             // every byte so far is text
+  uint32_t ms;                    // time of the last record
+  uint32_t records;               // good records
+  uint32_t text;                  // frames of text only (the sketch's messages), not counted bad
+  uint32_t bad;                   // frames dropped: not COBS, CRC, length or kind wrong
+};
+void initWireDecoder(VWireDecoder &d);
+// the next byte: true when it ends a good record, then in r
+bool wirePut(VWireDecoder &d, uint8_t b, VWireRecord &r);
+
+// COBS: n bytes from in, coded into out (n + 1 + n / 254 bytes, no 0 added), bytes written
+size_t cobsEncode(const uint8_t *in, size_t n, uint8_t *out);
+// back into out, at most max bytes: bytes decoded, 0 if not valid COBS
+size_t cobsDecode(const uint8_t *in, size_t n, uint8_t *out, size_t max);
+// CRC-16/CCITT-FALSE
+uint16_t crc16(const uint8_t *p, size_t n);
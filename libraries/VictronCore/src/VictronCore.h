@@ -0,0 +1,23 @@
+#pragma once
+
+// Everything in the VictronCore library, in one include
+#include "VDecode.h"
+#include "VLayout.h"
+#include "VRecord.h"
+#include "VAes.h"
+#include "VDevices.h"
+#include "VRing.h"
+#include "VFormat.h"
+#include "VHistory.h"
+#include "VAggregate.h"
+#include "VCapture.h"
+#include "VLatency.h"
+#include "VStats.h"
+#include "VSchedule.h"
+#include "VPipeline.h"
+#include "VOutlier.h"
+#include "VConfig.h"
+#include "VWire.h"
+#include "VMetrics.h"
+#include "VEnergy.h"
+#include "VBalance.h"